@@ -24,6 +24,7 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Allocator.h"
+#include "llvm/Support/Mutex.h"
 // FIXME: Enhance libsystem to support inode and other fields in stat.
 #include <sys/types.h>
 
@@ -117,9 +118,14 @@ public:
 /// on "inode", so that a file with two names (e.g. symlinked) will be treated
 /// as a single file.
 ///
+/// Lookups may come from several threads at once, so that the workers of a
+/// SourceManager (see SourceManager::enableWorkers) share one FileManager.
 class FileManager : public RefCountedBase<FileManager> {
   FileSystemOptions FileSystemOpts;
 
+  /// \brief Guards the caches and the statistics below.
+  mutable llvm::sys::Mutex Lock;
+
   class UniqueDirContainer;
   class UniqueFileContainer;
 
@@ -246,7 +252,8 @@ public:
   /// FileManager's FileSystemOptions.
   bool getNoncachedStatValue(StringRef Path, struct stat &StatBuf);
 
-  /// \brief Remove the real file \p Entry from the cache.
+  /// \brief Remove the real file \p Entry from the cache, under every name
+  /// it was found by, so that the next lookup stats it again.
   void invalidateCache(const FileEntry *Entry);
 
   /// \brief If path is not absolute and FileSystemOptions set the working
@@ -0,0 +1,114 @@
+//===--- FrozenIdentifierTable.h - Shared read-only identifiers -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the FrozenIdentifierTable class, an immutable set of
+/// identifier spellings shared by the IdentifierTables of many units.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FROZENIDENTIFIERTABLE_H
+#define LLVM_VLANG_FROZENIDENTIFIERTABLE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class IdentifierTable;
+
+/// \brief A read-only, open-addressing hash table of identifier spellings
+/// that IdentifierTables consult before their own hash table.
+///
+/// The same signal, macro and keyword names show up in every unit of a
+/// design.  A FrozenIdentifierTable holds them once, in a single flat block
+/// that can be written to disk and mapped back in:
+///
+///  - a 64-byte header,
+///  - a power-of-two array of 8-byte buckets, each holding the full hash of
+///    a name and its ID, so that eight buckets share a cache line,
+///  - the offset of each name's characters, indexed by ID, and
+///  - the names themselves, each preceded by its length plus one as a 16-bit
+///    little-endian value, in the layout IdentifierInfo::getNameStart()
+///    expects of externally stored identifiers.
+///
+/// The table is never modified after it is built, so lookups need no
+/// locking and any number of threads can share one instance.  The
+/// IdentifierInfo objects themselves stay per-unit, since they carry macro
+/// and front-end state; see IdentifierTable::setFrozenBase().
+class FrozenIdentifierTable {
+  /// \brief Backing storage when the table was built in memory.
+  std::vector<char> Storage;
+
+  /// \brief Backing storage when the table was loaded from disk.
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+
+  const char *Data;
+  unsigned NumBuckets;
+  unsigned NumIdentifiers;
+  const uint32_t *Buckets;
+  const uint32_t *Offsets;
+  const char *Strings;
+
+  FrozenIdentifierTable();
+  FrozenIdentifierTable(const FrozenIdentifierTable &) LLVM_DELETED_FUNCTION;
+  void operator=(const FrozenIdentifierTable &) LLVM_DELETED_FUNCTION;
+
+  /// \brief Point the accessors at a validated image of \p Size bytes.
+  bool init(const char *Image, size_t Size);
+
+public:
+  ~FrozenIdentifierTable();
+
+  /// \brief Build a table holding every identifier in \p Table, including
+  /// those it found in its own frozen base.
+  static FrozenIdentifierTable *create(const IdentifierTable &Table);
+
+  /// \brief Map a table written by writeToFile().  Returns null and sets
+  /// \p ErrorStr if the file cannot be read or is not a valid table.
+  static FrozenIdentifierTable *loadFromFile(StringRef Path,
+                                             std::string &ErrorStr);
+
+  /// \brief Write the table image to \p Path.  Returns true on error.
+  bool writeToFile(StringRef Path, std::string &ErrorStr) const;
+
+  /// \brief Compute the hash used to place \p Name in the table.
+  static unsigned hash(StringRef Name);
+
+  /// \brief Find \p Name, returning its ID in \p ID.
+  bool lookup(StringRef Name, unsigned &ID) const {
+    return lookup(Name, hash(Name), ID);
+  }
+  bool lookup(StringRef Name, unsigned Hash, unsigned &ID) const;
+
+  /// \brief Return the null-terminated spelling of the identifier \p ID.
+  const char *getNameStart(unsigned ID) const {
+    return Strings + Offsets[ID];
+  }
+
+  /// \brief Return the spelling of the identifier \p ID.
+  StringRef getName(unsigned ID) const {
+    const unsigned char *P = (const unsigned char *)getNameStart(ID);
+    return StringRef((const char *)P, (P[-2] | (P[-1] << 8)) - 1);
+  }
+
+  unsigned size() const { return NumIdentifiers; }
+};
+
+} // end namespace vlang
+
+#endif
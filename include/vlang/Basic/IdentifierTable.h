@@ -16,9 +16,11 @@
 #ifndef LLVM_VLANG_BASIC_IDENTIFIERTABLE_H
 #define LLVM_VLANG_BASIC_IDENTIFIERTABLE_H
 
+#include "vlang/Basic/FrozenIdentifierTable.h"
 #include "vlang/Basic/LLVM.h"
 #include "vlang/Basic/OperatorKinds.h"
 #include "vlang/Basic/TokenKinds.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/PointerLikeTypeTraits.h"
@@ -263,6 +265,16 @@ namespace vlang {
 
 		IdentifierInfoLookup* ExternalLookup;
 
+		/// \brief Shared, read-only identifier spellings consulted before
+		/// HashTable, or null.
+		const FrozenIdentifierTable *FrozenBase;
+
+		/// \brief The IdentifierInfos created for names found in FrozenBase,
+		/// indexed by their ID there.
+		llvm::DenseMap<unsigned, IdentifierInfo*> FrozenOverlay;
+
+		IdentifierInfo *getFrozenInfo(unsigned ID, bool UseExternalLookup);
+
 	public:
 		/// \brief Create the identifier table, populating it with info about the
 		/// language keywords for the language specified by \p LangOpts.
@@ -283,9 +295,36 @@ namespace vlang {
 			return HashTable.getAllocator();
 		}
 
+		/// \brief Look up names in \p Base before this table's own hash table.
+		///
+		/// Identifiers found in \p Base get an IdentifierInfo of this table
+		/// the first time they are looked up, which spells its name from
+		/// \p Base; their spelling is neither copied nor added to the hash
+		/// table.  \p Base is immutable, so any number of tables, e.g. one
+		/// per thread, can share it.  It must outlive this table.
+		///
+		/// Identifiers that were already created in this table, such as the
+		/// keywords, keep their IdentifierInfo.
+		void setFrozenBase(const FrozenIdentifierTable *Base) {
+			FrozenBase = Base;
+			FrozenOverlay.clear();
+		}
+
+		const FrozenIdentifierTable *getFrozenBase() const {
+			return FrozenBase;
+		}
+
 		/// \brief Return the identifier token info for the specified named
 		/// identifier.
 		IdentifierInfo &get(StringRef Name) {
+			unsigned FrozenID;
+			if (FrozenBase && FrozenBase->lookup(Name, FrozenID)) {
+				IdentifierInfo *&II = FrozenOverlay[FrozenID];
+				if (!II)
+					II = getFrozenInfo(FrozenID, /*UseExternalLookup=*/true);
+				return *II;
+			}
+
 			llvm::StringMapEntry<IdentifierInfo*> &Entry =
 				HashTable.GetOrCreateValue(Name);
 
@@ -328,6 +367,14 @@ namespace vlang {
 		/// introduce or modify an identifier. If they called get(), they would
 		/// likely end up in a recursion.
 		IdentifierInfo &getOwn(StringRef Name) {
+			unsigned FrozenID;
+			if (FrozenBase && FrozenBase->lookup(Name, FrozenID)) {
+				IdentifierInfo *&II = FrozenOverlay[FrozenID];
+				if (!II)
+					II = getFrozenInfo(FrozenID, /*UseExternalLookup=*/false);
+				return *II;
+			}
+
 			llvm::StringMapEntry<IdentifierInfo*> &Entry =
 				HashTable.GetOrCreateValue(Name);
 
@@ -347,6 +394,8 @@ namespace vlang {
 			return *II;
 		}
 
+		/// Iteration only visits identifiers in this table's own hash table;
+		/// names found in the frozen base are not included.
 		typedef HashTableTy::const_iterator iterator;
 		typedef HashTableTy::const_iterator const_iterator;
 
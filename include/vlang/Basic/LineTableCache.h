@@ -0,0 +1,79 @@
+//===--- LineTableCache.h - On-disk cache of line offsets -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the LineTableCache class, which keeps the line offset
+/// tables of large source files in sidecar files between runs.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LINETABLECACHE_H
+#define LLVM_VLANG_LINETABLECACHE_H
+
+#include "vlang/Basic/LLVM.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class FileEntry;
+
+/// \brief A directory of sidecar files holding the line offset tables that
+/// SourceManager computes for large files.
+///
+/// Each sidecar is a small header identifying the file contents it was
+/// computed from, followed by the raw array of line start offsets in host
+/// byte order. Sidecars are mapped into memory and used in place, so a file
+/// that has not changed since the last run never has to be rescanned for
+/// newlines. A sidecar whose header does not match the file is ignored.
+class LineTableCache {
+  std::string Dir;
+
+  /// \brief The sidecars mapped so far; their contents back the line tables
+  /// of the corresponding ContentCaches.
+  std::vector<llvm::MemoryBuffer *> Tables;
+
+  // Statistics.
+  unsigned NumHits, NumMisses, NumStores;
+
+  LineTableCache(const LineTableCache &) LLVM_DELETED_FUNCTION;
+  void operator=(const LineTableCache &) LLVM_DELETED_FUNCTION;
+
+  std::string getSidecarPath(const FileEntry *Entry) const;
+
+public:
+  /// \brief Files smaller than this are rescanned rather than cached.
+  static const unsigned MinFileSize = 1U << 20;
+
+  explicit LineTableCache(StringRef Dir);
+  ~LineTableCache();
+
+  /// \brief Look up the line table of \p Entry.
+  ///
+  /// On success, \p Offsets points at \p NumLines line start offsets which
+  /// remain valid for the lifetime of this object.
+  bool lookup(const FileEntry *Entry, const unsigned *&Offsets,
+              unsigned &NumLines);
+
+  /// \brief Write the complete line table of \p Entry to its sidecar.
+  ///
+  /// Failures are silently ignored; the cache is only an optimization.
+  void store(const FileEntry *Entry, const unsigned *Offsets,
+             unsigned NumLines);
+
+  void PrintStats() const;
+};
+
+} // end namespace vlang
+
+#endif
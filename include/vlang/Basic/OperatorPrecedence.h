@@ -47,8 +47,21 @@ namespace prec {
   };
 }
 
+/// \brief The precedence of each token kind as a binary operator, indexed by
+/// token kind; prec::Unknown for tokens that are not binary operators.
+extern const unsigned char BinOpPrecedenceTable[tok::NUM_TOKENS];
+
 /// \brief Return the precedence of the specified binary operator token.
-prec::Level getBinOpPrecedence(tok::TokenKind Kind);
+inline prec::Level getBinOpPrecedence(tok::TokenKind Kind) {
+  return static_cast<prec::Level>(BinOpPrecedenceTable[Kind]);
+}
+
+/// \brief Return true if operators of the given precedence group from the
+/// right, as in "a ? b : c ? d : e" or "a -> b -> c".
+inline bool isRightAssociative(prec::Level Level) {
+  return Level == prec::Assignment || Level == prec::Implication ||
+         Level == prec::Conditional;
+}
 
 }  // end namespace vlang
 
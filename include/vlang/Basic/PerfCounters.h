@@ -0,0 +1,125 @@
+//===--- PerfCounters.h - Front end performance counters --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines scoped phase timers and event counters for the lexer,
+/// preprocessor and parser, with a flat summary and Chrome trace output.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_PERFCOUNTERS_H
+#define LLVM_VLANG_PERFCOUNTERS_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/Support/DataTypes.h"
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace vlang {
+
+/// \brief Instrumentation of the front end's hot paths.
+///
+/// Each thread keeps its own call counts, self and inclusive times per
+/// phase, and event counts, so recording never takes a lock.  Times are read
+/// from the processor's cycle counter where one is available and converted
+/// to wall time when reported.
+///
+/// Instrumentation is off by default; a disabled PhaseScope or count() costs
+/// a load and a branch.  Call enable() before any thread starts work, and
+/// print the results once all threads have finished.
+namespace perf {
+
+enum Phase {
+#define PERF_PHASE(Name, Desc) Name,
+#include "vlang/Basic/PerfCounters.def"
+  NumPhases
+};
+
+enum Counter {
+#define PERF_COUNTER(Name, Desc) Name,
+#include "vlang/Basic/PerfCounters.def"
+  NumCounters
+};
+
+class ThreadState;
+
+/// \brief Whether instrumentation is enabled; use isEnabled().
+extern bool EnabledFlag;
+
+inline bool isEnabled() { return EnabledFlag; }
+
+/// \brief Start recording.
+///
+/// \param RecordEvents Keep each phase instance at least \p GranularityUS
+/// microseconds long, for writeChromeTrace().
+void enable(bool RecordEvents = false, unsigned GranularityUS = 100);
+
+/// \brief Add \p N to the calling thread's counter \p C.
+void addCount(Counter C, uint64_t N);
+
+inline void count(Counter C, uint64_t N = 1) {
+  if (EnabledFlag)
+    addCount(C, N);
+}
+
+/// \brief Times the enclosing scope as an instance of a phase.
+///
+/// Time spent in nested PhaseScopes is subtracted from this phase's self
+/// time.  Recursive instances of a phase count once in its inclusive time.
+///
+/// Phases whose instances are too short to time one by one, such as lexing
+/// a token, can be sampled instead: only one instance in every \p Period is
+/// timed, and it counts as \p Period instances.
+class PhaseScope {
+  ThreadState *TS;
+  Phase P;
+  unsigned Weight;
+  uint64_t Start;
+  uint64_t SavedChildTicks;
+
+  PhaseScope(const PhaseScope &) LLVM_DELETED_FUNCTION;
+  void operator=(const PhaseScope &) LLVM_DELETED_FUNCTION;
+
+  void begin();
+  void end();
+
+public:
+  explicit PhaseScope(Phase P) : TS(0), P(P), Weight(1) {
+    if (EnabledFlag)
+      begin();
+  }
+
+  /// \brief Time this instance if it is the last of a period of \p Period
+  /// instances, a power of two, counted in \p Counter.  The caller keeps
+  /// the counter, so that the instances that are not timed cost no
+  /// thread-local lookup.
+  PhaseScope(Phase P, unsigned &Counter, unsigned Period)
+    : TS(0), P(P), Weight(Period) {
+    if (EnabledFlag && (++Counter & (Period - 1)) == 0)
+      begin();
+  }
+  ~PhaseScope() {
+    if (TS)
+      end();
+  }
+};
+
+/// \brief Print the totals of all threads as a table.
+void printSummary(raw_ostream &OS);
+
+/// \brief Write the recorded phase instances in the Chrome trace event
+/// format, for chrome://tracing or Perfetto.
+void writeChromeTrace(raw_ostream &OS);
+
+} // end namespace perf
+} // end namespace vlang
+
+#endif
@@ -48,6 +48,8 @@
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadLocal.h"
 #include <cassert>
 #include <map>
 #include <vector>
@@ -58,6 +60,7 @@ class DiagnosticsEngine;
 class SourceManager;
 class FileManager;
 class FileEntry;
+class LineTableCache;
 class LineTableInfo;
 class LangOptions;
 class ASTWriter;
@@ -113,11 +116,13 @@ namespace SrcMgr {
 
     /// \brief A bump pointer allocated array of offsets for each source line.
     ///
-    /// This is lazily computed.  This is owned by the SourceManager
-    /// BumpPointerAllocator object.
+    /// This is lazily computed, a chunk at a time, so it only covers the
+    /// lines up to LineScanOffset unless LinesComplete is set.  This is owned
+    /// by the SourceManager BumpPointerAllocator object, or points into a
+    /// sidecar mapped by its LineTableCache.
     unsigned *SourceLineCache;
 
-    /// \brief The number of lines in this ContentCache.
+    /// \brief The number of lines in SourceLineCache.
     ///
     /// This is only valid if SourceLineCache is non-null.
     unsigned NumLines : 31;
@@ -132,16 +137,28 @@ namespace SrcMgr {
     /// \brief True if this content cache was initially created for a source
     /// file considered as a system one.
     unsigned IsSystemFile : 1;
+
+    /// \brief True if SourceLineCache covers the whole buffer.
+    unsigned LinesComplete : 1;
+
+    /// \brief The offset at which scanning for line starts stopped; always the
+    /// start of a line.
+    unsigned LineScanOffset;
+
+    /// \brief The number of entries allocated for SourceLineCache.
+    unsigned LineCacheCapacity;
     
     ContentCache(const FileEntry *Ent = 0)
       : Buffer(0, false), OrigEntry(Ent), ContentsEntry(Ent),
         SourceLineCache(0), NumLines(0), BufferOverridden(false),
-        IsSystemFile(false) {}
+        IsSystemFile(false), LinesComplete(false), LineScanOffset(0),
+        LineCacheCapacity(0) {}
     
     ContentCache(const FileEntry *Ent, const FileEntry *contentEnt)
       : Buffer(0, false), OrigEntry(Ent), ContentsEntry(contentEnt),
         SourceLineCache(0), NumLines(0), BufferOverridden(false),
-        IsSystemFile(false) {}
+        IsSystemFile(false), LinesComplete(false), LineScanOffset(0),
+        LineCacheCapacity(0) {}
     
     ~ContentCache();
     
@@ -150,7 +167,8 @@ namespace SrcMgr {
     /// is not transferred, so this is a logical error.
     ContentCache(const ContentCache &RHS)
       : Buffer(0, false), SourceLineCache(0), BufferOverridden(false),
-        IsSystemFile(false)
+        IsSystemFile(false), LinesComplete(false), LineScanOffset(0),
+        LineCacheCapacity(0)
     {
       OrigEntry = RHS.OrigEntry;
       ContentsEntry = RHS.ContentsEntry;
@@ -219,6 +237,14 @@ namespace SrcMgr {
       return (Buffer.getInt() & DoNotFreeFlag) == 0;
     }
 
+    /// \brief Take over the buffer of \p RHS, which must have been read by
+    /// getBuffer(), along with its flags.
+    void takeBuffer(ContentCache &RHS) {
+      assert(!Buffer.getPointer() && "MemoryBuffer already set.");
+      Buffer = RHS.Buffer;
+      RHS.Buffer.setPointer(0);
+    }
+
   private:
     // Disable assignments.
     ContentCache &operator=(const ContentCache& RHS) LLVM_DELETED_FUNCTION;
@@ -233,22 +259,29 @@ namespace SrcMgr {
   ///
   /// FileInfos contain a "ContentCache *", with the contents of the file.
   ///
+  /// FileInfo is kept 4-byte aligned and no larger than ExpansionInfo so that
+  /// an SLocEntry takes 16 bytes.  Macro-heavy code creates far more
+  /// expansion entries than file entries, and each of them pays for the size
+  /// of the union.
+  ///
   class FileInfo {
     /// \brief The location of the \#include that brought in this file.
     ///
     /// This is an invalid SLOC for the main file (top of the \#include chain).
     unsigned IncludeLoc;  // Really a SourceLocation
 
-    /// \brief Number of FileIDs (files and macros) that were created during
-    /// preprocessing of this \#include, including this SLocEntry.
-    ///
-    /// Zero means the preprocessor didn't provide such info for this SLocEntry.
-    unsigned NumCreatedFIDs;
-
     /// \brief Contains the ContentCache* and the bits indicating the
     /// characteristic of the file and whether it has \#line info, all
-    /// bitmangled together.
-    uintptr_t Data;
+    /// bitmangled together and split into two 32-bit halves.
+    unsigned DataLo, DataHi;
+
+    uintptr_t getData() const {
+      return (uintptr_t)(((uint64_t)DataHi << 32) | DataLo);
+    }
+    void setData(uintptr_t Data) {
+      DataLo = (unsigned)Data;
+      DataHi = (unsigned)((uint64_t)Data >> 32);
+    }
 
     friend class vlang::SourceManager;
     friend class vlang::ASTWriter;
@@ -259,11 +292,10 @@ namespace SrcMgr {
                         CharacteristicKind FileCharacter) {
       FileInfo X;
       X.IncludeLoc = IL.getRawEncoding();
-      X.NumCreatedFIDs = 0;
-      X.Data = (uintptr_t)Con;
-      assert((X.Data & 7) == 0 &&"ContentCache pointer insufficiently aligned");
+      uintptr_t Data = (uintptr_t)Con;
+      assert((Data & 7) == 0 && "ContentCache pointer insufficiently aligned");
       assert((unsigned)FileCharacter < 4 && "invalid file character");
-      X.Data |= (unsigned)FileCharacter;
+      X.setData(Data | (unsigned)FileCharacter);
       return X;
     }
 
@@ -271,21 +303,21 @@ namespace SrcMgr {
       return SourceLocation::getFromRawEncoding(IncludeLoc);
     }
     const ContentCache* getContentCache() const {
-      return reinterpret_cast<const ContentCache*>(Data & ~uintptr_t(7));
+      return reinterpret_cast<const ContentCache*>(getData() & ~uintptr_t(7));
     }
 
     /// \brief Return whether this is a system header or not.
     CharacteristicKind getFileCharacteristic() const {
-      return (CharacteristicKind)(Data & 3);
+      return (CharacteristicKind)(DataLo & 3);
     }
 
     /// \brief Return true if this FileID has \#line directives in it.
-    bool hasLineDirectives() const { return (Data & 4) != 0; }
+    bool hasLineDirectives() const { return (DataLo & 4) != 0; }
 
     /// \brief Set the flag that indicates that this FileID has
     /// line table entries associated with it.
     void setHasLineDirectives() {
-      Data |= 4;
+      DataLo |= 4;
     }
   };
 
@@ -531,10 +563,10 @@ typedef ArrayRef<std::pair<std::string, FullSourceLoc> > ModuleBuildStack;
 /// the case of a macro expansion, for example, the spelling location indicates
 /// where the expanded token came from and the expansion location specifies
 /// where it was expanded.
+///
+/// Several threads can share one SourceManager once enableWorkers() is
+/// called; see beginWorker().
 class SourceManager : public RefCountedBase<SourceManager> {
-  /// \brief DiagnosticsEngine object.
-  DiagnosticsEngine &Diag;
-
   FileManager &FileMgr;
 
   mutable llvm::BumpPtrAllocator ContentCacheAlloc;
@@ -579,23 +611,12 @@ class SourceManager : public RefCountedBase<SourceManager> {
   /// as they do not refer to a file.
   std::vector<SrcMgr::ContentCache*> MemBufferInfos;
 
-  /// \brief The table of SLocEntries that are local to this module.
-  ///
-  /// Positive FileIDs are indexes into this table. Entry 0 indicates an invalid
-  /// expansion.
-  SmallVector<SrcMgr::SLocEntry, 0> LocalSLocEntryTable;
-
   /// \brief The table of SLocEntries that are loaded from other modules.
   ///
   /// Negative FileIDs are indexes into this table. To get from ID to an index,
   /// use (-ID - 2).
   mutable SmallVector<SrcMgr::SLocEntry, 0> LoadedSLocEntryTable;
 
-  /// \brief The starting offset of the next local SLocEntry.
-  ///
-  /// This is LocalSLocEntryTable.back().Offset + the size of that entry.
-  unsigned NextLocalOffset;
-
   /// \brief The starting offset of the latest batch of loaded SLocEntries.
   ///
   /// This is LoadedSLocEntryTable.back().Offset, except that that entry might
@@ -615,39 +636,13 @@ class SourceManager : public RefCountedBase<SourceManager> {
   /// \brief An external source for source location entries.
   ExternalSLocEntrySource *ExternalSLocEntries;
 
-  /// \brief A one-entry cache to speed up getFileID.
-  ///
-  /// LastFileIDLookup records the last FileID looked up or created, because it
-  /// is very common to look up many tokens from the same file.
-  mutable FileID LastFileIDLookup;
-
   /// \brief Holds information for \#line directives.
   ///
   /// This is referenced by indices from SLocEntryTable.
   LineTableInfo *LineTable;
 
-  /// \brief These ivars serve as a cache used in the getLineNumber
-  /// method which is used to speedup getLineNumber calls to nearby locations.
-  mutable FileID LastLineNoFileIDQuery;
-  mutable SrcMgr::ContentCache *LastLineNoContentCache;
-  mutable unsigned LastLineNoFilePos;
-  mutable unsigned LastLineNoResult;
-
-  /// \brief The file ID for the main source file of the translation unit.
-  FileID MainFileID;
-
-  /// \brief The file ID for the precompiled preamble there is one.
-  FileID PreambleFileID;
-
-  // Statistics for -print-stats.
-  mutable unsigned NumLinearScans, NumBinaryProbes;
-
-  /// \brief Associates a FileID with its "included/expanded in" decomposed
-  /// location.
-  ///
-  /// Used to cache results from and speed-up \c getDecomposedIncludedLoc
-  /// function.
-  mutable llvm::DenseMap<FileID, std::pair<FileID, unsigned> > IncludedLocMap;
+  /// \brief Sidecar files holding the line tables of large files, if enabled.
+  OwningPtr<LineTableCache> LineCache;
 
   /// The key value into the IsBeforeInTUCache table.
   typedef std::pair<FileID, FileID> IsBeforeInTUCacheKey;
@@ -657,9 +652,125 @@ class SourceManager : public RefCountedBase<SourceManager> {
   typedef llvm::DenseMap<IsBeforeInTUCacheKey, InBeforeInTUCacheEntry>
           InBeforeInTUCache;
 
-  /// Cache results for the isBeforeInTranslationUnit method.
-  mutable InBeforeInTUCache IBTUCache;
-  mutable InBeforeInTUCacheEntry IBTUCacheOverflow;
+  /// \brief Lazily computed map of macro argument chunks to their expanded
+  /// source location.
+  typedef std::map<unsigned, SourceLocation> MacroArgsMap;
+
+  /// \brief The local SLocEntries one thread created, and the caches of the
+  /// queries it makes.
+  ///
+  /// Without workers the main state is the only one.  A worker thread has
+  /// its own, which owns the partition of the offset space and of the local
+  /// FileIDs that starts at Base, so that only that thread adds entries to
+  /// it, and its lookups never evict those of another thread.
+  struct LocalState {
+    /// \brief Where errors found by the queries of the thread are reported.
+    DiagnosticsEngine *Diag;
+
+    /// \brief The table of SLocEntries that are local to this module.
+    ///
+    /// The entry at index I has the FileID Base + I.  Entry 0 of the main
+    /// state indicates an invalid expansion.
+    SmallVector<SrcMgr::SLocEntry, 0> LocalSLocEntryTable;
+
+    /// \brief The FileID of the first entry and the first offset of the
+    /// partition.
+    unsigned Base;
+
+    /// \brief The starting offset of the next local SLocEntry.
+    ///
+    /// This is LocalSLocEntryTable.back().Offset + the size of that entry.
+    unsigned NextLocalOffset;
+
+    /// \brief The end of the partition of the offset space.
+    unsigned OffsetLimit;
+
+    /// \brief Number of FileIDs (files and macros) that were created during
+    /// preprocessing of each \#include, including its own SLocEntry.
+    ///
+    /// Only files the preprocessor reported are present.  This lives outside
+    /// of FileInfo to keep SLocEntry small.
+    llvm::DenseMap<FileID, unsigned> NumCreatedFIDs;
+
+    /// \brief The file ID for the main source file of the translation unit.
+    FileID MainFileID;
+
+    /// \brief The file ID for the precompiled preamble there is one.
+    FileID PreambleFileID;
+
+    /// \brief A one-entry cache to speed up getFileID.
+    ///
+    /// LastFileIDLookup records the last FileID looked up or created, because
+    /// it is very common to look up many tokens from the same file.
+    FileID LastFileIDLookup;
+
+    /// \brief These ivars serve as a cache used in the getLineNumber
+    /// method which is used to speedup getLineNumber calls to nearby
+    /// locations.
+    FileID LastLineNoFileIDQuery;
+    SrcMgr::ContentCache *LastLineNoContentCache;
+    unsigned LastLineNoFilePos;
+    unsigned LastLineNoResult;
+
+    /// \brief A cache used by getColumnNumber for positions on lines that
+    /// the line table does not cover yet: the bytes in
+    /// [LastColumnLineStart, LastColumnScanEnd) of LastColumnFileID are known
+    /// to hold no newline, and LastColumnLineStart is the start of a line.
+    FileID LastColumnFileID;
+    unsigned LastColumnLineStart;
+    unsigned LastColumnScanEnd;
+
+    // Statistics for -print-stats.
+    unsigned NumLinearScans, NumBinaryProbes;
+
+    /// \brief Associates a FileID with its "included/expanded in" decomposed
+    /// location.
+    ///
+    /// Used to cache results from and speed-up \c getDecomposedIncludedLoc
+    /// function.
+    llvm::DenseMap<FileID, std::pair<FileID, unsigned> > IncludedLocMap;
+
+    /// Cache results for the isBeforeInTranslationUnit method.
+    InBeforeInTUCache IBTUCache;
+    InBeforeInTUCacheEntry IBTUCacheOverflow;
+
+    llvm::DenseMap<FileID, MacroArgsMap *> MacroArgsCacheMap;
+
+    LocalState(DiagnosticsEngine &Diag, unsigned Base, unsigned OffsetLimit);
+    ~LocalState();
+
+    /// \brief Drop the entries and the caches, and start over at \p Base.
+    void reset(unsigned Base, unsigned OffsetLimit);
+
+  private:
+    LocalState(const LocalState &) LLVM_DELETED_FUNCTION;
+    void operator=(const LocalState &) LLVM_DELETED_FUNCTION;
+  };
+
+  /// \brief The state of every thread that is not a worker.
+  mutable LocalState MainState;
+
+  /// \brief The states of the partitions workers claim, partition P at
+  /// index P - 1.  Empty without workers.
+  std::vector<LocalState *> Workers;
+
+  /// \brief The number of Workers that have been claimed.
+  unsigned NumClaimedWorkers;
+
+  /// \brief The number of partitions, one more than there are workers.
+  ///
+  /// Partition P starts at the first X for which X * NumPartitions >> 31 is
+  /// P, so that finding the partition of a FileID or offset takes a multiply
+  /// rather than a divide.  Without workers this is one, so that every local
+  /// FileID and offset is in that of the main state.
+  unsigned NumPartitions;
+
+  /// \brief The state of the calling thread, if it is a worker.
+  mutable llvm::sys::ThreadLocal<LocalState> CurrentWorker;
+
+  /// \brief Guards what workers share: the content caches and their line
+  /// tables, the \#line table and the buffers used for recovery.
+  mutable llvm::sys::Mutex WorkerLock;
 
   /// Return the cache entry for comparing the given file IDs
   /// for isBeforeInTranslationUnit.
@@ -670,12 +781,6 @@ class SourceManager : public RefCountedBase<SourceManager> {
 
   mutable SrcMgr::ContentCache *FakeContentCacheForRecovery;
 
-  /// \brief Lazily computed map of macro argument chunks to their expanded
-  /// source location.
-  typedef std::map<unsigned, SourceLocation> MacroArgsMap;
-
-  mutable llvm::DenseMap<FileID, MacroArgsMap *> MacroArgsCacheMap;
-
   /// \brief The stack of modules being built, which is used to detect
   /// cycles in the module dependency graph as modules are being built, as
   /// well as to describe why we're rebuilding a particular module.
@@ -695,7 +800,10 @@ public:
 
   void clearIDTables();
 
-  DiagnosticsEngine &getDiagnostics() const { return Diag; }
+  /// \brief Return the diagnostics engine of the calling thread.
+  DiagnosticsEngine &getDiagnostics() const {
+    return *getLocalState().Diag;
+  }
 
   FileManager &getFileManager() const { return FileMgr; }
 
@@ -709,6 +817,47 @@ public:
   /// (likely to change while trying to use them).
   bool userFilesAreVolatile() const { return UserFilesAreVolatile; }
 
+  /// \brief Let up to \p NumWorkers threads create FileIDs and query
+  /// locations at the same time.
+  ///
+  /// The offset space and the local FileIDs are divided into
+  /// NumWorkers + 1 partitions of equal size.  The calling thread keeps the
+  /// first, which must hold the entries created so far, and each worker
+  /// claims one of the others in beginWorker(); running out of one is a
+  /// fatal error.  From then on a file is read as soon as its content cache
+  /// is created, so that the caches workers share do not change; loaded
+  /// entries and overriding file contents are not supported.
+  ///
+  /// \returns true if the entries created so far do not fit in a partition.
+  bool enableWorkers(unsigned NumWorkers);
+
+  /// \brief Whether enableWorkers() was called.
+  bool hasWorkers() const { return !Workers.empty(); }
+
+  /// \brief Make the calling thread a worker, whose errors are reported
+  /// through \p WorkerDiags.
+  ///
+  /// The FileIDs the thread creates from then on, its main file among them,
+  /// go into a partition of its own, and its queries are cached apart from
+  /// those of other threads.  A worker may look up its own locations and
+  /// those created before enableWorkers(); those of another worker only
+  /// once that one called endWorker() and the two threads synchronized,
+  /// e.g. by a join.
+  ///
+  /// \returns true if every partition has been claimed.
+  bool beginWorker(DiagnosticsEngine &WorkerDiags);
+
+  /// \brief Stop making the calling thread a worker.  The entries it created
+  /// stay, for any thread that synchronizes with this one to look up.
+  void endWorker();
+
+  /// \brief Keep the line tables of large files in sidecar files under
+  /// \p Dir, and reuse them for files that did not change.
+  void setLineTableCacheDir(StringRef Dir);
+
+  /// \brief Return the sidecar line table cache, or null if not enabled.
+  LineTableCache *getLineTableCache() const { return LineCache.get(); }
+
   /// \brief Retrieve the module build stack.
   ModuleBuildStack getModuleBuildStack() const {
     return StoredModuleBuildStack;
@@ -732,6 +881,7 @@ public:
   /// from STDIN.
   FileID createMainFileIDForMemBuffer(const llvm::MemoryBuffer *Buffer,
                              SrcMgr::CharacteristicKind Kind = SrcMgr::C_User) {
+    FileID &MainFileID = getLocalState().MainFileID;
     assert(MainFileID.isInvalid() && "MainFileID already set!");
     MainFileID = createFileIDForMemBuffer(Buffer, Kind);
     return MainFileID;
@@ -741,12 +891,14 @@ public:
   // MainFileID creation and querying methods.
   //===--------------------------------------------------------------------===//
 
-  /// \brief Returns the FileID of the main source file.
-  FileID getMainFileID() const { return MainFileID; }
+  /// \brief Returns the FileID of the main source file of the calling
+  /// thread.
+  FileID getMainFileID() const { return getLocalState().MainFileID; }
 
   /// \brief Create the FileID for the main source file.
   FileID createMainFileID(const FileEntry *SourceFile, 
                           SrcMgr::CharacteristicKind Kind = SrcMgr::C_User) {
+    FileID &MainFileID = getLocalState().MainFileID;
     assert(MainFileID.isInvalid() && "MainFileID already set!");
     MainFileID = createFileID(SourceFile, SourceLocation(), Kind);
     return MainFileID;
@@ -754,18 +906,22 @@ public:
 
   /// \brief Set the file ID for the main source file.
   void setMainFileID(FileID FID) {
+    FileID &MainFileID = getLocalState().MainFileID;
     assert(MainFileID.isInvalid() && "MainFileID already set!");
     MainFileID = FID;
   }
 
   /// \brief Set the file ID for the precompiled preamble.
   void setPreambleFileID(FileID Preamble) {
+    FileID &PreambleFileID = getLocalState().PreambleFileID;
     assert(PreambleFileID.isInvalid() && "PreambleFileID already set!");
     PreambleFileID = Preamble;
   }
 
   /// \brief Get the file ID for the precompiled preamble if there is one.
-  FileID getPreambleFileID() const { return PreambleFileID; }
+  FileID getPreambleFileID() const {
+    return getLocalState().PreambleFileID;
+  }
 
   //===--------------------------------------------------------------------===//
   // Methods to create new FileID's and macro expansions.
@@ -882,8 +1038,8 @@ public:
       return getFakeBufferForRecovery();
     }
 
-    return Entry.getFile().getContentCache()->getBuffer(Diag, *this, Loc,
-                                                        Invalid);
+    return Entry.getFile().getContentCache()->getBuffer(getDiagnostics(),
+                                                        *this, Loc, Invalid);
   }
 
   const llvm::MemoryBuffer *getBuffer(FileID FID, bool *Invalid = 0) const {
@@ -896,7 +1052,8 @@ public:
       return getFakeBufferForRecovery();
     }
 
-    return Entry.getFile().getContentCache()->getBuffer(Diag, *this,
+    return Entry.getFile().getContentCache()->getBuffer(getDiagnostics(),
+                                                        *this,
                                                         SourceLocation(),
                                                         Invalid);
   }
@@ -933,12 +1090,11 @@ public:
   /// \brief Get the number of FileIDs (files and macros) that were created
   /// during preprocessing of \p FID, including it.
   unsigned getNumCreatedFIDsForFileID(FileID FID) const {
-    bool Invalid = false;
-    const SrcMgr::SLocEntry &Entry = getSLocEntry(FID, &Invalid);
-    if (Invalid || !Entry.isFile())
-      return 0;
-
-    return Entry.getFile().NumCreatedFIDs;
+    const llvm::DenseMap<FileID, unsigned> &NumCreatedFIDs =
+      getPartitionForID(FID.ID).NumCreatedFIDs;
+    llvm::DenseMap<FileID, unsigned>::const_iterator I =
+      NumCreatedFIDs.find(FID);
+    return I == NumCreatedFIDs.end() ? 0 : I->second;
   }
 
   /// \brief Set the number of FileIDs (files and macros) that were created
@@ -949,8 +1105,9 @@ public:
     if (Invalid || !Entry.isFile())
       return;
 
-    assert(Entry.getFile().NumCreatedFIDs == 0 && "Already set!");
-    const_cast<SrcMgr::FileInfo &>(Entry.getFile()).NumCreatedFIDs = NumFIDs;
+    unsigned &Slot = getPartitionForID(FID.ID).NumCreatedFIDs[FID];
+    assert(Slot == 0 && "Already set!");
+    Slot = NumFIDs;
   }
 
   //===--------------------------------------------------------------------===//
@@ -967,6 +1124,7 @@ public:
     unsigned SLocOffset = SpellingLoc.getOffset();
 
     // If our one-entry cache covers this offset, just return it.
+    FileID LastFileIDLookup = getLocalState().LastFileIDLookup;
     if (isOffsetInFileID(LastFileIDLookup, SLocOffset))
       return LastFileIDLookup;
 
@@ -1150,8 +1308,9 @@ public:
   bool isInSLocAddrSpace(SourceLocation Loc,
                          SourceLocation Start, unsigned Length,
                          unsigned *RelativeOffset = 0) const {
-    assert(((Start.getOffset() < NextLocalOffset &&
-               Start.getOffset()+Length <= NextLocalOffset) ||
+    assert(((Start.getOffset() < CurrentLoadedOffset &&
+               Start.getOffset()+Length <=
+                 getPartitionForOffset(Start.getOffset()).NextLocalOffset) ||
             (Start.getOffset() >= CurrentLoadedOffset &&
                 Start.getOffset()+Length < MaxLoadedOffset)) &&
            "Chunk is not valid SLoc address space");
@@ -1421,14 +1580,18 @@ public:
   ///
   void PrintStats() const;
 
-  /// \brief Get the number of local SLocEntries we have.
-  unsigned local_sloc_entry_size() const { return LocalSLocEntryTable.size(); }
+  /// \brief Get the number of local SLocEntries the calling thread has.
+  unsigned local_sloc_entry_size() const {
+    return getLocalState().LocalSLocEntryTable.size();
+  }
 
-  /// \brief Get a local SLocEntry. This is exposed for indexing.
+  /// \brief Get a local SLocEntry of the calling thread. This is exposed for
+  /// indexing.
   const SrcMgr::SLocEntry &getLocalSLocEntry(unsigned Index,
                                              bool *Invalid = 0) const {
-    assert(Index < LocalSLocEntryTable.size() && "Invalid index");
-    return LocalSLocEntryTable[Index];
+    const LocalState &State = getLocalState();
+    assert(Index < State.LocalSLocEntryTable.size() && "Invalid index");
+    return State.LocalSLocEntryTable[Index];
   }
 
   /// \brief Get the number of loaded SLocEntries we have.
@@ -1446,12 +1609,16 @@ public:
   const SrcMgr::SLocEntry &getSLocEntry(FileID FID, bool *Invalid = 0) const {
     if (FID.ID == 0 || FID.ID == -1) {
       if (Invalid) *Invalid = true;
-      return LocalSLocEntryTable[0];
+      return MainState.LocalSLocEntryTable[0];
     }
     return getSLocEntryByID(FID.ID);
   }
 
-  unsigned getNextLocalOffset() const { return NextLocalOffset; }
+  /// \brief Get the offset of the next local SLocEntry the calling thread
+  /// creates.
+  unsigned getNextLocalOffset() const {
+    return getLocalState().NextLocalOffset;
+  }
 
   void setExternalSLocEntrySource(ExternalSLocEntrySource *Source) {
     assert(LoadedSLocEntryTable.empty() &&
@@ -1475,7 +1642,7 @@ public:
 
   /// \brief Returns true if \p Loc did not come from a PCH/Module.
   bool isLocalSourceLocation(SourceLocation Loc) const {
-    return Loc.getOffset() < NextLocalOffset;
+    return Loc.getOffset() < getNextLocalOffset();
   }
 
   /// \brief Returns true if \p FID came from a PCH/Module.
@@ -1511,12 +1678,50 @@ private:
 
   const SrcMgr::SLocEntry &loadSLocEntry(unsigned Index, bool *Invalid) const;
 
+  /// \brief Return the state of the calling thread.
+  LocalState &getLocalState() const {
+    if (!Workers.empty())
+      if (LocalState *State = CurrentWorker.get())
+        return *State;
+    return MainState;
+  }
+
+  /// \brief Return the state whose partition holds the local FileID \p ID,
+  /// or the main state for a loaded one.
+  LocalState &getPartitionForID(int ID) const {
+    unsigned P = ID < 0 ? 0 : getPartitionIndex(static_cast<unsigned>(ID));
+    return P ? *Workers[P - 1] : MainState;
+  }
+
+  /// \brief Return the state whose partition holds the local offset
+  /// \p Offset.
+  LocalState &getPartitionForOffset(unsigned Offset) const {
+    assert(Offset < MaxLoadedOffset && "Not a local offset");
+    unsigned P = getPartitionIndex(Offset);
+    return P ? *Workers[P - 1] : MainState;
+  }
+
+  /// \brief Return the partition holding the local FileID or offset \p X.
+  unsigned getPartitionIndex(unsigned X) const {
+    return static_cast<unsigned>((static_cast<uint64_t>(X) * NumPartitions) >>
+                                 31);
+  }
+
+  /// \brief Return the first local FileID and offset of partition \p P.
+  unsigned getPartitionBase(unsigned P) const {
+    return static_cast<unsigned>(((static_cast<uint64_t>(P) << 31) +
+                                  NumPartitions - 1) / NumPartitions);
+  }
+
   /// \brief Get the entry with the given unwrapped FileID.
   const SrcMgr::SLocEntry &getSLocEntryByID(int ID) const {
     assert(ID != -1 && "Using FileID sentinel value");
     if (ID < 0)
       return getLoadedSLocEntryByID(ID);
-    return getLocalSLocEntry(static_cast<unsigned>(ID));
+    const LocalState &Partition = getPartitionForID(ID);
+    unsigned Index = static_cast<unsigned>(ID) - Partition.Base;
+    assert(Index < Partition.LocalSLocEntryTable.size() && "Invalid index");
+    return Partition.LocalSLocEntryTable[Index];
   }
 
   const SrcMgr::SLocEntry &getLoadedSLocEntryByID(int ID,
@@ -1542,9 +1747,14 @@ private:
     if (FID.ID == -2)
       return true;
 
-    // If it is the last local entry, then it does if the location is local.
-    if (FID.ID+1 == static_cast<int>(LocalSLocEntryTable.size()))
-      return SLocOffset < NextLocalOffset;
+    // If it is the last local entry of its partition, then it does if the
+    // location is local.
+    if (FID.ID >= 0) {
+      const LocalState &Partition = getPartitionForID(FID.ID);
+      if (static_cast<unsigned>(FID.ID) + 1 - Partition.Base ==
+            Partition.LocalSLocEntryTable.size())
+        return SLocOffset < Partition.NextLocalOffset;
+    }
 
     // Otherwise, the entry after it has to not include it. This works for both
     // local and loaded entries.
@@ -1570,7 +1780,7 @@ private:
   createMemBufferContentCache(const llvm::MemoryBuffer *Buf);
 
   FileID getFileIDSlow(unsigned SLocOffset) const;
-  FileID getFileIDLocal(unsigned SLocOffset) const;
+  FileID getFileIDLocal(const LocalState &Partition, unsigned SLocOffset) const;
   FileID getFileIDLoaded(unsigned SLocOffset) const;
 
   SourceLocation getExpansionLocSlowCase(SourceLocation Loc) const;
@@ -1582,6 +1792,8 @@ private:
   std::pair<FileID, unsigned>
   getDecomposedSpellingLocSlowCase(const SrcMgr::SLocEntry *E,
                                    unsigned Offset) const;
+  void ensureLineNumbers(SrcMgr::ContentCache *Content, bool &Invalid,
+                         unsigned FilePos, unsigned Line = 0) const;
   void computeMacroArgsCache(MacroArgsMap *&MacroArgsCache, FileID FID) const;
   void associateFileChunkWithMacroArgExp(MacroArgsMap &MacroArgsCache,
                                          FileID FID,
@@ -0,0 +1,37 @@
+//===--- StableHash.h - Hashes that are stable across runs ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines hashFNV1a, the hash of file contents and cache keys that
+/// are written to disk.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_BASIC_STABLEHASH_H
+#define LLVM_VLANG_BASIC_STABLEHASH_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+
+namespace vlang {
+
+/// \brief The 64-bit FNV-1a offset basis, the hash of no bytes.
+const uint64_t FNV1aOffsetBasis = 14695981039346656037ULL;
+
+/// \brief Continue the 64-bit FNV-1a hash \p Hash over the bytes of \p Data.
+///
+/// Unlike llvm::hash_value, the result does not depend on the host or the
+/// run, so it can be stored in files; changing it changes every format that
+/// stores it.
+uint64_t hashFNV1a(StringRef Data, uint64_t Hash = FNV1aOffsetBasis);
+
+}  // end namespace vlang
+
+#endif
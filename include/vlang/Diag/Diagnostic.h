@@ -22,7 +22,9 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/type_traits.h"
+#include <deque>
 #include <list>
 #include <vector>
 
@@ -252,6 +254,84 @@ private:
   typedef std::vector<DiagStatePoint> DiagStatePointsTy;
   mutable DiagStatePointsTy DiagStatePoints;
 
+  /// \brief Per-FileID index of the diagnostic state transitions, used to
+  /// answer "which state is active at this location" without comparing
+  /// locations in translation unit order.
+  ///
+  /// Each file records the offsets at which a new state becomes active. A
+  /// transition inside an included file or macro expansion is also recorded
+  /// in every parent at the offset where the child was entered, so a lookup
+  /// only needs to decompose the location once and search a single file.
+  /// The last answer is cached, which makes lookups for monotonically
+  /// advancing locations O(1).
+  class DiagStateIndex {
+    struct Transition {
+      unsigned Offset;
+      DiagState *State;
+      Transition(unsigned Offset, DiagState *State)
+        : Offset(Offset), State(State) { }
+    };
+
+    struct File {
+      /// \brief The file (or expansion) this one was entered from, or null
+      /// for a top-level file.
+      File *Parent;
+      unsigned ParentOffset;
+      /// \brief State transitions sorted by offset; the first one is always
+      /// at offset 0.
+      SmallVector<Transition, 2> Transitions;
+
+      File() : Parent(0), ParentOffset(0) { }
+
+      /// \brief Returns the index of the transition active at \p Offset.
+      unsigned lookup(unsigned Offset) const;
+    };
+
+    /// \brief The state active before any source location, i.e. the one set
+    /// up through the command line.
+    DiagState *FirstState;
+
+    /// \brief Owns the File records; a deque keeps the Parent pointers stable.
+    mutable std::deque<File> FileStorage;
+    mutable llvm::DenseMap<FileID, File *> Files;
+
+    /// \brief Cache of the last lookup: offsets [CachedBegin, CachedEnd) of
+    /// CachedFID all map to CachedState.
+    mutable FileID CachedFID;
+    mutable unsigned CachedBegin;
+    mutable unsigned CachedEnd;
+    mutable DiagState *CachedState;
+
+    File *getFile(const SourceManager &SM, FileID FID) const;
+
+  public:
+    DiagStateIndex()
+      : FirstState(0), CachedBegin(0), CachedEnd(0), CachedState(0) { }
+
+    /// \brief Forget all transitions; \p First becomes the state of every
+    /// location.
+    void clear(DiagState *First);
+
+    /// \brief Record that \p State becomes active at \p Loc. Locations must
+    /// be appended in translation unit order.
+    void append(const SourceManager &SM, SourceLocation Loc, DiagState *State);
+
+    /// \brief Returns the state active at the valid location \p Loc.
+    DiagState *lookup(const SourceManager &SM, SourceLocation Loc) const;
+
+    /// \brief Returns the number of files that have an index record.
+    unsigned getNumFiles() const { return Files.size(); }
+  };
+
+  /// \brief The index used by GetDiagStateForLoc, kept in sync with
+  /// DiagStatePoints unless DiagStateIndexIsStale is set.
+  mutable DiagStateIndex DiagStatesByLoc;
+
+  /// \brief Set when a point was inserted out of translation unit order;
+  /// the index is then rebuilt by the next GetDiagStateForLoc, so a run of
+  /// such inserts costs one rebuild rather than one each.
+  mutable bool DiagStateIndexIsStale;
+
   /// \brief Keeps the DiagState that was active during each diagnostic 'push'
   /// so we can get back at it when we 'pop'.
   std::vector<DiagState *> DiagStateOnPushStack;
@@ -270,12 +350,25 @@ private:
             DiagStatePoints.back().Loc.isBeforeInTranslationUnitThan(Loc)) &&
            "Previous point loc comes after or is the same as new one");
     DiagStatePoints.push_back(DiagStatePoint(State, Loc));
+    if (!DiagStateIndexIsStale)
+      DiagStatesByLoc.append(getSourceManager(), L, State);
   }
 
+  /// \brief Rebuild DiagStatesByLoc from DiagStatePoints, after a point was
+  /// inserted out of translation unit order.
+  void RebuildDiagStateIndex() const;
+
   /// \brief Finds the DiagStatePoint that contains the diagnostic state of
   /// the given source location.
+  ///
+  /// This compares locations in translation unit order and is only used when
+  /// the state is modified out of order; use GetDiagStateForLoc otherwise.
   DiagStatePointsTy::iterator GetDiagStatePointForLoc(SourceLocation Loc) const;
 
+  /// \brief Returns the diagnostic state in effect at the given source
+  /// location.
+  DiagState *GetDiagStateForLoc(SourceLocation Loc) const;
+
   /// \brief Sticky flag set to \c true when an error is emitted.
   bool ErrorOccurred;
 
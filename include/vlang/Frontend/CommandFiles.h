@@ -0,0 +1,55 @@
+//===--- CommandFiles.h - Verilog command files and plusargs ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the expansion of -f command files and the extraction of
+/// the plus-arguments of Verilog simulator command lines.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_COMMANDFILES_H
+#define LLVM_VLANG_FRONTEND_COMMANDFILES_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <string>
+#include <vector>
+
+namespace vlang {
+
+/// \brief The plus-arguments of a command line, which the option parser
+/// does not know the form of.
+struct PlusArgs {
+  /// \brief From +define+NAME[=VALUE]..., in the -D form "NAME=VALUE".
+  std::vector<std::string> Defines;
+  /// \brief From +incdir+DIR...
+  std::vector<std::string> IncludeDirs;
+  /// \brief From +libext+EXT..., such as ".v".
+  std::vector<std::string> LibraryExtensions;
+};
+
+/// ExpandCommandFiles - Copy \p Argv to \p Args, replacing each "-f FILE"
+/// with the arguments FILE holds, recursively.  A command file holds
+/// arguments separated by whitespace, with // and /* */ comments, "quoted"
+/// arguments, and $VAR, ${VAR} and $(VAR) environment references.  Paths
+/// in a command file are relative to the current directory, as in other
+/// tools.  Returns true and sets \p ErrorStr on error.
+bool ExpandCommandFiles(ArrayRef<const char *> Argv,
+                        std::vector<std::string> &Args,
+                        std::string &ErrorStr);
+
+/// ExtractPlusArgs - Move the +define+, +incdir+ and +libext+ arguments of
+/// \p Args to \p Plus.  Other plus-arguments are removed and appended to
+/// \p Unknown.
+void ExtractPlusArgs(std::vector<std::string> &Args, PlusArgs &Plus,
+                     std::vector<std::string> &Unknown);
+
+}  // end namespace vlang
+
+#endif
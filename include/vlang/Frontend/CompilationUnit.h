@@ -0,0 +1,65 @@
+//===--- CompilationUnit.h - Several files as one unit ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the support for parsing several files as one compilation
+/// unit, in which a `define of one file is visible in the files after it.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_COMPILATIONUNIT_H
+#define LLVM_VLANG_FRONTEND_COMPILATIONUNIT_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Lex/MacroState.h"
+#include "vlang/Lex/PPCallbacks.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <string>
+#include <vector>
+
+namespace vlang {
+
+class Preprocessor;
+
+/// getCompilationUnitSource - Return the text of a main file that makes
+/// \p Files one compilation unit: an `include of each, in order, by its
+/// absolute path.  One Preprocessor and one Parser then see every file, with
+/// the macros and the $unit declarations of those before it.
+std::string getCompilationUnitSource(ArrayRef<std::string> Files);
+
+/// \brief Records the macros defined as each file of a compilation unit
+/// from getCompilationUnitSource() is entered.
+///
+/// Snapshot \e i holds the `define directives that restore, in a fresh
+/// Preprocessor, the macros that files 0 to \e i-1 left defined, so that
+/// file \e i can be preprocessed on its own as it would be in the unit.
+/// A file that leaves the macro state as it found it, as most do, shares
+/// the text of the snapshot before it.
+class MacroSnapshotRecorder : public PPCallbacks {
+  Preprocessor &PP;
+  std::vector<std::string> Snapshots;
+  std::vector<MacroState> States;
+
+public:
+  explicit MacroSnapshotRecorder(Preprocessor &PP) : PP(PP) {}
+
+  virtual void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                           SrcMgr::CharacteristicKind FileType,
+                           FileID PrevFID);
+
+  /// \brief The snapshot taken as each file of the unit was entered.
+  const std::vector<std::string> &getSnapshots() const { return Snapshots; }
+
+  /// \brief The macro state as each file of the unit was entered.
+  const std::vector<MacroState> &getStates() const { return States; }
+};
+
+}  // end namespace vlang
+
+#endif
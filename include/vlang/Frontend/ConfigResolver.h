@@ -0,0 +1,105 @@
+//===--- ConfigResolver.h - Bind cell instances to libraries ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the ConfigResolver class, which binds the instances of a
+/// design to the libraries a configuration selects.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_CONFIGRESOLVER_H
+#define LLVM_VLANG_FRONTEND_CONFIGRESOLVER_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace vlang {
+
+class ConfigTable;
+class DesignUnitTable;
+struct ConfigRule;
+struct Configuration;
+
+/// \brief Binds each instance of a design, from its top cells down, to the
+/// library cell that a configuration selects for it (IEEE 1800 33.4).
+///
+/// An instance takes the rule of its configuration that names it, or else
+/// the one that names its cell, or else the default liblist.  A rule's
+/// liblist gives the libraries to search in order, and its use clause the
+/// library cell, or the configuration, to bind the instance to.  Without
+/// a rule or default liblist, the library of the parent is searched first,
+/// then the others in the order they were added.
+///
+/// Parameter overrides of use clauses are not applied.
+class ConfigResolver {
+public:
+  enum {
+    NoLibrary = ~0U
+  };
+
+  struct Binding {
+    /// \brief The hierarchical name of the instance, from its top cell.
+    std::string Path;
+    unsigned Library;
+    StringRef Cell;
+  };
+
+  struct Unbound {
+    std::string Path;
+    StringRef Cell;
+  };
+
+private:
+  struct Library {
+    StringRef Name;
+    const DesignUnitTable *Units;
+  };
+
+  const ConfigTable &Configs;
+  std::vector<Library> Libraries;
+  std::vector<Binding> Bindings;
+  std::vector<Unbound> Unresolved;
+
+  unsigned findLibrary(StringRef Name) const;
+  unsigned searchLibraries(ArrayRef<StringRef> Liblist, unsigned Parent,
+                           StringRef Cell) const;
+  const ConfigRule *findRule(const Configuration *Config, StringRef RelPath,
+                             StringRef Cell, unsigned Parent) const;
+  void bindTop(const Configuration *Config, StringRef Library,
+               StringRef Cell, const std::string &Path, unsigned Depth);
+  void bindInstance(const Configuration *Config, const std::string &RelPath,
+                    const std::string &Path, StringRef Cell, unsigned Parent,
+                    unsigned Depth);
+  void elaborate(const Configuration *Config, const std::string &RelPath,
+                 const std::string &Path, unsigned Library, StringRef Cell,
+                 unsigned Depth);
+
+public:
+  explicit ConfigResolver(const ConfigTable &Configs) : Configs(Configs) {}
+
+  /// \brief Add library \p Name with the design units parsed from its
+  /// files.  Libraries are searched in the order they are added.
+  void addLibrary(StringRef Name, const DesignUnitTable &Units);
+
+  /// \brief Bind the design of \p Config, or, if it is null, the design
+  /// whose top cells are those no library instantiates, with no rules.
+  void resolve(const Configuration *Config);
+
+  StringRef getLibraryName(unsigned L) const { return Libraries[L].Name; }
+
+  ArrayRef<Binding> getBindings() const { return Bindings; }
+  ArrayRef<Unbound> getUnresolved() const { return Unresolved; }
+};
+
+}  // end namespace vlang
+
+#endif
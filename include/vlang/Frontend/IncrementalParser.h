@@ -0,0 +1,228 @@
+//===--- IncrementalParser.h - Reparse edited design elements ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the IncrementalParser interface, which keeps a document
+/// parsed across edits for editors and language servers.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_INCREMENTALPARSER_H
+#define LLVM_VLANG_FRONTEND_INCREMENTALPARSER_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Basic/SourceLocation.h"
+#include "vlang/Basic/TokenKinds.h"
+#include "vlang/Diag/Diagnostic.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vlang {
+
+class FileManager;
+class FrozenIdentifierTable;
+class HeaderSearchOptions;
+class PreprocessorOptions;
+class Token;
+class TokenBuffer;
+
+/// \brief A diagnostic about a document, located by byte offset in the
+/// document's current text.
+struct DocumentDiagnostic {
+  DiagnosticsEngine::Level Level;
+
+  /// \brief Whether Offset is meaningful; diagnostics without a location,
+  /// or located in another file, have none.
+  bool HasOffset;
+  unsigned Offset;
+
+  std::string Message;
+};
+
+/// \brief One top-level design element of a document: a module, interface,
+/// package, class, or any other top-level declaration.
+struct DesignElement {
+  /// \brief The byte range [Begin, End) of the element's tokens.  Tokens
+  /// that come from an included file are located at the `include.
+  unsigned Begin, End;
+
+  /// \brief The keyword that introduces the element, e.g. tok::kw_module.
+  tok::TokenKind Keyword;
+
+  /// \brief The element's name, or empty if it has none.
+  std::string Name;
+
+  unsigned NumTokens;
+
+  /// \brief The macros the element names or expands, directly or through
+  /// other macros, sorted.
+  std::vector<std::string> MacroUses;
+};
+
+/// \brief A `define or `undef of a macro in a document.
+struct MacroSite {
+  unsigned Offset;
+  bool IsDefinition;
+
+  MacroSite(unsigned Offset, bool IsDefinition)
+    : Offset(Offset), IsDefinition(IsDefinition) {}
+
+  bool operator<(const MacroSite &RHS) const { return Offset < RHS.Offset; }
+};
+
+/// \brief Keeps one document parsed while it is being edited.
+///
+/// The first parse lexes and parses the whole document and records, for
+/// each top-level design element, its byte range and the macros it uses,
+/// and, for each macro, where the document defines or undefines it.
+///
+/// An edit is then reparsed incrementally when possible: only the design
+/// elements the edit touches (or, for an edit between elements, the text
+/// between the neighbouring unaffected elements) are lexed and parsed
+/// again, against the preprocessor left over from the previous parse.
+/// That preprocessor's macro table is the state at the end of the
+/// document; it agrees with the state at the edited region for every macro
+/// without a `define or `undef after the region start, so the recorded
+/// define sites act as a checkpoint of the macro state at every element
+/// boundary.
+///
+/// Edits that add, change or remove a `define are handled precisely: the
+/// region's old definitions are undone, and the later elements that use one
+/// of the affected macros are reparsed as well.  Everything else falls back
+/// to parsing the whole document again: edits involving a conditional or an
+/// `include, macros that are also defined outside the region, regions that
+/// do not end at a complete design element, and affected macros tested by a
+/// later conditional.
+class IncrementalParser {
+public:
+  /// \brief Counts of the work done so far.
+  struct Statistics {
+    unsigned FullParses;
+    unsigned IncrementalParses;
+    unsigned ElementsReparsed;
+    uint64_t BytesRelexed;
+
+    Statistics()
+      : FullParses(0), IncrementalParses(0), ElementsReparsed(0),
+        BytesRelexed(0) {}
+  };
+
+private:
+  class Session;
+  class DiagConsumer;
+  class MacroRecorder;
+
+  IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts;
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts;
+  IntrusiveRefCntPtr<FileManager> FileMgr;
+  const FrozenIdentifierTable *IdentifierBase;
+
+  /// \brief The compiler state of the last full parse, updated by each
+  /// incremental one.
+  OwningPtr<Session> S;
+
+  std::string Name;
+  std::string Text;
+  std::vector<DesignElement> Elements;
+  std::vector<DocumentDiagnostic> Diagnostics;
+  llvm::StringMap<std::vector<MacroSite> > MacroSites;
+  Statistics Stats;
+
+  /// \brief The buffer being lexed and the document offset of its start.
+  /// Locations in other buffers are mapped through their `include; those
+  /// in unrelated buffers have no document offset.
+  FileID CurFID;
+  unsigned CurBase;
+
+  /// \brief Whether a diagnostic without a document offset was reported
+  /// while reparsing a region.
+  bool LostDiagnostic;
+
+  /// \brief Macro expansions seen while lexing, as (offset, name) pairs.
+  std::vector<std::pair<unsigned, std::string> > PendingUses;
+
+  IncrementalParser(const IncrementalParser &) LLVM_DELETED_FUNCTION;
+  void operator=(const IncrementalParser &) LLVM_DELETED_FUNCTION;
+
+  bool getDocumentOffset(SourceLocation Loc, unsigned &Offset) const;
+  void handleDiagnostic(DiagnosticsEngine::Level Level, const Diagnostic &Info);
+  void recordMacroSite(const Token &MacroNameTok, bool IsDefinition);
+  void recordMacroUse(const Token &MacroNameTok);
+
+  void fullReparse();
+  void lexBuffer(StringRef BufferName, StringRef Buffer, unsigned Base,
+                 TokenBuffer &Toks);
+  bool parseTokens(const TokenBuffer &Toks, std::vector<DesignElement> &Out);
+  void addElement(const TokenBuffer &Toks, unsigned First, unsigned Last,
+                  std::vector<DesignElement> &Out);
+  void collectMacroUses(std::vector<DesignElement> &Elts);
+  bool reparseRegion(unsigned Begin, unsigned End,
+                     std::vector<DesignElement> &Out);
+  bool hasLaterSite(StringRef Macro, unsigned Offset) const;
+  bool tryIncrementalEdit(unsigned Offset, unsigned Length,
+                          StringRef NewText);
+
+public:
+  IncrementalParser(IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts,
+                    IntrusiveRefCntPtr<PreprocessorOptions> PPOpts);
+  ~IncrementalParser();
+
+  /// \brief Look files up through \p FM, whose caches can then be shared
+  /// with other parsers.  Takes effect at the next full parse.
+  void setFileManager(FileManager *FM);
+
+  /// \brief Look identifiers up in \p Base before adding them to the
+  /// document's own table.  Takes effect at the next full parse.
+  void setIdentifierBase(const FrozenIdentifierTable *Base) {
+    IdentifierBase = Base;
+  }
+
+  /// \brief Parse \p Text, named \p Name, from scratch.
+  void parse(StringRef Name, StringRef Text);
+
+  /// \brief Replace \p Length bytes at \p Offset with \p NewText and bring
+  /// the elements and diagnostics up to date.
+  ///
+  /// \returns true if only part of the document was reparsed.
+  bool applyEdit(unsigned Offset, unsigned Length, StringRef NewText);
+
+  StringRef getName() const { return Name; }
+  StringRef getText() const { return Text; }
+
+  /// \brief The document's design elements, in source order.
+  const std::vector<DesignElement> &getElements() const { return Elements; }
+
+  /// \brief The element containing \p Offset, or null.
+  const DesignElement *findElement(unsigned Offset) const;
+
+  /// \brief The diagnostics of the document, sorted by offset; those
+  /// without an offset come first.
+  const std::vector<DocumentDiagnostic> &getDiagnostics() const {
+    return Diagnostics;
+  }
+
+  /// \brief Find the `define of \p Macro in effect at \p Offset.
+  ///
+  /// \returns true and sets \p DefOffset to the offset of the macro name in
+  /// the `define if the document defines it before \p Offset.
+  bool findMacroDefinition(StringRef Macro, unsigned Offset,
+                           unsigned &DefOffset) const;
+
+  const Statistics &getStatistics() const { return Stats; }
+};
+
+} // end namespace vlang
+
+#endif
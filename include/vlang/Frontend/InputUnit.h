@@ -0,0 +1,138 @@
+//===--- InputUnit.h - The front end objects of one input -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the InputUnit class, which reads one input of a vlang run,
+/// and the functions that preprocess or parse it.  They are shared by the
+/// vlang driver and the vlangd compile server, so that both produce the same
+/// output for the same input.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_INPUTUNIT_H
+#define LLVM_VLANG_FRONTEND_INPUTUNIT_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace vlang {
+
+class ConfigTable;
+class DesignUnitTable;
+class FileManager;
+class FrozenIdentifierTable;
+class HeaderSearch;
+class LangOptions;
+class NetlistTable;
+class PackageTable;
+class ParseCache;
+class PreprocessorOptions;
+
+/// \brief The front end objects of one input.
+///
+/// The source manager and the preprocessor, which hold what the input read
+/// and defined, are the unit's own.  The diagnostics engine, the file
+/// manager, the language options and the header search are the caller's,
+/// so that they can be kept across the inputs of a run or, in a server,
+/// across its jobs.
+class InputUnit {
+  bool InSourceFile;
+
+  InputUnit(const InputUnit &) LLVM_DELETED_FUNCTION;
+  void operator=(const InputUnit &) LLVM_DELETED_FUNCTION;
+
+public:
+  SourceManager SourceMgr;
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts;
+  Preprocessor PP;
+  /// \brief The tokens of the input, if they are lexed before parsing.
+  TokenBuffer Toks;
+  /// \brief The identifiers of the unit's own table before it was read.
+  unsigned NumInitialIdentifiers;
+
+  /// \brief Set up the preprocessor with the macros \p Defines, in the
+  /// form of -D, and the identifier base \p IdentifierBase, if not null.
+  InputUnit(DiagnosticsEngine &Diags, FileManager &FileMgr,
+            LangOptions &LangOpts, HeaderSearch &HeaderInfo,
+            ArrayRef<std::string> Defines,
+            const FrozenIdentifierTable *IdentifierBase);
+  ~InputUnit();
+
+  /// \brief Make \p Source, or the contents of \p File if it is empty, the
+  /// main file.  \p AsFileEntry reads \p File as a file entry, which is
+  /// needed for it to be among the files of the unit.  Returns true and
+  /// sets \p ErrorStr on error.
+  bool createMainFile(const std::string &File, StringRef Source,
+                      bool AsFileEntry, std::string &ErrorStr);
+
+  /// \brief Tell the diagnostic client that the input is being read; it
+  /// is told the input is done when the unit is destroyed.
+  void beginSourceFile();
+
+  /// \brief Enter the main file, after the definitions of \p Macros.
+  void enterMainFile(StringRef Macros);
+
+  /// \brief Whether the input added identifiers the identifier base does
+  /// not have.
+  bool hasNewIdentifiers() const {
+    return PP.getIdentifierTable().size() > NumInitialIdentifiers;
+  }
+};
+
+/// \brief Preprocess the main file of \p Unit, printing to \p OS its output,
+/// or with \p PrintDependencies the make rule of the files it reads, with a
+/// target named after \p File the way a C compiler names objects.
+void preprocessInput(InputUnit &Unit, StringRef File, bool PrintDependencies,
+                     raw_ostream &OS);
+
+/// \brief Where parseInput() records what it parses.  Each table is
+/// optional.
+struct InputParseOptions {
+  DesignUnitTable *Units;
+  ConfigTable *Configs;
+  /// \brief Record instances and continuous assignments here; see
+  /// Parser::setNetlistTable().
+  NetlistTable *Netlist;
+  PackageTable *Packages;
+  /// \brief Replay unchanged design elements from here, and store the
+  /// others.  Requires Units.
+  ParseCache *Parses;
+  /// \brief Lex the input before parsing it, which the tables other than
+  /// Units and Configs, and the parse cache, imply.
+  bool UseTokenBuffer;
+
+  InputParseOptions()
+    : Units(0), Configs(0), Netlist(0), Packages(0), Parses(0),
+      UseTokenBuffer(false) {}
+};
+
+/// \brief What parseInput() did with the design elements of the input.
+struct InputParseResult {
+  /// \brief Whether the parse cache was used; the counts are zero if not.
+  bool UsedParseCache;
+  unsigned NumReplayed;
+  unsigned NumParsed;
+  unsigned NumStored;
+
+  InputParseResult()
+    : UsedParseCache(false), NumReplayed(0), NumParsed(0), NumStored(0) {}
+};
+
+/// \brief Parse the main file of \p Unit, which enterMainFile() entered.
+InputParseResult parseInput(InputUnit &Unit, const InputParseOptions &Opts);
+
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,99 @@
+//===--- LibraryMap.h - IEEE 1800 library map files -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the LibraryMap class, which reads library map files and
+/// assigns source files to logical libraries.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_LIBRARYMAP_H
+#define LLVM_VLANG_FRONTEND_LIBRARYMAP_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace vlang {
+
+/// \brief The logical libraries of a design and the files in each.
+///
+/// A library map file declares libraries with the file path specifications
+/// of their source files, and includes other library map files:
+///
+/// \code
+///   library rtl  rtl/*.v, common/...;
+///   library gate netlist/top_gate.v -incdir netlist/include;
+///   include ../ip/lib.map;
+/// \endcode
+///
+/// A specification is relative to the directory of the map file that holds
+/// it.  In it, ? matches one character and * any number of them within one
+/// path component, ... matches any number of directories, and a trailing /
+/// matches every file of the directory.  A file matched by several
+/// libraries belongs to the one whose specification has no wildcards, or
+/// else to the one declared first.
+class LibraryMap {
+public:
+  enum {
+    NoLibrary = ~0U
+  };
+
+  struct Library {
+    std::string Name;
+    /// \brief The absolute file path specifications.
+    std::vector<std::string> Specs;
+    /// \brief The absolute include directories of the library's files.
+    std::vector<std::string> IncludeDirs;
+  };
+
+private:
+  std::vector<Library> Libraries;
+  llvm::StringMap<unsigned> LibrariesByName;
+  std::vector<std::string> Warnings;
+  unsigned IncludeDepth;
+
+  bool parse(StringRef Contents, StringRef MapPath, std::string &ErrorStr);
+  void addSpec(unsigned L, StringRef Spec, StringRef BaseDir);
+
+public:
+  LibraryMap() : IncludeDepth(0) {}
+
+  /// \brief Read the library map file \p Path and the files it includes.
+  /// Returns true and sets \p ErrorStr on error.
+  bool loadFromFile(StringRef Path, std::string &ErrorStr);
+
+  /// \brief Add library \p Name, if it is not known yet.
+  unsigned addLibrary(StringRef Name);
+
+  unsigned getNumLibraries() const { return Libraries.size(); }
+  const Library &getLibrary(unsigned L) const { return Libraries[L]; }
+
+  /// \brief The library named \p Name, or NoLibrary.
+  unsigned findLibrary(StringRef Name) const;
+
+  /// \brief The library the file \p Path belongs to, or NoLibrary.
+  unsigned getLibraryForFile(StringRef Path) const;
+
+  /// \brief Append the files of library \p L, sorted, by expanding its
+  /// specifications against the file system.
+  void getLibraryFiles(unsigned L, std::vector<std::string> &Files) const;
+
+  /// \brief What was read but ignored, such as config blocks.
+  const std::vector<std::string> &getWarnings() const { return Warnings; }
+
+  /// \brief \p Path made absolute, with . and .. components resolved.
+  static std::string getNormalizedPath(StringRef Path);
+};
+
+}  // end namespace vlang
+
+#endif
@@ -0,0 +1,86 @@
+//===--- LibraryResolver.h - Find cells in Verilog libraries ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the LibraryResolver class, which finds the files of the
+/// library cells a design instantiates but does not define.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_FRONTEND_LIBRARYRESOLVER_H
+#define LLVM_VLANG_FRONTEND_LIBRARYRESOLVER_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace vlang {
+
+/// \brief The library directories (-y) and library files (-v) of a
+/// compilation, searched for undefined cells in the order given.
+///
+/// A library directory holds one cell per file, named after the cell with
+/// one of the library extensions (+libext+), or with none if there are no
+/// extensions.  A library file holds any number of cells.
+///
+/// The first lookup indexes every library once: a directory by listing it,
+/// and a library file by a scan of its text for the names of the modules,
+/// macromodules, interfaces, programs and primitives it declares, which is
+/// much cheaper than parsing it.  Later lookups are a map lookup, and no
+/// library file is parsed until a cell in it is needed.
+class LibraryResolver {
+  struct Library {
+    std::string Path;
+    bool IsDirectory;
+  };
+
+  std::vector<Library> Libraries;
+  std::vector<std::string> Extensions;
+
+  /// \brief The file of each cell; the first library that has a cell wins.
+  llvm::StringMap<std::string> CellFiles;
+  bool Indexed;
+  unsigned NumFilesScanned;
+
+  void indexDirectory(StringRef Dir);
+  void indexFile(StringRef Path);
+  void addCell(StringRef Name, StringRef Path);
+
+public:
+  LibraryResolver() : Indexed(false), NumFilesScanned(0) {}
+
+  void addLibraryDirectory(StringRef Dir) {
+    Library L = { Dir, true };
+    Libraries.push_back(L);
+  }
+  void addLibraryFile(StringRef Path) {
+    Library L = { Path, false };
+    Libraries.push_back(L);
+  }
+  /// \brief Add an extension, such as ".v", of the files in library
+  /// directories.  Earlier extensions take precedence.
+  void addExtension(StringRef Ext) { Extensions.push_back(Ext); }
+
+  bool empty() const { return Libraries.empty(); }
+
+  /// \brief Index the libraries, if not done yet.
+  void index();
+
+  /// \brief The file defining cell \p Name, or an empty string.
+  StringRef findCell(StringRef Name);
+
+  unsigned getNumCells() const { return CellFiles.size(); }
+  unsigned getNumFilesScanned() const { return NumFilesScanned; }
+};
+
+}  // end namespace vlang
+
+#endif
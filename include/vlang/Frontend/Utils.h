@@ -64,6 +64,13 @@ void DoPrintPreprocessedInput(Preprocessor &PP, raw_ostream* OS,
 void AttachDependencyFileGen(Preprocessor &PP,
                              const DependencyOutputOptions &Opts);
 
+/// AttachDependencyPrinter - Like AttachDependencyFileGen, but write the
+/// dependencies to \p OS, which must outlive the preprocessor, instead of
+/// the output file of \p Opts.
+void AttachDependencyPrinter(Preprocessor &PP,
+                             const DependencyOutputOptions &Opts,
+                             raw_ostream &OS);
+
 /// AttachDependencyGraphGen - Create a dependency graph generator, and attach
 /// it to the given preprocessor.
   void AttachDependencyGraphGen(Preprocessor &PP, StringRef OutputFile,
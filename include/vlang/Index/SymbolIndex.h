@@ -0,0 +1,261 @@
+//===--- SymbolIndex.h - Design-wide symbol index ---------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the on-disk symbol index of a design and the builder that
+/// writes it.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_INDEX_SYMBOLINDEX_H
+#define LLVM_VLANG_INDEX_SYMBOLINDEX_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class FileManager;
+class HeaderSearchOptions;
+class PreprocessorOptions;
+
+/// \brief Indexing of definitions and references across a design.
+namespace index {
+
+enum SymbolKind {
+  SK_Module,
+  SK_Interface,
+  SK_Program,
+  SK_Package,
+  SK_Primitive,
+  SK_Class,
+  SK_Checker,
+  SK_Config,
+  SK_Parameter,
+  SK_Port,
+  SK_Net,
+  SK_Task,
+  SK_Function,
+  SK_Macro,
+  NumSymbolKinds
+};
+
+enum SymbolRole {
+  SR_Definition,
+  SR_Reference,
+  /// \brief An instantiation of a module, interface, program or checker.
+  SR_Instantiation,
+  NumSymbolRoles
+};
+
+const char *getSymbolKindName(SymbolKind K);
+const char *getSymbolRoleName(SymbolRole R);
+
+/// \brief Where a symbol is defined or referenced.  Lines and columns are
+/// one-based.
+struct SymbolOccurrence {
+  unsigned File;
+  unsigned Line;
+  unsigned Column;
+  SymbolKind Kind;
+  SymbolRole Role;
+};
+
+namespace ondisk {
+struct IndexHeader;
+struct FileRecord;
+struct UnitRecord;
+struct SymbolRecord;
+struct OccurrenceRecord;
+}
+
+/// \brief A symbol index written by IndexBuilder, mapped from disk.
+///
+/// The file is a header followed by flat arrays that are used in place:
+///  - a string table of symbol names and file paths, sorted, so that a
+///    name is found by binary search and its ID orders like the name;
+///  - the indexed files with their size, modification time and content
+///    hash, and the compilation units with the files each one read;
+///  - the symbols, sorted by name ID and kind, each pointing at a posting
+///    list of occurrences.
+///
+/// A lookup is two binary searches and a scan of one posting list; nothing
+/// is deserialized when the index is loaded.
+class SymbolIndex {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  const ondisk::IndexHeader *Header;
+  const uint32_t *StringOffsets;
+  const char *StringData;
+  const ondisk::FileRecord *Files;
+  const ondisk::UnitRecord *Units;
+  const uint32_t *UnitFiles;
+  const ondisk::SymbolRecord *Symbols;
+  const ondisk::OccurrenceRecord *Occurrences;
+
+  SymbolIndex();
+  SymbolIndex(const SymbolIndex &) LLVM_DELETED_FUNCTION;
+  void operator=(const SymbolIndex &) LLVM_DELETED_FUNCTION;
+
+  bool init();
+
+public:
+  ~SymbolIndex();
+
+  /// \brief Map the index at \p Path.  Returns null and sets \p ErrorStr if
+  /// the file cannot be read or is not a valid index.
+  static SymbolIndex *loadFromFile(StringRef Path, std::string &ErrorStr);
+
+  unsigned getNumStrings() const;
+  StringRef getString(unsigned ID) const;
+
+  /// \brief Find \p Str in the string table.
+  bool lookupString(StringRef Str, unsigned &ID) const;
+
+  unsigned getNumFiles() const;
+  StringRef getFilePath(unsigned File) const;
+  uint64_t getFileSize(unsigned File) const;
+  uint64_t getFileModTime(unsigned File) const;
+  uint64_t getFileHash(unsigned File) const;
+
+  unsigned getNumUnits() const;
+  /// \brief The main file of unit \p Unit.
+  unsigned getUnitMainFile(unsigned Unit) const;
+  /// \brief The files unit \p Unit read, including its main file.
+  ArrayRef<uint32_t> getUnitFiles(unsigned Unit) const;
+
+  unsigned getNumSymbols() const;
+  StringRef getSymbolName(unsigned Symbol) const;
+  SymbolKind getSymbolKind(unsigned Symbol) const;
+  unsigned getNumOccurrences(unsigned Symbol) const;
+  SymbolOccurrence getOccurrence(unsigned Symbol, unsigned I) const;
+
+  /// \brief Append the occurrences of the symbols named \p Name to \p Out.
+  ///
+  /// \param Kind If not NumSymbolKinds, only symbols of this kind.
+  /// \param Role If not NumSymbolRoles, only occurrences with this role.
+  void findOccurrences(StringRef Name, std::vector<SymbolOccurrence> &Out,
+                       SymbolKind Kind = NumSymbolKinds,
+                       SymbolRole Role = NumSymbolRoles) const;
+};
+
+/// \brief Builds a symbol index, updating a previous one where its inputs
+/// changed.
+///
+/// Each compilation unit is preprocessed with a CompactPreprocessingRecord,
+/// which provides the macro definitions and expansions, and its tokens are
+/// scanned for the definitions of design elements, parameters, ports, nets,
+/// tasks and functions, for instantiations, and for references to packages
+/// and subroutines.  Occurrences are attributed to the file they appear in
+/// (the expansion site, for tokens produced by macros), so a header shared
+/// by many units is indexed once.
+///
+/// A unit of the previous index is kept as is when none of the files it
+/// read changed: a file whose size and modification time are unchanged is
+/// assumed unchanged, otherwise its content hash decides.
+class IndexBuilder {
+public:
+  enum FileState {
+    /// \brief From the previous index, not yet compared with the disk.
+    FS_Unchecked,
+    /// \brief From the previous index, whose occurrences are still valid.
+    FS_Unchanged,
+    /// \brief From the previous index, whose occurrences are out of date.
+    FS_Changed,
+    /// \brief Not in the previous index and not yet read.
+    FS_New,
+    /// \brief Indexed by this run; occurrences from before it are dropped.
+    FS_Indexed
+  };
+
+  struct FileInfo {
+    std::string Path;
+    uint64_t Size;
+    uint64_t ModTime;
+    uint64_t Hash;
+    FileState State;
+  };
+
+  struct UnitInfo {
+    unsigned MainFile;
+    std::vector<unsigned> Files;
+    /// \brief Whether the unit was given to this run.
+    bool Live;
+  };
+
+  struct Occurrence {
+    unsigned Name;
+    unsigned File;
+    unsigned Line;
+    unsigned Column;
+    unsigned char Kind;
+    unsigned char Role;
+    /// \brief Whether the occurrence was recorded by this run.
+    bool Fresh;
+  };
+
+private:
+  IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts;
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts;
+  IntrusiveRefCntPtr<FileManager> FileMgr;
+
+  llvm::StringMap<unsigned> NameIDs;
+  std::vector<std::string> Names;
+  llvm::StringMap<unsigned> FileIDs;
+  std::vector<FileInfo> Files;
+  llvm::StringMap<unsigned> UnitIDs;
+  std::vector<UnitInfo> Units;
+  std::vector<Occurrence> Occurrences;
+
+  unsigned NumUnitsReused, NumUnitsIndexed;
+
+  unsigned getNameID(StringRef Name);
+  unsigned getFileID(StringRef Path);
+  bool isFileUnchanged(unsigned File);
+  void finish();
+
+  friend class UnitIndexer;
+
+public:
+  IndexBuilder(IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts,
+               IntrusiveRefCntPtr<PreprocessorOptions> PPOpts);
+  ~IndexBuilder();
+
+  /// \brief Start from the contents of \p Old.
+  void loadFrom(const SymbolIndex &Old);
+
+  /// \brief Bring the unit whose main file is \p MainFile up to date,
+  /// reindexing it unless none of its files changed.  Returns true and
+  /// sets \p ErrorStr if the main file cannot be read.
+  bool addUnit(StringRef MainFile, std::string &ErrorStr);
+
+  /// \brief Write the index, without the units of the previous index that
+  /// were not added again.  Returns true on error.
+  bool writeToFile(StringRef Path, std::string &ErrorStr);
+
+  unsigned getNumUnitsReused() const { return NumUnitsReused; }
+  unsigned getNumUnitsIndexed() const { return NumUnitsIndexed; }
+
+  /// \brief Compute the content hash stored for each file (64-bit FNV-1a).
+  static uint64_t hashContents(StringRef Data);
+};
+
+} // end namespace index
+} // end namespace vlang
+
+#endif
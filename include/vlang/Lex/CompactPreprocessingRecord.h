@@ -0,0 +1,188 @@
+//===--- CompactPreprocessingRecord.h - Columnar PP record ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the CompactPreprocessingRecord class, a columnar record
+//  of the macro definitions, macro expansions and inclusions of a unit.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LEX_COMPACTPREPROCESSINGRECORD_H
+#define LLVM_VLANG_LEX_COMPACTPREPROCESSINGRECORD_H
+
+#include "vlang/Basic/SourceLocation.h"
+#include "vlang/Lex/PPCallbacks.h"
+#include "vlang/Lex/PreprocessingRecord.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/DataTypes.h"
+#include <utility>
+#include <vector>
+
+namespace vlang {
+
+class SourceManager;
+
+/// \brief A record of the macro definitions, macro expansions and
+/// inclusions of a unit, stored as parallel arrays.
+///
+/// PreprocessingRecord allocates an object per entity and orders them with
+/// SourceManager comparisons; for units with tens of millions of macro
+/// expansions both the memory and the comparisons dominate.  This record
+/// keeps each entity as a kind byte and three 32-bit columns: a name index
+/// and the begin and end offsets of its expansion range within its file.
+///
+/// Entities are grouped by segment: the text of one FileID, so a file
+/// entered twice has two segments.  Within a segment they are sorted by
+/// begin offset, and a range query is two binary searches over the offset
+/// columns.  Names, included file names and segment paths share one string
+/// table.
+///
+/// While preprocessing, entities are appended as they are seen; the record
+/// is sorted when the main file ends, or by an explicit finalize().
+class CompactPreprocessingRecord : public PPCallbacks {
+  SourceManager *SourceMgr;
+
+  // Recording state, and the storage of the columns.
+  llvm::DenseMap<FileID, unsigned> SegmentIDs;
+  std::vector<FileID> SegmentFileIDs;
+  std::vector<uint32_t> SegmentPathsStorage;
+  std::vector<uint32_t> SegmentFirstStorage;
+  llvm::StringMap<unsigned> StringIDs;
+  std::vector<uint32_t> StringOffsetsStorage;
+  std::vector<char> StringDataStorage;
+  std::vector<uint32_t> EntitySegments;
+  std::vector<uint32_t> BeginsStorage;
+  std::vector<uint32_t> EndsStorage;
+  std::vector<uint32_t> NamesStorage;
+  std::vector<uint8_t> KindsStorage;
+  bool Finalized;
+
+  // The columns of a finalized record, pointing into the storage above.
+  unsigned NumSegments, NumEntities, NumStrings;
+  const uint32_t *SegmentPaths;
+  const uint32_t *SegmentFirst;
+  const uint32_t *StringOffsets;
+  const char *StringData;
+  const uint32_t *Begins;
+  const uint32_t *Ends;
+  const uint32_t *Names;
+  const uint8_t *Kinds;
+
+  CompactPreprocessingRecord(const CompactPreprocessingRecord &)
+    LLVM_DELETED_FUNCTION;
+  void operator=(const CompactPreprocessingRecord &) LLVM_DELETED_FUNCTION;
+
+  unsigned getStringID(StringRef Str);
+  void addEntity(PreprocessedEntity::EntityKind Kind, SourceRange Range,
+                 StringRef Name);
+  void setColumns();
+
+  virtual void MacroExpands(const Token &MacroNameTok,
+                            const MacroDirective *MD, SourceRange Range,
+                            const MacroArgs *Args);
+  virtual void MacroDefined(const Token &MacroNameTok,
+                            const MacroDirective *MD);
+  virtual void InclusionDirective(SourceLocation HashLoc,
+                                  const Token &IncludeTok, StringRef FileName,
+                                  bool IsAngled, CharSourceRange FilenameRange,
+                                  const FileEntry *File, StringRef SearchPath,
+                                  StringRef RelativePath);
+  virtual void Ifdef(SourceLocation Loc, const Token &MacroNameTok,
+                     const MacroDirective *MD);
+  virtual void Ifndef(SourceLocation Loc, const Token &MacroNameTok,
+                      const MacroDirective *MD);
+  virtual void Defined(const Token &MacroNameTok, const MacroDirective *MD);
+  virtual void EndOfMainFile();
+
+public:
+  /// \brief Create a record of the preprocessing done with \p SM.
+  explicit CompactPreprocessingRecord(SourceManager &SM);
+  ~CompactPreprocessingRecord();
+
+  /// \brief Sort the entities recorded so far.  Entities recorded later
+  /// make the record unfinalized again.
+  void finalize();
+  bool isFinalized() const { return Finalized; }
+
+  /// \name Queries on a finalized record
+  /// @{
+
+  unsigned getNumSegments() const { return NumSegments; }
+  unsigned getNumEntities() const { return NumEntities; }
+
+  /// \brief The name of the file of segment \p S.
+  StringRef getSegmentPath(unsigned S) const {
+    assert(Finalized && S < NumSegments && "Invalid segment");
+    return getString(SegmentPaths[S]);
+  }
+
+  /// \brief The FileID of segment \p S.
+  FileID getSegmentFileID(unsigned S) const {
+    assert(S < SegmentFileIDs.size() && "Invalid segment");
+    return SegmentFileIDs[S];
+  }
+
+  /// \brief The segment of \p FID, if it has any entities.
+  bool findSegment(FileID FID, unsigned &S) const;
+
+  /// \brief The segments of the file named \p Path.
+  void findSegments(StringRef Path, SmallVectorImpl<unsigned> &Out) const;
+
+  /// \brief The entities of segment \p S are [first, second).
+  std::pair<unsigned, unsigned> getSegmentEntities(unsigned S) const {
+    assert(Finalized && S < NumSegments && "Invalid segment");
+    return std::make_pair(SegmentFirst[S], SegmentFirst[S + 1]);
+  }
+
+  /// \brief The entities of segment \p S whose range overlaps the offsets
+  /// [\p BeginOffset, \p EndOffset].
+  ///
+  /// Like PreprocessingRecord, this assumes that end offsets are sorted as
+  /// well, which only fails for expansions inside macro arguments; there,
+  /// a containing expansion may be returned too.
+  std::pair<unsigned, unsigned> findEntitiesInRange(unsigned S,
+                                                    unsigned BeginOffset,
+                                                    unsigned EndOffset) const;
+
+  /// \brief The entities overlapping \p Range, which must lie in one file.
+  std::pair<unsigned, unsigned> findEntitiesInRange(SourceRange Range) const;
+
+  PreprocessedEntity::EntityKind getKind(unsigned I) const {
+    assert(Finalized && I < NumEntities && "Invalid entity");
+    return static_cast<PreprocessedEntity::EntityKind>(Kinds[I]);
+  }
+  unsigned getBeginOffset(unsigned I) const {
+    assert(Finalized && I < NumEntities && "Invalid entity");
+    return Begins[I];
+  }
+  unsigned getEndOffset(unsigned I) const {
+    assert(Finalized && I < NumEntities && "Invalid entity");
+    return Ends[I];
+  }
+
+  /// \brief The macro name, or for an inclusion the file name as written.
+  StringRef getName(unsigned I) const {
+    assert(Finalized && I < NumEntities && "Invalid entity");
+    return getString(Names[I]);
+  }
+
+  unsigned getNumStrings() const { return NumStrings; }
+  StringRef getString(unsigned ID) const {
+    assert(ID < NumStrings && "Invalid string");
+    return StringRef(StringData + StringOffsets[ID]);
+  }
+
+  /// @}
+
+  size_t getTotalMemory() const;
+};
+
+} // end namespace vlang
+
+#endif
@@ -67,6 +67,10 @@ class Lexer : public PreprocessorLexer {
   /// it returns comments, when it is set to 0 it returns normal tokens only.
   unsigned char ExtendedTokenMode;
 
+  // PerfSampleCounter - Counts the tokens lexed, to pick those whose lexing
+  // is timed when performance counters are enabled.
+  unsigned PerfSampleCounter;
+
   //===--------------------------------------------------------------------===//
   // Context that changes as the file is lexed.
   // NOTE: any state that mutates when in raw mode must have save/restore code
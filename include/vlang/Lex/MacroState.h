@@ -0,0 +1,112 @@
+//===--- MacroState.h - Persistent snapshots of macro state -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the MacroState and MacroStateTable classes, which capture
+/// the macros visible at a point of preprocessing in O(1).
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_MACROSTATE_H
+#define LLVM_VLANG_MACROSTATE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/DataTypes.h"
+
+namespace vlang {
+
+class IdentifierInfo;
+class MacroInfo;
+
+/// \brief The macros visible at one point of preprocessing, as an immutable
+/// snapshot of a MacroStateTable.
+///
+/// A snapshot is the root of a persistent hash trie, so taking or copying
+/// one is O(1), and it stays unchanged while the table that made it lives.
+/// Its fingerprint hashes the names and definitions of its macros, and does
+/// not depend on the order they were defined in or on the run, so a cache
+/// keyed on macro state can compare fingerprints instead of macros.
+class MacroState {
+  friend class MacroStateTable;
+
+  const void *Root;
+  uint64_t Fingerprint;
+  unsigned Size;
+
+public:
+  MacroState() : Root(0), Fingerprint(0), Size(0) {}
+
+  unsigned size() const { return Size; }
+  bool empty() const { return Size == 0; }
+  uint64_t getFingerprint() const { return Fingerprint; }
+
+  /// \brief The definition of \p Name, or null if it is not defined.
+  const MacroInfo *lookup(const IdentifierInfo *Name) const;
+
+  /// \brief Whether both snapshots hold macros with the same definitions;
+  /// taken from the fingerprints unless they are the same snapshot.
+  bool operator==(const MacroState &RHS) const {
+    return Root == RHS.Root ||
+           (Size == RHS.Size && Fingerprint == RHS.Fingerprint);
+  }
+  bool operator!=(const MacroState &RHS) const { return !(*this == RHS); }
+};
+
+/// \brief A macro whose definition differs between two snapshots.
+struct MacroStateChange {
+  const IdentifierInfo *Name;
+  /// \brief The earlier definition, or null if the macro was not defined.
+  const MacroInfo *Old;
+  /// \brief The later definition, or null if the macro is not defined.
+  const MacroInfo *New;
+};
+
+/// \brief The macros defined so far, kept as a persistent hash trie.
+///
+/// Each `define or `undef copies the trie nodes on the path to its name and
+/// shares the rest with the previous state, so the states it replaced stay
+/// valid as snapshots.  Nodes are never freed before the table.
+class MacroStateTable {
+  llvm::BumpPtrAllocator Allocator;
+  MacroState Current;
+
+  MacroStateTable(const MacroStateTable &) LLVM_DELETED_FUNCTION;
+  void operator=(const MacroStateTable &) LLVM_DELETED_FUNCTION;
+
+public:
+  MacroStateTable() {}
+
+  /// \brief Define \p Name as \p Macro, replacing any definition it has.
+  /// \p DefinitionHash is the content hash of the definition, see
+  /// Preprocessor::hashMacroDefinition().
+  void define(const IdentifierInfo *Name, const MacroInfo *Macro,
+              uint64_t DefinitionHash);
+
+  /// \brief Remove the definition of \p Name, if any.
+  void undefine(const IdentifierInfo *Name);
+
+  /// \brief A snapshot of the macros defined now.
+  const MacroState &getCurrent() const { return Current; }
+
+  /// \brief Append to \p Changes the macros whose definitions differ in
+  /// content between \p Old and \p New, in no particular order.  Subtries
+  /// the snapshots share are skipped, so the cost grows with the number of
+  /// changes rather than with the number of macros.
+  static void diff(const MacroState &Old, const MacroState &New,
+                   SmallVectorImpl<MacroStateChange> &Changes);
+
+  size_t getMemorySize() const { return Allocator.getTotalMemory(); }
+};
+
+}  // end namespace vlang
+
+#endif
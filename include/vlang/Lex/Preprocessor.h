@@ -20,6 +20,7 @@
 #include "vlang/Basic/Systask.h"
 #include "vlang/Lex/Lexer.h"
 #include "vlang/Lex/MacroInfo.h"
+#include "vlang/Lex/MacroState.h"
 #include "vlang/Lex/PPCallbacks.h"
 #include "vlang/Lex/TokenLexer.h"
 #include "llvm/ADT/ArrayRef.h"
@@ -48,6 +49,7 @@ class PPCallbacks;
 class CodeCompletionHandler;
 class DirectoryLookup;
 class PreprocessingRecord;
+class CompactPreprocessingRecord;
 class PreprocessorOptions;
 
 /// \brief Stores token information for comparing actual tokens with
@@ -234,6 +236,15 @@ class Preprocessor : public RefCountedBase<Preprocessor> {
   /// keep a mapping to the history of all macro definitions and `undefs in
   /// the reverse order (the latest one is in the head of the list).
   llvm::DenseMap<const IdentifierInfo*, MacroDirective*> Macros;
+
+  /// \brief The macros defined now, in a persistent table that snapshots
+  /// of the state can be taken from in O(1).
+  MacroStateTable MacroStates;
+
+  /// \brief The arguments of the last `timescale and `default_nettype, as
+  /// written, or empty if there has been none.
+  std::string Timescale;
+  std::string DefaultNettype;
   
   /// \brief Macros that we want to warn because they are not used at the end
   /// of the translation unit; we store just their SourceLocations instead
@@ -285,6 +296,10 @@ class Preprocessor : public RefCountedBase<Preprocessor> {
   /// \c createPreprocessingRecord() prior to preprocessing.
   PreprocessingRecord *Record;
 
+  /// \brief A columnar record of the macro definitions, expansions and
+  /// inclusions, enabled with \c createCompactPreprocessingRecord().
+  CompactPreprocessingRecord *CompactRecord;
+
 private:  // Cached tokens state.
   typedef SmallVector<Token, 1> CachedTokensTy;
 
@@ -453,6 +468,16 @@ public:
   /// identifiers that hadMacroDefinition().
   MacroDirective *getMacroDirectiveHistory(const IdentifierInfo *II) const;
 
+  /// \brief A snapshot of the macros defined now.  It is O(1) to take and
+  /// stays valid while this Preprocessor lives; see MacroState.
+  const MacroState &getMacroState() const { return MacroStates.getCurrent(); }
+
+  /// \brief The `timescale in effect, as "<unit>/<precision>", or empty.
+  StringRef getTimescale() const { return Timescale; }
+
+  /// \brief The `default_nettype in effect, or empty for the default wire.
+  StringRef getDefaultNettype() const { return DefaultNettype; }
+
   /// \brief Add a directive to the macro directive history for this identifier.
   void appendMacroDirective(IdentifierInfo *II, MacroDirective *MD);
   DefMacroDirective *appendDefMacroDirective(IdentifierInfo *II, MacroInfo *MI,
@@ -480,6 +505,15 @@ public:
   StringRef getLastMacroWithSpelling(SourceLocation Loc,
                                      ArrayRef<TokenValue> Tokens) const;
 
+  /// \brief Append the name of each macro defined in a source file, and
+  /// not undefined since, with the text of its definition after `define.
+  ///
+  /// Replaying the definitions restores the macros the source files have
+  /// defined; builtin and predefined macros are left out, as every
+  /// Preprocessor defines those itself.
+  void getSourceMacroDefinitions(
+    std::vector<std::pair<StringRef, StringRef> > &Macros) const;
+
   const std::string &getPredefines() const { return Predefines; }
   /// setPredefines - Set the predefines for this Preprocessor.  These
   /// predefines are automatically injected when parsing the main file.
@@ -527,6 +561,16 @@ public:
   /// all macro expansions, macro definitions, etc.
   void createPreprocessingRecord();
 
+  /// \brief Retrieve the compact preprocessing record, or NULL if there is
+  /// none.
+  CompactPreprocessingRecord *getCompactPreprocessingRecord() const {
+    return CompactRecord;
+  }
+
+  /// \brief Create a compact preprocessing record, which keeps the same
+  /// entities as a preprocessing record in far less memory.
+  void createCompactPreprocessingRecord();
+
   /// EnterMainSourceFile - Enter the specified FileID as the main source file,
   /// which implicitly adds the builtin defines etc.
   void EnterMainSourceFile();
@@ -1147,6 +1191,10 @@ private:
   /// as a builtin macro, handle it and return the next token as 'Tok'.
   void ExpandBuiltinMacro(Token &Tok);
 
+  /// hashMacroDefinition - Hash the formal arguments and the spelling of the
+  /// body of \p MI, for the fingerprint of the macro state.
+  uint64_t hashMacroDefinition(const MacroInfo *MI);
+
   /// EnterSourceFileWithLexer - Add a lexer to the top of the include stack and
   /// start lexing tokens from it instead of the current buffer.
   void EnterSourceFileWithLexer(Lexer *TheLexer, const DirectoryLookup *Dir);
@@ -1196,6 +1244,7 @@ private:
   void HandleMacroPrivateDirective(Token &Tok);
 
   void HandleTimescaleDirective(Token &Tok);
+  void HandleDefaultNettypeDirective(Token &Tok);
 
   // File inclusion.
   void HandleIncludeDirective(Token &Tok);
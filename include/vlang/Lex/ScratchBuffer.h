@@ -27,6 +27,17 @@ class ScratchBuffer {
   char *CurBuffer;
   SourceLocation BufferStartLoc;
   unsigned BytesUsed;
+
+  /// CurBufferSize - The size of the current chunk.
+  unsigned CurBufferSize;
+
+  /// NextBufferSize - The size of the next chunk.  Chunks grow geometrically
+  /// so that macro-heavy units do not create a FileID for every page of
+  /// scratch text.
+  unsigned NextBufferSize;
+
+  /// NumChunks - The number of chunks (and so FileIDs) allocated.
+  unsigned NumChunks;
 public:
   ScratchBuffer(SourceManager &SM);
 
@@ -36,6 +47,8 @@ public:
   /// token.
   SourceLocation getToken(const char *Buf, unsigned Len, const char *&DestPtr);
 
+  unsigned getNumChunks() const { return NumChunks; }
+
 private:
   void AllocScratchBuffer(unsigned RequestLen);
 };
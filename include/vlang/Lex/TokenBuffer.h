@@ -0,0 +1,120 @@
+//===--- TokenBuffer.h - Preprocessed token stream --------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the TokenBuffer interface.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_TOKENBUFFER_H
+#define LLVM_VLANG_TOKENBUFFER_H
+
+#include "vlang/Lex/MacroState.h"
+#include "vlang/Lex/Token.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace vlang {
+
+class IdentifierInfo;
+class Preprocessor;
+
+/// TokenBuffer - The fully preprocessed token stream of a compilation unit,
+/// stored as a structure of arrays.
+///
+/// Each token takes 15 bytes spread over parallel arrays instead of a 24-byte
+/// Token, and a scan over one field (e.g. the kinds, during lookahead) only
+/// touches that field's array.  Identifier and literal pointers live in side
+/// tables and are referenced by index.  Once filled, the buffer is immutable:
+/// any number of consumers (the parser, a linter, an indexer) can walk it
+/// without lexing the unit again, and backtracking is just resetting an index.
+class TokenBuffer {
+public:
+  /// DirectiveState - The macros, `timescale and `default_nettype in effect
+  /// from token FirstToken on.
+  struct DirectiveState {
+    unsigned FirstToken;
+    MacroState Macros;
+    std::string Timescale;
+    std::string DefaultNettype;
+  };
+
+private:
+  std::vector<uint16_t> Kinds;
+  std::vector<uint8_t> Flags;
+  std::vector<uint32_t> Locations;   // Raw SourceLocation encodings.
+  std::vector<uint32_t> Lengths;
+
+  /// DataIndices - For each token, 0 if it has no identifier or literal data,
+  /// otherwise one plus its index into Identifiers or LiteralData, depending
+  /// on whether it is a literal.
+  std::vector<uint32_t> DataIndices;
+
+  /// Identifiers - The distinct identifiers referenced by the tokens.
+  std::vector<IdentifierInfo *> Identifiers;
+  llvm::DenseMap<IdentifierInfo *, unsigned> IdentifierIndices;
+
+  /// LiteralData - Pointers to the spelling of each literal token.
+  std::vector<const char *> LiteralData;
+
+  /// States - The directive state at each token where it differs from the
+  /// token before, in token order.  Only lexAll() records these.
+  std::vector<DirectiveState> States;
+
+public:
+  /// lexAll - Lex every remaining token from \p PP, up to and including the
+  /// end-of-file token, into the buffer, recording the directive state
+  /// wherever it changes.
+  void lexAll(Preprocessor &PP);
+
+  /// push_back - Append a token; annotation tokens are not supported.
+  void push_back(const Token &Tok);
+
+  void clear();
+
+  unsigned size() const { return Kinds.size(); }
+  bool empty() const { return Kinds.empty(); }
+
+  tok::TokenKind getKind(unsigned Idx) const {
+    return (tok::TokenKind)Kinds[Idx];
+  }
+  SourceLocation getLocation(unsigned Idx) const {
+    return SourceLocation::getFromRawEncoding(Locations[Idx]);
+  }
+  unsigned getLength(unsigned Idx) const { return Lengths[Idx]; }
+  unsigned getFlags(unsigned Idx) const { return Flags[Idx]; }
+
+  IdentifierInfo *getIdentifierInfo(unsigned Idx) const {
+    if (DataIndices[Idx] == 0 || tok::isLiteral(getKind(Idx)))
+      return 0;
+    return Identifiers[DataIndices[Idx] - 1];
+  }
+
+  /// getLiteralData - The spelling of the literal token at \p Idx, or null.
+  const char *getLiteralData(unsigned Idx) const {
+    if (DataIndices[Idx] == 0 || !tok::isLiteral(getKind(Idx)))
+      return 0;
+    return LiteralData[DataIndices[Idx] - 1];
+  }
+
+  /// getDirectiveState - The directive state the token at \p Idx was lexed
+  /// in, or null if the buffer was not filled by lexAll().
+  const DirectiveState *getDirectiveState(unsigned Idx) const;
+
+  /// getToken - Reconstruct the token at \p Idx into \p Result.
+  void getToken(unsigned Idx, Token &Result) const;
+
+  /// getMemorySize - Return the number of bytes used by the buffer.
+  size_t getMemorySize() const;
+};
+
+}  // end namespace vlang
+
+#endif
@@ -0,0 +1,349 @@
+//===--- NetlistDatabase.h - Design connectivity graph ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the NetlistDatabase class, the connectivity graph of a
+//  parsed netlist, and the CellLibrary class, the pin directions of cells
+//  the design does not define.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_NETLIST_NETLISTDATABASE_H
+#define LLVM_VLANG_NETLIST_NETLISTDATABASE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Parse/ParserResult.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class NetlistTable;
+class SourceManager;
+
+/// \brief The pin directions of library cells, which a netlist instantiates
+/// but does not define.
+class CellLibrary {
+  /// \brief Keyed by the cell name, a NUL and the pin name.
+  llvm::StringMap<PortKind> Pins;
+
+public:
+  void addPin(StringRef Cell, StringRef Pin, PortKind Kind);
+
+  /// \brief The direction of pin \p Pin of \p Cell, or PortKind::Unknown.
+  PortKind getPinKind(StringRef Cell, StringRef Pin) const;
+};
+
+/// \brief The connectivity graph of a netlist.
+///
+/// The database is built from the NetlistTable filled while parsing in
+/// netlist mode.  It is not flattened: each module is a template holding
+/// its own instances, nets and ports once, however often it is
+/// instantiated, and an instance of a module defined in the design refers
+/// to that module's template.  Instances, nets and pins are numbered
+/// globally, and the ones of a module are contiguous.
+///
+/// Adjacency is kept as compressed sparse rows: the pins of an instance
+/// are a range of the pin arrays, and the pins on a net are a range of a
+/// second array of pin numbers.  Besides the pins of instances, every net
+/// named like a port of its module has a port pin with no instance, so
+/// that an input port drives its nets and an output port loads them.
+///
+/// Every array is a flat column of fixed-size elements, and references
+/// between them are 32-bit indexes.  A built database can be written to
+/// disk and loaded back by mapping the file and pointing the columns into
+/// it, with no deserialization.
+///
+/// Each pin has a role on its net.  It comes from the port directions of a
+/// module template, from the terminal order of a gate primitive or
+/// continuous assignment, or from a CellLibrary; a pin whose direction is
+/// not known this way is neither a driver nor a load.
+class NetlistDatabase {
+public:
+  enum PinRole {
+    PR_Unknown,
+    PR_Driver,
+    PR_Load,
+    PR_Bidirectional
+  };
+
+  enum {
+    NoFile = ~0U,
+    NoModule = ~0U,
+    NoInstance = ~0U,
+    NoNet = ~0U,
+    NoPort = ~0U
+  };
+
+private:
+  /// \brief An array filled while building, or used in place from a mapped
+  /// file.
+  template <typename T> struct Column {
+    std::vector<T> Storage;
+    const T *Data;
+    size_t Size;
+
+    Column() : Data(0), Size(0) {}
+
+    /// \brief Make the built Storage readable.
+    void seal() {
+      Data = Storage.empty() ? 0 : &Storage[0];
+      Size = Storage.size();
+    }
+    void map(const T *MappedData, size_t MappedSize) {
+      std::vector<T>().swap(Storage);
+      Data = MappedData;
+      Size = MappedSize;
+    }
+
+    size_t size() const { return Size; }
+    const T &operator[](size_t I) const {
+      assert(I < Size && "Index out of range");
+      return Data[I];
+    }
+    ArrayRef<T> slice(size_t Begin, size_t End) const {
+      return ArrayRef<T>(Data + Begin, End - Begin);
+    }
+  };
+
+  // Interned names, with the IDs of the NetlistTable.
+  Column<uint32_t> NameOffsets;
+  Column<char> NameData;
+
+  // The source files, by name ID.
+  Column<uint32_t> FileNames;
+
+  // Modules.  The per-module arrays hold one more entry than there are
+  // modules, so that module M's range is [Begin[M], Begin[M + 1]).
+  Column<uint32_t> ModuleNames;
+  Column<uint32_t> ModuleInstanceBegin;
+  Column<uint32_t> ModuleNetBegin;
+  Column<uint32_t> ModulePortBegin;
+  Column<uint32_t> ModulePortPinBegin;
+
+  // Ports, in the order their module lists them.
+  Column<uint32_t> PortNames;
+  Column<PortKind> PortKinds;
+  Column<uint32_t> PortNets;
+
+  // Instances.
+  Column<uint32_t> InstanceNames;
+  Column<uint32_t> InstanceCells;
+  Column<uint32_t> InstanceTemplates;
+  Column<uint32_t> InstanceFiles;
+  Column<uint32_t> InstanceOffsets;
+  Column<uint32_t> InstancePinBegin;
+
+  // Pins: those of instances, in instance order, then the port pins.
+  Column<uint32_t> PinNets;
+  Column<uint32_t> PinNames;
+  Column<uint32_t> PinInstances;
+  Column<uint8_t> PinRoles;
+
+  // Nets.
+  Column<uint32_t> NetModules;
+  Column<uint32_t> NetNames;
+  Column<uint32_t> NetBits;
+  Column<uint32_t> NetPinBegin;
+  Column<uint32_t> NetPins;
+
+  /// \brief The file the columns are mapped from, if loaded.
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+
+  NetlistDatabase() {}
+  NetlistDatabase(const NetlistDatabase &) LLVM_DELETED_FUNCTION;
+  void operator=(const NetlistDatabase &) LLVM_DELETED_FUNCTION;
+
+  friend class NetlistDatabaseBuilder;
+
+  void sealColumns();
+  bool init();
+
+public:
+  ~NetlistDatabase();
+
+  /// \brief Build the graph of \p Table.  Pins of cells the design does
+  /// not define take their directions from \p Library, if given.
+  /// Instance locations are resolved to files and offsets with \p SM, if
+  /// given, and are unknown otherwise.
+  static NetlistDatabase *build(const NetlistTable &Table,
+                                const CellLibrary *Library = 0,
+                                const SourceManager *SM = 0);
+
+  /// \brief Map a database written by writeToFile().  Returns null and sets
+  /// \p ErrorStr on failure.
+  static NetlistDatabase *loadFromFile(StringRef Path, std::string &ErrorStr);
+
+  /// \brief Write the database.  Returns true on error.
+  bool writeToFile(StringRef Path, std::string &ErrorStr) const;
+
+  unsigned getNumNames() const {
+    return NameOffsets.size() ? NameOffsets.size() - 1 : 0;
+  }
+  StringRef getName(unsigned ID) const {
+    assert(ID + 1 < NameOffsets.size() && "Invalid name");
+    return StringRef(NameData.Data + NameOffsets[ID],
+                     NameOffsets[ID + 1] - NameOffsets[ID]);
+  }
+
+  /// \name Files
+  /// @{
+
+  unsigned getNumFiles() const { return FileNames.size(); }
+  StringRef getFileName(unsigned F) const { return getName(FileNames[F]); }
+
+  /// @}
+  /// \name Modules
+  /// @{
+
+  unsigned getNumModules() const { return ModuleNames.size(); }
+
+  /// \brief The name of module \p M; empty for the module holding what was
+  /// recorded outside any module.
+  StringRef getModuleName(unsigned M) const;
+
+  /// \brief The module named \p Name, or NoModule.
+  unsigned findModule(StringRef Name) const;
+
+  std::pair<unsigned, unsigned> getModuleInstances(unsigned M) const {
+    return std::make_pair(ModuleInstanceBegin[M], ModuleInstanceBegin[M + 1]);
+  }
+  std::pair<unsigned, unsigned> getModuleNets(unsigned M) const {
+    return std::make_pair(ModuleNetBegin[M], ModuleNetBegin[M + 1]);
+  }
+  std::pair<unsigned, unsigned> getModulePorts(unsigned M) const {
+    return std::make_pair(ModulePortBegin[M], ModulePortBegin[M + 1]);
+  }
+
+  /// \brief The port pins of module \p M are [first, second).
+  std::pair<unsigned, unsigned> getModulePortPins(unsigned M) const {
+    return std::make_pair(ModulePortPinBegin[M], ModulePortPinBegin[M + 1]);
+  }
+
+  /// @}
+  /// \name Ports
+  /// @{
+
+  StringRef getPortName(unsigned P) const { return getName(PortNames[P]); }
+  PortKind getPortKind(unsigned P) const { return PortKinds[P]; }
+
+  /// \brief The net of the whole of port \p P, or NoNet if only bits of it
+  /// are used.
+  unsigned getPortNet(unsigned P) const { return PortNets[P]; }
+
+  /// @}
+  /// \name Instances
+  /// @{
+
+  unsigned getNumInstances() const { return InstanceNames.size(); }
+
+  /// \brief The instance name; empty for unnamed gates and assignments.
+  StringRef getInstanceName(unsigned I) const;
+  StringRef getInstanceCell(unsigned I) const {
+    return getName(InstanceCells[I]);
+  }
+
+  /// \brief The file of the instance name, or NoFile if it is unknown.
+  unsigned getInstanceFile(unsigned I) const { return InstanceFiles[I]; }
+
+  /// \brief The offset of the instance name in its file, or of its macro
+  /// expansion.
+  unsigned getInstanceOffset(unsigned I) const { return InstanceOffsets[I]; }
+
+  /// \brief The module template instance \p I instantiates, or NoModule
+  /// for a cell the design does not define.
+  unsigned getInstanceTemplate(unsigned I) const {
+    return InstanceTemplates[I];
+  }
+
+  /// \brief The pins of instance \p I are [first, second).
+  std::pair<unsigned, unsigned> getInstancePins(unsigned I) const {
+    return std::make_pair(InstancePinBegin[I], InstancePinBegin[I + 1]);
+  }
+
+  /// @}
+  /// \name Pins
+  /// @{
+
+  unsigned getNumPins() const { return PinNets.size(); }
+
+  /// \brief The net of pin \p P, or NoNet if it is unconnected.
+  unsigned getPinNet(unsigned P) const { return PinNets[P]; }
+
+  /// \brief The instance of pin \p P, or NoInstance for a port pin.
+  unsigned getPinInstance(unsigned P) const { return PinInstances[P]; }
+
+  /// \brief The pin name, or the port name of a port pin; empty for an
+  /// ordered connection.
+  StringRef getPinName(unsigned P) const;
+
+  /// \brief The position of an ordered connection.
+  bool getPinPosition(unsigned P, unsigned &Position) const;
+
+  PinRole getPinRole(unsigned P) const {
+    return static_cast<PinRole>(PinRoles[P]);
+  }
+
+  /// \brief The net inside the template of pin \p P's instance that the
+  /// pin connects to, or NoNet.
+  unsigned getChildNet(unsigned P) const;
+
+  /// @}
+  /// \name Nets
+  /// @{
+
+  unsigned getNumNets() const { return NetNames.size(); }
+  unsigned getNetModule(unsigned N) const { return NetModules[N]; }
+  StringRef getNetName(unsigned N) const { return getName(NetNames[N]); }
+
+  /// \brief The selected bit, or NetlistTable::NoBit, ConstantBit or
+  /// OpaqueBit.
+  unsigned getNetBit(unsigned N) const { return NetBits[N]; }
+
+  /// \brief All the pins on net \p N, in pin order.
+  ArrayRef<uint32_t> getNetPins(unsigned N) const {
+    return NetPins.slice(NetPinBegin[N], NetPinBegin[N + 1]);
+  }
+
+  /// @}
+  /// \name Traversal
+  /// @{
+
+  /// \brief Append the pins driving net \p N, bidirectional ones included.
+  void getFanin(unsigned N, SmallVectorImpl<unsigned> &Pins) const;
+
+  /// \brief Append the pins loading net \p N, bidirectional ones included.
+  void getFanout(unsigned N, SmallVectorImpl<unsigned> &Pins) const;
+
+  /// \brief Append, once each, the instances driving the nets loaded by
+  /// instance \p I.
+  void getFaninInstances(unsigned I, SmallVectorImpl<unsigned> &Out) const;
+
+  /// \brief Append, once each, the instances loading the nets driven by
+  /// instance \p I.
+  void getFanoutInstances(unsigned I, SmallVectorImpl<unsigned> &Out) const;
+
+  /// @}
+
+  size_t getMemorySize() const;
+};
+
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,106 @@
+//===--- ConfigTable.h - Configurations of a design -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ConfigTable class, the configurations declared by
+//  config blocks, which select the library each cell instance comes from.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_PARSE_CONFIGTABLE_H
+#define LLVM_VLANG_PARSE_CONFIGTABLE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <vector>
+
+namespace vlang {
+
+/// \brief A cell, optionally qualified by its library: [lib.]cell.
+struct ConfigCell {
+  /// \brief Empty if the library is not given.
+  StringRef Library;
+  StringRef Cell;
+};
+
+/// \brief A rule of a configuration, selecting the libraries or the cell
+/// that an instance or the instances of a cell are bound to.
+struct ConfigRule {
+  enum RuleKind {
+    /// \brief default liblist ...
+    RK_Default,
+    /// \brief instance top.inst... liblist ... or use ...
+    RK_Instance,
+    /// \brief cell [lib.]cell liblist ... or use ...
+    RK_Cell
+  };
+
+  RuleKind Kind;
+  /// \brief For an instance rule, the hierarchical name of the instance,
+  /// starting at a top cell of the configuration.
+  StringRef InstancePath;
+  /// \brief For a cell rule, the cell.
+  ConfigCell Cell;
+
+  /// \brief Whether the rule is a use clause rather than a liblist.
+  bool HasUse;
+  /// \brief The cell used; empty if the use clause only sets parameters,
+  /// which are not recorded.
+  ConfigCell Use;
+  /// \brief The used cell is a configuration: "use lib.cfg : config".
+  bool UseIsConfig;
+
+  /// \brief The libraries to search, in order.
+  std::vector<StringRef> Liblist;
+};
+
+/// \brief A config block.
+struct Configuration {
+  StringRef Name;
+  /// \brief The top cells of the design statement.
+  std::vector<ConfigCell> Design;
+  std::vector<ConfigRule> Rules;
+};
+
+/// \brief The configurations declared by the compilation units parsed so
+/// far.  The table copies the names of what is added to it, so it can
+/// outlive the units; see Parser::setConfigTable().
+class ConfigTable {
+  std::vector<Configuration> Configs;
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> ConfigsByName;
+  llvm::StringMap<char, llvm::BumpPtrAllocator> Strings;
+  unsigned NumDeclarations;
+
+  ConfigTable(const ConfigTable &) LLVM_DELETED_FUNCTION;
+  void operator=(const ConfigTable &) LLVM_DELETED_FUNCTION;
+
+  StringRef copyString(StringRef Str);
+  ConfigCell copyCell(const ConfigCell &Cell);
+
+public:
+  ConfigTable() : NumDeclarations(0) {}
+
+  /// \brief Add a copy of \p Config.  A configuration declared again
+  /// replaces the earlier one.
+  void addConfig(const Configuration &Config);
+
+  /// \brief The configuration named \p Name, or null.
+  const Configuration *findConfig(StringRef Name) const;
+
+  unsigned getNumConfigs() const { return Configs.size(); }
+  const Configuration &getConfig(unsigned C) const { return Configs[C]; }
+
+  /// \brief The config blocks added, those replaced included.
+  unsigned getNumDeclarations() const { return NumDeclarations; }
+};
+
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,104 @@
+//===--- DesignUnitTable.h - Defined and instantiated units -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the DesignUnitTable class, the design elements a
+//  design defines and the cells they instantiate.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_PARSE_DESIGNUNITTABLE_H
+#define LLVM_VLANG_PARSE_DESIGNUNITTABLE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <vector>
+
+namespace vlang {
+
+/// \brief The design elements defined and the cells instantiated by the
+/// compilation units parsed so far.
+///
+/// The parser adds each module, interface and program it parses, and each
+/// instance of a module in it; see Parser::setDesignUnitTable().  One table
+/// can outlive the units that fill it, as it copies the names, so that the
+/// cells a design instantiates but does not define can be looked for in
+/// libraries after all of its files are parsed, and so that a table can be
+/// saved and restored without parsing again.
+class DesignUnitTable {
+public:
+  enum {
+    NoDefinition = ~0U
+  };
+
+  struct Instance {
+    StringRef Cell;
+    /// \brief The instance name; empty if it is not known.
+    StringRef Name;
+  };
+
+private:
+  struct Definition {
+    StringRef Name;
+    std::vector<Instance> Instances;
+  };
+
+  /// \brief Every name defined or referenced, mapped to its definition or
+  /// to NoDefinition.
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> Units;
+  /// \brief The instance names.
+  llvm::StringMap<char, llvm::BumpPtrAllocator> InstanceNames;
+  std::vector<Definition> Definitions;
+  /// \brief The names referenced, in the order first referenced.
+  std::vector<StringRef> References;
+  unsigned CurDefinition;
+
+  StringRef addReference(StringRef Name);
+
+public:
+  DesignUnitTable() : CurDefinition(NoDefinition) {}
+
+  /// \brief Start the definition of \p Name; the instances added after it
+  /// are its.  A second definition of a name is ignored, as it would be by
+  /// elaboration, and so are its instances.
+  void addDefinition(StringRef Name);
+
+  /// \brief Add an instance named \p Name of \p Cell to the current
+  /// definition, if any.
+  void addInstance(StringRef Cell, StringRef Name);
+
+  /// \brief Add the definitions of \p Other, with their instances.
+  void append(const DesignUnitTable &Other);
+
+  bool isDefined(StringRef Name) const {
+    return findDefinition(Name) != NoDefinition;
+  }
+
+  /// \brief The definition of \p Name, or NoDefinition.
+  unsigned findDefinition(StringRef Name) const;
+
+  unsigned getNumDefinitions() const { return Definitions.size(); }
+  StringRef getDefinitionName(unsigned D) const {
+    return Definitions[D].Name;
+  }
+  ArrayRef<Instance> getInstances(unsigned D) const {
+    return Definitions[D].Instances;
+  }
+
+  /// \brief Append the names referenced but not defined, in the order first
+  /// referenced.
+  void getUnresolved(SmallVectorImpl<StringRef> &Names) const;
+};
+
+} // end namespace vlang
+
+#endif
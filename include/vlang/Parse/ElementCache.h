@@ -0,0 +1,44 @@
+//===--- ElementCache.h - Results of parsing design elements ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ElementCache interface, through which the parser
+//  skips top-level design elements whose results are already known.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_PARSE_ELEMENTCACHE_H
+#define LLVM_VLANG_PARSE_ELEMENTCACHE_H
+
+namespace vlang {
+
+/// \brief Abstract interface for a cache of the results of parsing top-level
+/// design elements from a token buffer; see Parser::setElementCache().
+///
+/// Before each top-level element the parser asks the cache to replay it.  A
+/// cache that knows the element reproduces what parsing it would have done,
+/// its diagnostics and the tables it would have filled, and the parser
+/// resumes after it without looking at its tokens.  Otherwise the parser
+/// parses the element and says where it ended, so that the cache can
+/// record it.
+class ElementCache {
+public:
+  virtual ~ElementCache();
+
+  /// \brief Replay the element that starts at token \p FirstToken.  Returns
+  /// the index of the token after it, or 0 if the element must be parsed.
+  virtual unsigned replayElement(unsigned FirstToken) = 0;
+
+  /// \brief The element at \p FirstToken, which replayElement() returned 0
+  /// for, was parsed and ended before token \p EndToken.
+  virtual void parsedElement(unsigned FirstToken, unsigned EndToken) = 0;
+};
+
+} // end namespace vlang
+
+#endif
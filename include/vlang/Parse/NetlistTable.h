@@ -0,0 +1,236 @@
+//===--- NetlistTable.h - Cell instance connectivity ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the NetlistTable class, the connectivity of the simple
+//  cell instances of a gate-level netlist.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_PARSE_NETLISTTABLE_H
+#define LLVM_VLANG_PARSE_NETLISTTABLE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Basic/SourceLocation.h"
+#include "vlang/Parse/ParserResult.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/DataTypes.h"
+#include <cassert>
+#include <vector>
+
+namespace vlang {
+
+class IdentifierInfo;
+
+/// \brief The modules, ports, instances, pins and nets of a netlist, as
+/// flat arrays.
+///
+/// In netlist mode the parser records each instantiation and continuous
+/// assignment whose connections are all identifiers, constant bit-selects
+/// of identifiers or constants here instead of parsing it in full; see
+/// Parser::setNetlistTable().  Anything else goes through the general
+/// parser, which records it too, and is counted.  A continuous assignment
+/// `assign a = b` is recorded as an unnamed instance of the cell "assign"
+/// with the ordered connections a and b.
+///
+/// Cell, instance, module and pin names are interned into name IDs.  A net
+/// is a name, or one bit of a name, within the module being parsed; the
+/// same name in another module is another net.  Each constant connected
+/// in a module is a net of its own, named by its spelling, and so is each
+/// expression the general parser connects other than a plain identifier.
+/// Modules are numbered in the order they are begun.
+class NetlistTable {
+public:
+  enum {
+    /// \brief The name of an unnamed gate instance.
+    NoName = ~0U,
+    /// \brief The module of an instance outside any module.
+    NoModule = ~0U,
+    /// \brief The net of an unconnected pin, as in .A().
+    NoNet = ~0U,
+    /// \brief The bit of a net that is a whole identifier.
+    NoBit = ~0U,
+    /// \brief The bit of a net that is a constant.
+    ConstantBit = ~0U - 1,
+    /// \brief The bit of a net that is an expression the parser did not
+    /// break down into nets.
+    OpaqueBit = ~0U - 2,
+    /// \brief Set in the pin of an ordered connection, whose other bits
+    /// hold its position.
+    OrderedPinFlag = 1U << 31
+  };
+
+  struct Instance {
+    /// \brief The index of the module, or NoModule.
+    uint32_t Module;
+    uint32_t Cell;
+    uint32_t Name;
+    uint32_t FirstConnection;
+    /// \brief The raw encoding of the instance name's location.
+    uint32_t Loc;
+  };
+
+  struct Connection {
+    /// \brief The pin's name ID, or its position | OrderedPinFlag.
+    uint32_t Pin;
+    uint32_t Net;
+  };
+
+  struct Port {
+    uint32_t Module;
+    uint32_t Name;
+    PortKind Kind;
+  };
+
+  struct Net {
+    uint32_t Module;
+    uint32_t Name;
+    /// \brief The selected bit, NoBit, ConstantBit or OpaqueBit.
+    uint32_t Bit;
+
+    bool isConstant() const { return Bit == ConstantBit; }
+    bool isOpaque() const { return Bit == OpaqueBit; }
+  };
+
+private:
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> NameIDs;
+  std::vector<StringRef> Names;
+  llvm::DenseMap<const IdentifierInfo *, unsigned> IdentifierNames;
+
+  std::vector<uint32_t> Modules;
+  std::vector<Port> Ports;
+  std::vector<Instance> Instances;
+  std::vector<Connection> Connections;
+  std::vector<Net> Nets;
+
+  /// \brief The nets of the current module, keyed by name ID in the high
+  /// and bit plus one in the low half.
+  llvm::DenseMap<uint64_t, unsigned> ModuleNets;
+  /// \brief The ports of the current module, keyed by name ID.
+  llvm::DenseMap<unsigned, unsigned> ModulePorts;
+  unsigned CurModule;
+  unsigned NumComplexItems;
+
+  NetlistTable(const NetlistTable &) LLVM_DELETED_FUNCTION;
+  void operator=(const NetlistTable &) LLVM_DELETED_FUNCTION;
+
+public:
+  NetlistTable();
+
+  /// \name Recording
+  /// @{
+
+  /// \brief Start module \p Name, to which the ports, instances and nets
+  /// recorded next belong.
+  void beginModule(StringRef Name);
+
+  /// \brief Add port \p Name to the current module, or set the direction
+  /// of a port already listed in its header.
+  void addPort(StringRef Name, PortKind Kind);
+
+  unsigned getNameID(StringRef Name);
+  unsigned getNameID(const IdentifierInfo *II) {
+    unsigned &ID = IdentifierNames[II];
+    if (ID == 0)
+      ID = getNameID(getIdentifierName(II)) + 1;
+    return ID - 1;
+  }
+
+  /// \brief The net of bit \p Bit of the name \p Name in the current
+  /// module, or of all of it if \p Bit is NoBit.
+  unsigned getNetID(unsigned Name, unsigned Bit);
+  unsigned getNetID(const IdentifierInfo *II, unsigned Bit) {
+    assert(Bit != ConstantBit && Bit != OpaqueBit &&
+           "Bit reserved for constants and expressions");
+    return getNetID(getNameID(II), Bit);
+  }
+
+  /// \brief The net of constant \p Spelling in the current module.
+  unsigned getConstantNetID(StringRef Spelling) {
+    return getNetID(getNameID(Spelling), ConstantBit);
+  }
+
+  /// \brief A new net in the current module for the expression \p Spelling.
+  /// Expressions are not compared, so each is a net of its own.
+  unsigned getOpaqueNetID(StringRef Spelling) {
+    Net N = { CurModule, getNameID(Spelling), OpaqueBit };
+    Nets.push_back(N);
+    return Nets.size() - 1;
+  }
+
+  /// \brief Start an instance; its connections are the ones added until
+  /// the next instance.
+  void addInstance(unsigned Cell, unsigned Name, SourceLocation Loc) {
+    Instance I = { CurModule, Cell, Name, (uint32_t)Connections.size(),
+                   Loc.getRawEncoding() };
+    Instances.push_back(I);
+  }
+
+  void addConnection(unsigned Pin, unsigned Net) {
+    assert(!Instances.empty() && "Connection outside an instance");
+    Connection C = { Pin, Net };
+    Connections.push_back(C);
+  }
+
+  /// \brief Count an instantiation or continuous assignment the general
+  /// parser recorded.
+  void noteComplexItem() { ++NumComplexItems; }
+
+  /// @}
+
+  unsigned getNumNames() const { return Names.size(); }
+  StringRef getName(unsigned ID) const {
+    assert(ID < Names.size() && "Invalid name");
+    return Names[ID];
+  }
+
+  unsigned getNumModules() const { return Modules.size(); }
+  /// \brief The name ID of module \p M.
+  unsigned getModuleName(unsigned M) const { return Modules[M]; }
+
+  unsigned getNumPorts() const { return Ports.size(); }
+  const Port &getPort(unsigned P) const { return Ports[P]; }
+
+  unsigned getNumInstances() const { return Instances.size(); }
+  const Instance &getInstance(unsigned I) const { return Instances[I]; }
+  ArrayRef<Connection> getConnections(unsigned I) const {
+    assert(I < Instances.size() && "Invalid instance");
+    unsigned End = I + 1 == Instances.size()
+                     ? Connections.size()
+                     : Instances[I + 1].FirstConnection;
+    return ArrayRef<Connection>(Connections).slice(
+      Instances[I].FirstConnection, End - Instances[I].FirstConnection);
+  }
+
+  unsigned getNumConnections() const { return Connections.size(); }
+
+  unsigned getNumNets() const { return Nets.size(); }
+  const Net &getNet(unsigned N) const { return Nets[N]; }
+
+  static bool isOrderedPin(unsigned Pin) { return Pin & OrderedPinFlag; }
+  static unsigned getOrderedPin(unsigned Position) {
+    return Position | OrderedPinFlag;
+  }
+
+  /// \brief The instantiations and continuous assignments the general
+  /// parser recorded.
+  unsigned getNumComplexItems() const { return NumComplexItems; }
+
+  size_t getMemorySize() const;
+
+private:
+  static StringRef getIdentifierName(const IdentifierInfo *II);
+};
+
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,226 @@
+//===--- PackageTable.h - Packages and imports of a unit --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the PackageTable class, the packages a compilation unit
+//  declares or imports and the package symbols its names resolve to, and
+//  the ExternalPackageSource interface for packages it does not declare.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_PARSE_PACKAGETABLE_H
+#define LLVM_VLANG_PARSE_PACKAGETABLE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <cassert>
+#include <vector>
+
+namespace vlang {
+
+/// \brief What a package symbol declares.
+enum class PackageSymbolKind : char {
+  Parameter,
+  Type,
+  EnumConstant,
+  Variable,
+  Net,
+  Function,
+  Task,
+  Class
+};
+
+/// \brief A symbol declared by a package.
+struct PackageSymbol {
+  StringRef Name;
+  PackageSymbolKind Kind;
+  /// \brief For a package parsed in this unit, the declaration is tokens
+  /// [FirstToken, EndToken) of the token buffer.
+  unsigned FirstToken;
+  unsigned EndToken;
+  /// \brief For a package from an ExternalPackageSource, the preprocessed
+  /// text of the declaration.
+  StringRef Definition;
+};
+
+/// \brief Abstract interface for sources of packages a unit imports but does
+/// not declare, such as precompiled packages.
+class ExternalPackageSource {
+public:
+  virtual ~ExternalPackageSource();
+
+  /// \brief Make package \p Name available.  Returns false if the source has
+  /// no such package.
+  virtual bool findPackage(StringRef Name) = 0;
+
+  /// \brief Fill \p Symbol with symbol \p Name of package \p Package, which
+  /// findPackage() returned true for, whether the package declares it or
+  /// exports it.  Returns false if the package has no such symbol.  Strings
+  /// in \p Symbol must live as long as the source.
+  virtual bool findSymbol(StringRef Package, StringRef Name,
+                          PackageSymbol &Symbol) = 0;
+};
+
+/// \brief The packages of a compilation unit and the imports in effect.
+///
+/// The parser records each package it parses with the symbols of its items
+/// (see Parser::setPackageTable()), and each import.  A package imported
+/// but not declared in the unit is requested from the ExternalPackageSource
+/// when first imported, and only the symbols that names are looked up for
+/// are materialized from it; the others are never read.
+///
+/// Imports are scoped: those of a design element end with it, and those
+/// outside any are visible to the rest of the unit.
+///
+/// A package's exports make names it imports visible to its own importers,
+/// as if the package declared them.
+class PackageTable {
+public:
+  enum {
+    NoPackage = ~0U,
+    NoSymbol = ~0U
+  };
+
+private:
+  struct Import {
+    unsigned Package;
+    /// \brief The name imported, or empty for a wildcard import.
+    StringRef Name;
+  };
+
+  /// \brief An export of a package.  Package is NoPackage for export *::*,
+  /// which exports everything the package imports.
+  typedef Import Export;
+
+  struct Package {
+    StringRef Name;
+    bool External;
+    /// \brief The package is tokens [FirstToken, EndToken) of the token
+    /// buffer, if parsed in this unit.
+    unsigned FirstToken;
+    unsigned EndToken;
+    /// \brief The symbols of a parsed package, in declaration order.
+    std::vector<unsigned> Symbols;
+    /// \brief The imports and exports of a parsed package, in order.
+    std::vector<Import> Imports;
+    std::vector<Export> Exports;
+    /// \brief Set while the exports are searched, so that packages that
+    /// export each other's names do not recurse forever.
+    bool Searching;
+  };
+
+  std::vector<Package> Packages;
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> PackagesByName;
+
+  std::vector<PackageSymbol> Symbols;
+  /// \brief Keyed by package name, "::" and symbol name; NoSymbol caches a
+  /// name an external package does not have.
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> SymbolsByName;
+
+  std::vector<Import> Imports;
+  SmallVector<unsigned, 4> ScopeStarts;
+
+  unsigned CurPackage;
+  ExternalPackageSource *External;
+  unsigned NumMaterialized;
+
+  PackageTable(const PackageTable &) LLVM_DELETED_FUNCTION;
+  void operator=(const PackageTable &) LLVM_DELETED_FUNCTION;
+
+  unsigned findSymbol(unsigned P, StringRef Name);
+  unsigned findExportedSymbol(unsigned P, StringRef Name);
+
+public:
+  PackageTable();
+
+  /// \brief Request packages the unit does not declare from \p Source.
+  void setExternalSource(ExternalPackageSource *Source) { External = Source; }
+  ExternalPackageSource *getExternalSource() const { return External; }
+
+  /// \name Recording
+  /// @{
+
+  /// \brief Start package \p Name, which begins at token \p FirstToken.
+  void beginPackage(StringRef Name, unsigned FirstToken);
+
+  /// \brief Add a symbol of the current package.
+  void addSymbol(StringRef Name, PackageSymbolKind Kind, unsigned FirstToken,
+                 unsigned EndToken);
+
+  /// \brief End the current package before token \p EndToken.
+  void endPackage(unsigned EndToken);
+
+  bool isInPackage() const { return CurPackage != NoPackage; }
+
+  /// \brief Enter a design element or package; its imports end with it.
+  void beginScope() { ScopeStarts.push_back(Imports.size()); }
+  void endScope();
+
+  /// \brief import \p Package::*.  Returns false if the package is unknown.
+  bool importAll(StringRef Package);
+
+  /// \brief import \p Package::\p Name.  Returns false if the package or
+  /// the symbol is unknown.
+  bool importName(StringRef Package, StringRef Name);
+
+  /// \brief export \p Package::\p Name from the current package, or
+  /// \p Package::* if \p Name is empty, or *::* if both are.  Returns false
+  /// if the package or the symbol is unknown.
+  bool addExport(StringRef Package, StringRef Name);
+
+  /// @}
+  /// \name Resolution
+  /// @{
+
+  /// \brief The package named \p Name, requesting it from the external
+  /// source if needed, or NoPackage.
+  unsigned findPackage(StringRef Name);
+
+  /// \brief The symbol \p Name resolves to through the imports in effect,
+  /// or NoSymbol.  Names declared locally are not known here, so a caller
+  /// should try them first.
+  unsigned lookup(StringRef Name);
+
+  /// \brief The symbol \p Package::\p Name, or NoSymbol.
+  unsigned lookupQualified(StringRef Package, StringRef Name);
+
+  /// @}
+
+  unsigned getNumPackages() const { return Packages.size(); }
+  StringRef getPackageName(unsigned P) const { return Packages[P].Name; }
+  bool isExternal(unsigned P) const { return Packages[P].External; }
+  std::pair<unsigned, unsigned> getPackageTokens(unsigned P) const {
+    return std::make_pair(Packages[P].FirstToken, Packages[P].EndToken);
+  }
+  ArrayRef<unsigned> getPackageSymbols(unsigned P) const {
+    return Packages[P].Symbols;
+  }
+
+  /// \brief The exports of parsed package \p P as (package, name) pairs,
+  /// with an empty name for a wildcard.  export *::* is given as the
+  /// imports it covers.
+  void getPackageExports(
+      unsigned P, SmallVectorImpl<std::pair<StringRef, StringRef> > &Exports)
+      const;
+
+  const PackageSymbol &getSymbol(unsigned S) const {
+    assert(S < Symbols.size() && "Invalid symbol");
+    return Symbols[S];
+  }
+
+  /// \brief The symbols read from the external source so far.
+  unsigned getNumMaterialized() const { return NumMaterialized; }
+};
+
+} // end namespace vlang
+
+#endif
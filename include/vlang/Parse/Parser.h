@@ -19,10 +19,17 @@
 #include "vlang/Basic/Specifiers.h"
 #include "vlang/Lex/CodeCompletionHandler.h"
 #include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "vlang/Parse/ConfigTable.h"
+#include "vlang/Parse/DesignUnitTable.h"
+#include "vlang/Parse/ElementCache.h"
+#include "vlang/Parse/NetlistTable.h"
+#include "vlang/Parse/PackageTable.h"
 #include "vlang/Sema/Sema.h"
 #include "vlang/Sema/Scope.h"
 #include <llvm/ADT/OwningPtr.h>
 #include <llvm/ADT/SmallVector.h>
+#include <algorithm>
 #include <stack>
 
 namespace vlang {
@@ -45,6 +52,36 @@ class Parser : public CodeCompletionHandler {
   /// that this is valid.
   Token Tok;
 
+  /// TokBuf - If non-null, the preprocessed tokens of the unit, which are
+  /// consumed in place of lexing from PP.
+  const TokenBuffer *TokBuf;
+
+  /// TokBufPos - The index in TokBuf of the token after Tok.
+  unsigned TokBufPos;
+
+  /// LookAheadTok - Storage for the token returned by GetLookAheadToken when
+  /// reading from TokBuf.
+  Token LookAheadTok;
+
+  /// Netlist - If non-null, simple instantiations are recorded here instead
+  /// of being parsed in full.
+  NetlistTable *Netlist;
+
+  /// Packages - If non-null, the packages of the unit are recorded here and
+  /// imports resolve through it.
+  PackageTable *Packages;
+
+  /// Units - If non-null, the design elements defined and the cells
+  /// instantiated are recorded here.
+  DesignUnitTable *Units;
+
+  /// Configs - If non-null, the config blocks parsed are recorded here.
+  ConfigTable *Configs;
+
+  /// Elements - If non-null, top-level elements are replayed from it when
+  /// it can, and parsed otherwise.
+  ElementCache *Elements;
+
   // PrevTokLocation - The location of the token we Previously
   // consumed. This token is used for diagnostics where we expected to
   // see a token following another token (e.g., the ';' at the end of
@@ -78,6 +115,54 @@ public:
   Sema &getActions() const { return Actions; }
 
   const Token &getCurToken() const { return Tok; }
+
+  /// setTokenBuffer - Parse the tokens in \p Buf, which must hold the whole
+  /// preprocessed unit, instead of lexing them from the preprocessor.  Must
+  /// be called before Initialize().
+  void setTokenBuffer(const TokenBuffer *Buf) {
+    assert(Buf && !Buf->empty() && "Token buffer must end with eof");
+    TokBuf = Buf;
+    TokBufPos = 0;
+  }
+
+  /// getTokenBufferIndex - The index in the token buffer of the current
+  /// token.  Only valid when parsing from a token buffer.
+  unsigned getTokenBufferIndex() const {
+    assert(TokBuf && "Not parsing from a token buffer");
+    return Tok.is(tok::eof) ? TokBuf->size() - 1 : TokBufPos - 1;
+  }
+
+  /// setNetlistTable - Parse in netlist mode: instantiations whose
+  /// connections are identifiers, constant bit-selects and constants are
+  /// recorded in \p Table by a scan of the token buffer, and anything else
+  /// is parsed as usual and recorded with a net of its own for each other
+  /// connection.  Needs a token buffer.
+  void setNetlistTable(NetlistTable *Table) {
+    assert(TokBuf && "Netlist mode needs a token buffer");
+    Netlist = Table;
+  }
+
+  /// setPackageTable - Record imports in \p Table and resolve names through
+  /// it.  Packages declared in the unit are added to it with the symbols of
+  /// their items, found by a scan of the token buffer; without one, only
+  /// their names are known.
+  void setPackageTable(PackageTable *Table) { Packages = Table; }
+
+  /// setDesignUnitTable - Record in \p Table the modules, interfaces and
+  /// programs defined and the cells instantiated, so that a driver can find
+  /// the cells that are not defined.
+  void setDesignUnitTable(DesignUnitTable *Table) { Units = Table; }
+
+  /// setConfigTable - Record the config blocks parsed in \p Table.
+  void setConfigTable(ConfigTable *Table) { Configs = Table; }
+
+  /// setElementCache - Replay the top-level elements \p Cache knows instead
+  /// of parsing them.  The cache must reproduce whatever the tables set on
+  /// the parser would record for them.  Needs a token buffer.
+  void setElementCache(ElementCache *Cache) {
+    assert(TokBuf && "An element cache needs a token buffer");
+    Elements = Cache;
+  }
   Scope *getCurScope() const { return Actions.getCurScope(); }
 
   ExprResult ExprError() { return ExprResult(true); }
@@ -111,7 +196,7 @@ public:
       return handleUnexpectedCodeCompletionToken();
 
     PrevTokLocation = Tok.getLocation();
-    PP.Lex(Tok);
+    LexToken();
     return PrevTokLocation;
   }
 
@@ -120,6 +205,27 @@ private:
   // Low-Level token Peeking and consumption methods.
   //
 
+  /// LexToken - Read the next token into Tok, from the token buffer if there
+  /// is one.  The buffer's final eof token is returned indefinitely.
+  void LexToken() {
+    if (!TokBuf) {
+      PP.Lex(Tok);
+      return;
+    }
+    TokBuf->getToken(TokBufPos, Tok);
+    if (TokBufPos + 1 < TokBuf->size())
+      ++TokBufPos;
+  }
+
+  /// SkipToTokenBufferIndex - Make the token at \p Idx of the token buffer
+  /// the current one, as if those before it had been consumed.
+  void SkipToTokenBufferIndex(unsigned Idx) {
+    assert(TokBuf && Idx != 0 && Idx < TokBuf->size() && "Invalid index");
+    PrevTokLocation = TokBuf->getLocation(Idx - 1);
+    TokBufPos = Idx;
+    LexToken();
+  }
+
   /// isTokenParen - Return true if the cur token is '(' or ')'.
   bool isTokenParen() const {
     return Tok.getKind() == tok::l_paren || Tok.getKind() == tok::r_paren;
@@ -175,7 +281,7 @@ private:
     else if (ParenCount)
       --ParenCount;       // Don't let unbalanced )'s drive the count negative.
     PrevTokLocation = Tok.getLocation();
-    PP.Lex(Tok);
+    LexToken();
     return PrevTokLocation;
   }
 
@@ -189,7 +295,7 @@ private:
       --BracketCount;     // Don't let unbalanced ]'s drive the count negative.
 
     PrevTokLocation = Tok.getLocation();
-    PP.Lex(Tok);
+    LexToken();
     return PrevTokLocation;
   }
 
@@ -203,7 +309,7 @@ private:
       --BraceCount;     // Don't let unbalanced }'s drive the count negative.
 
     PrevTokLocation = Tok.getLocation();
-    PP.Lex(Tok);
+    LexToken();
     return PrevTokLocation;
   }
 
@@ -215,7 +321,7 @@ private:
     assert(isTokenStringLiteral() &&
            "Should only consume string literals with this method");
     PrevTokLocation = Tok.getLocation();
-    PP.Lex(Tok);
+    LexToken();
     return PrevTokLocation;
   }
 
@@ -226,7 +332,7 @@ private:
   SourceLocation ConsumeCodeCompletionToken() {
     assert(Tok.is(tok::code_completion));
     PrevTokLocation = Tok.getLocation();
-    PP.Lex(Tok);
+    LexToken();
     return PrevTokLocation;
   }
 
@@ -254,6 +360,11 @@ private:
   ///
   const Token &GetLookAheadToken(unsigned N) {
     if (N == 0 || Tok.is(tok::eof)) return Tok;
+    if (TokBuf) {
+      TokBuf->getToken(std::min(TokBufPos + N - 1, TokBuf->size() - 1),
+                       LookAheadTok);
+      return LookAheadTok;
+    }
     return PP.LookAhead(N-1);
   }
 
@@ -261,6 +372,8 @@ public:
   /// NextToken - This Peeks ahead one token and returns it without
   /// consuming it.
   const Token &NextToken() {
+    if (TokBuf)
+      return GetLookAheadToken(1);
     return PP.LookAhead(0);
   }
 
@@ -280,6 +393,7 @@ private:
   class TentativeParsingAction {
     Parser &P;
     Token PrevTok;
+    unsigned PrevTokBufPos;
     size_t PrevTentativelyDeclaredIdentifierCount;
     unsigned short PrevParenCount, PrevBracketCount, PrevBraceCount;
     bool isActive;
@@ -292,19 +406,25 @@ private:
       PrevParenCount = P.ParenCount;
       PrevBracketCount = P.BracketCount;
       PrevBraceCount = P.BraceCount;
-      P.PP.EnableBacktrackAtThisPos();
+      PrevTokBufPos = P.TokBufPos;
+      if (!P.TokBuf)
+        P.PP.EnableBacktrackAtThisPos();
       isActive = true;
     }
     void Commit() {
       assert(isActive && "Parsing action was finished!");
       P.TentativelyDeclaredIdentifiers.resize(
           PrevTentativelyDeclaredIdentifierCount);
-      P.PP.CommitBacktrackedTokens();
+      if (!P.TokBuf)
+        P.PP.CommitBacktrackedTokens();
       isActive = false;
     }
     void Revert() {
       assert(isActive && "Parsing action was finished!");
-      P.PP.Backtrack();
+      if (P.TokBuf)
+        P.TokBufPos = PrevTokBufPos;
+      else
+        P.PP.Backtrack();
       P.Tok = PrevTok;
       P.TentativelyDeclaredIdentifiers.resize(
           PrevTentativelyDeclaredIdentifierCount);
@@ -495,7 +615,12 @@ private:
   bool ParseBindInstantiation();
 
   // Section A.1.5 - Configuration source text
-  // TODO
+  bool ParseDesignStatement(Configuration &Config);
+  bool ParseConfigRuleStatement(Configuration &Config);
+  bool ParseConfigCell(ConfigCell &Cell);
+  bool ParseInstName(SmallVectorImpl<char> &Path);
+  void ParseLiblistClause(ConfigRule &Rule);
+  void ParseUseClause(ConfigRule &Rule);
 
   // Section A.1.6 - Interface items
   bool ParseInterfaceOrGenerateItem();
@@ -519,6 +644,9 @@ private:
 
   // Section A.1.11 - Package items
   bool ParsePackageItem();
+  void recordPackageItem(unsigned Idx, unsigned End);
+  void SkipBlock(tok::TokenKind Begin, tok::TokenKind End);
+  void DiagUnparsedPackageItem(unsigned Kind);
   bool ParsePackageOrGenerateItemDeclaration();
   bool ParseAnonymousProgram();
   bool ParseAnonymousProgramItem();
@@ -536,6 +664,7 @@ private:
   bool ParsePackageExportDeclaration();
   bool ParseGenvarDeclaration();
   bool ParseTypeDeclaration();
+  bool ParseUserTypeDataDeclaration();
 
   bool ParseDataDeclarationList();
   DeclLifetime ParseLifetime();
@@ -547,6 +676,7 @@ private:
   bool ParseCastingType();
   TypeResult ParseDataType(NetType nType);
   TypeResult ParseDataTypeOrImplicit(NetType nType);
+  bool ParseDataTypeForDeclaration();
   bool ParseEnumBaseType();
   bool ParseEnumNameDeclaration();
   bool ParseClassScope();
@@ -665,13 +795,22 @@ private:
   // Section A.4 - Instantiations
   // Section A.4.1.1 - Module instantiation
   bool ParseModuleInstantiation();
+  bool ParseNetlistInstantiation();
+  unsigned scanNetlistInstantiation(unsigned Idx) const;
+  unsigned scanNetlistConnection(unsigned Idx) const;
+  unsigned scanNetlistAssign(unsigned Idx) const;
+  void recordNetlistInstantiation(unsigned Idx, unsigned End);
+  void recordNetlistAssign(unsigned Idx, unsigned End);
+  unsigned recordNetlistConnection(unsigned Idx, unsigned &Net);
+  unsigned ParseNetlistConnection();
+  void recordNetlistPorts(PortKind Kind);
   bool ParseParameterValueAssignment();
   bool ParseListOfParameterAssignments();
   bool ParseOrderedParameterAssignment();
   bool ParseNamedParameterAssignment();
-  bool ParseHierarchicalInstance();
+  bool ParseHierarchicalInstance(unsigned Cell = NetlistTable::NoName);
   bool ParseNameOfInstance();
-  bool ParseListOfPortConnections();
+  bool ParseListOfPortConnections(bool Record = false);
 
   // Section A.4.1.2 - Interface instantiation
   // Section A.4.1.3 - Program instantiation
@@ -688,7 +827,7 @@ private:
   // Section A.6.1 - Continuous assignments
   bool ParseContinuousAssign();
   bool ParseNetAlias();
-  bool ParseListOfAssignments();
+  bool ParseListOfAssignments(unsigned Cell = NetlistTable::NoName);
 
   // Section A.6.2 - Procedural blocks and assignments
   bool ParseInitialConstruct();
@@ -788,6 +927,7 @@ private:
   ExprResult ParseTaggedUnionExpression();
   ExprResult ParseInsideExpression();
   ExprResult ParseValueRange();
+  ExprResult ParseDistList();
   ExprResult ParseMintypmaxExpression();
   ExprResult ParsePartSelectRange();
   ExprResult ParseIndexedRange();
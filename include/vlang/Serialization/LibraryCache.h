@@ -0,0 +1,152 @@
+//===--- LibraryCache.h - Parsed design units of libraries ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines parsed libraries and the cache that writes them, so that
+/// the files of a library that have not changed are not parsed again.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_SERIALIZATION_LIBRARYCACHE_H
+#define LLVM_VLANG_SERIALIZATION_LIBRARYCACHE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class DesignUnitTable;
+class SourceManager;
+
+namespace serialization {
+namespace ondisk {
+struct LibraryHeader;
+struct LibraryFileRecord;
+struct FileRecord;
+struct DefinitionRecord;
+struct InstanceRecord;
+}
+}
+
+/// \brief A file a source file of a library read, such as an `include.
+struct LibraryDependency {
+  std::string Path;
+  uint64_t Size;
+  uint64_t Hash;
+};
+
+/// \brief A source file of a library and the design units parsed from it.
+struct LibraryFile {
+  std::string Path;
+  uint64_t Size;
+  uint64_t Hash;
+  /// \brief The fingerprint of the macros and include directories it was
+  /// parsed with; the caller decides what goes into it.
+  uint64_t OptionsHash;
+  /// \brief The other files it read.
+  std::vector<LibraryDependency> Dependencies;
+  const DesignUnitTable *Units;
+
+  LibraryFile() : Size(0), Hash(0), OptionsHash(0), Units(0) {}
+};
+
+/// \brief The design units of a library as an earlier run parsed them,
+/// mapped from disk.
+///
+/// The file holds, for each source file of the library, the definitions
+/// parsed from it, with their instances, and what they were parsed from:
+/// its size and content hash, those of the files it included, and the
+/// fingerprint of the options it was parsed with.  A file for which none of
+/// them changed need not be parsed again: its definitions are read back
+/// instead.
+class ParsedLibrary {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  const serialization::ondisk::LibraryHeader *Header;
+  const serialization::ondisk::LibraryFileRecord *Files;
+  const serialization::ondisk::FileRecord *Dependencies;
+  const serialization::ondisk::DefinitionRecord *Definitions;
+  const serialization::ondisk::InstanceRecord *Instances;
+  const char *StringData;
+
+  ParsedLibrary();
+  ParsedLibrary(const ParsedLibrary &) LLVM_DELETED_FUNCTION;
+  void operator=(const ParsedLibrary &) LLVM_DELETED_FUNCTION;
+
+  bool init();
+  StringRef getString(uint32_t Offset, uint32_t Size) const {
+    return StringRef(StringData + Offset, Size);
+  }
+
+public:
+  ~ParsedLibrary();
+
+  /// \brief Map the parsed library at \p Path.  Returns null and sets
+  /// \p ErrorStr if the file cannot be read or is not valid.
+  static ParsedLibrary *loadFromFile(StringRef Path, std::string &ErrorStr);
+
+  /// \brief Write library \p Name with \p Files.  Returns true on error.
+  static bool writeToFile(StringRef Path, StringRef Name,
+                          ArrayRef<LibraryFile> Files, std::string &ErrorStr);
+
+  /// \brief The content hash files are compared by.
+  static uint64_t hashContents(StringRef Data);
+
+  /// \brief Add the files \p SM read, other than its main file, to
+  /// \p Dependencies.
+  static void getDependencies(const SourceManager &SM,
+                              std::vector<LibraryDependency> &Dependencies);
+
+  StringRef getName() const;
+  unsigned getNumFiles() const;
+
+  /// \brief Add the definitions parsed from \p File to \p Units, if it
+  /// had the size, content hash and options hash of \p File then, and the
+  /// files it read are unchanged on disk.  Returns false if not, or if it is
+  /// not a file of the library.  The dependencies of \p File are ignored.
+  bool getUnits(const LibraryFile &File, DesignUnitTable &Units) const;
+};
+
+/// \brief A directory of parsed libraries, one file per library.
+class LibraryCache {
+  std::string Directory;
+  /// \brief The libraries asked for; null for those missing or invalid.
+  llvm::StringMap<ParsedLibrary *> Libraries;
+
+  LibraryCache(const LibraryCache &) LLVM_DELETED_FUNCTION;
+  void operator=(const LibraryCache &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit LibraryCache(StringRef Directory) : Directory(Directory) {}
+  ~LibraryCache();
+
+  /// \brief The path of the parsed library \p Name.
+  std::string getLibraryPath(StringRef Name) const;
+
+  /// \brief The parsed library \p Name, loaded on first use, or null.
+  const ParsedLibrary *getLibrary(StringRef Name);
+
+  /// \brief Replace the parsed library \p Name with \p Files.  Returns true
+  /// on error.
+  bool writeLibrary(StringRef Name, ArrayRef<LibraryFile> Files,
+                    std::string &ErrorStr);
+};
+
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,164 @@
+//===--- PackageCache.h - Precompiled SystemVerilog packages ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines precompiled packages and the cache that writes them and
+/// serves them to the imports of later compilation units.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_SERIALIZATION_PACKAGECACHE_H
+#define LLVM_VLANG_SERIALIZATION_PACKAGECACHE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Parse/PackageTable.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class FileManager;
+class MacroBuilder;
+class Preprocessor;
+class TokenBuffer;
+
+namespace serialization {
+namespace ondisk {
+struct PackageHeader;
+struct FileRecord;
+struct SymbolRecord;
+struct MacroRecord;
+struct ExportRecord;
+}
+}
+
+/// \brief A package compiled by an earlier run, mapped from disk.
+///
+/// The file holds the package's symbols, sorted by name, each with the
+/// preprocessed text of its declaration; the macros defined when the
+/// package was compiled; and the path, size and content hash of every file
+/// its compilation read, the package file and its `include closure; and the
+/// names it exports from other packages.  A lookup is a binary search that
+/// materializes one symbol; nothing else is read.
+class PrecompiledPackage {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  const serialization::ondisk::PackageHeader *Header;
+  const serialization::ondisk::FileRecord *Files;
+  const serialization::ondisk::SymbolRecord *Symbols;
+  const serialization::ondisk::MacroRecord *Macros;
+  const serialization::ondisk::ExportRecord *Exports;
+  const char *StringData;
+
+  PrecompiledPackage();
+  PrecompiledPackage(const PrecompiledPackage &) LLVM_DELETED_FUNCTION;
+  void operator=(const PrecompiledPackage &) LLVM_DELETED_FUNCTION;
+
+  bool init();
+  StringRef getString(uint32_t Offset, uint32_t Size) const {
+    return StringRef(StringData + Offset, Size);
+  }
+
+public:
+  ~PrecompiledPackage();
+
+  /// \brief Map the precompiled package at \p Path.  Returns null and sets
+  /// \p ErrorStr if the file cannot be read or is not valid.
+  static PrecompiledPackage *loadFromFile(StringRef Path,
+                                          std::string &ErrorStr);
+
+  /// \brief Write package \p P of \p Table, which the parser recorded from
+  /// \p Toks, with the macros of \p PP.  Returns true on error.
+  static bool writeToFile(StringRef Path, const PackageTable &Table,
+                          unsigned P, const TokenBuffer &Toks,
+                          Preprocessor &PP, std::string &ErrorStr);
+
+  StringRef getName() const;
+
+  unsigned getNumFiles() const;
+  StringRef getFilePath(unsigned File) const;
+
+  /// \brief Whether every file the package was compiled from still has the
+  /// contents it had then.  Sets \p Changed to the first one that does not.
+  bool isUpToDate(FileManager &FileMgr, std::string &Changed) const;
+
+  unsigned getNumSymbols() const;
+
+  /// \brief Fill \p Symbol with the symbol named \p Name.  Returns false if
+  /// the package has none.
+  bool lookup(StringRef Name, PackageSymbol &Symbol) const;
+
+  unsigned getNumMacros() const;
+  StringRef getMacroName(unsigned M) const;
+  /// \brief The text after `define of macro \p M.
+  StringRef getMacroDefinition(unsigned M) const;
+
+  unsigned getNumExports() const;
+  /// \brief The package export \p E exports from.
+  StringRef getExportPackage(unsigned E) const;
+  /// \brief The name export \p E exports, or empty for all of them.
+  StringRef getExportName(unsigned E) const;
+};
+
+/// \brief A directory of precompiled packages, one file per package.
+///
+/// As an ExternalPackageSource, the cache loads a package the first time a
+/// unit imports it, and only if its files are unchanged; a stale or missing
+/// package is reported as unknown, so that the importer diagnoses it.
+class PackageCache : public ExternalPackageSource {
+  std::string Directory;
+  OwningPtr<FileManager> FileMgr;
+  /// \brief The packages asked for; null for those missing or stale.
+  llvm::StringMap<PrecompiledPackage *> Packages;
+  /// \brief The packages whose exports findSymbol() is searching.
+  llvm::SmallPtrSet<const PrecompiledPackage *, 4> Searching;
+  unsigned NumStale;
+
+  PackageCache(const PackageCache &) LLVM_DELETED_FUNCTION;
+  void operator=(const PackageCache &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit PackageCache(StringRef Directory);
+  ~PackageCache();
+
+  /// \brief The path of the precompiled package \p Name.
+  std::string getPackagePath(StringRef Name) const;
+
+  /// \brief The up-to-date precompiled package \p Name, loaded on first
+  /// use, or null.
+  const PrecompiledPackage *getPackage(StringRef Name);
+
+  /// \brief Precompile every package \p Table recorded from \p Toks.
+  /// Returns true on error.
+  bool writePackages(const PackageTable &Table, const TokenBuffer &Toks,
+                     Preprocessor &PP, std::string &ErrorStr);
+
+  /// \brief Append the macros of package \p Name to \p Builder, as if the
+  /// package file had been read.  Returns false if there is no such
+  /// up-to-date package.
+  bool addMacros(StringRef Name, MacroBuilder &Builder);
+
+  /// \brief The packages found but out of date.
+  unsigned getNumStale() const { return NumStale; }
+
+  virtual bool findPackage(StringRef Name);
+  virtual bool findSymbol(StringRef Package, StringRef Name,
+                          PackageSymbol &Symbol);
+};
+
+} // end namespace vlang
+
+#endif
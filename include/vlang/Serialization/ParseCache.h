@@ -0,0 +1,184 @@
+//===--- ParseCache.h - Cached parses of design elements --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines the on-disk cache of the results of parsing top-level
+/// design elements, and the ElementCache that serves one compilation unit
+/// from it.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_SERIALIZATION_PARSECACHE_H
+#define LLVM_VLANG_SERIALIZATION_PARSECACHE_H
+
+#include "vlang/Basic/LLVM.h"
+#include "vlang/Basic/SourceLocation.h"
+#include "vlang/Diag/Diagnostic.h"
+#include "vlang/Parse/ElementCache.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/Mutex.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MemoryBuffer;
+}
+
+namespace vlang {
+
+class DesignUnitTable;
+class Preprocessor;
+class TokenBuffer;
+
+/// \brief A directory of the results of parsing design elements, one file
+/// per element, named by the hash of its key.
+///
+/// Entries are written to a temporary file and renamed into place, and
+/// never changed after, so any number of threads and processes can share a
+/// directory.  A hit touches the entry, and prune() removes the entries
+/// used least recently until the directory is back under its size limit.
+class ParseCache {
+  std::string Directory;
+  uint64_t SizeLimit;
+
+  /// \brief Guards the statistics, which the sessions of parallel jobs
+  /// add to.
+  mutable llvm::sys::Mutex Lock;
+  unsigned NumReplayed;
+  unsigned NumParsed;
+  unsigned NumStored;
+
+  ParseCache(const ParseCache &) LLVM_DELETED_FUNCTION;
+  void operator=(const ParseCache &) LLVM_DELETED_FUNCTION;
+
+public:
+  ParseCache(StringRef Directory, uint64_t SizeLimit);
+
+  StringRef getDirectory() const { return Directory; }
+  uint64_t getSizeLimit() const { return SizeLimit; }
+
+  /// \brief The path of the entry for \p Key.
+  std::string getEntryPath(uint64_t Key) const;
+
+  /// \brief The entry for \p Key, marked as just used, or null if there is
+  /// none.
+  llvm::MemoryBuffer *lookup(uint64_t Key);
+
+  /// \brief Make \p Data the entry for \p Key.  Returns true on error.
+  bool store(uint64_t Key, StringRef Data, std::string &ErrorStr);
+
+  /// \brief Remove the entries used least recently until the directory is
+  /// within the size limit, and temporary files abandoned by writers that
+  /// died.  Returns the number of entries removed.
+  unsigned prune();
+
+  void addStatistics(unsigned Replayed, unsigned Parsed, unsigned Stored);
+  unsigned getNumReplayed() const;
+  unsigned getNumParsed() const;
+  unsigned getNumStored() const;
+};
+
+/// \brief Serves the design elements of one compilation unit from a
+/// ParseCache, and records those it parses.
+///
+/// Modules, macromodules, interfaces and programs are cached.  An element's
+/// key is made of the preprocessed tokens of the element and the one after
+/// it, the contents of the file it starts in, the fingerprint of the macros
+/// defined before it, the language options, the diagnostic options, and the
+/// `timescale and `default_nettype in effect.  Its entry holds the
+/// diagnostics parsing it reported, as formatted text at token-relative
+/// locations, and the definition and instances it added to the
+/// DesignUnitTable.
+///
+/// An element is only stored if the parser ended it where a scan for its
+/// end keyword did, it defined exactly one new design unit, and every
+/// diagnostic it reported is located within it; anything else is parsed
+/// every time.
+///
+/// While it lives, the session sits between the DiagnosticsEngine of the
+/// unit and its client, to see the diagnostics of the elements it records.
+class ParseCacheSession : public ElementCache {
+  class DiagRecorder;
+
+  struct ElementKey {
+    uint64_t TokenHash;
+    uint64_t FileHash;
+    uint64_t MacroFingerprint;
+    uint64_t OptionsHash;
+    uint64_t DirectiveHash;
+    unsigned NumTokens;
+
+    /// \brief The hash that names the entry.
+    uint64_t getHash() const;
+  };
+
+  struct RecordedDiagnostic {
+    DiagnosticsEngine::Level Level;
+    unsigned Token;
+    unsigned Offset;
+    std::string Message;
+  };
+
+  ParseCache &Cache;
+  Preprocessor &PP;
+  const TokenBuffer &Toks;
+  DesignUnitTable &Units;
+  DiagnosticsEngine &Diags;
+  DiagnosticConsumer *Client;
+  bool OwnsClient;
+  uint64_t OptionsHash;
+  llvm::DenseMap<FileID, uint64_t> FileHashes;
+
+  /// \name The element being parsed after a miss.
+  /// @{
+  bool Recording;
+  bool Uncacheable;
+  unsigned FirstToken;
+  unsigned EndToken;
+  unsigned NumDefinitions;
+  ElementKey Key;
+  std::vector<RecordedDiagnostic> Diagnostics;
+  /// @}
+
+  unsigned NumReplayed;
+  unsigned NumParsed;
+  unsigned NumStored;
+
+  ParseCacheSession(const ParseCacheSession &) LLVM_DELETED_FUNCTION;
+  void operator=(const ParseCacheSession &) LLVM_DELETED_FUNCTION;
+
+  unsigned findElementEnd(unsigned First) const;
+  uint64_t getFileHash(SourceLocation Loc);
+  void computeKey(unsigned First, unsigned End, ElementKey &Result);
+  bool replay(const llvm::MemoryBuffer &Entry, const ElementKey &Expected,
+              unsigned First);
+  void recordDiagnostic(DiagnosticsEngine::Level Level,
+                        const Diagnostic &Info);
+  void store();
+
+public:
+  /// \brief Serve the elements of the unit that \p Toks holds, preprocessed
+  /// by \p PP, adding the design units of those replayed to \p Units.
+  ParseCacheSession(ParseCache &Cache, Preprocessor &PP,
+                    const TokenBuffer &Toks, DesignUnitTable &Units);
+  ~ParseCacheSession();
+
+  virtual unsigned replayElement(unsigned FirstToken);
+  virtual void parsedElement(unsigned FirstToken, unsigned EndToken);
+
+  unsigned getNumReplayed() const { return NumReplayed; }
+  unsigned getNumParsed() const { return NumParsed; }
+  unsigned getNumStored() const { return NumStored; }
+};
+
+} // end namespace vlang
+
+#endif
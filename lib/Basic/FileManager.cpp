@@ -23,6 +23,7 @@
 #include "llvm/Config/llvm-config.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/system_error.h"
@@ -201,6 +202,7 @@ FileManager::~FileManager() {
 void FileManager::addStatCache(FileSystemStatCache *statCache,
                                bool AtBeginning) {
   assert(statCache && "No stat cache provided?");
+  llvm::MutexGuard Guard(Lock);
   if (AtBeginning || StatCache.get() == 0) {
     statCache->setNextStatCache(StatCache.take());
     StatCache.reset(statCache);
@@ -218,6 +220,7 @@ void FileManager::removeStatCache(FileSystemStatCache *statCache) {
   if (!statCache)
     return;
   
+  llvm::MutexGuard Guard(Lock);
   if (StatCache.get() == statCache) {
     // This is the first stat cache.
     StatCache.reset(StatCache->takeNextStatCache());
@@ -234,6 +237,7 @@ void FileManager::removeStatCache(FileSystemStatCache *statCache) {
 }
 
 void FileManager::clearStatCaches() {
+  llvm::MutexGuard Guard(Lock);
   StatCache.reset(0);
 }
 
@@ -293,6 +297,7 @@ const DirectoryEntry *FileManager::getDirectory(StringRef DirName,
       llvm::sys::path::is_separator(DirName.back()))
     DirName = DirName.substr(0, DirName.size()-1);
 
+  llvm::MutexGuard Guard(Lock);
   ++NumDirLookups;
   llvm::StringMapEntry<DirectoryEntry *> &NamedDirEnt =
     SeenDirEntries.GetOrCreateValue(DirName);
@@ -339,6 +344,7 @@ const DirectoryEntry *FileManager::getDirectory(StringRef DirName,
 
 const FileEntry *FileManager::getFile(StringRef Filename, bool openFile,
                                       bool CacheFailure) {
+  llvm::MutexGuard Guard(Lock);
   ++NumFileLookups;
 
   // See if there is already an entry in the map.
@@ -421,6 +427,7 @@ const FileEntry *FileManager::getFile(StringRef Filename, bool openFile,
 const FileEntry *
 FileManager::getVirtualFile(StringRef Filename, off_t Size,
                             time_t ModificationTime) {
+  llvm::MutexGuard Guard(Lock);
   ++NumFileLookups;
 
   // See if there is already an entry in the map.
@@ -510,14 +517,20 @@ getBufferForFile(const FileEntry *Entry, std::string *ErrorStr,
     FileSize = -1;
 
   const char *Filename = Entry->getName();
-  // If the file is already open, use the open file descriptor.
-  if (Entry->FD != -1) {
-    ec = llvm::MemoryBuffer::getOpenFile(Entry->FD, Filename, Result, FileSize);
+  // If the file is already open, use the open file descriptor.  Only one
+  // thread may take it.
+  int FD;
+  {
+    llvm::MutexGuard Guard(Lock);
+    FD = Entry->FD;
+    Entry->FD = -1;
+  }
+  if (FD != -1) {
+    ec = llvm::MemoryBuffer::getOpenFile(FD, Filename, Result, FileSize);
     if (ErrorStr)
       *ErrorStr = ec.message();
 
-    close(Entry->FD);
-    Entry->FD = -1;
+    close(FD);
     return Result.take();
   }
 
@@ -587,8 +600,18 @@ bool FileManager::getNoncachedStatValue(StringRef Path,
 
 void FileManager::invalidateCache(const FileEntry *Entry) {
   assert(Entry && "Cannot invalidate a NULL FileEntry");
+  llvm::MutexGuard Guard(Lock);
 
-  SeenFileEntries.erase(Entry->getName());
+  // The entry may have been found by other names than its own, through a
+  // symlink or another spelling of its path; none of them may outlive it.
+  SmallVector<StringRef, 2> Names;
+  for (llvm::StringMap<FileEntry*, llvm::BumpPtrAllocator>::iterator
+         FE = SeenFileEntries.begin(), FEEnd = SeenFileEntries.end();
+       FE != FEEnd; ++FE)
+    if (FE->getValue() == Entry)
+      Names.push_back(FE->getKey());
+  for (unsigned i = 0, e = Names.size(); i != e; ++i)
+    SeenFileEntries.erase(Names[i]);
 
   // FileEntry invalidation should not block future optimizations in the file
   // caches. Possible alternatives are cache truncation (invalidate last N) or
@@ -599,6 +622,7 @@ void FileManager::invalidateCache(const FileEntry *Entry) {
 
 void FileManager::GetUniqueIDMapping(
                    SmallVectorImpl<const FileEntry *> &UIDToFiles) const {
+  llvm::MutexGuard Guard(Lock);
   UIDToFiles.clear();
   UIDToFiles.resize(NextFileUID);
   
@@ -626,6 +650,7 @@ void FileManager::modifyFileEntry(FileEntry *File,
 StringRef FileManager::getCanonicalName(const DirectoryEntry *Dir) {
   // FIXME: use llvm::sys::fs::canonical() when it gets implemented
 #ifdef LLVM_ON_UNIX
+  llvm::MutexGuard Guard(Lock);
   llvm::DenseMap<const DirectoryEntry *, llvm::StringRef>::iterator Known
     = CanonicalDirNames.find(Dir);
   if (Known != CanonicalDirNames.end())
@@ -648,6 +673,7 @@ StringRef FileManager::getCanonicalName(const DirectoryEntry *Dir) {
 }
 
 void FileManager::PrintStats() const {
+  llvm::MutexGuard Guard(Lock);
   llvm::errs() << "\n*** File Manager Stats:\n";
   llvm::errs() << UniqueRealFiles.size() << " real files found, "
                << UniqueRealDirs.size() << " real dirs found.\n";
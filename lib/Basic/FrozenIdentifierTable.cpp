@@ -0,0 +1,260 @@
+//===--- FrozenIdentifierTable.cpp - Shared read-only identifiers ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the FrozenIdentifierTable class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Basic/FrozenIdentifierTable.h"
+#include "vlang/Basic/IdentifierTable.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <cstring>
+
+using namespace vlang;
+
+namespace {
+/// \brief The header at the start of every table image.
+struct FrozenHeader {
+  uint32_t Magic;
+  uint32_t NumBuckets;
+  uint32_t NumIdentifiers;
+  uint32_t StringsSize;
+  uint32_t Padding[12];
+};
+}
+
+/// \brief Identifies a table image; also rejects images written on a host of
+/// different endianness.
+static const uint32_t FrozenMagic = 0x56494431; // 'VID1'
+
+/// \brief Bucket arrays start at a multiple of this, relative to the image.
+static const unsigned CacheLineSize = 64;
+
+/// \brief Names longer than this do not fit the 16-bit length prefix and are
+/// left to the per-unit tables.
+static const unsigned MaxNameLength = 0xFFFE;
+
+static size_t getBucketsOffset() { return sizeof(FrozenHeader); }
+static size_t getOffsetsOffset(unsigned NumBuckets) {
+  return getBucketsOffset() + NumBuckets * 2 * sizeof(uint32_t);
+}
+static size_t getStringsOffset(unsigned NumBuckets, unsigned NumIdentifiers) {
+  return getOffsetsOffset(NumBuckets) + NumIdentifiers * sizeof(uint32_t);
+}
+
+FrozenIdentifierTable::FrozenIdentifierTable()
+  : Data(0), NumBuckets(0), NumIdentifiers(0), Buckets(0), Offsets(0),
+    Strings(0) {}
+
+FrozenIdentifierTable::~FrozenIdentifierTable() {}
+
+unsigned FrozenIdentifierTable::hash(StringRef Name) {
+  // Bernstein hash; part of the on-disk format, so it must not change.
+  unsigned Result = 0;
+  for (StringRef::size_type i = 0, e = Name.size(); i != e; ++i)
+    Result = Result * 33 + (unsigned char)Name[i];
+  return Result;
+}
+
+bool FrozenIdentifierTable::init(const char *Image, size_t Size) {
+  if (Size < sizeof(FrozenHeader))
+    return true;
+  const FrozenHeader *H = reinterpret_cast<const FrozenHeader *>(Image);
+  if (H->Magic != FrozenMagic || H->NumBuckets == 0 ||
+      (H->NumBuckets & (H->NumBuckets - 1)) != 0 ||
+      H->NumIdentifiers >= H->NumBuckets ||
+      Size != getStringsOffset(H->NumBuckets, H->NumIdentifiers) +
+              H->StringsSize)
+    return true;
+
+  const uint32_t *B =
+    reinterpret_cast<const uint32_t *>(Image + getBucketsOffset());
+  const uint32_t *O = reinterpret_cast<const uint32_t *>(
+    Image + getOffsetsOffset(H->NumBuckets));
+  const char *S = Image + getStringsOffset(H->NumBuckets, H->NumIdentifiers);
+
+  // Every name must lie within the string data, behind its length prefix
+  // and in front of its terminator.
+  for (unsigned ID = 0; ID != H->NumIdentifiers; ++ID) {
+    uint32_t Offset = O[ID];
+    if (Offset < 2 || Offset > H->StringsSize)
+      return true;
+    const unsigned char *P = (const unsigned char *)S + Offset;
+    unsigned LenPlusOne = P[-2] | (P[-1] << 8);
+    if (LenPlusOne == 0 || LenPlusOne > H->StringsSize - Offset ||
+        P[LenPlusOne - 1] != '\0')
+      return true;
+  }
+
+  // Every bucket must name a valid ID, and at least one must be empty so
+  // that probing terminates.
+  unsigned NumUsed = 0;
+  for (unsigned Bucket = 0; Bucket != H->NumBuckets; ++Bucket) {
+    if (B[2 * Bucket + 1] > H->NumIdentifiers)
+      return true;
+    if (B[2 * Bucket + 1] != 0)
+      ++NumUsed;
+  }
+  if (NumUsed >= H->NumBuckets)
+    return true;
+
+  Data = Image;
+  NumBuckets = H->NumBuckets;
+  NumIdentifiers = H->NumIdentifiers;
+  Buckets = B;
+  Offsets = O;
+  Strings = S;
+  return false;
+}
+
+bool FrozenIdentifierTable::lookup(StringRef Name, unsigned Hash,
+                                   unsigned &ID) const {
+  // Linear probing over (hash, ID + 1) pairs; an ID of zero marks an empty
+  // bucket.  The full hash is compared before touching the string data.
+  unsigned Mask = NumBuckets - 1;
+  for (unsigned Bucket = Hash & Mask; ; Bucket = (Bucket + 1) & Mask) {
+    const uint32_t *B = Buckets + 2 * Bucket;
+    if (B[1] == 0)
+      return false;
+    if (B[0] != Hash)
+      continue;
+    StringRef Candidate = getName(B[1] - 1);
+    if (Candidate == Name) {
+      ID = B[1] - 1;
+      return true;
+    }
+  }
+}
+
+FrozenIdentifierTable *
+FrozenIdentifierTable::create(const IdentifierTable &Table) {
+  // Collect the distinct names.
+  llvm::StringSet<> Seen;
+  std::vector<StringRef> Names;
+  for (IdentifierTable::iterator I = Table.begin(), E = Table.end();
+       I != E; ++I) {
+    StringRef Name(I->getKeyData(), I->getKeyLength());
+    if (Name.size() <= MaxNameLength && Seen.insert(Name))
+      Names.push_back(Name);
+  }
+  if (const FrozenIdentifierTable *Base = Table.getFrozenBase())
+    for (unsigned ID = 0, e = Base->size(); ID != e; ++ID)
+      if (Seen.insert(Base->getName(ID)))
+        Names.push_back(Base->getName(ID));
+
+  // Keep the load factor at or below one half.
+  unsigned NumBuckets = 64;
+  while (NumBuckets < 2 * Names.size() + 1)
+    NumBuckets *= 2;
+
+  size_t StringsSize = 0;
+  for (unsigned i = 0, e = Names.size(); i != e; ++i)
+    StringsSize += Names[i].size() + 3;
+
+  size_t Size = getStringsOffset(NumBuckets, Names.size()) + StringsSize;
+  FrozenIdentifierTable *Result = new FrozenIdentifierTable();
+  Result->Storage.resize(Size + CacheLineSize);
+  char *Image = &Result->Storage[0];
+  Image += (CacheLineSize - ((uintptr_t)Image & (CacheLineSize - 1))) &
+           (CacheLineSize - 1);
+  memset(Image, 0, getStringsOffset(NumBuckets, Names.size()));
+
+  FrozenHeader *H = reinterpret_cast<FrozenHeader *>(Image);
+  H->Magic = FrozenMagic;
+  H->NumBuckets = NumBuckets;
+  H->NumIdentifiers = Names.size();
+  H->StringsSize = StringsSize;
+
+  uint32_t *Buckets = reinterpret_cast<uint32_t *>(Image + getBucketsOffset());
+  uint32_t *Offsets =
+    reinterpret_cast<uint32_t *>(Image + getOffsetsOffset(NumBuckets));
+  char *Strings = Image + getStringsOffset(NumBuckets, Names.size());
+  size_t StrOffset = 0;
+  for (unsigned ID = 0, e = Names.size(); ID != e; ++ID) {
+    StringRef Name = Names[ID];
+    unsigned LenPlusOne = Name.size() + 1;
+    Strings[StrOffset++] = (char)(LenPlusOne & 0xFF);
+    Strings[StrOffset++] = (char)(LenPlusOne >> 8);
+    Offsets[ID] = StrOffset;
+    memcpy(Strings + StrOffset, Name.data(), Name.size());
+    StrOffset += Name.size();
+    Strings[StrOffset++] = '\0';
+
+    unsigned Hash = hash(Name);
+    unsigned Bucket = Hash & (NumBuckets - 1);
+    while (Buckets[2 * Bucket + 1] != 0)
+      Bucket = (Bucket + 1) & (NumBuckets - 1);
+    Buckets[2 * Bucket] = Hash;
+    Buckets[2 * Bucket + 1] = ID + 1;
+  }
+
+  bool Invalid = Result->init(Image, Size);
+  assert(!Invalid && "Built an invalid identifier table");
+  (void)Invalid;
+  return Result;
+}
+
+FrozenIdentifierTable *
+FrozenIdentifierTable::loadFromFile(StringRef Path, std::string &ErrorStr) {
+  OwningPtr<llvm::MemoryBuffer> File;
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(
+        Path, File, -1, /*RequiresNullTerminator=*/false)) {
+    ErrorStr = EC.message();
+    return 0;
+  }
+
+  OwningPtr<FrozenIdentifierTable> Result(new FrozenIdentifierTable());
+  if (Result->init(File->getBufferStart(), File->getBufferSize())) {
+    ErrorStr = "not a valid identifier table";
+    return 0;
+  }
+  Result->Buffer.reset(File.take());
+  return Result.take();
+}
+
+bool FrozenIdentifierTable::writeToFile(StringRef Path,
+                                        std::string &ErrorStr) const {
+  // Write to a file of our own and rename it into place: other processes,
+  // and this one if it loaded its base from \p Path, may have the previous
+  // table mapped, and truncating it under them would fault their reads.
+  SmallString<256> TempPath;
+  int FD;
+  if (llvm::error_code EC = llvm::sys::fs::unique_file(
+        Path + ".%%%%%%%%.tmp", FD, TempPath)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    const FrozenHeader *H = reinterpret_cast<const FrozenHeader *>(Data);
+    OS.write(Data, getStringsOffset(NumBuckets, NumIdentifiers) +
+                   H->StringsSize);
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      bool Existed;
+      llvm::sys::fs::remove(TempPath.str(), Existed);
+      ErrorStr = "error writing '" + TempPath.str().str() + "'";
+      return true;
+    }
+  }
+
+  if (llvm::error_code EC = llvm::sys::fs::rename(TempPath.str(), Path)) {
+    bool Existed;
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+    ErrorStr = EC.message();
+    return true;
+  }
+  return false;
+}
@@ -66,7 +66,7 @@ ExternalIdentifierLookup::~ExternalIdentifierLookup() {}
 IdentifierTable::IdentifierTable(const LangOptions &LangOpts,
 								 IdentifierInfoLookup* externalLookup)
 								 : HashTable(8192), // Start with space for 8K identifiers.
-								 ExternalLookup(externalLookup) {
+								 ExternalLookup(externalLookup), FrozenBase(0) {
 
   // Populate the identifier table with info about keywords for the current
   // language.
@@ -74,6 +74,31 @@ IdentifierTable::IdentifierTable(const LangOptions &LangOpts,
 
 }
 
+/// getFrozenInfo - Create the IdentifierInfo for the identifier \p ID of the
+/// frozen base.
+IdentifierInfo *IdentifierTable::getFrozenInfo(unsigned ID,
+											   bool UseExternalLookup) {
+	StringRef Name = FrozenBase->getName(ID);
+
+	// Reuse the IdentifierInfo this table made before it had a base, e.g. for
+	// a keyword.
+	HashTableTy::iterator I = HashTable.find(Name);
+	if (I != HashTable.end() && I->getValue())
+		return I->getValue();
+
+	if (UseExternalLookup && ExternalLookup)
+		if (IdentifierInfo *II = ExternalLookup->get(Name))
+			return II;
+
+	// Spell the name from the frozen base instead of copying it.  This is the
+	// layout IdentifierInfo::getNameStart() expects when Entry is null.
+	typedef std::pair<IdentifierInfo, const char*> ExternalNameTy;
+	void *Mem = getAllocator().Allocate<ExternalNameTy>();
+	ExternalNameTy *Info = new (Mem) ExternalNameTy();
+	Info->second = FrozenBase->getNameStart(ID);
+	return &Info->first;
+}
+
 //===----------------------------------------------------------------------===//
 // Language Keyword Implementation
 //===----------------------------------------------------------------------===//
@@ -163,6 +188,9 @@ void IdentifierTable::PrintStats() const {
 	fprintf(stderr, "Ave identifier length: %f\n",
 		(AverageIdentifierSize/(double)NumIdentifiers));
 	fprintf(stderr, "Max identifier length: %d\n", MaxIdentifierLength);
+	if (FrozenBase)
+		fprintf(stderr, "# Frozen base identifiers used: %d of %d\n",
+			FrozenOverlay.size(), FrozenBase->size());
 
 	// Compute statistics about the memory allocated for identifiers.
 	HashTable.getAllocator().PrintStats();
@@ -0,0 +1,148 @@
+//===--- LineTableCache.cpp - On-disk cache of line offsets ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the LineTableCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Basic/LineTableCache.h"
+#include "vlang/Basic/FileManager.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+using namespace vlang;
+
+namespace {
+/// \brief The header at the start of every sidecar file.
+///
+/// All fields are 32 bits wide so that the offsets following the header are
+/// suitably aligned in the mapped file.
+struct SidecarHeader {
+  uint32_t Magic;
+  uint32_t NumLines;
+  uint32_t FileSize;
+  uint32_t ModTime;
+  uint32_t Inode;
+  uint32_t Device;
+};
+}
+
+/// \brief Identifies a sidecar file; also rejects sidecars written on a host
+/// of different endianness.
+static const uint32_t SidecarMagic = 0x564c4e31; // 'VLN1'
+
+static void initHeader(SidecarHeader &H, const FileEntry *Entry,
+                       unsigned NumLines) {
+  H.Magic = SidecarMagic;
+  H.NumLines = NumLines;
+  H.FileSize = (uint32_t)Entry->getSize();
+  H.ModTime = (uint32_t)Entry->getModificationTime();
+  H.Inode = (uint32_t)Entry->getInode();
+  H.Device = (uint32_t)Entry->getDevice();
+}
+
+LineTableCache::LineTableCache(StringRef Dir)
+  : Dir(Dir), NumHits(0), NumMisses(0), NumStores(0) {}
+
+LineTableCache::~LineTableCache() {
+  for (unsigned i = 0, e = Tables.size(); i != e; ++i)
+    delete Tables[i];
+}
+
+std::string LineTableCache::getSidecarPath(const FileEntry *Entry) const {
+  SmallString<128> Path(Dir);
+  std::string Name = llvm::utohexstr(
+    (uint64_t)llvm::hash_value(StringRef(Entry->getName())));
+  Name += ".vlines";
+  llvm::sys::path::append(Path, Name);
+  return Path.str();
+}
+
+bool LineTableCache::lookup(const FileEntry *Entry, const unsigned *&Offsets,
+                            unsigned &NumLines) {
+  llvm::OwningPtr<llvm::MemoryBuffer> Table;
+  if (llvm::MemoryBuffer::getFile(getSidecarPath(Entry), Table, -1,
+                                  /*RequiresNullTerminator=*/false)) {
+    ++NumMisses;
+    return false;
+  }
+
+  // Validate the header against the file and the size of the table, which
+  // also catches sidecars that were truncated while being written.
+  size_t Size = Table->getBufferSize();
+  if (Size < sizeof(SidecarHeader)) {
+    ++NumMisses;
+    return false;
+  }
+  const SidecarHeader *H =
+    reinterpret_cast<const SidecarHeader *>(Table->getBufferStart());
+  SidecarHeader Expected;
+  initHeader(Expected, Entry, H->NumLines);
+  if (H->Magic != Expected.Magic || H->FileSize != Expected.FileSize ||
+      H->ModTime != Expected.ModTime || H->Inode != Expected.Inode ||
+      H->Device != Expected.Device || H->NumLines == 0 ||
+      Size != sizeof(SidecarHeader) + H->NumLines * sizeof(unsigned)) {
+    ++NumMisses;
+    return false;
+  }
+
+  ++NumHits;
+  NumLines = H->NumLines;
+  Offsets = reinterpret_cast<const unsigned *>(H + 1);
+  Tables.push_back(Table.take());
+  return true;
+}
+
+void LineTableCache::store(const FileEntry *Entry, const unsigned *Offsets,
+                           unsigned NumLines) {
+  // Write to a file of our own and rename it into place: other processes
+  // may have the previous sidecar mapped, and truncating it under them
+  // would fault their reads.
+  SmallString<128> Model(Dir);
+  llvm::sys::path::append(Model, "%%%%%%%%%%%%.vlines.tmp");
+  SmallString<128> TempPath;
+  int FD;
+  if (llvm::sys::fs::unique_file(Model.str(), FD, TempPath))
+    return;
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    SidecarHeader H;
+    initHeader(H, Entry, NumLines);
+    OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+    OS.write(reinterpret_cast<const char *>(Offsets),
+             NumLines * sizeof(unsigned));
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      bool Existed;
+      llvm::sys::fs::remove(TempPath.str(), Existed);
+      return;
+    }
+  }
+
+  if (llvm::sys::fs::rename(TempPath.str(), getSidecarPath(Entry))) {
+    bool Existed;
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+    return;
+  }
+  ++NumStores;
+}
+
+void LineTableCache::PrintStats() const {
+  llvm::errs() << "*** Line Table Cache Stats:\n";
+  llvm::errs() << NumHits << " sidecar hits, " << NumMisses << " misses, "
+               << NumStores << " sidecars written.\n";
+}
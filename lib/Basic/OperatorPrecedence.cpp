@@ -13,120 +13,96 @@
 //===----------------------------------------------------------------------===//
 #include "vlang/Basic/OperatorPrecedence.h"
 
-namespace vlang {
-
-prec::Level getBinOpPrecedence(tok::TokenKind Kind) {
-  bool allowAssign = true;
-  bool unaryOp = false;
-  switch (Kind) {
-  default: return prec::Unknown;
-
-  case tok::lessequal:
-	  return (allowAssign) ? prec::Assignment : prec::Relational;
-	  break;
-
-  case tok::plus:
-  case tok::minus:
-	  return (unaryOp) ? prec::Unary : prec::Additive;
-	  break;
-
-  case tok::amp:
-	  return (unaryOp) ? prec::Unary : prec::BitAnd;
-	  break;
-
-  case tok::caret:
-  case tok::tildecaret:
-  case tok::carettilde:
-	  return (unaryOp) ? prec::Unary : prec::BitXor;
-	  break;
-
-  case tok::pipe:
-	  return (unaryOp) ? prec::Unary : prec::BitOr;
-	  break;
-
-  case tok::exclaim:
-  case tok::tilde:
-  case tok::tildeamp:
-  case tok::tildepipe:
-  case tok::plusplus:
-  case tok::minusminus:
-	  return prec::Unary;
-	  break;
-
-  case tok::starstar:
-	  return prec::Power;
-	  break;
-
-  case tok::star:
-  case tok::slash:
-  case tok::percent:
-	  return prec::Multiplicative;
-	  break;
-
-  case tok::lessless:
-  case tok::greatergreater:
-  case tok::lesslessless:
-  case tok::greatergreatergreater:
-	  return prec::Shift;
-	  break;
-
-  case tok::less:
-  case tok::greater:
-  case tok::greaterequal:
-  case tok::kw_inside:
-  case tok::kw_dist:
-	  return prec::Relational;
-	  break;
-
-  case tok::equalequal:
-  case tok::exclaimequal:
-  case tok::equalequalequal:
-  case tok::exclaimequalequal:
-  case tok::equalequalquestion:
-  case tok::exclaimequalquestion:
-	  return prec::Equality;
-	  break;
-
-  case tok::ampamp:
-	  return prec::LogicalAnd;
-	  break;
-
-  case tok::pipepipe:
-	  return prec::LogicalOr;
-	  break;
-
-  case tok::question:
-  case tok::colon:
-	  return prec::Conditional;
-	  break;
-
-  case tok::arrow:
-  case tok::lessminusgreater:
-	  return prec::Implication;
-	  break;
-
-  case tok::equal:
-  case tok::plusequal:
-  case tok::minusequal:
-  case tok::starequal:
-  case tok::slashequal:
-  case tok::percentequal:
-  case tok::caretequal:
-  case tok::pipeequal:
-  case tok::lesslessequal:
-  case tok::greatergreaterequal:
-  case tok::lesslesslessequal:
-  case tok::greatergreatergreaterequal:
-  case tok::colonequal:
-  case tok::colonslash:
-	  return prec::Assignment;
-	  break;
-
-  case tok::l_brace:
-  case tok::r_brace:
-	  return prec::Assignment;
-	  break;
-  }
-}
-
-}  // namespace vlang
+using namespace vlang;
+
+namespace {
+
+/// The precedence of token kind K as a binary operator.  Specialized below
+/// for the operator tokens, so that the table is built at compile time.
+template <tok::TokenKind K> struct BinOpPrecedence {
+  static const unsigned char Value = prec::Unknown;
+};
+
+#define BINOP(Kind, Level)                                                     \
+  template <> struct BinOpPrecedence<tok::Kind> {                              \
+    static const unsigned char Value = prec::Level;                            \
+  };
+
+// '<=' is parsed as a nonblocking assignment; relational uses of it are
+// sorted out by the caller.
+BINOP(lessequal,                  Assignment)
+
+BINOP(plus,                       Additive)
+BINOP(minus,                      Additive)
+BINOP(amp,                        BitAnd)
+BINOP(caret,                      BitXor)
+BINOP(tildecaret,                 BitXor)
+BINOP(carettilde,                 BitXor)
+BINOP(pipe,                       BitOr)
+
+BINOP(exclaim,                    Unary)
+BINOP(tilde,                      Unary)
+BINOP(tildeamp,                   Unary)
+BINOP(tildepipe,                  Unary)
+BINOP(plusplus,                   Unary)
+BINOP(minusminus,                 Unary)
+
+BINOP(starstar,                   Power)
+
+BINOP(star,                       Multiplicative)
+BINOP(slash,                      Multiplicative)
+BINOP(percent,                    Multiplicative)
+
+BINOP(lessless,                   Shift)
+BINOP(greatergreater,             Shift)
+BINOP(lesslessless,               Shift)
+BINOP(greatergreatergreater,      Shift)
+
+BINOP(less,                       Relational)
+BINOP(greater,                    Relational)
+BINOP(greaterequal,               Relational)
+BINOP(kw_inside,                  Relational)
+BINOP(kw_dist,                    Relational)
+
+BINOP(equalequal,                 Equality)
+BINOP(exclaimequal,               Equality)
+BINOP(equalequalequal,            Equality)
+BINOP(exclaimequalequal,          Equality)
+BINOP(equalequalquestion,         Equality)
+BINOP(exclaimequalquestion,       Equality)
+
+BINOP(ampamp,                     LogicalAnd)
+BINOP(pipepipe,                   LogicalOr)
+
+BINOP(question,                   Conditional)
+BINOP(colon,                      Conditional)
+
+BINOP(arrow,                      Implication)
+BINOP(lessminusgreater,           Implication)
+
+BINOP(equal,                      Assignment)
+BINOP(plusequal,                  Assignment)
+BINOP(minusequal,                 Assignment)
+BINOP(starequal,                  Assignment)
+BINOP(slashequal,                 Assignment)
+BINOP(percentequal,               Assignment)
+BINOP(caretequal,                 Assignment)
+BINOP(pipeequal,                  Assignment)
+BINOP(lesslessequal,              Assignment)
+BINOP(greatergreaterequal,        Assignment)
+BINOP(lesslesslessequal,          Assignment)
+BINOP(greatergreatergreaterequal, Assignment)
+BINOP(colonequal,                 Assignment)
+BINOP(colonslash,                 Assignment)
+
+BINOP(l_brace,                    Assignment)
+BINOP(r_brace,                    Assignment)
+
+#undef BINOP
+
+} // end anonymous namespace
+
+const unsigned char vlang::BinOpPrecedenceTable[tok::NUM_TOKENS] = {
+#define TOK(X) BinOpPrecedence<tok::X>::Value,
+#include "vlang/Basic/TokenKinds.def"
+};
@@ -0,0 +1,214 @@
+//===--- PerfCounters.cpp - Front end performance counters ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the front end's phase timers and event counters.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Basic/PerfCounters.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+using namespace vlang;
+using namespace vlang::perf;
+
+static const char *const PhaseNames[] = {
+#define PERF_PHASE(Name, Desc) Desc,
+#include "vlang/Basic/PerfCounters.def"
+};
+
+static const char *const CounterNames[] = {
+#define PERF_COUNTER(Name, Desc) Desc,
+#include "vlang/Basic/PerfCounters.def"
+};
+
+bool perf::EnabledFlag = false;
+
+static uint64_t getSteadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// \brief Read the cheapest monotonic clock available.  The unit is
+/// arbitrary; see getTicksPerMicrosecond().
+static inline uint64_t readTicks() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  return __builtin_ia32_rdtsc();
+#else
+  return getSteadyNanos();
+#endif
+}
+
+namespace {
+/// \brief One recorded instance of a phase.
+struct TraceEvent {
+  uint64_t Start;
+  uint64_t Ticks;
+  Phase P;
+
+  TraceEvent(uint64_t Start, uint64_t Ticks, Phase P)
+    : Start(Start), Ticks(Ticks), P(P) {}
+};
+}
+
+namespace vlang {
+namespace perf {
+class ThreadState {
+public:
+  unsigned ThreadID;
+  uint64_t Calls[NumPhases];
+  uint64_t SelfTicks[NumPhases];
+  uint64_t InclusiveTicks[NumPhases];
+  unsigned Depth[NumPhases];
+  uint64_t Counts[NumCounters];
+
+  /// \brief Ticks spent in phases nested in the innermost active one.
+  uint64_t ChildTicks;
+
+  std::vector<TraceEvent> Events;
+
+  explicit ThreadState(unsigned ThreadID) : ThreadID(ThreadID), ChildTicks(0) {
+    memset(Calls, 0, sizeof(Calls));
+    memset(SelfTicks, 0, sizeof(SelfTicks));
+    memset(InclusiveTicks, 0, sizeof(InclusiveTicks));
+    memset(Depth, 0, sizeof(Depth));
+    memset(Counts, 0, sizeof(Counts));
+  }
+};
+} // end namespace perf
+} // end namespace vlang
+
+// The states of all threads that recorded anything; never freed, so that
+// they can be reported after their threads exit.
+static llvm::sys::Mutex RegistryLock;
+static std::vector<ThreadState *> Registry;
+
+static bool RecordEvents = false;
+static uint64_t GranularityTicks = 0;
+static uint64_t BaseTicks = 0;
+static uint64_t BaseNanos = 0;
+
+static thread_local ThreadState *CurrentThread = 0;
+
+static ThreadState &getThreadState() {
+  if (!CurrentThread) {
+    llvm::MutexGuard Guard(RegistryLock);
+    CurrentThread = new ThreadState(Registry.size());
+    Registry.push_back(CurrentThread);
+  }
+  return *CurrentThread;
+}
+
+/// \brief Convert between ticks and wall time, using the interval since
+/// enable() as the reference.
+static double getTicksPerMicrosecond() {
+  uint64_t Nanos = getSteadyNanos() - BaseNanos;
+  uint64_t Ticks = readTicks() - BaseTicks;
+  if (Nanos == 0 || Ticks == 0)
+    return 1000.0;
+  return Ticks * 1000.0 / Nanos;
+}
+
+void perf::enable(bool Record, unsigned GranularityUS) {
+  BaseTicks = readTicks();
+  BaseNanos = getSteadyNanos();
+  RecordEvents = Record;
+  if (Record) {
+    // Calibrate the granularity with a short spin; the reports use the
+    // whole run as reference instead.
+    while (getSteadyNanos() - BaseNanos < 2000000) {}
+    GranularityTicks = (uint64_t)(getTicksPerMicrosecond() * GranularityUS);
+  }
+  EnabledFlag = true;
+}
+
+void perf::addCount(Counter C, uint64_t N) {
+  getThreadState().Counts[C] += N;
+}
+
+void PhaseScope::begin() {
+  TS = &getThreadState();
+  TS->Calls[P] += Weight;
+  ++TS->Depth[P];
+  SavedChildTicks = TS->ChildTicks;
+  TS->ChildTicks = 0;
+  Start = readTicks();
+}
+
+void PhaseScope::end() {
+  uint64_t Ticks = readTicks() - Start;
+  TS->SelfTicks[P] += (Ticks - std::min(Ticks, TS->ChildTicks)) * Weight;
+  if (--TS->Depth[P] == 0)
+    TS->InclusiveTicks[P] += Ticks * Weight;
+  // A sample stands for the instances that were not timed, whose time is
+  // also part of the enclosing phase.
+  TS->ChildTicks = SavedChildTicks + Ticks * Weight;
+  if (RecordEvents && Ticks >= GranularityTicks)
+    TS->Events.push_back(TraceEvent(Start, Ticks, P));
+}
+
+void perf::printSummary(raw_ostream &OS) {
+  llvm::MutexGuard Guard(RegistryLock);
+  uint64_t Calls[NumPhases] = { 0 }, Self[NumPhases] = { 0 };
+  uint64_t Inclusive[NumPhases] = { 0 }, Counts[NumCounters] = { 0 };
+  for (unsigned t = 0, e = Registry.size(); t != e; ++t) {
+    for (unsigned i = 0; i != NumPhases; ++i) {
+      Calls[i] += Registry[t]->Calls[i];
+      Self[i] += Registry[t]->SelfTicks[i];
+      Inclusive[i] += Registry[t]->InclusiveTicks[i];
+    }
+    for (unsigned i = 0; i != NumCounters; ++i)
+      Counts[i] += Registry[t]->Counts[i];
+  }
+
+  double TicksPerMS = getTicksPerMicrosecond() * 1000.0;
+  OS << "*** Performance Counters (" << Registry.size() << " threads):\n";
+  OS << "Phase                       Calls    Self (ms)   Total (ms)\n";
+  for (unsigned i = 0; i != NumPhases; ++i)
+    OS << llvm::format("%-20s %12llu %12.3f %12.3f\n", PhaseNames[i],
+                       (unsigned long long)Calls[i], Self[i] / TicksPerMS,
+                       Inclusive[i] / TicksPerMS);
+  for (unsigned i = 0; i != NumCounters; ++i)
+    OS << Counts[i] << " " << CounterNames[i] << "\n";
+}
+
+void perf::writeChromeTrace(raw_ostream &OS) {
+  llvm::MutexGuard Guard(RegistryLock);
+  double TicksPerUS = getTicksPerMicrosecond();
+  OS << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  bool First = true;
+  for (unsigned t = 0, e = Registry.size(); t != e; ++t) {
+    const ThreadState &TS = *Registry[t];
+    for (unsigned i = 0, ie = TS.Events.size(); i != ie; ++i) {
+      const TraceEvent &Ev = TS.Events[i];
+      OS << (First ? "\n" : ",\n") << "{\"name\": \"" << PhaseNames[Ev.P]
+         << "\", \"cat\": \"vlang\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+         << TS.ThreadID << ", \"ts\": "
+         << llvm::format("%.3f", (Ev.Start - BaseTicks) / TicksPerUS)
+         << ", \"dur\": " << llvm::format("%.3f", Ev.Ticks / TicksPerUS)
+         << "}";
+      First = false;
+    }
+    // Report the counters as args of a zero-length event per thread.
+    OS << (First ? "\n" : ",\n") << "{\"name\": \"counters\", \"cat\": "
+       << "\"vlang\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": "
+       << TS.ThreadID << ", \"ts\": 0, \"args\": {";
+    for (unsigned i = 0; i != NumCounters; ++i)
+      OS << (i ? ", \"" : "\"") << CounterNames[i] << "\": " << TS.Counts[i];
+    OS << "}}";
+    First = false;
+  }
+  OS << "\n]}\n";
+}
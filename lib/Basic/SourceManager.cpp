@@ -14,13 +14,18 @@
 #include "vlang/Basic/SourceManager.h"
 #include "vlang/Diag/Diagnostic.h"
 #include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/LineTableCache.h"
 #include "vlang/Basic/SourceManagerInternals.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/Capacity.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -286,6 +291,7 @@ void LineTableInfo::AddEntry(FileID FID,
 /// getLineTableFilenameID - Return the uniqued ID for the specified filename.
 ///
 unsigned SourceManager::getLineTableFilenameID(StringRef Name) {
+  llvm::MutexGuard Guard(WorkerLock);
   if (LineTable == 0)
     LineTable = new LineTableInfo();
   return LineTable->getLineTableFilenameID(Name);
@@ -309,6 +315,7 @@ void SourceManager::AddLineNote(SourceLocation Loc, unsigned LineNo,
   // Remember that this file has #line directives now if it doesn't already.
   const_cast<SrcMgr::FileInfo&>(FileInfo).setHasLineDirectives();
 
+  llvm::MutexGuard Guard(WorkerLock);
   if (LineTable == 0)
     LineTable = new LineTableInfo();
   LineTable->AddLineNote(LocInfo.first, LocInfo.second, LineNo, FilenameID);
@@ -339,6 +346,7 @@ void SourceManager::AddLineNote(SourceLocation Loc, unsigned LineNo,
   // Remember that this file has #line directives now if it doesn't already.
   const_cast<SrcMgr::FileInfo&>(FileInfo).setHasLineDirectives();
 
+  llvm::MutexGuard Guard(WorkerLock);
   if (LineTable == 0)
     LineTable = new LineTableInfo();
 
@@ -361,6 +369,7 @@ void SourceManager::AddLineNote(SourceLocation Loc, unsigned LineNo,
 }
 
 LineTableInfo &SourceManager::getLineTable() {
+  llvm::MutexGuard Guard(WorkerLock);
   if (LineTable == 0)
     LineTable = new LineTableInfo();
   return *LineTable;
@@ -370,12 +379,47 @@ LineTableInfo &SourceManager::getLineTable() {
 // Private 'Create' methods.
 //===----------------------------------------------------------------------===//
 
+SourceManager::LocalState::LocalState(DiagnosticsEngine &Diag, unsigned Base,
+                                      unsigned OffsetLimit)
+  : Diag(&Diag), NumLinearScans(0), NumBinaryProbes(0) {
+  reset(Base, OffsetLimit);
+}
+
+SourceManager::LocalState::~LocalState() {
+  for (llvm::DenseMap<FileID, MacroArgsMap *>::iterator
+         I = MacroArgsCacheMap.begin(),E = MacroArgsCacheMap.end(); I!=E; ++I) {
+    delete I->second;
+  }
+}
+
+void SourceManager::LocalState::reset(unsigned Base, unsigned OffsetLimit) {
+  this->Base = Base;
+  this->OffsetLimit = OffsetLimit;
+  NextLocalOffset = Base;
+  LocalSLocEntryTable.clear();
+  NumCreatedFIDs.clear();
+  MainFileID = FileID();
+  PreambleFileID = FileID();
+  LastFileIDLookup = FileID();
+  LastLineNoFileIDQuery = FileID();
+  LastLineNoContentCache = 0;
+  LastColumnFileID = FileID();
+  IncludedLocMap.clear();
+  IBTUCache.clear();
+  for (llvm::DenseMap<FileID, MacroArgsMap *>::iterator
+         I = MacroArgsCacheMap.begin(),E = MacroArgsCacheMap.end(); I!=E; ++I) {
+    delete I->second;
+  }
+  MacroArgsCacheMap.clear();
+}
+
 SourceManager::SourceManager(DiagnosticsEngine &Diag, FileManager &FileMgr,
                              bool UserFilesAreVolatile)
-  : Diag(Diag), FileMgr(FileMgr), OverridenFilesKeepOriginalName(true),
+  : FileMgr(FileMgr), OverridenFilesKeepOriginalName(true),
     UserFilesAreVolatile(UserFilesAreVolatile),
-    ExternalSLocEntries(0), LineTable(0), NumLinearScans(0),
-    NumBinaryProbes(0), FakeBufferForRecovery(0),
+    ExternalSLocEntries(0), LineTable(0),
+    MainState(Diag, 0, MaxLoadedOffset), NumClaimedWorkers(0),
+    NumPartitions(1), FakeBufferForRecovery(0),
     FakeContentCacheForRecovery(0) {
   clearIDTables();
   Diag.setSourceManager(this);
@@ -404,30 +448,89 @@ SourceManager::~SourceManager() {
   delete FakeBufferForRecovery;
   delete FakeContentCacheForRecovery;
 
-  for (llvm::DenseMap<FileID, MacroArgsMap *>::iterator
-         I = MacroArgsCacheMap.begin(),E = MacroArgsCacheMap.end(); I!=E; ++I) {
-    delete I->second;
-  }
+  llvm::DeleteContainerPointers(Workers);
 }
 
 void SourceManager::clearIDTables() {
-  MainFileID = FileID();
-  LocalSLocEntryTable.clear();
+  llvm::DeleteContainerPointers(Workers);
+  NumClaimedWorkers = 0;
+  NumPartitions = 1;
+  MainState.reset(0, MaxLoadedOffset);
   LoadedSLocEntryTable.clear();
   SLocEntryLoaded.clear();
-  LastLineNoFileIDQuery = FileID();
-  LastLineNoContentCache = 0;
-  LastFileIDLookup = FileID();
 
   if (LineTable)
     LineTable->clear();
 
   // Use up FileID #0 as an invalid expansion.
-  NextLocalOffset = 0;
   CurrentLoadedOffset = MaxLoadedOffset;
   createExpansionLoc(SourceLocation(),SourceLocation(),SourceLocation(), 1);
 }
 
+void SourceManager::setLineTableCacheDir(StringRef Dir) {
+  LineCache.reset(new LineTableCache(Dir));
+}
+
+bool SourceManager::enableWorkers(unsigned NumWorkers) {
+  assert(Workers.empty() && "Workers already enabled");
+  assert(LoadedSLocEntryTable.empty() && !ExternalSLocEntries &&
+         "Workers cannot share loaded SLocEntries");
+  assert(!OverriddenFilesInfo && "Workers cannot share overridden files");
+  if (NumWorkers == 0)
+    return false;
+
+  // The calling thread keeps partition 0.
+  NumPartitions = NumWorkers + 1;
+  if (NumPartitions > MaxLoadedOffset / 2 ||
+      MainState.NextLocalOffset > getPartitionBase(1)) {
+    NumPartitions = 1;
+    return true;
+  }
+
+  // Content caches are read when they are created from now on; read those
+  // that exist already, and finish their line tables, so that workers never
+  // fill one in.
+  for (llvm::DenseMap<const FileEntry*, SrcMgr::ContentCache*>::iterator
+       I = FileInfos.begin(), E = FileInfos.end(); I != E; ++I) {
+    if (!I->second)
+      continue;
+    I->second->getBuffer(getDiagnostics(), *this);
+    if (I->second->SourceLineCache) {
+      bool Invalid = false;
+      ensureLineNumbers(I->second, Invalid, ~0U, ~0U);
+    }
+  }
+
+  MainState.OffsetLimit = getPartitionBase(1);
+  for (unsigned P = 1; P != NumPartitions; ++P)
+    Workers.push_back(new LocalState(getDiagnostics(), getPartitionBase(P),
+                                     getPartitionBase(P + 1)));
+  return false;
+}
+
+bool SourceManager::beginWorker(DiagnosticsEngine &WorkerDiags) {
+  assert(!CurrentWorker.get() && "Thread is a worker already");
+  LocalState *State;
+  {
+    llvm::MutexGuard Guard(WorkerLock);
+    if (NumClaimedWorkers == Workers.size())
+      return true;
+    State = Workers[NumClaimedWorkers++];
+  }
+
+  State->Diag = &WorkerDiags;
+  WorkerDiags.setSourceManager(this);
+  CurrentWorker.set(State);
+  return false;
+}
+
+void SourceManager::endWorker() {
+  LocalState *State = CurrentWorker.get();
+  assert(State && "Thread is not a worker");
+  State->Diag = MainState.Diag;
+  CurrentWorker.erase();
+}
+
 /// getOrCreateContentCache - Create or return a cached ContentCache for the
 /// specified file.
 const ContentCache *
@@ -435,6 +538,22 @@ SourceManager::getOrCreateContentCache(const FileEntry *FileEnt,
                                        bool isSystemFile) {
   assert(FileEnt && "Didn't specify a file entry to use?");
 
+  // Workers share content caches, so read the file before they see it, but
+  // without holding the lock; should another worker get there first, its
+  // cache wins and this copy is dropped.
+  ContentCache Read(FileEnt);
+  if (hasWorkers()) {
+    {
+      llvm::MutexGuard Guard(WorkerLock);
+      if (ContentCache *Entry = FileInfos.lookup(FileEnt))
+        return Entry;
+    }
+    Read.IsSystemFile = isSystemFile;
+    Read.getBuffer(getDiagnostics(), *this);
+  }
+
+  llvm::MutexGuard Guard(WorkerLock);
+
   // Do we already have information about this file?
   ContentCache *&Entry = FileInfos[FileEnt];
   if (Entry) return Entry;
@@ -462,6 +581,8 @@ SourceManager::getOrCreateContentCache(const FileEntry *FileEnt,
   }
 
   Entry->IsSystemFile = isSystemFile;
+  if (hasWorkers())
+    Entry->takeBuffer(Read);
 
   return Entry;
 }
@@ -476,6 +597,7 @@ SourceManager::createMemBufferContentCache(const MemoryBuffer *Buffer) {
   // the pointer for its own nefarious purposes.
   unsigned EntryAlign = llvm::AlignOf<ContentCache>::Alignment;
   EntryAlign = std::max(8U, EntryAlign);
+  llvm::MutexGuard Guard(WorkerLock);
   ContentCache *Entry = ContentCacheAlloc.Allocate<ContentCache>(1, EntryAlign);
   new (Entry) ContentCache();
   MemBufferInfos.push_back(Entry);
@@ -506,10 +628,12 @@ std::pair<int, unsigned>
 SourceManager::AllocateLoadedSLocEntries(unsigned NumSLocEntries,
                                          unsigned TotalSize) {
   assert(ExternalSLocEntries && "Don't have an external sloc source");
+  assert(!hasWorkers() && "Workers cannot share loaded SLocEntries");
   LoadedSLocEntryTable.resize(LoadedSLocEntryTable.size() + NumSLocEntries);
   SLocEntryLoaded.resize(LoadedSLocEntryTable.size());
   CurrentLoadedOffset -= TotalSize;
-  assert(CurrentLoadedOffset >= NextLocalOffset && "Out of source locations");
+  assert(CurrentLoadedOffset >= MainState.NextLocalOffset &&
+         "Out of source locations");
   int ID = LoadedSLocEntryTable.size();
   return std::make_pair(-ID - 1, CurrentLoadedOffset);
 }
@@ -517,6 +641,7 @@ SourceManager::AllocateLoadedSLocEntries(unsigned NumSLocEntries,
 /// \brief As part of recovering from missing or changed content, produce a
 /// fake, non-empty buffer.
 const llvm::MemoryBuffer *SourceManager::getFakeBufferForRecovery() const {
+  llvm::MutexGuard Guard(WorkerLock);
   if (!FakeBufferForRecovery)
     FakeBufferForRecovery
       = llvm::MemoryBuffer::getMemBuffer("<<<INVALID BUFFER>>");
@@ -528,6 +653,7 @@ const llvm::MemoryBuffer *SourceManager::getFakeBufferForRecovery() const {
 /// fake content cache.
 const SrcMgr::ContentCache *
 SourceManager::getFakeContentCacheForRecovery() const {
+  llvm::MutexGuard Guard(WorkerLock);
   if (!FakeContentCacheForRecovery) {
     FakeContentCacheForRecovery = new ContentCache();
     FakeContentCacheForRecovery->replaceBuffer(getFakeBufferForRecovery(),
@@ -540,6 +666,14 @@ SourceManager::getFakeContentCacheForRecovery() const {
 // Methods to create new FileID's and macro expansions.
 //===----------------------------------------------------------------------===//
 
+/// \brief Give up on a unit whose entries no longer fit the offset space, or
+/// the partition of it the calling thread owns.
+static void reportOutOfSourceLocations(bool HasWorkers) {
+  llvm::report_fatal_error(HasWorkers ? "ran out of source locations; use "
+                                        "fewer worker threads"
+                                      : "ran out of source locations");
+}
+
 /// createFileID - Create a new FileID for the specified ContentCache and
 /// include position.  This works regardless of whether the ContentCache
 /// corresponds to a file or some other input source.
@@ -557,21 +691,23 @@ FileID SourceManager::createFileID(const ContentCache *File,
     SLocEntryLoaded[Index] = true;
     return FileID::get(LoadedID);
   }
-  LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset,
-                                               FileInfo::get(IncludePos, File,
-                                                             FileCharacter)));
+  LocalState &State = getLocalState();
+  State.LocalSLocEntryTable.push_back(
+    SLocEntry::get(State.NextLocalOffset,
+                   FileInfo::get(IncludePos, File, FileCharacter)));
   unsigned FileSize = File->getSize();
-  assert(NextLocalOffset + FileSize + 1 > NextLocalOffset &&
-         NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset &&
+  if (FileSize >= State.OffsetLimit - State.NextLocalOffset)
+    reportOutOfSourceLocations(hasWorkers());
+  assert(State.NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset &&
          "Ran out of source locations!");
   // We do a +1 here because we want a SourceLocation that means "the end of the
   // file", e.g. for the "no newline at the end of the file" diagnostic.
-  NextLocalOffset += FileSize + 1;
+  State.NextLocalOffset += FileSize + 1;
 
   // Set LastFileIDLookup to the newly created file.  The next getFileID call is
   // almost guaranteed to be from that file.
-  FileID FID = FileID::get(LocalSLocEntryTable.size()-1);
-  return LastFileIDLookup = FID;
+  FileID FID = FileID::get(State.Base + State.LocalSLocEntryTable.size() - 1);
+  return State.LastFileIDLookup = FID;
 }
 
 SourceLocation
@@ -609,13 +745,16 @@ SourceManager::createExpansionLocImpl(const ExpansionInfo &Info,
     SLocEntryLoaded[Index] = true;
     return SourceLocation::getMacroLoc(LoadedOffset);
   }
-  LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset, Info));
-  assert(NextLocalOffset + TokLength + 1 > NextLocalOffset &&
-         NextLocalOffset + TokLength + 1 <= CurrentLoadedOffset &&
+  LocalState &State = getLocalState();
+  State.LocalSLocEntryTable.push_back(SLocEntry::get(State.NextLocalOffset,
+                                                     Info));
+  if (TokLength >= State.OffsetLimit - State.NextLocalOffset)
+    reportOutOfSourceLocations(hasWorkers());
+  assert(State.NextLocalOffset + TokLength + 1 <= CurrentLoadedOffset &&
          "Ran out of source locations!");
   // See createFileID for that +1.
-  NextLocalOffset += TokLength + 1;
-  return SourceLocation::getMacroLoc(NextLocalOffset - (TokLength + 1));
+  State.NextLocalOffset += TokLength + 1;
+  return SourceLocation::getMacroLoc(State.NextLocalOffset - (TokLength + 1));
 }
 
 const llvm::MemoryBuffer *
@@ -623,7 +762,7 @@ SourceManager::getMemoryBufferForFile(const FileEntry *File,
                                       bool *Invalid) {
   const SrcMgr::ContentCache *IR = getOrCreateContentCache(File);
   assert(IR && "getOrCreateContentCache() cannot return NULL");
-  return IR->getBuffer(Diag, *this, SourceLocation(), Invalid);
+  return IR->getBuffer(getDiagnostics(), *this, SourceLocation(), Invalid);
 }
 
 void SourceManager::overrideFileContents(const FileEntry *SourceFile,
@@ -672,8 +811,8 @@ StringRef SourceManager::getBufferData(FileID FID, bool *Invalid) const {
   }
   
   const llvm::MemoryBuffer *Buf
-    = SLoc.getFile().getContentCache()->getBuffer(Diag, *this, SourceLocation(), 
-                                                  &MyInvalid);
+    = SLoc.getFile().getContentCache()->getBuffer(getDiagnostics(), *this,
+                                                  SourceLocation(), &MyInvalid);
   if (Invalid)
     *Invalid = MyInvalid;
 
@@ -697,18 +836,27 @@ FileID SourceManager::getFileIDSlow(unsigned SLocOffset) const {
     return FileID::get(0);
 
   // Now it is time to search for the correct file. See where the SLocOffset
-  // sits in the global view and consult local or loaded buffers for it.
-  if (SLocOffset < NextLocalOffset)
-    return getFileIDLocal(SLocOffset);
+  // sits in the global view and consult local or loaded buffers for it.  Each
+  // partition of the local offsets has its own table.
+  if (SLocOffset < CurrentLoadedOffset) {
+    const LocalState &Partition = getPartitionForOffset(SLocOffset);
+    if (SLocOffset < Partition.NextLocalOffset)
+      return getFileIDLocal(Partition, SLocOffset);
+  }
   return getFileIDLoaded(SLocOffset);
 }
 
 /// \brief Return the FileID for a SourceLocation with a low offset.
 ///
-/// This function knows that the SourceLocation is in a local buffer, not a
-/// loaded one.
-FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
-  assert(SLocOffset < NextLocalOffset && "Bad function choice");
+/// This function knows that the SourceLocation is in a local buffer of
+/// \p Partition, not a loaded one.
+FileID SourceManager::getFileIDLocal(const LocalState &Partition,
+                                     unsigned SLocOffset) const {
+  assert(SLocOffset >= Partition.Base &&
+         SLocOffset < Partition.NextLocalOffset && "Bad function choice");
+  LocalState &State = getLocalState();
+  const SmallVectorImpl<SrcMgr::SLocEntry> &Table =
+    Partition.LocalSLocEntryTable;
 
   // After the first and second level caches, I see two common sorts of
   // behavior: 1) a lot of searched FileID's are "near" the cached file
@@ -722,14 +870,15 @@ FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
   // See if this is near the file point - worst case we start scanning from the
   // most newly created FileID.
   const SrcMgr::SLocEntry *I;
+  unsigned LastIndex = unsigned(State.LastFileIDLookup.ID) - Partition.Base;
 
-  if (LastFileIDLookup.ID < 0 ||
-      LocalSLocEntryTable[LastFileIDLookup.ID].getOffset() < SLocOffset) {
+  if (State.LastFileIDLookup.ID < 0 || LastIndex >= Table.size() ||
+      Table[LastIndex].getOffset() < SLocOffset) {
     // Neither loc prunes our search.
-    I = LocalSLocEntryTable.end();
+    I = Table.end();
   } else {
     // Perhaps it is near the file point.
-    I = LocalSLocEntryTable.begin()+LastFileIDLookup.ID;
+    I = Table.begin()+LastIndex;
   }
 
   // Find the FileID that contains this.  "I" is an iterator that points to a
@@ -738,13 +887,13 @@ FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
   while (1) {
     --I;
     if (I->getOffset() <= SLocOffset) {
-      FileID Res = FileID::get(int(I - LocalSLocEntryTable.begin()));
+      FileID Res = FileID::get(int(Partition.Base + (I - Table.begin())));
 
       // If this isn't an expansion, remember it.  We have good locality across
       // FileID lookups.
       if (!I->isExpansion())
-        LastFileIDLookup = Res;
-      NumLinearScans += NumProbes+1;
+        State.LastFileIDLookup = Res;
+      State.NumLinearScans += NumProbes+1;
       return Res;
     }
     if (++NumProbes == 8)
@@ -753,19 +902,15 @@ FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
 
   // Convert "I" back into an index.  We know that it is an entry whose index is
   // larger than the offset we are looking for.
-  unsigned GreaterIndex = I - LocalSLocEntryTable.begin();
+  unsigned GreaterIndex = I - Table.begin();
   // LessIndex - This is the lower bound of the range that we're searching.
   // We know that the offset corresponding to the FileID is is less than
   // SLocOffset.
   unsigned LessIndex = 0;
   NumProbes = 0;
   while (1) {
-    bool Invalid = false;
     unsigned MiddleIndex = (GreaterIndex-LessIndex)/2+LessIndex;
-    unsigned MidOffset = getLocalSLocEntry(MiddleIndex, &Invalid).getOffset();
-    if (Invalid)
-      return FileID::get(0);
-    
+    unsigned MidOffset = Table[MiddleIndex].getOffset();
     ++NumProbes;
 
     // If the offset of the midpoint is too large, chop the high side of the
@@ -778,14 +923,13 @@ FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
     // If the middle index contains the value, succeed and return.
     // FIXME: This could be made faster by using a function that's aware of
     // being in the local area.
-    if (isOffsetInFileID(FileID::get(MiddleIndex), SLocOffset)) {
-      FileID Res = FileID::get(MiddleIndex);
-
+    FileID Res = FileID::get(int(Partition.Base + MiddleIndex));
+    if (isOffsetInFileID(Res, SLocOffset)) {
       // If this isn't a macro expansion, remember it.  We have good locality
       // across FileID lookups.
-      if (!LocalSLocEntryTable[MiddleIndex].isExpansion())
-        LastFileIDLookup = Res;
-      NumBinaryProbes += NumProbes;
+      if (!Table[MiddleIndex].isExpansion())
+        State.LastFileIDLookup = Res;
+      State.NumBinaryProbes += NumProbes;
       return Res;
     }
 
@@ -809,8 +953,9 @@ FileID SourceManager::getFileIDLoaded(unsigned SLocOffset) const {
   // in the other direction.
 
   // First do a linear scan from the last lookup position, if possible.
+  LocalState &State = getLocalState();
   unsigned I;
-  int LastID = LastFileIDLookup.ID;
+  int LastID = State.LastFileIDLookup.ID;
   if (LastID >= 0 || getLoadedSLocEntryByID(LastID).getOffset() < SLocOffset)
     I = 0;
   else
@@ -824,8 +969,8 @@ FileID SourceManager::getFileIDLoaded(unsigned SLocOffset) const {
       FileID Res = FileID::get(-int(I) - 2);
 
       if (!E.isExpansion())
-        LastFileIDLookup = Res;
-      NumLinearScans += NumProbes + 1;
+        State.LastFileIDLookup = Res;
+      State.NumLinearScans += NumProbes + 1;
       return Res;
     }
   }
@@ -858,8 +1003,8 @@ FileID SourceManager::getFileIDLoaded(unsigned SLocOffset) const {
     if (isOffsetInFileID(FileID::get(-int(MiddleIndex) - 2), SLocOffset)) {
       FileID Res = FileID::get(-int(MiddleIndex) - 2);
       if (!E.isExpansion())
-        LastFileIDLookup = Res;
-      NumBinaryProbes += NumProbes;
+        State.LastFileIDLookup = Res;
+      State.NumBinaryProbes += NumProbes;
       return Res;
     }
 
@@ -1022,13 +1167,31 @@ const char *SourceManager::getCharacterData(SourceLocation SL,
   }
   const llvm::MemoryBuffer *Buffer
     = Entry.getFile().getContentCache()
-                  ->getBuffer(Diag, *this, SourceLocation(), &CharDataInvalid);
+                  ->getBuffer(getDiagnostics(), *this, SourceLocation(),
+                              &CharDataInvalid);
   if (Invalid)
     *Invalid = CharDataInvalid;
   return Buffer->getBufferStart() + (CharDataInvalid? 0 : LocInfo.second);
 }
 
 
+/// \brief Whether the line table of \p FI covers \p FilePos and line
+/// \p Line + 1.  With workers \p Shared, only a complete table may be read,
+/// since another thread may be extending it.
+static inline bool hasLineNumbers(const ContentCache *FI, bool Shared,
+                                  unsigned FilePos, unsigned Line) {
+  if (Shared) {
+    if (!FI->LinesComplete)
+      return false;
+    llvm::sys::MemoryFence();
+    return true;
+  }
+  return FI->SourceLineCache != 0 &&
+         (FI->LinesComplete ||
+          (FI->NumLines > Line &&
+           FI->SourceLineCache[FI->NumLines-1] > FilePos));
+}
+
 /// getColumnNumber - Return the column # for the specified file position.
 /// this is significantly cheaper to compute than the line number.
 unsigned SourceManager::getColumnNumber(FileID FID, unsigned FilePos,
@@ -1050,20 +1213,52 @@ unsigned SourceManager::getColumnNumber(FileID FID, unsigned FilePos,
 
   // See if we just calculated the line number for this FilePos and can use
   // that to lookup the start of the line instead of searching for it.
-  if (LastLineNoFileIDQuery == FID &&
-      LastLineNoContentCache->SourceLineCache != 0 &&
-      LastLineNoResult < LastLineNoContentCache->NumLines) {
-    unsigned *SourceLineCache = LastLineNoContentCache->SourceLineCache;
-    unsigned LineStart = SourceLineCache[LastLineNoResult - 1];
-    unsigned LineEnd = SourceLineCache[LastLineNoResult];
+  LocalState &State = getLocalState();
+  if (State.LastLineNoFileIDQuery == FID &&
+      State.LastLineNoContentCache->SourceLineCache != 0 &&
+      State.LastLineNoResult < State.LastLineNoContentCache->NumLines) {
+    unsigned *SourceLineCache = State.LastLineNoContentCache->SourceLineCache;
+    unsigned LineStart = SourceLineCache[State.LastLineNoResult - 1];
+    unsigned LineEnd = SourceLineCache[State.LastLineNoResult];
     if (FilePos >= LineStart && FilePos < LineEnd)
       return FilePos - LineStart + 1;
   }
 
+  // If the line table already covers FilePos, find the start of its line
+  // there.
+  const ContentCache *Content =
+    getSLocEntry(FID).getFile().getContentCache();
+  if (hasLineNumbers(Content, hasWorkers(), FilePos, 0)) {
+    const unsigned *Pos =
+      std::upper_bound(Content->SourceLineCache,
+                       Content->SourceLineCache + Content->NumLines, FilePos);
+    return FilePos - Pos[-1] + 1;
+  }
+
+  // Otherwise scan for the start of the line.  Generated code can have very
+  // long lines, so remember the newline-free range scanned last time, and
+  // only look at the bytes between it and FilePos.
   const char *Buf = MemBuf->getBufferStart();
+  if (State.LastColumnFileID == FID && FilePos >= State.LastColumnLineStart) {
+    if (FilePos <= State.LastColumnScanEnd)
+      return FilePos - State.LastColumnLineStart + 1;
+
+    unsigned Pos = State.LastColumnScanEnd;
+    while (Pos != FilePos && Buf[Pos] != '\n' && Buf[Pos] != '\r')
+      ++Pos;
+    if (Pos == FilePos) {
+      State.LastColumnScanEnd = FilePos;
+      return FilePos - State.LastColumnLineStart + 1;
+    }
+  }
+
   unsigned LineStart = FilePos;
   while (LineStart && Buf[LineStart-1] != '\n' && Buf[LineStart-1] != '\r')
     --LineStart;
+
+  State.LastColumnFileID = FID;
+  State.LastColumnLineStart = LineStart;
+  State.LastColumnScanEnd = FilePos;
   return FilePos-LineStart+1;
 }
 
@@ -1100,29 +1295,79 @@ unsigned SourceManager::getPresumedColumnNumber(SourceLocation Loc,
 #include <emmintrin.h>
 #endif
 
+/// \brief Line offsets are scanned at least this many bytes at a time, to
+/// amortize the cost of growing the table.
+static const unsigned LineScanChunkSize = 1U << 16;
+
+/// \brief Append \p Offs to the line table of \p FI, growing it as needed.
+static void appendLineOffset(ContentCache *FI, llvm::BumpPtrAllocator &Alloc,
+                             unsigned Offs) {
+  if (FI->NumLines == FI->LineCacheCapacity) {
+    unsigned NewCapacity = std::max(2 * FI->LineCacheCapacity, 256U);
+    unsigned *NewCache = Alloc.Allocate<unsigned>(NewCapacity);
+    if (FI->NumLines)
+      std::copy(FI->SourceLineCache, FI->SourceLineCache + FI->NumLines,
+                NewCache);
+    FI->SourceLineCache = NewCache;
+    FI->LineCacheCapacity = NewCapacity;
+  }
+  FI->SourceLineCache[FI->NumLines++] = Offs;
+}
+
+/// \brief Extend the line table of \p FI until it covers the line holding
+/// \p UpToOffset and the line numbered \p UpToLine + 1, or the whole file.
+///
+/// Only the part of the buffer that has not been scanned by a previous call
+/// is looked at, so a query near the top of a huge file does not pay for
+/// the rest of it.  When all of a large file has been scanned, its table is
+/// written to the sidecar cache if there is one; when the table is first
+/// needed, a valid sidecar replaces scanning altogether.
 static LLVM_ATTRIBUTE_NOINLINE void
 ComputeLineNumbers(DiagnosticsEngine &Diag, ContentCache *FI,
                    llvm::BumpPtrAllocator &Alloc,
-                   const SourceManager &SM, bool &Invalid);
+                   const SourceManager &SM, bool &Invalid,
+                   unsigned UpToOffset, unsigned UpToLine);
 static void ComputeLineNumbers(DiagnosticsEngine &Diag, ContentCache *FI,
                                llvm::BumpPtrAllocator &Alloc,
-                               const SourceManager &SM, bool &Invalid) {
+                               const SourceManager &SM, bool &Invalid,
+                               unsigned UpToOffset, unsigned UpToLine) {
   // Note that calling 'getBuffer()' may lazily page in the file.
   const MemoryBuffer *Buffer = FI->getBuffer(Diag, SM, SourceLocation(),
                                              &Invalid);
-  if (Invalid)
+  if (Invalid || FI->LinesComplete)
     return;
 
-  // Find the file offsets of all of the *physical* source lines.  This does
-  // not look at trigraphs, escaped newlines, or anything else tricky.
-  SmallVector<unsigned, 256> LineOffsets;
+  LineTableCache *Cache = SM.getLineTableCache();
+  bool UseCache = Cache && FI->ContentsEntry && !FI->BufferOverridden &&
+                  Buffer->getBufferSize() >= LineTableCache::MinFileSize;
+
+  if (FI->SourceLineCache == 0) {
+    const unsigned *Offsets;
+    unsigned NumLines;
+    if (UseCache && Cache->lookup(FI->ContentsEntry, Offsets, NumLines)) {
+      // The table is complete and never written to again, so it can point
+      // straight into the mapped sidecar.
+      FI->SourceLineCache = const_cast<unsigned *>(Offsets);
+      FI->NumLines = NumLines;
+      FI->LineCacheCapacity = NumLines;
+      FI->LineScanOffset = Buffer->getBufferSize();
+      // Workers read complete tables without the lock.
+      llvm::sys::MemoryFence();
+      FI->LinesComplete = true;
+      return;
+    }
 
-  // Line #1 starts at char 0.
-  LineOffsets.push_back(0);
+    // Line #1 starts at char 0.
+    appendLineOffset(FI, Alloc, 0);
+  }
 
-  const unsigned char *Buf = (const unsigned char *)Buffer->getBufferStart();
+  // Find the file offsets of all of the *physical* source lines.  This does
+  // not look at trigraphs, escaped newlines, or anything else tricky.
+  unsigned Offs = FI->LineScanOffset;
+  unsigned StopOffset = std::max(UpToOffset, Offs + LineScanChunkSize);
+  const unsigned char *Buf =
+    (const unsigned char *)Buffer->getBufferStart() + Offs;
   const unsigned char *End = (const unsigned char *)Buffer->getBufferEnd();
-  unsigned Offs = 0;
   while (1) {
     // Skip over the contents of the line.
     const unsigned char *NextBuf = (const unsigned char *)Buf;
@@ -1171,7 +1416,14 @@ FoundSpecialChar:
       if ((Buf[1] == '\n' || Buf[1] == '\r') && Buf[0] != Buf[1])
         ++Offs, ++Buf;
       ++Offs, ++Buf;
-      LineOffsets.push_back(Offs);
+      appendLineOffset(FI, Alloc, Offs);
+
+      // Stop at a line start once the requested prefix is covered; the next
+      // call picks up from here.
+      if (Offs > StopOffset && FI->NumLines > UpToLine) {
+        FI->LineScanOffset = Offs;
+        return;
+      }
     } else {
       // Otherwise, this is a null.  If end of file, exit.
       if (Buf == End) break;
@@ -1180,10 +1432,28 @@ FoundSpecialChar:
     }
   }
 
-  // Copy the offsets into the FileInfo structure.
-  FI->NumLines = LineOffsets.size();
-  FI->SourceLineCache = Alloc.Allocate<unsigned>(LineOffsets.size());
-  std::copy(LineOffsets.begin(), LineOffsets.end(), FI->SourceLineCache);
+  FI->LineScanOffset = Offs;
+  llvm::sys::MemoryFence();
+  FI->LinesComplete = true;
+  if (UseCache)
+    Cache->store(FI->ContentsEntry, FI->SourceLineCache, FI->NumLines);
+}
+
+/// \brief Make sure the line table of \p FI covers \p FilePos and line
+/// \p Line + 1, if the file has that many lines.
+void SourceManager::ensureLineNumbers(ContentCache *FI, bool &Invalid,
+                                      unsigned FilePos, unsigned Line) const {
+  bool Shared = hasWorkers();
+  if (hasLineNumbers(FI, Shared, FilePos, Line))
+    return;
+
+  // Workers compute the whole table at once, so that it never changes once
+  // they read it.
+  llvm::MutexGuard Guard(WorkerLock);
+  if (hasLineNumbers(FI, Shared, FilePos, Line))
+    return;
+  ComputeLineNumbers(getDiagnostics(), FI, ContentCacheAlloc, *this, Invalid,
+                     Shared ? ~0U : FilePos, Shared ? ~0U : Line);
 }
 
 /// getLineNumber - Given a SourceLocation, return the spelling line number
@@ -1198,9 +1468,10 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
     return 1;
   }
 
+  LocalState &State = getLocalState();
   ContentCache *Content;
-  if (LastLineNoFileIDQuery == FID)
-    Content = LastLineNoContentCache;
+  if (State.LastLineNoFileIDQuery == FID)
+    Content = State.LastLineNoContentCache;
   else {
     bool MyInvalid = false;
     const SLocEntry &Entry = getSLocEntry(FID, &MyInvalid);
@@ -1213,17 +1484,13 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
     Content = const_cast<ContentCache*>(Entry.getFile().getContentCache());
   }
   
-  // If this is the first use of line information for this buffer, compute the
-  /// SourceLineCache for it on demand.
-  if (Content->SourceLineCache == 0) {
-    bool MyInvalid = false;
-    ComputeLineNumbers(Diag, Content, ContentCacheAlloc, *this, MyInvalid);
-    if (Invalid)
-      *Invalid = MyInvalid;
-    if (MyInvalid)
-      return 1;
-  } else if (Invalid)
-    *Invalid = false;
+  // Compute the SourceLineCache on demand, up to the queried position.
+  bool MyInvalid = false;
+  ensureLineNumbers(Content, MyInvalid, FilePos);
+  if (Invalid)
+    *Invalid = MyInvalid;
+  if (MyInvalid)
+    return 1;
 
   // Okay, we know we have a line number table.  Do a binary search to find the
   // line number that this character position lands on.
@@ -1246,10 +1513,10 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
   // If the previous query was to the same file, we know both the file pos from
   // that query and the line number returned.  This allows us to narrow the
   // search space from the entire file to something near the match.
-  if (LastLineNoFileIDQuery == FID) {
-    if (QueriedFilePos >= LastLineNoFilePos) {
+  if (State.LastLineNoFileIDQuery == FID) {
+    if (QueriedFilePos >= State.LastLineNoFilePos) {
       // FIXME: Potential overflow?
-      SourceLineCache = SourceLineCache+LastLineNoResult-1;
+      SourceLineCache = SourceLineCache+State.LastLineNoResult-1;
 
       // The query is likely to be nearby the previous one.  Here we check to
       // see if it is within 5, 10 or 20 lines.  It can be far away in cases
@@ -1268,8 +1535,8 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
         }
       }
     } else {
-      if (LastLineNoResult < Content->NumLines)
-        SourceLineCacheEnd = SourceLineCache+LastLineNoResult+1;
+      if (State.LastLineNoResult < Content->NumLines)
+        SourceLineCacheEnd = SourceLineCache+State.LastLineNoResult+1;
     }
   }
 
@@ -1302,10 +1569,10 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
     = std::lower_bound(SourceLineCache, SourceLineCacheEnd, QueriedFilePos);
   unsigned LineNo = Pos-SourceLineCacheStart;
 
-  LastLineNoFileIDQuery = FID;
-  LastLineNoContentCache = Content;
-  LastLineNoFilePos = QueriedFilePos;
-  LastLineNoResult = LineNo;
+  State.LastLineNoFileIDQuery = FID;
+  State.LastLineNoContentCache = Content;
+  State.LastLineNoFilePos = QueriedFilePos;
+  State.LastLineNoResult = LineNo;
   return LineNo;
 }
 
@@ -1351,6 +1618,7 @@ SourceManager::getFileCharacteristic(SourceLocation Loc) const {
   if (!FI.hasLineDirectives())
     return FI.getFileCharacteristic();
 
+  llvm::MutexGuard Guard(WorkerLock);
   assert(LineTable && "Can't have linetable entries without a LineTable!");
   // See if there is a #line directive before the location.
   const LineEntry *Entry =
@@ -1403,7 +1671,7 @@ PresumedLoc SourceManager::getPresumedLoc(SourceLocation Loc,
   if (C->OrigEntry)
     Filename = C->OrigEntry->getName();
   else
-    Filename = C->getBuffer(Diag, *this)->getBufferIdentifier();
+    Filename = C->getBuffer(getDiagnostics(), *this)->getBufferIdentifier();
 
   unsigned LineNo = getLineNumber(LocInfo.first, LocInfo.second, &Invalid);
   if (Invalid)
@@ -1417,6 +1685,7 @@ PresumedLoc SourceManager::getPresumedLoc(SourceLocation Loc,
   // If we have #line directives in this file, update and overwrite the physical
   // location info if appropriate.
   if (UseLineDirectives && FI.hasLineDirectives()) {
+    llvm::MutexGuard Guard(WorkerLock);
     assert(LineTable && "Can't have linetable entries without a LineTable!");
     // See if there is a #line directive before this.  If so, get it.
     if (const LineEntry *Entry =
@@ -1453,9 +1722,11 @@ unsigned SourceManager::getFileIDSize(FileID FID) const {
     return 0;
 
   int ID = FID.ID;
+  const LocalState &Partition = getPartitionForID(ID);
   unsigned NextOffset;
-  if ((ID > 0 && unsigned(ID+1) == local_sloc_entry_size()))
-    NextOffset = getNextLocalOffset();
+  if (ID > 0 &&
+      unsigned(ID) + 1 - Partition.Base == Partition.LocalSLocEntryTable.size())
+    NextOffset = Partition.NextLocalOffset;
   else if (ID+1 == -1)
     NextOffset = MaxLoadedOffset;
   else
@@ -1509,6 +1780,8 @@ FileID SourceManager::translateFile(const FileEntry *SourceFile) const {
 
   // First, check the main file ID, since it is common to look for a
   // location in the main file.
+  const LocalState &State = getLocalState();
+  FileID MainFileID = State.MainFileID;
   Optional<ino_t> SourceFileInode;
   Optional<StringRef> SourceFileName;
   if (!MainFileID.isInvalid()) {
@@ -1556,7 +1829,7 @@ FileID SourceManager::translateFile(const FileEntry *SourceFile) const {
       if (SLoc.isFile() && 
           SLoc.getFile().getContentCache() &&
           SLoc.getFile().getContentCache()->OrigEntry == SourceFile) {
-        FirstFID = FileID::get(I);
+        FirstFID = FileID::get(State.Base + I);
         break;
       }
     }
@@ -1585,7 +1858,7 @@ FileID SourceManager::translateFile(const FileEntry *SourceFile) const {
     bool Invalid = false;
     for (unsigned I = 0, N = local_sloc_entry_size(); I != N; ++I) {
       FileID IFileID;
-      IFileID.ID = I;
+      IFileID.ID = State.Base + I;
       const SLocEntry &SLoc = getSLocEntry(IFileID, &Invalid);
       if (Invalid)
         return FileID();
@@ -1598,7 +1871,7 @@ FileID SourceManager::translateFile(const FileEntry *SourceFile) const {
             *SourceFileName == llvm::sys::path::filename(Entry->getName())) {
           if (Optional<ino_t> EntryInode = getActualFileInode(Entry)) {
             if (*SourceFileInode == *EntryInode) {
-              FirstFID = FileID::get(I);
+              FirstFID = IFileID;
               SourceFile = Entry;
               break;
             }
@@ -1638,23 +1911,22 @@ SourceLocation SourceManager::translateLineCol(FileID FID,
   if (!Content)
     return SourceLocation();
     
-  // If this is the first use of line information for this buffer, compute the
-  // SourceLineCache for it on demand.
-  if (Content->SourceLineCache == 0) {
-    bool MyInvalid = false;
-    ComputeLineNumbers(Diag, Content, ContentCacheAlloc, *this, MyInvalid);
-    if (MyInvalid)
-      return SourceLocation();
-  }
+  // Compute the SourceLineCache on demand, up to the requested line.
+  bool MyInvalid = false;
+  ensureLineNumbers(Content, MyInvalid, 0, Line - 1);
+  if (MyInvalid)
+    return SourceLocation();
 
   if (Line > Content->NumLines) {
-    unsigned Size = Content->getBuffer(Diag, *this)->getBufferSize();
+    unsigned Size =
+      Content->getBuffer(getDiagnostics(), *this)->getBufferSize();
     if (Size > 0)
       --Size;
     return FileLoc.getLocWithOffset(Size);
   }
 
-  const llvm::MemoryBuffer *Buffer = Content->getBuffer(Diag, *this);
+  const llvm::MemoryBuffer *Buffer =
+    Content->getBuffer(getDiagnostics(), *this);
   unsigned FilePos = Content->SourceLineCache[Line - 1];
   const char *Buf = Buffer->getBufferStart() + FilePos;
   unsigned BufLength = Buffer->getBufferSize() - FilePos;
@@ -1689,12 +1961,13 @@ void SourceManager::computeMacroArgsCache(MacroArgsMap *&CachePtr,
   // Initially no macro argument chunk is present.
   MacroArgsCache.insert(std::make_pair(0, SourceLocation()));
 
+  const LocalState &Partition = getPartitionForID(FID.ID);
   int ID = FID.ID;
   while (1) {
     ++ID;
     // Stop if there are no more FileIDs to check.
     if (ID > 0) {
-      if (unsigned(ID) >= local_sloc_entry_size())
+      if (unsigned(ID) - Partition.Base >= Partition.LocalSLocEntryTable.size())
         return;
     } else if (ID == -1) {
       return;
@@ -1710,8 +1983,8 @@ void SourceManager::computeMacroArgsCache(MacroArgsMap *&CachePtr,
 
       // Skip the files/macros of the #include'd file, we only care about macros
       // that lexed macro arguments from our file.
-      if (Entry.getFile().NumCreatedFIDs)
-        ID += Entry.getFile().NumCreatedFIDs - 1/*because of next ++ID*/;
+      if (unsigned NumFIDs = getNumCreatedFIDsForFileID(FileID::get(ID)))
+        ID += NumFIDs - 1/*because of next ++ID*/;
       continue;
     }
 
@@ -1832,7 +2105,7 @@ SourceManager::getMacroArgExpandedLocation(SourceLocation Loc) const {
   if (FID.isInvalid())
     return Loc;
 
-  MacroArgsMap *&MacroArgsCache = MacroArgsCacheMap[FID];
+  MacroArgsMap *&MacroArgsCache = getLocalState().MacroArgsCacheMap[FID];
   if (!MacroArgsCache)
     computeMacroArgsCache(MacroArgsCache, FID);
 
@@ -1854,6 +2127,7 @@ SourceManager::getDecomposedIncludedLoc(FileID FID) const {
 
   typedef std::pair<FileID, unsigned> DecompTy;
   typedef llvm::DenseMap<FileID, DecompTy> MapTy;
+  MapTy &IncludedLocMap = getLocalState().IncludedLocMap;
   std::pair<MapTy::iterator, bool>
     InsertOp = IncludedLocMap.insert(std::make_pair(FID, DecompTy()));
   DecompTy &DecompLoc = InsertOp.first->second;
@@ -1896,6 +2170,8 @@ InBeforeInTUCacheEntry &SourceManager::getInBeforeInTUCache(FileID LFID,
   // out to ~250 items).  We can make it larger if necessary.
   enum { MagicCacheSize = 300 };
   IsBeforeInTUCacheKey Key(LFID, RFID);
+  LocalState &State = getLocalState();
+  InBeforeInTUCache &IBTUCache = State.IBTUCache;
 
   // If the cache size isn't too large, do a lookup and if necessary default
   // construct an entry.  We can then return it to the caller for direct
@@ -1910,7 +2186,7 @@ InBeforeInTUCacheEntry &SourceManager::getInBeforeInTUCache(FileID LFID,
     return I->second;
 
   // Fall back to the overflow value.
-  return IBTUCacheOverflow;
+  return State.IBTUCacheOverflow;
 }
 
 /// \brief Determines the order of 2 source locations in the translation unit.
@@ -1988,32 +2264,95 @@ bool SourceManager::isBeforeInTranslationUnit(SourceLocation LHS,
   return LOffs.first < ROffs.first;
 }
 
+namespace {
+/// \brief The layout of an SLocEntry before FileInfo kept its ContentCache
+/// pointer in two halves and NumCreatedFIDs moved out of it, for comparison
+/// in PrintStats().
+struct OldSLocEntry {
+  struct FileInfo {
+    unsigned IncludeLoc;
+    unsigned NumCreatedFIDs;
+    uintptr_t Data;
+  };
+  struct ExpansionInfo {
+    unsigned SpellingLoc, ExpansionLocStart, ExpansionLocEnd;
+  };
+
+  unsigned Offset;
+  union {
+    FileInfo File;
+    ExpansionInfo Expansion;
+  };
+};
+}
+
 void SourceManager::PrintStats() const {
   llvm::errs() << "\n*** Source Manager Stats:\n";
   llvm::errs() << FileInfos.size() << " files mapped, " << MemBufferInfos.size()
                << " mem buffers mapped.\n";
-  llvm::errs() << LocalSLocEntryTable.size() << " local SLocEntry's allocated ("
-               << llvm::capacity_in_bytes(LocalSLocEntryTable)
-               << " bytes of capacity), "
-               << NextLocalOffset << "B of Sloc address space used.\n";
+
+  // Workers' entries and caches count with those of the main state.
+  SmallVector<const LocalState *, 8> States;
+  States.push_back(&MainState);
+  States.append(Workers.begin(), Workers.end());
+  size_t NumLocalEntries = 0, LocalCapacity = 0, LocalSpace = 0;
+  unsigned NumMacroArgsComputed = 0, NumMacroArgChunks = 0, NumExpansions = 0;
+  unsigned NumLinearScans = 0, NumBinaryProbes = 0;
+  for (unsigned S = 0, SE = States.size(); S != SE; ++S) {
+    const LocalState &State = *States[S];
+    NumLocalEntries += State.LocalSLocEntryTable.size();
+    LocalCapacity += llvm::capacity_in_bytes(State.LocalSLocEntryTable);
+    LocalSpace += State.NextLocalOffset - State.Base;
+    NumMacroArgsComputed += State.MacroArgsCacheMap.size();
+    for (llvm::DenseMap<FileID, MacroArgsMap *>::const_iterator
+           I = State.MacroArgsCacheMap.begin(),
+           E = State.MacroArgsCacheMap.end(); I != E; ++I)
+      NumMacroArgChunks += I->second->size();
+    for (unsigned i = 0, e = State.LocalSLocEntryTable.size(); i != e; ++i)
+      NumExpansions += State.LocalSLocEntryTable[i].isExpansion();
+    NumLinearScans += State.NumLinearScans;
+    NumBinaryProbes += State.NumBinaryProbes;
+  }
+
+  llvm::errs() << NumLocalEntries << " local SLocEntry's allocated ("
+               << LocalCapacity << " bytes of capacity), "
+               << LocalSpace << "B of Sloc address space used";
+  if (!Workers.empty())
+    llvm::errs() << ", in " << NumClaimedWorkers + 1 << " of "
+                 << States.size() << " partitions";
+  llvm::errs() << ".\n";
   llvm::errs() << LoadedSLocEntryTable.size()
                << " loaded SLocEntries allocated, "
                << MaxLoadedOffset - CurrentLoadedOffset
                << "B of Sloc address space used.\n";
   
   unsigned NumLineNumsComputed = 0;
+  unsigned NumLineNumsPartial = 0;
   unsigned NumFileBytesMapped = 0;
   for (fileinfo_iterator I = fileinfo_begin(), E = fileinfo_end(); I != E; ++I){
     NumLineNumsComputed += I->second->SourceLineCache != 0;
+    NumLineNumsPartial += I->second->SourceLineCache != 0 &&
+                          !I->second->LinesComplete;
     NumFileBytesMapped  += I->second->getSizeBytesMapped();
   }
-  unsigned NumMacroArgsComputed = MacroArgsCacheMap.size();
+  for (unsigned i = 0, e = LoadedSLocEntryTable.size(); i != e; ++i)
+    NumExpansions += SLocEntryLoaded[i] &&
+                     LoadedSLocEntryTable[i].isExpansion();
 
   llvm::errs() << NumFileBytesMapped << " bytes of files mapped, "
-               << NumLineNumsComputed << " files with line #'s computed, "
+               << NumLineNumsComputed << " files with line #'s computed ("
+               << NumLineNumsPartial << " partially), "
                << NumMacroArgsComputed << " files with macro args computed.\n";
+  llvm::errs() << NumExpansions << " expansion SLocEntries ("
+               << NumExpansions * sizeof(SrcMgr::SLocEntry) << " bytes, "
+               << sizeof(SrcMgr::SLocEntry) << " bytes/entry; "
+               << NumExpansions * sizeof(OldSLocEntry) << " bytes at the "
+               << sizeof(OldSLocEntry) << " bytes/entry of the old layout), "
+               << NumMacroArgChunks << " macro arg chunks cached.\n";
   llvm::errs() << "FileID scans: " << NumLinearScans << " linear, "
                << NumBinaryProbes << " binary.\n";
+  if (LineCache)
+    LineCache->PrintStats();
 }
 
 ExternalSLocEntrySource::~ExternalSLocEntrySource() { }
@@ -2040,10 +2379,12 @@ SourceManager::MemoryBufferSizes SourceManager::getMemoryBufferSizes() const {
 
 size_t SourceManager::getDataStructureSizes() const {
   size_t size = llvm::capacity_in_bytes(MemBufferInfos)
-    + llvm::capacity_in_bytes(LocalSLocEntryTable)
+    + llvm::capacity_in_bytes(MainState.LocalSLocEntryTable)
     + llvm::capacity_in_bytes(LoadedSLocEntryTable)
     + llvm::capacity_in_bytes(SLocEntryLoaded)
     + llvm::capacity_in_bytes(FileInfos);
+  for (unsigned i = 0, e = Workers.size(); i != e; ++i)
+    size += llvm::capacity_in_bytes(Workers[i]->LocalSLocEntryTable);
   
   if (OverriddenFilesInfo)
     size += llvm::capacity_in_bytes(OverriddenFilesInfo->OverriddenFiles);
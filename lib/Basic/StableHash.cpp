@@ -0,0 +1,24 @@
+//===--- StableHash.cpp - Hashes that are stable across runs --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements hashFNV1a.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Basic/StableHash.h"
+
+using namespace vlang;
+
+uint64_t vlang::hashFNV1a(StringRef Data, uint64_t Hash) {
+  for (StringRef::size_type i = 0, e = Data.size(); i != e; ++i) {
+    Hash ^= (unsigned char)Data[i];
+    Hash *= 1099511628211ULL;
+  }
+  return Hash;
+}
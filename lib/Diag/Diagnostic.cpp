@@ -16,6 +16,7 @@
 #include "vlang/Diag/PartialDiagnostic.h"
 #include "vlang/Basic/CharInfo.h"
 #include "vlang/Basic/IdentifierTable.h"
+#include "vlang/Basic/SourceManager.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CrashRecoveryContext.h"
@@ -120,6 +121,8 @@ void DiagnosticsEngine::Reset() {
   // through command-line.
   DiagStates.push_back(DiagState());
   DiagStatePoints.push_back(DiagStatePoint(&DiagStates.back(), FullSourceLoc()));
+  DiagStatesByLoc.clear(&DiagStates.back());
+  DiagStateIndexIsStale = false;
 }
 
 void DiagnosticsEngine::SetDelayedDiagnostic(unsigned DiagID, StringRef Arg1,
@@ -139,6 +142,114 @@ void DiagnosticsEngine::ReportDelayed() {
   DelayedDiagArg2.clear();
 }
 
+unsigned DiagnosticsEngine::DiagStateIndex::File::lookup(unsigned Offset) const {
+  assert(!Transitions.empty() && Transitions.front().Offset == 0 &&
+         "File record without an initial state");
+  unsigned Lo = 0, Hi = Transitions.size();
+  // Find the last transition at or before Offset.
+  while (Hi - Lo > 1) {
+    unsigned Mid = Lo + (Hi - Lo) / 2;
+    if (Transitions[Mid].Offset <= Offset)
+      Lo = Mid;
+    else
+      Hi = Mid;
+  }
+  return Lo;
+}
+
+DiagnosticsEngine::DiagStateIndex::File *
+DiagnosticsEngine::DiagStateIndex::getFile(const SourceManager &SM,
+                                           FileID FID) const {
+  llvm::DenseMap<FileID, File *>::iterator I = Files.find(FID);
+  if (I != Files.end())
+    return I->second;
+
+  FileStorage.push_back(File());
+  File *F = &FileStorage.back();
+
+  // A file starts out in the state that was active where it was entered.
+  DiagState *Initial = FirstState;
+  std::pair<FileID, unsigned> Decomp = SM.getDecomposedIncludedLoc(FID);
+  if (!Decomp.first.isInvalid()) {
+    File *Parent = getFile(SM, Decomp.first);
+    F->Parent = Parent;
+    F->ParentOffset = Decomp.second;
+    Initial = Parent->Transitions[Parent->lookup(Decomp.second)].State;
+  }
+  F->Transitions.push_back(Transition(0, Initial));
+
+  Files[FID] = F;
+  return F;
+}
+
+void DiagnosticsEngine::DiagStateIndex::clear(DiagState *First) {
+  FirstState = First;
+  FileStorage.clear();
+  Files.clear();
+  CachedFID = FileID();
+  CachedState = 0;
+}
+
+void DiagnosticsEngine::DiagStateIndex::append(const SourceManager &SM,
+                                               SourceLocation Loc,
+                                               DiagState *State) {
+  assert(Loc.isValid() && "Appending a state at an invalid location");
+  CachedFID = FileID();
+
+  std::pair<FileID, unsigned> Decomp = SM.getDecomposedLoc(Loc);
+  unsigned Offset = Decomp.second;
+  for (File *F = getFile(SM, Decomp.first); F;
+       Offset = F->ParentOffset, F = F->Parent) {
+    Transition &Last = F->Transitions.back();
+    assert(Last.Offset <= Offset && "State appended out of order");
+    if (Last.Offset == Offset) {
+      if (Last.State == State)
+        break;
+      Last.State = State;
+      continue;
+    }
+    F->Transitions.push_back(Transition(Offset, State));
+  }
+}
+
+DiagnosticsEngine::DiagState *
+DiagnosticsEngine::DiagStateIndex::lookup(const SourceManager &SM,
+                                          SourceLocation Loc) const {
+  std::pair<FileID, unsigned> Decomp = SM.getDecomposedLoc(Loc);
+  if (Decomp.first == CachedFID &&
+      Decomp.second >= CachedBegin && Decomp.second < CachedEnd)
+    return CachedState;
+
+  const File *F = getFile(SM, Decomp.first);
+  unsigned Idx = F->lookup(Decomp.second);
+  CachedFID = Decomp.first;
+  CachedBegin = F->Transitions[Idx].Offset;
+  CachedEnd = Idx + 1 == F->Transitions.size() ? ~0U
+                                               : F->Transitions[Idx+1].Offset;
+  CachedState = F->Transitions[Idx].State;
+  return CachedState;
+}
+
+void DiagnosticsEngine::RebuildDiagStateIndex() const {
+  assert(DiagStatePoints.front().Loc.isInvalid() &&
+         "Should have created a DiagStatePoint for command-line");
+  DiagStatesByLoc.clear(DiagStatePoints.front().State);
+  for (DiagStatePointsTy::iterator I = DiagStatePoints.begin() + 1,
+         E = DiagStatePoints.end(); I != E; ++I)
+    DiagStatesByLoc.append(*SourceMgr, I->Loc, I->State);
+  DiagStateIndexIsStale = false;
+}
+
+DiagnosticsEngine::DiagState *
+DiagnosticsEngine::GetDiagStateForLoc(SourceLocation L) const {
+  assert(!DiagStatePoints.empty());
+  if (!SourceMgr || L.isInvalid() || DiagStatePoints.size() == 1)
+    return GetCurDiagState();
+  if (DiagStateIndexIsStale)
+    RebuildDiagStateIndex();
+  return DiagStatesByLoc.lookup(*SourceMgr, L);
+}
+
 DiagnosticsEngine::DiagStatePointsTy::iterator
 DiagnosticsEngine::GetDiagStatePointForLoc(SourceLocation L) const {
   assert(!DiagStatePoints.empty());
@@ -211,23 +322,23 @@ void DiagnosticsEngine::setDiagnosticMapping(diag::kind Diag, diag::Mapping Map,
   // Update all diagnostic states that are active after the given location.
   for (DiagStatePointsTy::iterator
          I = Pos+1, E = DiagStatePoints.end(); I != E; ++I) {
-    GetCurDiagState()->setMappingInfo(Diag, MappingInfo);
+    I->State->setMappingInfo(Diag, MappingInfo);
   }
 
   // If the location corresponds to an existing point, just update its state.
   if (Pos->Loc == Loc) {
-    GetCurDiagState()->setMappingInfo(Diag, MappingInfo);
+    Pos->State->setMappingInfo(Diag, MappingInfo);
     return;
   }
 
   // Create a new state/point and fit it into the vector of DiagStatePoints
   // so that the vector is always ordered according to location.
-  Pos->Loc.isBeforeInTranslationUnitThan(Loc);
   DiagStates.push_back(*Pos->State);
   DiagState *NewState = &DiagStates.back();
-  GetCurDiagState()->setMappingInfo(Diag, MappingInfo);
+  NewState->setMappingInfo(Diag, MappingInfo);
   DiagStatePoints.insert(Pos+1, DiagStatePoint(NewState,
                                                FullSourceLoc(Loc, *SourceMgr)));
+  DiagStateIndexIsStale = true;
 }
 
 bool DiagnosticsEngine::setDiagnosticGroupMapping(
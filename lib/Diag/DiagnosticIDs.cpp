@@ -16,8 +16,8 @@
 #include "vlang/Diag/DiagnosticCategories.h"
 #include "vlang/Basic/SourceManager.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/ErrorHandling.h"
-#include <map>
 using namespace vlang;
 
 //===----------------------------------------------------------------------===//
@@ -34,34 +34,44 @@ enum {
   CLASS_ERROR      = 0x04
 };
 
+/// \brief The fields consulted every time a diagnostic is classified.
+///
+/// These are kept apart from the description strings, which are only needed
+/// once a diagnostic is actually emitted.  A record is six bytes, so a 64-byte
+/// cache line holds ten of them and classifying a diagnostic touches one line,
+/// or two when its record straddles a line boundary.
 struct StaticDiagInfoRec {
-  unsigned short DiagID;
-  unsigned Mapping : 3;
-  unsigned Class : 3;
-  unsigned SFINAE : 1;
-  unsigned AccessControl : 1;
-  unsigned WarnNoWerror : 1;
-  unsigned WarnShowInSystemHeader : 1;
-  unsigned Category : 5;
+  uint16_t DiagID;
+  uint16_t Mapping : 3;
+  uint16_t Class : 3;
+  uint16_t SFINAE : 1;
+  uint16_t AccessControl : 1;
+  uint16_t WarnNoWerror : 1;
+  uint16_t WarnShowInSystemHeader : 1;
+  uint16_t Category : 5;
 
   uint16_t OptionGroupIndex;
 
-  uint16_t DescriptionLen;
-  const char *DescriptionStr;
-
   unsigned getOptionGroupIndex() const {
     return OptionGroupIndex;
   }
 
-  StringRef getDescription() const {
-    return StringRef(DescriptionStr, DescriptionLen);
-  }
-
   bool operator<(const StaticDiagInfoRec &RHS) const {
     return DiagID < RHS.DiagID;
   }
 };
 
+/// \brief The description of a builtin diagnostic, parallel to
+/// StaticDiagInfo.
+struct StaticDiagDescriptionRec {
+  const char *DescriptionStr;
+  uint16_t DescriptionLen;
+
+  StringRef getDescription() const {
+    return StringRef(DescriptionStr, DescriptionLen);
+  }
+};
+
 } // namespace anonymous
 
 static const StaticDiagInfoRec StaticDiagInfo[] = {
@@ -69,14 +79,26 @@ static const StaticDiagInfoRec StaticDiagInfo[] = {
              SFINAE,ACCESS,NOWERROR,SHOWINSYSHEADER,              \
              CATEGORY)                                            \
   { diag::ENUM, DEFAULT_MAPPING, CLASS, SFINAE, ACCESS,           \
-    NOWERROR, SHOWINSYSHEADER, CATEGORY, GROUP,                   \
-    STR_SIZE(DESC, uint16_t), DESC },
+    NOWERROR, SHOWINSYSHEADER, CATEGORY, GROUP },
+#include "vlang/Diag/DiagnosticCommonKinds.inc"
+#include "vlang/Diag/DiagnosticFrontendKinds.inc"
+#include "vlang/Diag/DiagnosticLexKinds.inc"
+#include "vlang/Diag/DiagnosticParseKinds.inc"
+#undef DIAG
+  { 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+};
+
+static const StaticDiagDescriptionRec StaticDiagDescriptions[] = {
+#define DIAG(ENUM,CLASS,DEFAULT_MAPPING,DESC,GROUP,               \
+             SFINAE,ACCESS,NOWERROR,SHOWINSYSHEADER,              \
+             CATEGORY)                                            \
+  { DESC, STR_SIZE(DESC, uint16_t) },
 #include "vlang/Diag/DiagnosticCommonKinds.inc"
 #include "vlang/Diag/DiagnosticFrontendKinds.inc"
 #include "vlang/Diag/DiagnosticLexKinds.inc"
 #include "vlang/Diag/DiagnosticParseKinds.inc"
 #undef DIAG
-  { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+  { 0, 0 }
 };
 
 static const unsigned StaticDiagInfoSize =
@@ -262,7 +284,9 @@ namespace vlang {
     class CustomDiagInfo {
       typedef std::pair<DiagnosticIDs::Level, std::string> DiagDesc;
       std::vector<DiagDesc> DiagInfo;
-      std::map<DiagDesc, unsigned> DiagIDs;
+      /// \brief The IDs of the custom diagnostics, keyed by message and
+      /// indexed by level.
+      llvm::StringMap<unsigned> DiagIDs[DiagnosticIDs::Fatal + 1];
     public:
 
       /// getDescription - Return the description of the specified custom
@@ -282,16 +306,14 @@ namespace vlang {
 
       unsigned getOrCreateDiagID(DiagnosticIDs::Level L, StringRef Message,
                                  DiagnosticIDs &Diags) {
-        DiagDesc D(L, Message);
         // Check to see if it already exists.
-        std::map<DiagDesc, unsigned>::iterator I = DiagIDs.lower_bound(D);
-        if (I != DiagIDs.end() && I->first == D)
-          return I->second;
+        unsigned &ID = DiagIDs[L].GetOrCreateValue(Message, 0U).getValue();
+        if (ID)
+          return ID;
 
         // If not, assign a new ID.
-        unsigned ID = DiagInfo.size()+DIAG_UPPER_LIMIT;
-        DiagIDs.insert(std::make_pair(D, ID));
-        DiagInfo.push_back(D);
+        ID = DiagInfo.size()+DIAG_UPPER_LIMIT;
+        DiagInfo.push_back(DiagDesc(L, Message));
         return ID;
       }
     };
@@ -365,7 +387,7 @@ bool DiagnosticIDs::isDefaultMappingAsError(unsigned DiagID) {
 /// issue.
 StringRef DiagnosticIDs::getDescription(unsigned DiagID) const {
   if (const StaticDiagInfoRec *Info = GetDiagInfo(DiagID))
-    return Info->getDescription();
+    return StaticDiagDescriptions[Info - StaticDiagInfo].getDescription();
   return CustomDiagInfo->getDescription(DiagID);
 }
 
@@ -398,9 +420,7 @@ DiagnosticIDs::getDiagnosticLevel(unsigned DiagID, unsigned DiagClass,
   // to error.  Errors can only be mapped to fatal.
   DiagnosticIDs::Level Result = DiagnosticIDs::Fatal;
 
-  DiagnosticsEngine::DiagStatePointsTy::iterator
-    Pos = Diag.GetDiagStatePointForLoc(Loc);
-  DiagnosticsEngine::DiagState *State = Pos->State;
+  DiagnosticsEngine::DiagState *State = Diag.GetDiagStateForLoc(Loc);
 
   // Get the mapping information, or compute it lazily.
   DiagnosticMappingInfo &MappingInfo = State->getOrAddMappingInfo(
@@ -500,6 +520,9 @@ struct vlang::WarningOption {
   const char *NameStr;
   const short *Members;
   const short *SubGroups;
+  /// \brief Every diagnostic controlled by the group, including those of its
+  /// subgroups; flattened by TableGen.
+  const short *Closure;
 
   StringRef getName() const {
     return StringRef(NameStr, NameLen);
@@ -513,7 +536,7 @@ struct vlang::WarningOption {
 // Second the table of options, sorted by name for fast binary lookup.
 static const WarningOption OptionTable[] = {
 #define GET_DIAG_TABLE
-  { 0, "",                                               0, DiagSubGroup0 },
+  { 0, "",                                            0, DiagSubGroup0, 0 },
   //TODO: 
 #include "vlang/Diag/DiagnosticGroups.inc"
 #undef GET_DIAG_TABLE
@@ -538,23 +561,18 @@ StringRef DiagnosticIDs::getWarningOptionForDiag(unsigned DiagID) {
 void DiagnosticIDs::getDiagnosticsInGroup(
     const WarningOption *Group,
     SmallVectorImpl<diag::kind> &Diags) const {
-  // Add the members of the option diagnostic set.
-  if (const short *Member = Group->Members) {
+  // The subgroups are already folded into the closure, so this is a plain
+  // copy rather than a walk of the group tree.
+  if (const short *Member = Group->Closure) {
     for (; *Member != -1; ++Member)
       Diags.push_back(*Member);
   }
-
-  // Add the members of the subgroups.
-  if (const short *SubGroups = Group->SubGroups) {
-    for (; *SubGroups != (short)-1; ++SubGroups)
-      getDiagnosticsInGroup(&OptionTable[(short)*SubGroups], Diags);
-  }
 }
 
 bool DiagnosticIDs::getDiagnosticsInGroup(
     StringRef Group,
     SmallVectorImpl<diag::kind> &Diags) const {
-  WarningOption Key = { Group.size(), Group.data(), 0, 0 };
+  WarningOption Key = { Group.size(), Group.data(), 0, 0, 0 };
   const WarningOption *Found =
   std::lower_bound(OptionTable, OptionTable + OptionTableSize, Key,
                    WarningOptionCompare);
@@ -0,0 +1,166 @@
+//===--- CommandFiles.cpp - Verilog command files and plusargs ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the expansion of command files and plusargs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/CommandFiles.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include <cstdlib>
+
+using namespace vlang;
+
+/// \brief Command files nested deeper than this are assumed to include
+/// themselves.
+static const unsigned MaxCommandFileDepth = 32;
+
+static bool isArgumentSeparator(char C) {
+  return C == ' ' || C == '\t' || C == '\n' || C == '\r' || C == '\f' ||
+         C == '\v';
+}
+
+/// Appends to \p Out the argument at \p Ptr, with its environment references
+/// expanded and its quotes removed, and advances \p Ptr past it.
+static void readArgument(const char *&Ptr, const char *End, std::string &Out) {
+  while (Ptr != End && !isArgumentSeparator(*Ptr)) {
+    if (*Ptr == '"') {
+      for (++Ptr; Ptr != End && *Ptr != '"'; ++Ptr)
+        Out += *Ptr;
+      if (Ptr != End)
+        ++Ptr;
+      continue;
+    }
+    if (*Ptr == '/' && Ptr + 1 != End && (Ptr[1] == '/' || Ptr[1] == '*'))
+      break;
+    if (*Ptr != '$' || Ptr + 1 == End) {
+      Out += *Ptr++;
+      continue;
+    }
+
+    // $VAR, ${VAR} or $(VAR).  An unset variable expands to nothing.
+    const char *NameBegin = Ptr + 1;
+    char Close = 0;
+    if (*NameBegin == '{')
+      Close = '}';
+    else if (*NameBegin == '(')
+      Close = ')';
+    if (Close)
+      ++NameBegin;
+    const char *NameEnd = NameBegin;
+    while (NameEnd != End &&
+           ((*NameEnd >= 'a' && *NameEnd <= 'z') ||
+            (*NameEnd >= 'A' && *NameEnd <= 'Z') ||
+            (*NameEnd >= '0' && *NameEnd <= '9') || *NameEnd == '_'))
+      ++NameEnd;
+    if (NameEnd == NameBegin || (Close && (NameEnd == End ||
+                                           *NameEnd != Close))) {
+      Out += *Ptr++;
+      continue;
+    }
+    if (const char *Value = getenv(std::string(NameBegin, NameEnd).c_str()))
+      Out += Value;
+    Ptr = Close ? NameEnd + 1 : NameEnd;
+  }
+}
+
+/// Splits \p Contents into arguments, skipping comments.
+static void tokenizeCommandFile(StringRef Contents,
+                                std::vector<std::string> &Args) {
+  const char *Ptr = Contents.begin(), *End = Contents.end();
+  while (Ptr != End) {
+    if (isArgumentSeparator(*Ptr)) {
+      ++Ptr;
+    } else if (*Ptr == '/' && Ptr + 1 != End && Ptr[1] == '/') {
+      while (Ptr != End && *Ptr != '\n')
+        ++Ptr;
+    } else if (*Ptr == '/' && Ptr + 1 != End && Ptr[1] == '*') {
+      StringRef Rest(Ptr + 2, End - Ptr - 2);
+      size_t CommentEnd = Rest.find("*/");
+      Ptr = CommentEnd == StringRef::npos ? End : Rest.begin() + CommentEnd + 2;
+    } else {
+      std::string Arg;
+      readArgument(Ptr, End, Arg);
+      if (!Arg.empty())
+        Args.push_back(Arg);
+    }
+  }
+}
+
+static bool expandArguments(const std::vector<std::string> &In,
+                            std::vector<std::string> &Out, unsigned Depth,
+                            std::string &ErrorStr) {
+  for (unsigned I = 0, E = In.size(); I != E; ++I) {
+    if (In[I] != "-f") {
+      Out.push_back(In[I]);
+      continue;
+    }
+    if (I + 1 == E) {
+      ErrorStr = "-f expects a command file";
+      return true;
+    }
+    const std::string &Path = In[++I];
+    if (Depth == MaxCommandFileDepth) {
+      ErrorStr = "command files nested too deeply at '" + Path + "'";
+      return true;
+    }
+    OwningPtr<llvm::MemoryBuffer> Buffer;
+    if (llvm::error_code EC = llvm::MemoryBuffer::getFile(Path, Buffer)) {
+      ErrorStr = "cannot read command file '" + Path + "': " + EC.message();
+      return true;
+    }
+    std::vector<std::string> FileArgs;
+    tokenizeCommandFile(Buffer->getBuffer(), FileArgs);
+    if (expandArguments(FileArgs, Out, Depth + 1, ErrorStr))
+      return true;
+  }
+  return false;
+}
+
+bool vlang::ExpandCommandFiles(ArrayRef<const char *> Argv,
+                               std::vector<std::string> &Args,
+                               std::string &ErrorStr) {
+  std::vector<std::string> In(Argv.begin(), Argv.end());
+  return expandArguments(In, Args, 0, ErrorStr);
+}
+
+/// Appends the '+'-separated values of \p Arg after \p Prefix to \p Values.
+static void splitPlusValues(StringRef Arg, StringRef Prefix,
+                            std::vector<std::string> &Values) {
+  StringRef Rest = Arg.substr(Prefix.size());
+  while (!Rest.empty()) {
+    std::pair<StringRef, StringRef> Split = Rest.split('+');
+    if (!Split.first.empty())
+      Values.push_back(Split.first);
+    Rest = Split.second;
+  }
+}
+
+void vlang::ExtractPlusArgs(std::vector<std::string> &Args, PlusArgs &Plus,
+                            std::vector<std::string> &Unknown) {
+  std::vector<std::string> Rest;
+  for (unsigned I = 0, E = Args.size(); I != E; ++I) {
+    StringRef Arg = Args[I];
+    if (!Arg.startswith("+")) {
+      Rest.push_back(Args[I]);
+    } else if (Arg.startswith("+define+")) {
+      splitPlusValues(Arg, "+define+", Plus.Defines);
+    } else if (Arg.startswith("+incdir+")) {
+      splitPlusValues(Arg, "+incdir+", Plus.IncludeDirs);
+    } else if (Arg.startswith("+libext+")) {
+      splitPlusValues(Arg, "+libext+", Plus.LibraryExtensions);
+    } else {
+      Unknown.push_back(Args[I]);
+    }
+  }
+  Args.swap(Rest);
+}
@@ -0,0 +1,71 @@
+//===--- CompilationUnit.cpp - Several files as one unit ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements getCompilationUnitSource() and the
+//  MacroSnapshotRecorder class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/CompilationUnit.h"
+#include "vlang/Basic/MacroBuilder.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace vlang;
+
+std::string vlang::getCompilationUnitSource(ArrayRef<std::string> Files) {
+  std::string Source;
+  for (unsigned I = 0, E = Files.size(); I != E; ++I) {
+    SmallString<256> Path(Files[I]);
+    llvm::sys::fs::make_absolute(Path);
+    Source += "`include \"";
+    Source += Path.str();
+    Source += "\"\n";
+  }
+  return Source;
+}
+
+void MacroSnapshotRecorder::FileChanged(SourceLocation Loc,
+                                        FileChangeReason Reason,
+                                        SrcMgr::CharacteristicKind FileType,
+                                        FileID PrevFID) {
+  if (Reason != EnterFile)
+    return;
+  // Only the files the unit's main file includes start a snapshot, not
+  // the files they include in turn.
+  SourceManager &SM = PP.getSourceManager();
+  SourceLocation IncludeLoc = SM.getIncludeLoc(SM.getFileID(Loc));
+  if (IncludeLoc.isInvalid() || SM.getFileID(IncludeLoc) != SM.getMainFileID())
+    return;
+
+  const MacroState &State = PP.getMacroState();
+  if (!States.empty() && States.back() == State) {
+    States.push_back(State);
+    Snapshots.push_back(Snapshots.back());
+    return;
+  }
+  States.push_back(State);
+
+  std::vector<std::pair<StringRef, StringRef> > Definitions;
+  PP.getSourceMacroDefinitions(Definitions);
+  // Sorted, so that equal macro states give equal snapshots.
+  std::sort(Definitions.begin(), Definitions.end());
+
+  std::string Snapshot;
+  llvm::raw_string_ostream OS(Snapshot);
+  MacroBuilder Builder(OS);
+  for (unsigned I = 0, E = Definitions.size(); I != E; ++I)
+    Builder.append("`define " + Definitions[I].second);
+  OS.flush();
+  Snapshots.push_back(Snapshot);
+}
@@ -0,0 +1,212 @@
+//===--- ConfigResolver.cpp - Bind cell instances to libraries ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the ConfigResolver class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/ConfigResolver.h"
+#include "vlang/Parse/ConfigTable.h"
+#include "vlang/Parse/DesignUnitTable.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+
+using namespace vlang;
+
+/// \brief Hierarchies deeper than this are assumed to instantiate
+/// themselves.
+static const unsigned MaxDepth = 256;
+
+void ConfigResolver::addLibrary(StringRef Name, const DesignUnitTable &Units) {
+  Library L = { Name, &Units };
+  Libraries.push_back(L);
+}
+
+unsigned ConfigResolver::findLibrary(StringRef Name) const {
+  for (unsigned L = 0, E = Libraries.size(); L != E; ++L)
+    if (Libraries[L].Name == Name)
+      return L;
+  return NoLibrary;
+}
+
+/// Finds \p Cell in the libraries of \p Liblist, or, if it is empty, in the
+/// library \p Parent and then in all of them.
+unsigned ConfigResolver::searchLibraries(ArrayRef<StringRef> Liblist,
+                                         unsigned Parent,
+                                         StringRef Cell) const {
+  if (!Liblist.empty()) {
+    for (unsigned I = 0, E = Liblist.size(); I != E; ++I) {
+      unsigned L = findLibrary(Liblist[I]);
+      if (L != NoLibrary && Libraries[L].Units->isDefined(Cell))
+        return L;
+    }
+    return NoLibrary;
+  }
+  if (Parent != NoLibrary && Libraries[Parent].Units->isDefined(Cell))
+    return Parent;
+  for (unsigned L = 0, E = Libraries.size(); L != E; ++L)
+    if (Libraries[L].Units->isDefined(Cell))
+      return L;
+  return NoLibrary;
+}
+
+static ArrayRef<StringRef> getDefaultLiblist(const Configuration *Config) {
+  ArrayRef<StringRef> Liblist;
+  if (Config)
+    for (unsigned I = 0, E = Config->Rules.size(); I != E; ++I)
+      if (Config->Rules[I].Kind == ConfigRule::RK_Default)
+        Liblist = Config->Rules[I].Liblist;
+  return Liblist;
+}
+
+/// Finds the rule of \p Config for the instance \p RelPath of \p Cell: the
+/// last instance rule naming it, or else the last cell rule naming its
+/// cell.  A cell rule naming a library applies only to the cell of that
+/// library the default search finds.
+const ConfigRule *ConfigResolver::findRule(const Configuration *Config,
+                                           StringRef RelPath, StringRef Cell,
+                                           unsigned Parent) const {
+  if (!Config)
+    return 0;
+  const ConfigRule *CellRule = 0;
+  for (unsigned I = Config->Rules.size(); I != 0; --I) {
+    const ConfigRule &Rule = Config->Rules[I - 1];
+    if (Rule.Kind == ConfigRule::RK_Instance && Rule.InstancePath == RelPath)
+      return &Rule;
+    if (CellRule || Rule.Kind != ConfigRule::RK_Cell ||
+        Rule.Cell.Cell != Cell)
+      continue;
+    if (!Rule.Cell.Library.empty()) {
+      unsigned L = searchLibraries(getDefaultLiblist(Config), Parent, Cell);
+      if (L == NoLibrary || Libraries[L].Name != Rule.Cell.Library)
+        continue;
+    }
+    CellRule = &Rule;
+  }
+  return CellRule;
+}
+
+void ConfigResolver::bindTop(const Configuration *Config, StringRef Library,
+                             StringRef Cell, const std::string &Path,
+                             unsigned Depth) {
+  unsigned L;
+  if (!Library.empty()) {
+    L = findLibrary(Library);
+    if (L != NoLibrary && !Libraries[L].Units->isDefined(Cell))
+      L = NoLibrary;
+  } else {
+    L = searchLibraries(getDefaultLiblist(Config), NoLibrary, Cell);
+  }
+  if (L == NoLibrary) {
+    Unbound U = { Path, Cell };
+    Unresolved.push_back(U);
+    return;
+  }
+  elaborate(Config, Cell, Path, L, Cell, Depth);
+}
+
+void ConfigResolver::bindInstance(const Configuration *Config,
+                                  const std::string &RelPath,
+                                  const std::string &Path, StringRef Cell,
+                                  unsigned Parent, unsigned Depth) {
+  const ConfigRule *Rule = findRule(Config, RelPath, Cell, Parent);
+  ArrayRef<StringRef> Liblist = getDefaultLiblist(Config);
+  if (Rule && !Rule->HasUse)
+    Liblist = Rule->Liblist;
+
+  if (Rule && Rule->HasUse && Rule->UseIsConfig) {
+    // The instance is the design of another configuration, whose rules
+    // name its instances from its own top cell.
+    const Configuration *Nested = Configs.findConfig(Rule->Use.Cell);
+    if (!Nested || Nested->Design.empty()) {
+      Unbound U = { Path, Rule->Use.Cell };
+      Unresolved.push_back(U);
+      return;
+    }
+    const ConfigCell &Top = Nested->Design[0];
+    bindTop(Nested, Top.Library, Top.Cell, Path, Depth);
+    return;
+  }
+
+  StringRef BoundCell = Cell;
+  unsigned L;
+  if (Rule && Rule->HasUse) {
+    if (!Rule->Use.Cell.empty())
+      BoundCell = Rule->Use.Cell;
+    if (!Rule->Use.Library.empty()) {
+      L = findLibrary(Rule->Use.Library);
+      if (L != NoLibrary && !Libraries[L].Units->isDefined(BoundCell))
+        L = NoLibrary;
+    } else {
+      L = searchLibraries(Liblist, Parent, BoundCell);
+    }
+  } else {
+    L = searchLibraries(Liblist, Parent, BoundCell);
+  }
+
+  if (L == NoLibrary) {
+    Unbound U = { Path, BoundCell };
+    Unresolved.push_back(U);
+    return;
+  }
+  elaborate(Config, RelPath, Path, L, BoundCell, Depth);
+}
+
+void ConfigResolver::elaborate(const Configuration *Config,
+                               const std::string &RelPath,
+                               const std::string &Path, unsigned Library,
+                               StringRef Cell, unsigned Depth) {
+  const DesignUnitTable &Units = *Libraries[Library].Units;
+  unsigned D = Units.findDefinition(Cell);
+  Binding B = { Path, Library, Units.getDefinitionName(D) };
+  Bindings.push_back(B);
+  if (Depth == MaxDepth)
+    return;
+
+  ArrayRef<DesignUnitTable::Instance> Instances = Units.getInstances(D);
+  for (unsigned I = 0, E = Instances.size(); I != E; ++I) {
+    // Unnamed instances cannot be named by rules; number them.
+    std::string Name = Instances[I].Name.empty() ? "<" + llvm::utostr(I) + ">"
+                                                 : Instances[I].Name.str();
+    bindInstance(Config, RelPath + "." + Name, Path + "." + Name,
+                 Instances[I].Cell, Library, Depth + 1);
+  }
+}
+
+void ConfigResolver::resolve(const Configuration *Config) {
+  Bindings.clear();
+  Unresolved.clear();
+
+  if (Config) {
+    for (unsigned I = 0, E = Config->Design.size(); I != E; ++I)
+      bindTop(Config, Config->Design[I].Library, Config->Design[I].Cell,
+              Config->Design[I].Cell, 0);
+    return;
+  }
+
+  // Without a configuration, the top cells are those nothing instantiates.
+  llvm::StringSet<> Instantiated;
+  for (unsigned L = 0, E = Libraries.size(); L != E; ++L) {
+    const DesignUnitTable &Units = *Libraries[L].Units;
+    for (unsigned D = 0, DE = Units.getNumDefinitions(); D != DE; ++D) {
+      ArrayRef<DesignUnitTable::Instance> Instances = Units.getInstances(D);
+      for (unsigned I = 0, IE = Instances.size(); I != IE; ++I)
+        Instantiated.insert(Instances[I].Cell);
+    }
+  }
+  llvm::StringSet<> Tops;
+  for (unsigned L = 0, E = Libraries.size(); L != E; ++L) {
+    const DesignUnitTable &Units = *Libraries[L].Units;
+    for (unsigned D = 0, DE = Units.getNumDefinitions(); D != DE; ++D) {
+      StringRef Name = Units.getDefinitionName(D);
+      if (!Instantiated.count(Name) && Tops.insert(Name))
+        elaborate(0, Name, Name, L, Name, 0);
+    }
+  }
+}
@@ -0,0 +1,225 @@
+//===--- DependencyFile.cpp - Generate dependency file --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This code generates dependency files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/Utils.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Frontend/DependencyOutputOptions.h"
+#include "vlang/Frontend/FrontendDiagnostic.h"
+#include "vlang/Lex/PPCallbacks.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+using namespace vlang;
+
+namespace {
+class DependencyFileCallback : public PPCallbacks {
+  std::vector<std::string> Files;
+  llvm::StringSet<> FilesSet;
+  const Preprocessor *PP;
+  std::vector<std::string> Targets;
+  raw_ostream *OS;
+  bool OwnsOS;
+  bool IncludeSystemHeaders;
+  bool PhonyTarget;
+  bool AddMissingHeaderDeps;
+
+  void AddFilename(StringRef Filename);
+  void OutputDependencyFile();
+
+public:
+  DependencyFileCallback(const Preprocessor *PP, raw_ostream *OS, bool OwnsOS,
+                         const DependencyOutputOptions &Opts)
+    : PP(PP), Targets(Opts.Targets), OS(OS), OwnsOS(OwnsOS),
+      IncludeSystemHeaders(Opts.IncludeSystemHeaders),
+      PhonyTarget(Opts.UsePhonyTargets),
+      AddMissingHeaderDeps(Opts.AddMissingHeaderDeps) {}
+
+  ~DependencyFileCallback() {
+    if (OwnsOS)
+      delete OS;
+  }
+
+  virtual void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                           SrcMgr::CharacteristicKind FileType,
+                           FileID PrevFID);
+  virtual void InclusionDirective(SourceLocation HashLoc,
+                                  const Token &IncludeTok,
+                                  StringRef FileName,
+                                  bool IsAngled,
+                                  CharSourceRange FilenameRange,
+                                  const FileEntry *File,
+                                  StringRef SearchPath,
+                                  StringRef RelativePath);
+
+  virtual void EndOfMainFile() {
+    OutputDependencyFile();
+  }
+};
+}
+
+void vlang::AttachDependencyFileGen(Preprocessor &PP,
+                                    const DependencyOutputOptions &Opts) {
+  assert(!Opts.Targets.empty() && "dependencies need a target");
+
+  std::string Err;
+  raw_ostream *OS = new llvm::raw_fd_ostream(Opts.OutputFile.c_str(), Err);
+  if (!Err.empty()) {
+    PP.getDiagnostics().Report(diag::err_fe_error_opening)
+      << Opts.OutputFile << Err;
+    delete OS;
+    return;
+  }
+
+  PP.addPPCallbacks(new DependencyFileCallback(&PP, OS, /*OwnsOS=*/true,
+                                               Opts));
+}
+
+void vlang::AttachDependencyPrinter(Preprocessor &PP,
+                                    const DependencyOutputOptions &Opts,
+                                    raw_ostream &OS) {
+  assert(!Opts.Targets.empty() && "dependencies need a target");
+  PP.addPPCallbacks(new DependencyFileCallback(&PP, &OS, /*OwnsOS=*/false,
+                                               Opts));
+}
+
+/// FileMatchesDepCriteria - Determine whether the given Filename should be
+/// considered as a dependency.
+static bool FileMatchesDepCriteria(const char *Filename,
+                                   SrcMgr::CharacteristicKind FileType,
+                                   bool IncludeSystemHeaders) {
+  if (strcmp("<built-in>", Filename) == 0)
+    return false;
+
+  if (IncludeSystemHeaders)
+    return true;
+
+  return FileType == SrcMgr::C_User;
+}
+
+void DependencyFileCallback::FileChanged(SourceLocation Loc,
+                                         FileChangeReason Reason,
+                                         SrcMgr::CharacteristicKind FileType,
+                                         FileID PrevFID) {
+  if (Reason != PPCallbacks::EnterFile)
+    return;
+
+  // Dependency generation really does want to go all the way to the
+  // file entry for a source location to find out what is depended on.
+  // We do not want `line directives to affect dependency generation!
+  SourceManager &SM = PP->getSourceManager();
+
+  const FileEntry *FE =
+    SM.getFileEntryForID(SM.getFileID(SM.getExpansionLoc(Loc)));
+  if (FE == 0) return;
+
+  StringRef Filename = FE->getName();
+  if (!FileMatchesDepCriteria(Filename.data(), FileType, IncludeSystemHeaders))
+    return;
+
+  // Remove leading "./" (or ".//" or "././" etc.)
+  while (Filename.size() > 2 && Filename[0] == '.' && Filename[1] == '/') {
+    Filename = Filename.substr(1);
+    while (Filename.size() > 1 && Filename[0] == '/')
+      Filename = Filename.substr(1);
+  }
+
+  AddFilename(Filename);
+}
+
+void DependencyFileCallback::InclusionDirective(SourceLocation HashLoc,
+                                                const Token &IncludeTok,
+                                                StringRef FileName,
+                                                bool IsAngled,
+                                                CharSourceRange FilenameRange,
+                                                const FileEntry *File,
+                                                StringRef SearchPath,
+                                                StringRef RelativePath) {
+  if (!File && AddMissingHeaderDeps)
+    AddFilename(FileName);
+}
+
+void DependencyFileCallback::AddFilename(StringRef Filename) {
+  if (FilesSet.insert(Filename))
+    Files.push_back(Filename);
+}
+
+/// PrintFilename - GCC escapes spaces, but apparently not ' or " or other
+/// scary characters.
+static void PrintFilename(raw_ostream &OS, StringRef Filename) {
+  for (unsigned i = 0, e = Filename.size(); i != e; ++i) {
+    if (Filename[i] == ' ')
+      OS << '\\';
+    OS << Filename[i];
+  }
+}
+
+void DependencyFileCallback::OutputDependencyFile() {
+  // Write out the dependency targets, trying to avoid overly long
+  // lines when possible. We try our best to emit exactly the same
+  // dependency file as GCC (4.2), assuming the included files are the
+  // same.
+  const unsigned MaxColumns = 75;
+  unsigned Columns = 0;
+
+  for (std::vector<std::string>::iterator
+         I = Targets.begin(), E = Targets.end(); I != E; ++I) {
+    unsigned N = I->length();
+    if (Columns == 0) {
+      Columns += N;
+    } else if (Columns + N + 2 > MaxColumns) {
+      Columns = N + 2;
+      *OS << " \\\n  ";
+    } else {
+      Columns += N + 1;
+      *OS << ' ';
+    }
+    // Targets already quoted as needed.
+    *OS << *I;
+  }
+
+  *OS << ':';
+  Columns += 1;
+
+  // Now add each dependency in the order it was seen, but avoiding
+  // duplicates.
+  for (std::vector<std::string>::iterator I = Files.begin(),
+         E = Files.end(); I != E; ++I) {
+    // Start a new line if this would exceed the column limit. Make
+    // sure to leave space for a trailing " \" in case we need to
+    // break the line on the next iteration.
+    unsigned N = I->length();
+    if (Columns + (N + 1) + 2 > MaxColumns) {
+      *OS << " \\\n ";
+      Columns = 2;
+    }
+    *OS << ' ';
+    PrintFilename(*OS, *I);
+    Columns += N + 1;
+  }
+  *OS << '\n';
+
+  // Create phony targets if requested.
+  if (PhonyTarget && !Files.empty()) {
+    // Skip the first entry, this is always the input file itself.
+    for (std::vector<std::string>::iterator I = Files.begin() + 1,
+           E = Files.end(); I != E; ++I) {
+      *OS << '\n';
+      PrintFilename(*OS, *I);
+      *OS << ":\n";
+    }
+  }
+  OS->flush();
+}
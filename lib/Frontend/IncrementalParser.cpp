@@ -0,0 +1,694 @@
+//===--- IncrementalParser.cpp - Reparse edited design elements -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the IncrementalParser class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/IncrementalParser.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/FrozenIdentifierTable.h"
+#include "vlang/Basic/LangOptions.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Diag/DiagnosticOptions.h"
+#include "vlang/Frontend/Utils.h"
+#include "vlang/Lex/HeaderSearch.h"
+#include "vlang/Lex/HeaderSearchOptions.h"
+#include "vlang/Lex/Lexer.h"
+#include "vlang/Lex/PPCallbacks.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/PreprocessorOptions.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "vlang/Parse/Parser.h"
+#include "vlang/Sema/Sema.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <algorithm>
+
+using namespace vlang;
+
+/// \brief Base offset of buffers that are not part of the document.
+static const unsigned NotInDocument = ~0U;
+
+/// \brief Parse from scratch once reparsed regions have used this much of
+/// the source location address space.
+static const unsigned MaxIncrementalSLocOffset = 1U << 30;
+
+//===----------------------------------------------------------------------===//
+// Compiler state
+//===----------------------------------------------------------------------===//
+
+/// \brief Records the diagnostics of the document.
+class IncrementalParser::DiagConsumer : public DiagnosticConsumer {
+  IncrementalParser &IP;
+
+public:
+  explicit DiagConsumer(IncrementalParser &IP) : IP(IP) {}
+
+  virtual void HandleDiagnostic(DiagnosticsEngine::Level Level,
+                                const Diagnostic &Info) {
+    DiagnosticConsumer::HandleDiagnostic(Level, Info);
+    IP.handleDiagnostic(Level, Info);
+  }
+};
+
+/// \brief Records where macros are defined and expanded.
+class IncrementalParser::MacroRecorder : public PPCallbacks {
+  IncrementalParser &IP;
+
+public:
+  explicit MacroRecorder(IncrementalParser &IP) : IP(IP) {}
+
+  virtual void MacroExpands(const Token &MacroNameTok,
+                            const MacroDirective *MD, SourceRange Range,
+                            const MacroArgs *Args) {
+    IP.recordMacroUse(MacroNameTok);
+  }
+
+  virtual void MacroDefined(const Token &MacroNameTok,
+                            const MacroDirective *MD) {
+    IP.recordMacroSite(MacroNameTok, true);
+  }
+
+  virtual void MacroUndefined(const Token &MacroNameTok,
+                              const MacroDirective *MD) {
+    IP.recordMacroSite(MacroNameTok, false);
+  }
+};
+
+/// \brief The compiler objects of one full parse.  The preprocessor runs
+/// in incremental mode, so that regions can be entered into it after the
+/// main file has ended.
+class IncrementalParser::Session {
+public:
+  IntrusiveRefCntPtr<FileManager> FileMgr;
+  DiagnosticsEngine Diags;
+  SourceManager SourceMgr;
+  LangOptions LangOpts;
+  HeaderSearch HeaderInfo;
+  Preprocessor PP;
+  Sema Actions;
+
+  explicit Session(IncrementalParser &IP)
+    : FileMgr(IP.FileMgr),
+      Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs()),
+            new DiagnosticOptions(), new DiagConsumer(IP)),
+      SourceMgr(Diags, *FileMgr),
+      HeaderInfo(IP.HSOpts, *FileMgr, Diags, LangOpts),
+      PP(IP.PPOpts, Diags, LangOpts, SourceMgr, HeaderInfo, 0,
+         /*OwnsHeaderSearch=*/false, /*DelayInitialization=*/false,
+         /*IncrProcessing=*/true),
+      Actions(PP, TU_Complete, 0) {
+    if (IP.IdentifierBase)
+      PP.getIdentifierTable().setFrozenBase(IP.IdentifierBase);
+    PP.addPPCallbacks(new MacroRecorder(IP));
+    InitializePreprocessor(PP, *IP.PPOpts, *IP.HSOpts);
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// Directive scanning
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// \brief What a textual scan of some source found after backticks.  This
+/// sees directives in comments and strings too, which only makes the
+/// callers more conservative.
+struct DirectiveScan {
+  /// \brief Macros used.
+  llvm::StringSet<> Uses;
+
+  /// \brief Macros tested by `ifdef, `ifndef or `elsif.
+  llvm::StringSet<> Tests;
+
+  /// \brief Whether a directive changes which text is lexed: a
+  /// conditional or `undefineall.
+  bool HasConditional;
+  bool HasInclude;
+
+  DirectiveScan() : HasConditional(false), HasInclude(false) {}
+
+  void scan(StringRef Text);
+};
+}
+
+static bool isIdentifierBody(char C) {
+  return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') ||
+         (C >= '0' && C <= '9') || C == '_' || C == '$';
+}
+
+/// \brief Read the identifier at \p Pos, after skipping blanks if
+/// \p SkipBlanks, and advance \p Pos past it.
+static StringRef readIdentifier(StringRef Text, size_t &Pos,
+                                bool SkipBlanks) {
+  if (SkipBlanks)
+    while (Pos < Text.size() && (Text[Pos] == ' ' || Text[Pos] == '\t'))
+      ++Pos;
+  size_t Start = Pos;
+  while (Pos < Text.size() && isIdentifierBody(Text[Pos]))
+    ++Pos;
+  return Text.slice(Start, Pos);
+}
+
+void DirectiveScan::scan(StringRef Text) {
+  size_t Pos = 0;
+  while ((Pos = Text.find('`', Pos)) != StringRef::npos) {
+    ++Pos;
+    StringRef Directive = readIdentifier(Text, Pos, false);
+    if (Directive.empty())
+      continue;   // `" or `` in a macro body.
+
+    if (Directive == "ifdef" || Directive == "ifndef" ||
+        Directive == "elsif") {
+      HasConditional = true;
+      StringRef Macro = readIdentifier(Text, Pos, true);
+      if (!Macro.empty())
+        Tests.insert(Macro);
+    } else if (Directive == "else" || Directive == "endif" ||
+               Directive == "undefineall") {
+      HasConditional = true;
+    } else if (Directive == "include") {
+      HasInclude = true;
+    } else if (Directive == "define" || Directive == "undef") {
+      // The defined name is not a use; the preprocessor reports the site.
+      readIdentifier(Text, Pos, true);
+    } else if (Directive != "timescale" && Directive != "celldefine" &&
+               Directive != "endcelldefine" &&
+               Directive != "default_nettype" && Directive != "resetall" &&
+               Directive != "line" && Directive != "pragma" &&
+               Directive != "begin_keywords" && Directive != "end_keywords" &&
+               Directive != "unconnected_drive" &&
+               Directive != "nounconnected_drive") {
+      Uses.insert(Directive);
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// IncrementalParser
+//===----------------------------------------------------------------------===//
+
+IncrementalParser::IncrementalParser(
+    IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts,
+    IntrusiveRefCntPtr<PreprocessorOptions> PPOpts)
+  : HSOpts(HSOpts), PPOpts(PPOpts),
+    FileMgr(new FileManager(FileSystemOptions())), IdentifierBase(0),
+    CurBase(0), LostDiagnostic(false) {}
+
+IncrementalParser::~IncrementalParser() {}
+
+void IncrementalParser::setFileManager(FileManager *FM) {
+  FileMgr = FM;
+}
+
+bool IncrementalParser::getDocumentOffset(SourceLocation Loc,
+                                          unsigned &Offset) const {
+  if (Loc.isInvalid() || CurFID.isInvalid())
+    return false;
+  const SourceManager &SM = S->SourceMgr;
+  Loc = SM.getExpansionLoc(Loc);
+  while (true) {
+    std::pair<FileID, unsigned> Decomposed = SM.getDecomposedLoc(Loc);
+    if (Decomposed.first == CurFID) {
+      Offset = CurBase + Decomposed.second;
+      return true;
+    }
+    Loc = SM.getIncludeLoc(Decomposed.first);
+    if (Loc.isInvalid())
+      return false;
+  }
+}
+
+void IncrementalParser::handleDiagnostic(DiagnosticsEngine::Level Level,
+                                         const Diagnostic &Info) {
+  if (Level == DiagnosticsEngine::Ignored || !S)
+    return;
+  if (CurFID.isInvalid())
+    return;   // Undoing definitions.
+
+  DocumentDiagnostic D;
+  D.Level = Level;
+  D.HasOffset = getDocumentOffset(Info.getLocation(), D.Offset);
+  if (!D.HasOffset) {
+    D.Offset = 0;
+    if (Info.getLocation().isValid())
+      LostDiagnostic = true;
+  }
+  SmallString<100> Message;
+  Info.FormatDiagnostic(Message);
+  D.Message = Message.str().str();
+  Diagnostics.push_back(D);
+}
+
+void IncrementalParser::recordMacroSite(const Token &MacroNameTok,
+                                        bool IsDefinition) {
+  unsigned Offset;
+  IdentifierInfo *II = MacroNameTok.getIdentifierInfo();
+  if (II && getDocumentOffset(MacroNameTok.getLocation(), Offset))
+    MacroSites[II->getName()].push_back(MacroSite(Offset, IsDefinition));
+}
+
+void IncrementalParser::recordMacroUse(const Token &MacroNameTok) {
+  unsigned Offset;
+  IdentifierInfo *II = MacroNameTok.getIdentifierInfo();
+  if (II && getDocumentOffset(MacroNameTok.getLocation(), Offset))
+    PendingUses.push_back(std::make_pair(Offset, II->getName().str()));
+}
+
+namespace {
+struct DiagnosticOffsetLess {
+  bool operator()(const DocumentDiagnostic &LHS,
+                  const DocumentDiagnostic &RHS) const {
+    if (LHS.HasOffset != RHS.HasOffset)
+      return !LHS.HasOffset;
+    return LHS.Offset < RHS.Offset;
+  }
+};
+}
+
+void IncrementalParser::fullReparse() {
+  Elements.clear();
+  Diagnostics.clear();
+  MacroSites.clear();
+  PendingUses.clear();
+  CurFID = FileID();
+  S.reset();
+  S.reset(new Session(*this));
+
+  CurFID = S->SourceMgr.createMainFileIDForMemBuffer(
+    llvm::MemoryBuffer::getMemBufferCopy(Text, Name));
+  CurBase = 0;
+  S->PP.EnterMainSourceFile();
+  TokenBuffer Toks;
+  Toks.lexAll(S->PP);
+  parseTokens(Toks, Elements);
+  collectMacroUses(Elements);
+  std::stable_sort(Diagnostics.begin(), Diagnostics.end(),
+                   DiagnosticOffsetLess());
+
+  ++Stats.FullParses;
+  Stats.ElementsReparsed += Elements.size();
+  Stats.BytesRelexed += Text.size();
+}
+
+void IncrementalParser::parse(StringRef NewName, StringRef NewText) {
+  Name = NewName.str();
+  Text = NewText.str();
+  fullReparse();
+}
+
+/// \brief Enter \p Buffer, located at document offset \p Base, after the
+/// end of the main file and lex it.
+void IncrementalParser::lexBuffer(StringRef BufferName, StringRef Buffer,
+                                  unsigned Base, TokenBuffer &Toks) {
+  FileID FID = S->SourceMgr.createFileIDForMemBuffer(
+    llvm::MemoryBuffer::getMemBufferCopy(Buffer, BufferName));
+  CurFID = Base == NotInDocument ? FileID() : FID;
+  CurBase = Base;
+  S->PP.EnterSourceFile(FID, 0, SourceLocation());
+  Toks.lexAll(S->PP);
+  Stats.BytesRelexed += Buffer.size();
+}
+
+/// \brief The keyword that must end an element introduced by \p Keyword.
+static tok::TokenKind getEndKeyword(tok::TokenKind Keyword) {
+  switch (Keyword) {
+  case tok::kw_module:
+  case tok::kw_macromodule: return tok::kw_endmodule;
+  case tok::kw_primitive:   return tok::kw_endprimitive;
+  case tok::kw_interface:   return tok::kw_endinterface;
+  case tok::kw_program:     return tok::kw_endprogram;
+  case tok::kw_package:     return tok::kw_endpackage;
+  case tok::kw_class:       return tok::kw_endclass;
+  case tok::kw_config:      return tok::kw_endconfig;
+  case tok::kw_checker:     return tok::kw_endchecker;
+  case tok::kw_function:    return tok::kw_endfunction;
+  case tok::kw_task:        return tok::kw_endtask;
+  default:                  return tok::semi;
+  }
+}
+
+/// \brief Parse \p Toks into design elements.
+///
+/// \returns true if the last element ends the way its keyword requires,
+/// i.e. the parser did not run out of tokens in the middle of it.
+bool IncrementalParser::parseTokens(const TokenBuffer &Toks,
+                                    std::vector<DesignElement> &Out) {
+  Parser P(S->PP, S->Actions, false);
+  P.setTokenBuffer(&Toks);
+  P.Initialize();
+  unsigned NumElements = Out.size();
+  unsigned First = P.getTokenBufferIndex(), Last = 0;
+  while (!P.ParseTopLevelDecl()) {
+    unsigned Next = P.getTokenBufferIndex();
+    if (Next > First) {
+      Last = Next - 1;
+      addElement(Toks, First, Last, Out);
+    }
+    First = Next;
+  }
+  if (Out.size() == NumElements)
+    return true;
+
+  tok::TokenKind End = getEndKeyword(Out.back().Keyword);
+  if (Toks.getKind(Last) == End)
+    return true;
+  // endmodule : name
+  return Last >= 2 && Toks.getKind(Last) == tok::identifier &&
+         Toks.getKind(Last - 1) == tok::colon &&
+         Toks.getKind(Last - 2) == End;
+}
+
+void IncrementalParser::addElement(const TokenBuffer &Toks, unsigned First,
+                                   unsigned Last,
+                                   std::vector<DesignElement> &Out) {
+  SourceManager &SM = S->SourceMgr;
+  DesignElement E;
+  if (!getDocumentOffset(Toks.getLocation(First), E.Begin))
+    return;
+
+  SourceLocation EndLoc = Toks.getLocation(Last);
+  if (EndLoc.isMacroID())
+    EndLoc = SM.getExpansionRange(EndLoc).second;
+  if (!getDocumentOffset(EndLoc, E.End)) {
+    E.End = E.Begin;
+  } else if (SM.getFileID(EndLoc) == CurFID) {
+    E.End += Lexer::MeasureTokenLength(EndLoc, SM, S->LangOpts);
+  } else {
+    // The element ends in an included file: take the rest of the line.
+    while (E.End < Text.size() && Text[E.End] != '\n')
+      ++E.End;
+  }
+  E.End = std::min(std::max(E.End, E.Begin + 1), (unsigned)Text.size());
+
+  unsigned I = First;
+  while (I < Last && (Toks.getKind(I) == tok::kw_virtual ||
+                      Toks.getKind(I) == tok::kw_extern))
+    ++I;
+  E.Keyword = Toks.getKind(I);
+  for (unsigned J = I + 1; J <= Last && J <= I + 3; ++J)
+    if (Toks.getKind(J) == tok::identifier) {
+      if (IdentifierInfo *II = Toks.getIdentifierInfo(J))
+        E.Name = II->getName().str();
+      break;
+    }
+  E.NumTokens = Last - First + 1;
+  Out.push_back(E);
+}
+
+namespace {
+struct ElementBeginLess {
+  bool operator()(unsigned Offset, const DesignElement &E) const {
+    return Offset < E.Begin;
+  }
+};
+}
+
+/// \brief Give \p Elts the macros they name in their text and those
+/// expanded in them since the last call.
+void IncrementalParser::collectMacroUses(std::vector<DesignElement> &Elts) {
+  for (unsigned i = 0, e = PendingUses.size(); i != e; ++i) {
+    unsigned Offset = PendingUses[i].first;
+    std::vector<DesignElement>::iterator It =
+      std::upper_bound(Elts.begin(), Elts.end(), Offset, ElementBeginLess());
+    if (It != Elts.begin() && Offset < (It - 1)->End)
+      (It - 1)->MacroUses.push_back(PendingUses[i].second);
+  }
+  PendingUses.clear();
+
+  for (unsigned i = 0, e = Elts.size(); i != e; ++i) {
+    DesignElement &E = Elts[i];
+    DirectiveScan Scan;
+    Scan.scan(StringRef(Text).slice(E.Begin, E.End));
+    for (llvm::StringSet<>::iterator I = Scan.Uses.begin(),
+           IE = Scan.Uses.end(); I != IE; ++I)
+      E.MacroUses.push_back(I->getKey().str());
+    std::sort(E.MacroUses.begin(), E.MacroUses.end());
+    E.MacroUses.erase(std::unique(E.MacroUses.begin(), E.MacroUses.end()),
+                      E.MacroUses.end());
+  }
+}
+
+/// \brief Lex and parse the text in [Begin, End) of the document.
+///
+/// \returns false if the result may differ from a full parse.
+bool IncrementalParser::reparseRegion(unsigned Begin, unsigned End,
+                                      std::vector<DesignElement> &Out) {
+  LostDiagnostic = false;
+  TokenBuffer Toks;
+  lexBuffer(Name, StringRef(Text).slice(Begin, End), Begin, Toks);
+  bool Complete = parseTokens(Toks, Out);
+  collectMacroUses(Out);
+  return Complete && !LostDiagnostic;
+}
+
+/// \brief Whether the document defines or undefines \p Macro at or after
+/// \p Offset.
+bool IncrementalParser::hasLaterSite(StringRef Macro, unsigned Offset) const {
+  llvm::StringMap<std::vector<MacroSite> >::const_iterator It =
+    MacroSites.find(Macro);
+  if (It == MacroSites.end())
+    return false;
+  for (unsigned i = 0, e = It->second.size(); i != e; ++i)
+    if (It->second[i].Offset >= Offset)
+      return true;
+  return false;
+}
+
+/// \brief Shift \p Offset, which is outside [RegionBegin, RegionEnd), by
+/// an edit of \p Delta bytes within that region.
+static unsigned shiftOffset(unsigned Offset, unsigned RegionEnd, int Delta) {
+  return Offset >= RegionEnd ? Offset + Delta : Offset;
+}
+
+bool IncrementalParser::tryIncrementalEdit(unsigned Offset, unsigned Length,
+                                           StringRef NewText) {
+  // The elements [I, J) touch the edit.  Reparse just them if the edit is
+  // inside them, or everything between their unaffected neighbours if it
+  // also changes the text between elements.
+  unsigned EditEnd = Offset + Length, N = Elements.size();
+  unsigned I = 0;
+  while (I != N && Elements[I].End < Offset)
+    ++I;
+  unsigned J = I;
+  while (J != N && Elements[J].Begin <= EditEnd)
+    ++J;
+  unsigned RegionBegin, RegionEnd;
+  if (I != J && Elements[I].Begin <= Offset &&
+      EditEnd <= Elements[J - 1].End) {
+    RegionBegin = Elements[I].Begin;
+    RegionEnd = Elements[J - 1].End;
+  } else {
+    RegionBegin = I ? Elements[I - 1].End : 0;
+    RegionEnd = J != N ? Elements[J].Begin : Text.size();
+  }
+
+  unsigned OldSize = Text.size();
+  std::string OldRegion = Text.substr(RegionBegin, RegionEnd - RegionBegin);
+  Text.replace(Offset, Length, NewText.data(), NewText.size());
+  int Delta = (int)NewText.size() - (int)Length;
+  unsigned NewRegionEnd = RegionEnd + Delta;
+
+  DirectiveScan OldScan, NewScan;
+  OldScan.scan(OldRegion);
+  NewScan.scan(StringRef(Text).slice(RegionBegin, NewRegionEnd));
+  if (OldScan.HasConditional || OldScan.HasInclude ||
+      NewScan.HasConditional || NewScan.HasInclude)
+    return false;
+  if (S->SourceMgr.getNextLocalOffset() > MaxIncrementalSLocOffset)
+    return false;
+
+  // The macros the region defines must not be defined anywhere else: then
+  // their state before the region is "undefined", and undoing them puts the
+  // preprocessor in the state the region starts in.
+  llvm::StringSet<> Changed;
+  for (llvm::StringMap<std::vector<MacroSite> >::iterator
+         It = MacroSites.begin(), E = MacroSites.end(); It != E; ++It) {
+    std::vector<MacroSite> &Sites = It->second;
+    bool InRegion = false, Outside = false;
+    for (unsigned i = 0, e = Sites.size(); i != e; ++i) {
+      if (Sites[i].Offset >= RegionBegin && Sites[i].Offset < RegionEnd)
+        InRegion = true;
+      else
+        Outside = true;
+    }
+    if (!InRegion)
+      continue;
+    if (Outside)
+      return false;
+    Changed.insert(It->getKey());
+  }
+
+  // Forget what the old region produced and move everything after it.
+  for (llvm::StringMap<std::vector<MacroSite> >::iterator
+         It = MacroSites.begin(), E = MacroSites.end(); It != E; ++It) {
+    std::vector<MacroSite> &Sites = It->second;
+    unsigned Kept = 0;
+    for (unsigned i = 0, e = Sites.size(); i != e; ++i) {
+      if (Sites[i].Offset >= RegionBegin && Sites[i].Offset < RegionEnd)
+        continue;
+      Sites[Kept] = Sites[i];
+      Sites[Kept++].Offset = shiftOffset(Sites[i].Offset, RegionEnd, Delta);
+    }
+    Sites.erase(Sites.begin() + Kept, Sites.end());
+  }
+  unsigned Kept = 0;
+  for (unsigned i = 0, e = Diagnostics.size(); i != e; ++i) {
+    DocumentDiagnostic &D = Diagnostics[i];
+    if (D.HasOffset && D.Offset >= RegionBegin &&
+        (D.Offset < RegionEnd || RegionEnd == OldSize))
+      continue;
+    if (D.HasOffset)
+      D.Offset = shiftOffset(D.Offset, RegionEnd, Delta);
+    Diagnostics[Kept++] = D;
+  }
+  Diagnostics.resize(Kept);
+  for (unsigned k = J; k != N; ++k) {
+    Elements[k].Begin += Delta;
+    Elements[k].End += Delta;
+  }
+
+  if (!Changed.empty()) {
+    std::string Undefs;
+    for (llvm::StringSet<>::iterator It = Changed.begin(), E = Changed.end();
+         It != E; ++It)
+      Undefs += "`undef " + It->getKey().str() + "\n";
+    TokenBuffer Ignored;
+    lexBuffer("<undo>", Undefs, NotInDocument, Ignored);
+  }
+
+  std::vector<DesignElement> NewElements;
+  if (!reparseRegion(RegionBegin, NewRegionEnd, NewElements))
+    return false;
+
+  // The macros the new region defines must not be defined anywhere else
+  // either, and the macros it uses must not change after it starts.
+  for (llvm::StringMap<std::vector<MacroSite> >::iterator
+         It = MacroSites.begin(), E = MacroSites.end(); It != E; ++It) {
+    std::vector<MacroSite> &Sites = It->second;
+    bool InRegion = false, Outside = false;
+    for (unsigned i = 0, e = Sites.size(); i != e; ++i) {
+      if (Sites[i].Offset >= RegionBegin && Sites[i].Offset < NewRegionEnd)
+        InRegion = true;
+      else
+        Outside = true;
+    }
+    if (InRegion && Outside)
+      return false;
+    if (InRegion)
+      Changed.insert(It->getKey());
+    std::sort(Sites.begin(), Sites.end());
+  }
+  for (llvm::StringSet<>::iterator It = NewScan.Uses.begin(),
+         E = NewScan.Uses.end(); It != E; ++It)
+    if (!Changed.count(It->getKey()) &&
+        hasLaterSite(It->getKey(), RegionBegin))
+      return false;
+  for (unsigned i = 0, e = NewElements.size(); i != e; ++i)
+    for (unsigned u = 0, ue = NewElements[i].MacroUses.size(); u != ue; ++u)
+      if (!Changed.count(NewElements[i].MacroUses[u]) &&
+          hasLaterSite(NewElements[i].MacroUses[u], RegionBegin))
+        return false;
+
+  // Reparse the later elements that use a changed macro.
+  unsigned NumReparsed = NewElements.size();
+  if (!Changed.empty()) {
+    DirectiveScan Rest;
+    Rest.scan(StringRef(Text).substr(NewRegionEnd));
+    if (Rest.HasInclude)
+      return false;
+    for (llvm::StringSet<>::iterator It = Changed.begin(), E = Changed.end();
+         It != E; ++It)
+      if (Rest.Tests.count(It->getKey()))
+        return false;
+
+    for (unsigned k = J; k != N; ++k) {
+      DesignElement &Elt = Elements[k];
+      bool UsesChanged = false;
+      for (unsigned u = 0, ue = Elt.MacroUses.size(); u != ue; ++u)
+        if (Changed.count(Elt.MacroUses[u]))
+          UsesChanged = true;
+      if (!UsesChanged)
+        continue;
+      for (unsigned u = 0, ue = Elt.MacroUses.size(); u != ue; ++u)
+        if (!Changed.count(Elt.MacroUses[u]) &&
+            hasLaterSite(Elt.MacroUses[u], Elt.Begin))
+          return false;
+      // Reparsing would record the element's own definitions again.
+      for (llvm::StringMap<std::vector<MacroSite> >::iterator
+             It = MacroSites.begin(), E = MacroSites.end(); It != E; ++It)
+        for (unsigned i = 0, e = It->second.size(); i != e; ++i)
+          if (It->second[i].Offset >= Elt.Begin &&
+              It->second[i].Offset < Elt.End)
+            return false;
+
+      Kept = 0;
+      for (unsigned i = 0, e = Diagnostics.size(); i != e; ++i) {
+        DocumentDiagnostic &D = Diagnostics[i];
+        if (!D.HasOffset || D.Offset < Elt.Begin || D.Offset >= Elt.End)
+          Diagnostics[Kept++] = D;
+      }
+      Diagnostics.resize(Kept);
+
+      std::vector<DesignElement> Replacement;
+      if (!reparseRegion(Elt.Begin, Elt.End, Replacement) ||
+          Replacement.size() != 1)
+        return false;
+      Elt = Replacement[0];
+      ++NumReparsed;
+    }
+  }
+
+  Elements.erase(Elements.begin() + I, Elements.begin() + J);
+  Elements.insert(Elements.begin() + I, NewElements.begin(),
+                  NewElements.end());
+  std::stable_sort(Diagnostics.begin(), Diagnostics.end(),
+                   DiagnosticOffsetLess());
+
+  ++Stats.IncrementalParses;
+  Stats.ElementsReparsed += NumReparsed;
+  return true;
+}
+
+bool IncrementalParser::applyEdit(unsigned Offset, unsigned Length,
+                                  StringRef NewText) {
+  assert(Offset + Length <= Text.size() && "Edit out of range");
+  if (S && tryIncrementalEdit(Offset, Length, NewText))
+    return true;
+  if (!S)
+    Text.replace(Offset, Length, NewText.data(), NewText.size());
+  fullReparse();
+  return false;
+}
+
+const DesignElement *IncrementalParser::findElement(unsigned Offset) const {
+  std::vector<DesignElement>::const_iterator It =
+    std::upper_bound(Elements.begin(), Elements.end(), Offset,
+                     ElementBeginLess());
+  if (It == Elements.begin() || Offset >= (It - 1)->End)
+    return 0;
+  return &*(It - 1);
+}
+
+bool IncrementalParser::findMacroDefinition(StringRef Macro, unsigned Offset,
+                                            unsigned &DefOffset) const {
+  llvm::StringMap<std::vector<MacroSite> >::const_iterator It =
+    MacroSites.find(Macro);
+  if (It == MacroSites.end())
+    return false;
+  const MacroSite *Found = 0;
+  for (unsigned i = 0, e = It->second.size(); i != e; ++i)
+    if (It->second[i].Offset < Offset)
+      Found = &It->second[i];
+  if (!Found || !Found->IsDefinition)
+    return false;
+  DefOffset = Found->Offset;
+  return true;
+}
@@ -0,0 +1,151 @@
+//===--- InputUnit.cpp - The front end objects of one input ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the InputUnit class and the functions that
+//  preprocess and parse one input with it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/InputUnit.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/FrozenIdentifierTable.h"
+#include "vlang/Diag/Diagnostic.h"
+#include "vlang/Frontend/DependencyOutputOptions.h"
+#include "vlang/Frontend/PreprocessorOutputOptions.h"
+#include "vlang/Frontend/Utils.h"
+#include "vlang/Lex/HeaderSearch.h"
+#include "vlang/Lex/PreprocessorOptions.h"
+#include "vlang/Parse/Parser.h"
+#include "vlang/Sema/Sema.h"
+#include "vlang/Serialization/ParseCache.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace vlang;
+
+InputUnit::InputUnit(DiagnosticsEngine &Diags, FileManager &FileMgr,
+                     LangOptions &LangOpts, HeaderSearch &HeaderInfo,
+                     ArrayRef<std::string> Defines,
+                     const FrozenIdentifierTable *IdentifierBase)
+  : InSourceFile(false), SourceMgr(Diags, FileMgr),
+    PPOpts(new PreprocessorOptions()),
+    PP(PPOpts, Diags, LangOpts, SourceMgr, HeaderInfo, 0, false, false) {
+  // What earlier units knew of the files is kept, but not which macros
+  // guarded them, since those belonged to their preprocessors.
+  HeaderInfo.ClearFileInfo();
+  for (unsigned i = 0, e = Defines.size(); i != e; ++i)
+    PPOpts->addMacroDef(Defines[i]);
+  if (IdentifierBase)
+    PP.getIdentifierTable().setFrozenBase(IdentifierBase);
+  NumInitialIdentifiers = PP.getIdentifierTable().size();
+  InitializePreprocessor(PP, *PPOpts, HeaderInfo.getHeaderSearchOpts());
+}
+
+InputUnit::~InputUnit() {
+  if (InSourceFile)
+    if (DiagnosticConsumer *Client = PP.getDiagnostics().getClient())
+      Client->EndSourceFile();
+}
+
+bool InputUnit::createMainFile(const std::string &File, StringRef Source,
+                               bool AsFileEntry, std::string &ErrorStr) {
+  FileManager &FileMgr = SourceMgr.getFileManager();
+  if (!Source.empty()) {
+    SourceMgr.createMainFileIDForMemBuffer(
+      llvm::MemoryBuffer::getMemBufferCopy(Source, File));
+  } else if (AsFileEntry) {
+    const FileEntry *MainFile = FileMgr.getFile(File);
+    if (!MainFile) {
+      ErrorStr = "cannot open '" + File + "'";
+      return true;
+    }
+    SourceMgr.createMainFileID(MainFile);
+  } else {
+    llvm::MemoryBuffer *Buffer =
+      FileMgr.getBufferForFile(File.c_str(), &ErrorStr);
+    if (!Buffer)
+      return true;
+    SourceMgr.createMainFileIDForMemBuffer(Buffer);
+  }
+  return false;
+}
+
+void InputUnit::beginSourceFile() {
+  if (InSourceFile)
+    return;
+  if (DiagnosticConsumer *Client = PP.getDiagnostics().getClient())
+    Client->BeginSourceFile(PP.getLangOpts(), &PP);
+  InSourceFile = true;
+}
+
+void InputUnit::enterMainFile(StringRef Macros) {
+  if (!Macros.empty())
+    PP.setPredefines(PP.getPredefines() + Macros.str());
+  beginSourceFile();
+  PP.EnterMainSourceFile();
+}
+
+void vlang::preprocessInput(InputUnit &Unit, StringRef File,
+                            bool PrintDependencies, raw_ostream &OS) {
+  Preprocessor &PP = Unit.PP;
+  DependencyOutputOptions DepOpts;
+  if (PrintDependencies) {
+    DepOpts.Targets.push_back((llvm::sys::path::stem(File) + ".o").str());
+    AttachDependencyPrinter(PP, DepOpts, OS);
+  }
+
+  Unit.beginSourceFile();
+  if (!PrintDependencies) {
+    PreprocessorOutputOptions PPOutOpts;
+    DoPrintPreprocessedInput(PP, &OS, PPOutOpts);
+  } else {
+    PP.EnterMainSourceFile();
+    Token Tok;
+    do
+      PP.Lex(Tok);
+    while (Tok.isNot(tok::eof));
+  }
+}
+
+InputParseResult vlang::parseInput(InputUnit &Unit,
+                                   const InputParseOptions &Opts) {
+  Preprocessor &PP = Unit.PP;
+  Sema Actions(PP, TU_Complete, 0);
+  Parser P(PP, Actions, false);
+  P.setDesignUnitTable(Opts.Units);
+  P.setConfigTable(Opts.Configs);
+  OwningPtr<ParseCacheSession> Elements;
+  if (Opts.UseTokenBuffer || Opts.Netlist || Opts.Packages || Opts.Parses) {
+    Unit.Toks.lexAll(PP);
+    P.setTokenBuffer(&Unit.Toks);
+    if (Opts.Netlist)
+      P.setNetlistTable(Opts.Netlist);
+  }
+  if (Opts.Parses) {
+    assert(Opts.Units && "The parse cache replays into a design unit table");
+    Elements.reset(new ParseCacheSession(*Opts.Parses, PP, Unit.Toks,
+                                         *Opts.Units));
+    P.setElementCache(Elements.get());
+  }
+  if (Opts.Packages)
+    P.setPackageTable(Opts.Packages);
+  P.Initialize();
+  while (!P.ParseTopLevelDecl()) {}
+
+  InputParseResult Result;
+  if (Elements) {
+    Result.UsedParseCache = true;
+    Result.NumReplayed = Elements->getNumReplayed();
+    Result.NumParsed = Elements->getNumParsed();
+    Result.NumStored = Elements->getNumStored();
+  }
+  return Result;
+}
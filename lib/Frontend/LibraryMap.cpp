@@ -0,0 +1,396 @@
+//===--- LibraryMap.cpp - IEEE 1800 library map files ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the LibraryMap class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/LibraryMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+
+using namespace vlang;
+
+/// \brief Library map files nested deeper than this are assumed to include
+/// themselves.
+static const unsigned MaxIncludeDepth = 32;
+
+std::string LibraryMap::getNormalizedPath(StringRef Path) {
+  SmallString<256> Absolute(Path);
+  llvm::sys::fs::make_absolute(Absolute);
+
+  SmallVector<StringRef, 16> Components;
+  SmallVector<StringRef, 16> Result;
+  StringRef(Absolute).split(Components, "/");
+  for (unsigned I = 0, E = Components.size(); I != E; ++I) {
+    if (Components[I].empty() || Components[I] == ".")
+      continue;
+    if (Components[I] == "..") {
+      if (!Result.empty())
+        Result.pop_back();
+      continue;
+    }
+    Result.push_back(Components[I]);
+  }
+
+  std::string Normalized;
+  for (unsigned I = 0, E = Result.size(); I != E; ++I) {
+    Normalized += '/';
+    Normalized += Result[I];
+  }
+  return Normalized.empty() ? "/" : Normalized;
+}
+
+unsigned LibraryMap::addLibrary(StringRef Name) {
+  llvm::StringMapEntry<unsigned> &Entry =
+    LibrariesByName.GetOrCreateValue(Name, Libraries.size());
+  if (Entry.getValue() == Libraries.size()) {
+    Library L;
+    L.Name = Name;
+    Libraries.push_back(L);
+  }
+  return Entry.getValue();
+}
+
+unsigned LibraryMap::findLibrary(StringRef Name) const {
+  llvm::StringMap<unsigned>::const_iterator I = LibrariesByName.find(Name);
+  return I == LibrariesByName.end() ? NoLibrary : I->getValue();
+}
+
+void LibraryMap::addSpec(unsigned L, StringRef Spec, StringRef BaseDir) {
+  SmallString<256> Path;
+  if (!llvm::sys::path::is_absolute(Spec))
+    Path = BaseDir;
+  llvm::sys::path::append(Path, Spec);
+  std::string Normalized = getNormalizedPath(Path);
+  // A directory stands for the files in it.
+  if (Spec.endswith("/"))
+    Normalized += "/*";
+  Libraries[L].Specs.push_back(Normalized);
+}
+
+//===----------------------------------------------------------------------===//
+// Reading
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// \brief Splits a library map into paths, keywords, ',' and ';'.
+class MapLexer {
+  const char *Ptr, *End;
+  unsigned Line;
+
+public:
+  explicit MapLexer(StringRef Contents)
+    : Ptr(Contents.begin()), End(Contents.end()), Line(1) {}
+
+  unsigned getLine() const { return Line; }
+
+  /// \brief The next token, or an empty string at the end.  A comment
+  /// starts only where a token could.
+  StringRef next() {
+    for (;;) {
+      while (Ptr != End && (*Ptr == ' ' || *Ptr == '\t' || *Ptr == '\r' ||
+                            *Ptr == '\n' || *Ptr == '\f' || *Ptr == '\v')) {
+        if (*Ptr == '\n')
+          ++Line;
+        ++Ptr;
+      }
+      if (Ptr == End)
+        return StringRef();
+      if (*Ptr == '/' && Ptr + 1 != End && Ptr[1] == '/') {
+        while (Ptr != End && *Ptr != '\n')
+          ++Ptr;
+        continue;
+      }
+      if (*Ptr == '/' && Ptr + 1 != End && Ptr[1] == '*') {
+        for (Ptr += 2; Ptr != End; ++Ptr) {
+          if (*Ptr == '\n')
+            ++Line;
+          else if (*Ptr == '*' && Ptr + 1 != End && Ptr[1] == '/')
+            break;
+        }
+        Ptr = Ptr == End ? End : Ptr + 2;
+        continue;
+      }
+      break;
+    }
+
+    const char *Begin = Ptr;
+    if (*Ptr == ',' || *Ptr == ';')
+      return StringRef(Ptr++, 1);
+    while (Ptr != End && *Ptr != ',' && *Ptr != ';' && *Ptr != ' ' &&
+           *Ptr != '\t' && *Ptr != '\r' && *Ptr != '\n' && *Ptr != '\f' &&
+           *Ptr != '\v')
+      ++Ptr;
+    return StringRef(Begin, Ptr - Begin);
+  }
+};
+} // end anonymous namespace
+
+bool LibraryMap::loadFromFile(StringRef Path, std::string &ErrorStr) {
+  if (IncludeDepth == MaxIncludeDepth) {
+    ErrorStr = "library map files nested too deeply at '" + Path.str() + "'";
+    return true;
+  }
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(Path, Buffer)) {
+    ErrorStr = "cannot read library map '" + Path.str() + "': " +
+               EC.message();
+    return true;
+  }
+  ++IncludeDepth;
+  bool Failed = parse(Buffer->getBuffer(), Path, ErrorStr);
+  --IncludeDepth;
+  return Failed;
+}
+
+// library_text ::= { library_description }
+// library_description ::=
+//   library_declaration | include_statement | config_declaration | ;
+// library_declaration ::=
+//   library library_identifier file_path_spec { , file_path_spec }
+//   [ -incdir file_path_spec { , file_path_spec } ] ;
+// include_statement ::= include file_path_spec ;
+bool LibraryMap::parse(StringRef Contents, StringRef MapPath,
+                       std::string &ErrorStr) {
+  std::string BaseDir =
+    llvm::sys::path::parent_path(getNormalizedPath(MapPath));
+  MapLexer Lex(Contents);
+  for (StringRef Tok = Lex.next(); !Tok.empty(); Tok = Lex.next()) {
+    std::string Where = MapPath.str() + ":" + llvm::utostr(Lex.getLine());
+    if (Tok == ";")
+      continue;
+
+    if (Tok == "library") {
+      StringRef Name = Lex.next();
+      if (Name.empty() || Name == ";" || Name == ",") {
+        ErrorStr = Where + ": expected library name";
+        return true;
+      }
+      unsigned L = addLibrary(Name);
+      bool InIncdir = false;
+      for (Tok = Lex.next(); Tok != ";"; Tok = Lex.next()) {
+        if (Tok.empty()) {
+          ErrorStr = Where + ": expected ';' after library declaration";
+          return true;
+        }
+        if (Tok == ",")
+          continue;
+        if (Tok == "-incdir") {
+          InIncdir = true;
+          continue;
+        }
+        if (InIncdir) {
+          SmallString<256> Dir;
+          if (!llvm::sys::path::is_absolute(Tok))
+            Dir = BaseDir;
+          llvm::sys::path::append(Dir, Tok);
+          Libraries[L].IncludeDirs.push_back(getNormalizedPath(Dir));
+        } else {
+          addSpec(L, Tok, BaseDir);
+        }
+      }
+      continue;
+    }
+
+    if (Tok == "include") {
+      StringRef Spec = Lex.next();
+      if (Spec.empty() || Spec == ";") {
+        ErrorStr = Where + ": expected file after include";
+        return true;
+      }
+      SmallString<256> Included;
+      if (!llvm::sys::path::is_absolute(Spec))
+        Included = BaseDir;
+      llvm::sys::path::append(Included, Spec);
+      if (loadFromFile(Included, ErrorStr))
+        return true;
+      if (Lex.next() != ";") {
+        ErrorStr = Where + ": expected ';' after include statement";
+        return true;
+      }
+      continue;
+    }
+
+    if (Tok == "config") {
+      // Configurations are read from source files, where the parser sees
+      // them; here they are skipped.
+      StringRef Name = Lex.next();
+      Warnings.push_back(Where + ": ignoring config '" + Name.str() +
+                         "' in a library map; declare it in a source file");
+      while (!Tok.empty() && !Tok.startswith("endconfig"))
+        Tok = Lex.next();
+      continue;
+    }
+    if (Tok == ":") {
+      // The label after an endconfig.
+      Lex.next();
+      continue;
+    }
+
+    ErrorStr = Where + ": expected 'library', 'include' or 'config'";
+    return true;
+  }
+  return false;
+}
+
+//===----------------------------------------------------------------------===//
+// Matching
+//===----------------------------------------------------------------------===//
+
+static bool hasWildcards(StringRef Spec) {
+  return Spec.find_first_of("*?") != StringRef::npos ||
+         Spec.find("...") != StringRef::npos;
+}
+
+/// Matches one path component against a pattern with * and ?.
+static bool matchComponent(StringRef Pattern, StringRef Name) {
+  while (!Pattern.empty()) {
+    if (Pattern[0] == '*') {
+      Pattern = Pattern.substr(1);
+      for (size_t I = 0; I <= Name.size(); ++I)
+        if (matchComponent(Pattern, Name.substr(I)))
+          return true;
+      return false;
+    }
+    if (Name.empty() || (Pattern[0] != '?' && Pattern[0] != Name[0]))
+      return false;
+    Pattern = Pattern.substr(1);
+    Name = Name.substr(1);
+  }
+  return Name.empty();
+}
+
+/// Matches path components against pattern components, where ... matches
+/// any number of components.
+static bool matchComponents(ArrayRef<StringRef> Pattern,
+                            ArrayRef<StringRef> Path) {
+  if (Pattern.empty())
+    return Path.empty();
+  if (Pattern[0] == "...") {
+    for (size_t I = 0; I <= Path.size(); ++I)
+      if (matchComponents(Pattern.slice(1), Path.slice(I)))
+        return true;
+    return false;
+  }
+  return !Path.empty() && matchComponent(Pattern[0], Path[0]) &&
+         matchComponents(Pattern.slice(1), Path.slice(1));
+}
+
+static void splitPath(StringRef Path, SmallVectorImpl<StringRef> &Out) {
+  SmallVector<StringRef, 16> Components;
+  Path.split(Components, "/");
+  for (unsigned I = 0, E = Components.size(); I != E; ++I)
+    if (!Components[I].empty())
+      Out.push_back(Components[I]);
+}
+
+unsigned LibraryMap::getLibraryForFile(StringRef Path) const {
+  std::string Normalized = getNormalizedPath(Path);
+  SmallVector<StringRef, 16> PathComponents;
+  splitPath(Normalized, PathComponents);
+
+  unsigned Best = NoLibrary;
+  for (unsigned L = 0, E = Libraries.size(); L != E; ++L) {
+    for (unsigned S = 0, SE = Libraries[L].Specs.size(); S != SE; ++S) {
+      StringRef Spec = Libraries[L].Specs[S];
+      if (!hasWildcards(Spec)) {
+        // An explicit file name is the most specific match there is.
+        if (Spec == Normalized)
+          return L;
+        continue;
+      }
+      if (Best != NoLibrary)
+        continue;
+      SmallVector<StringRef, 16> SpecComponents;
+      splitPath(Spec, SpecComponents);
+      if (matchComponents(SpecComponents, PathComponents))
+        Best = L;
+    }
+  }
+  return Best;
+}
+
+/// Appends the files under \p Dir that match \p Pattern.
+static void expandSpec(StringRef Dir, ArrayRef<StringRef> Pattern,
+                       std::vector<std::string> &Files) {
+  assert(!Pattern.empty() && "Empty file path specification");
+  if (Pattern[0] == "...") {
+    if (Pattern.size() > 1)
+      expandSpec(Dir, Pattern.slice(1), Files);
+    llvm::error_code EC;
+    for (llvm::sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+         I.increment(EC)) {
+      bool IsDirectory = false;
+      if (!llvm::sys::fs::is_directory(I->path(), IsDirectory) && IsDirectory)
+        expandSpec(I->path(), Pattern, Files);
+    }
+    return;
+  }
+
+  bool IsLast = Pattern.size() == 1;
+  if (Pattern[0].find_first_of("*?") == StringRef::npos) {
+    SmallString<256> Path(Dir);
+    llvm::sys::path::append(Path, Pattern[0]);
+    bool Matches = false;
+    if (IsLast)
+      llvm::sys::fs::is_regular_file(Path.str(), Matches);
+    else
+      llvm::sys::fs::is_directory(Path.str(), Matches);
+    if (Matches && IsLast)
+      Files.push_back(Path.str());
+    else if (Matches)
+      expandSpec(Path, Pattern.slice(1), Files);
+    return;
+  }
+
+  llvm::error_code EC;
+  for (llvm::sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    if (!matchComponent(Pattern[0], llvm::sys::path::filename(I->path())))
+      continue;
+    bool Matches = false;
+    if (IsLast)
+      llvm::sys::fs::is_regular_file(I->path(), Matches);
+    else
+      llvm::sys::fs::is_directory(I->path(), Matches);
+    if (Matches && IsLast)
+      Files.push_back(I->path());
+    else if (Matches)
+      expandSpec(I->path(), Pattern.slice(1), Files);
+  }
+}
+
+void LibraryMap::getLibraryFiles(unsigned L,
+                                 std::vector<std::string> &Files) const {
+  std::vector<std::string> Candidates;
+  for (unsigned S = 0, E = Libraries[L].Specs.size(); S != E; ++S) {
+    SmallVector<StringRef, 16> SpecComponents;
+    splitPath(Libraries[L].Specs[S], SpecComponents);
+    if (!SpecComponents.empty())
+      expandSpec("/", SpecComponents, Candidates);
+  }
+  std::sort(Candidates.begin(), Candidates.end());
+  Candidates.erase(std::unique(Candidates.begin(), Candidates.end()),
+                   Candidates.end());
+
+  // A file a more specific specification puts in another library is not
+  // this one's.
+  for (unsigned I = 0, E = Candidates.size(); I != E; ++I)
+    if (getLibraryForFile(Candidates[I]) == L)
+      Files.push_back(Candidates[I]);
+}
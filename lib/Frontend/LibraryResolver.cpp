@@ -0,0 +1,183 @@
+//===--- LibraryResolver.cpp - Find cells in Verilog libraries ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the LibraryResolver class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/LibraryResolver.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/system_error.h"
+
+using namespace vlang;
+
+void LibraryResolver::addCell(StringRef Name, StringRef Path) {
+  llvm::StringMapEntry<std::string> &Entry =
+    CellFiles.GetOrCreateValue(Name);
+  if (Entry.getValue().empty())
+    Entry.setValue(Path);
+}
+
+void LibraryResolver::indexDirectory(StringRef Dir) {
+  // Collect this directory's cells apart first, so that an extension listed
+  // earlier wins over one listed later whatever the listing order.
+  llvm::StringMap<std::pair<unsigned, std::string> > DirCells;
+  llvm::error_code EC;
+  for (llvm::sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    StringRef FileName = llvm::sys::path::filename(I->path());
+    unsigned Rank = 0;
+    StringRef Cell;
+    if (Extensions.empty()) {
+      Cell = FileName;
+    } else {
+      for (unsigned X = 0, XE = Extensions.size(); X != XE; ++X) {
+        if (FileName.size() > Extensions[X].size() &&
+            FileName.endswith(Extensions[X])) {
+          Rank = X;
+          Cell = FileName.drop_back(Extensions[X].size());
+          break;
+        }
+      }
+    }
+    if (Cell.empty())
+      continue;
+    bool IsRegular = false;
+    if (llvm::sys::fs::is_regular_file(I->path(), IsRegular) || !IsRegular)
+      continue;
+
+    llvm::StringMapEntry<std::pair<unsigned, std::string> > &Entry =
+      DirCells.GetOrCreateValue(Cell, std::make_pair(~0U, std::string()));
+    if (Rank < Entry.getValue().first)
+      Entry.setValue(std::make_pair(Rank, I->path()));
+  }
+
+  for (llvm::StringMap<std::pair<unsigned, std::string> >::iterator
+         I = DirCells.begin(), E = DirCells.end(); I != E; ++I)
+    addCell(I->getKey(), I->getValue().second);
+}
+
+static bool isIdentifierStart(char C) {
+  return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') || C == '_';
+}
+
+static bool isIdentifierBody(char C) {
+  return isIdentifierStart(C) || (C >= '0' && C <= '9') || C == '$';
+}
+
+/// Skips whitespace, comments and attribute instances at \p Ptr.
+static const char *skipTrivia(const char *Ptr, const char *End) {
+  while (Ptr != End) {
+    if (*Ptr == ' ' || *Ptr == '\t' || *Ptr == '\n' || *Ptr == '\r' ||
+        *Ptr == '\f' || *Ptr == '\v') {
+      ++Ptr;
+    } else if (*Ptr == '/' && Ptr + 1 != End && Ptr[1] == '/') {
+      while (Ptr != End && *Ptr != '\n')
+        ++Ptr;
+    } else if (*Ptr == '/' && Ptr + 1 != End && Ptr[1] == '*') {
+      StringRef Rest(Ptr + 2, End - Ptr - 2);
+      size_t CommentEnd = Rest.find("*/");
+      Ptr = CommentEnd == StringRef::npos ? End : Rest.begin() + CommentEnd + 2;
+    } else if (*Ptr == '(' && Ptr + 1 != End && Ptr[1] == '*') {
+      StringRef Rest(Ptr + 2, End - Ptr - 2);
+      size_t AttrEnd = Rest.find("*)");
+      Ptr = AttrEnd == StringRef::npos ? End : Rest.begin() + AttrEnd + 2;
+    } else {
+      break;
+    }
+  }
+  return Ptr;
+}
+
+static StringRef readIdentifier(const char *&Ptr, const char *End) {
+  const char *Begin = Ptr;
+  if (Ptr != End && isIdentifierStart(*Ptr))
+    while (Ptr != End && isIdentifierBody(*Ptr))
+      ++Ptr;
+  return StringRef(Begin, Ptr - Begin);
+}
+
+/// Finds the design elements a library file declares by their keywords.  A
+/// keyword inside a string is skipped; one in an `ifdef'd out region is
+/// not, which at worst maps a cell to a file that does not define it.
+void LibraryResolver::indexFile(StringRef Path) {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::MemoryBuffer::getFile(Path, Buffer))
+    return;
+  ++NumFilesScanned;
+
+  const char *Ptr = Buffer->getBufferStart(), *End = Buffer->getBufferEnd();
+  while (Ptr != End) {
+    Ptr = skipTrivia(Ptr, End);
+    if (Ptr == End)
+      break;
+    if (*Ptr == '"') {
+      for (++Ptr; Ptr != End && *Ptr != '"' && *Ptr != '\n'; ++Ptr)
+        if (*Ptr == '\\' && Ptr + 1 != End)
+          ++Ptr;
+      if (Ptr != End)
+        ++Ptr;
+      continue;
+    }
+    // Skip directives, escaped identifiers and anything else that is not
+    // an identifier a character at a time.
+    if (!isIdentifierStart(*Ptr)) {
+      char C = *Ptr++;
+      if (C == '`' || C == '\\' || C == '$')
+        while (Ptr != End && isIdentifierBody(*Ptr))
+          ++Ptr;
+      continue;
+    }
+
+    StringRef Word = readIdentifier(Ptr, End);
+    bool IsDesignElement = llvm::StringSwitch<bool>(Word)
+      .Cases("module", "macromodule", "primitive", true)
+      .Cases("interface", "program", true)
+      .Default(false);
+    if (!IsDesignElement)
+      continue;
+
+    Ptr = skipTrivia(Ptr, End);
+    const char *NamePtr = Ptr;
+    StringRef Name = readIdentifier(Ptr, End);
+    if (Name == "static" || Name == "automatic") {
+      Ptr = skipTrivia(Ptr, End);
+      NamePtr = Ptr;
+      Name = readIdentifier(Ptr, End);
+    }
+    if (!Name.empty())
+      addCell(Name, Path);
+    else
+      Ptr = NamePtr;
+  }
+}
+
+void LibraryResolver::index() {
+  if (Indexed)
+    return;
+  Indexed = true;
+  for (unsigned I = 0, E = Libraries.size(); I != E; ++I) {
+    if (Libraries[I].IsDirectory)
+      indexDirectory(Libraries[I].Path);
+    else
+      indexFile(Libraries[I].Path);
+  }
+}
+
+StringRef LibraryResolver::findCell(StringRef Name) {
+  index();
+  llvm::StringMap<std::string>::iterator I = CellFiles.find(Name);
+  if (I == CellFiles.end())
+    return StringRef();
+  return I->getValue();
+}
@@ -0,0 +1,133 @@
+//===--- PrintPreprocessedOutput.cpp - Implement the -E mode --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This code simply runs the preprocessor on the input file and prints out the
+// result.  This is the traditional behavior of the -E option.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Frontend/Utils.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Frontend/PreprocessorOutputOptions.h"
+#include "vlang/Lex/Lexer.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+using namespace vlang;
+
+namespace {
+/// \brief Keeps the printed tokens on the lines they came from, emitting
+/// blank lines for short gaps and `line directives for long gaps and
+/// changes of file.
+class PrintPPOutput {
+  SourceManager &SM;
+  raw_ostream &OS;
+  bool ShowLineMarkers;
+  std::string CurFilename;
+  unsigned CurLine;
+  bool EmittedTokenOnThisLine;
+
+public:
+  PrintPPOutput(SourceManager &SM, raw_ostream &OS, bool ShowLineMarkers)
+    : SM(SM), OS(OS), ShowLineMarkers(ShowLineMarkers), CurLine(0),
+      EmittedTokenOnThisLine(false) {}
+
+  /// \brief Move the output to the line of \p Loc.  Returns true if the
+  /// output is at the start of a line.
+  bool MoveToLine(SourceLocation Loc);
+
+  void WriteLineMarker(const PresumedLoc &PLoc);
+
+  void startNewLineIfNeeded() {
+    if (EmittedTokenOnThisLine) {
+      OS << '\n';
+      EmittedTokenOnThisLine = false;
+    }
+  }
+
+  void setEmittedTokenOnThisLine() { EmittedTokenOnThisLine = true; }
+};
+} // end anonymous namespace
+
+void PrintPPOutput::WriteLineMarker(const PresumedLoc &PLoc) {
+  startNewLineIfNeeded();
+  SmallString<256> Filename(PLoc.getFilename());
+  Lexer::Stringify(Filename);
+  OS << "`line " << PLoc.getLine() << " \"" << Filename << "\" 0\n";
+}
+
+bool PrintPPOutput::MoveToLine(SourceLocation Loc) {
+  PresumedLoc PLoc = SM.getPresumedLoc(SM.getExpansionLoc(Loc));
+  if (PLoc.isInvalid())
+    return false;
+
+  unsigned LineNo = PLoc.getLine();
+  if (CurFilename != PLoc.getFilename()) {
+    CurFilename = PLoc.getFilename();
+    if (ShowLineMarkers)
+      WriteLineMarker(PLoc);
+    else
+      startNewLineIfNeeded();
+  } else if (LineNo > CurLine) {
+    // Blank lines are cheaper than a directive for short gaps, and keep the
+    // output readable.
+    if (LineNo - CurLine <= 8 || !ShowLineMarkers) {
+      unsigned NumNewlines = ShowLineMarkers ? LineNo - CurLine : 1;
+      if (!EmittedTokenOnThisLine)
+        --NumNewlines;
+      for (; NumNewlines; --NumNewlines)
+        OS << '\n';
+      EmittedTokenOnThisLine = false;
+    } else {
+      WriteLineMarker(PLoc);
+    }
+  } else {
+    startNewLineIfNeeded();
+  }
+  CurLine = LineNo;
+  return true;
+}
+
+void vlang::DoPrintPreprocessedInput(Preprocessor &PP, raw_ostream *OS,
+                                     const PreprocessorOutputOptions &Opts) {
+  PP.SetCommentRetentionState(Opts.ShowComments, Opts.ShowMacroComments);
+
+  PrintPPOutput Callbacks(PP.getSourceManager(), *OS, Opts.ShowLineMarkers);
+  SmallString<128> SpellingBuffer;
+
+  PP.EnterMainSourceFile();
+  Token Tok;
+  bool AtStartOfOutput = true;
+  while (1) {
+    PP.Lex(Tok);
+    if (Tok.is(tok::eof))
+      break;
+
+    bool AtLineStart = false;
+    if (Tok.isAtStartOfLine() || AtStartOfOutput)
+      AtLineStart = Callbacks.MoveToLine(Tok.getLocation());
+    AtStartOfOutput = false;
+    if (!AtLineStart && Tok.hasLeadingSpace())
+      *OS << ' ';
+
+    *OS << PP.getSpelling(Tok, SpellingBuffer);
+    Callbacks.setEmittedTokenOnThisLine();
+  }
+  Callbacks.startNewLineIfNeeded();
+
+  // The definitions the input left behind, as the `define directives that
+  // would recreate them.
+  if (Opts.ShowMacros) {
+    std::vector<std::pair<StringRef, StringRef> > Macros;
+    PP.getSourceMacroDefinitions(Macros);
+    for (unsigned I = 0, E = Macros.size(); I != E; ++I)
+      *OS << "`define " << Macros[I].second << '\n';
+  }
+}
@@ -0,0 +1,1036 @@
+//===--- IndexBuilder.cpp - Build and update symbol indexes ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the IndexBuilder class, which indexes compilation
+//  units and writes symbol index files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Index/SymbolIndex.h"
+#include "IndexFormat.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/LangOptions.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Basic/StableHash.h"
+#include "vlang/Diag/DiagnosticOptions.h"
+#include "vlang/Frontend/Utils.h"
+#include "vlang/Lex/CompactPreprocessingRecord.h"
+#include "vlang/Lex/HeaderSearch.h"
+#include "vlang/Lex/HeaderSearchOptions.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/PreprocessorOptions.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace vlang;
+using namespace vlang::index;
+
+static std::string getAbsolutePath(StringRef Path) {
+  SmallString<256> Result(Path);
+  llvm::sys::fs::make_absolute(Result);
+  return Result.str().str();
+}
+
+//===----------------------------------------------------------------------===//
+// Unit indexing
+//===----------------------------------------------------------------------===//
+
+namespace vlang {
+namespace index {
+
+/// \brief Records the occurrences in the tokens and preprocessing record of
+/// one compilation unit.
+///
+/// The token scan does not parse: it recognizes the few token patterns that
+/// introduce or use an indexed symbol, at the nesting depth where they can
+/// occur.  Where a pattern does not tell which kind of symbol it names
+/// (module or interface instantiation, package or class scope, task or
+/// function call) it records a provisional kind, which IndexBuilder resolves
+/// against the definitions of the whole design when it writes the index.
+class UnitIndexer {
+  IndexBuilder &B;
+  SourceManager &SM;
+  Preprocessor &PP;
+  const TokenBuffer &Toks;
+
+  /// \brief The builder's file for each file whose occurrences this unit
+  /// records.
+  llvm::DenseMap<const FileEntry *, unsigned> Slots;
+  FileID LastFID;
+  int LastSlot;
+
+  /// \brief Instance names after the first in a list of instantiations,
+  /// which must not be taken for subroutine calls.
+  llvm::DenseSet<unsigned> InstanceNames;
+
+  tok::TokenKind kind(unsigned I) const {
+    return I < Toks.size() ? Toks.getKind(I) : tok::eof;
+  }
+  bool isIdent(unsigned I) const;
+  StringRef getName(unsigned I) const {
+    return Toks.getIdentifierInfo(I)->getName();
+  }
+
+  int getSlot(FileID FID);
+  void record(SourceLocation Loc, StringRef Name, SymbolKind K,
+              SymbolRole R);
+  void record(unsigned I, SymbolKind K, SymbolRole R) {
+    record(Toks.getLocation(I), getName(I), K, R);
+  }
+
+  unsigned skipBalanced(unsigned I) const;
+  unsigned skipDeclaration(unsigned I) const;
+  unsigned scanDesignElement(unsigned I, SymbolKind K);
+  unsigned scanParameters(unsigned I, bool InList);
+  unsigned scanDeclarators(unsigned I, SymbolKind K);
+  unsigned scanSubroutine(unsigned I, SymbolKind K);
+  unsigned scanBaseClass(unsigned I);
+  unsigned scanIdentifier(unsigned I);
+  void scanTokens();
+  void scanMacros();
+
+public:
+  UnitIndexer(IndexBuilder &B, Preprocessor &PP, const TokenBuffer &Toks)
+    : B(B), SM(PP.getSourceManager()), PP(PP), Toks(Toks), LastSlot(-1) {}
+
+  /// \brief Record the unit's occurrences and return the files it read.
+  void run(std::vector<unsigned> &Files);
+};
+
+} // end namespace index
+} // end namespace vlang
+
+bool UnitIndexer::isIdent(unsigned I) const {
+  // System tasks and functions lex as identifiers starting with '$'.
+  return kind(I) == tok::identifier && !getName(I).startswith("$");
+}
+
+int UnitIndexer::getSlot(FileID FID) {
+  if (FID == LastFID)
+    return LastSlot;
+  LastFID = FID;
+  LastSlot = -1;
+  if (const FileEntry *FE = SM.getFileEntryForID(FID)) {
+    llvm::DenseMap<const FileEntry *, unsigned>::iterator Pos = Slots.find(FE);
+    if (Pos != Slots.end())
+      LastSlot = Pos->second;
+  }
+  return LastSlot;
+}
+
+void UnitIndexer::record(SourceLocation Loc, StringRef Name, SymbolKind K,
+                         SymbolRole R) {
+  if (Loc.isInvalid())
+    return;
+  std::pair<FileID, unsigned> Decomposed = SM.getDecomposedExpansionLoc(Loc);
+  int Slot = getSlot(Decomposed.first);
+  if (Slot < 0)
+    return;
+
+  IndexBuilder::Occurrence Occ;
+  Occ.Name = B.getNameID(Name);
+  Occ.File = Slot;
+  Occ.Line = SM.getLineNumber(Decomposed.first, Decomposed.second);
+  Occ.Column = SM.getColumnNumber(Decomposed.first, Decomposed.second);
+  Occ.Kind = K;
+  Occ.Role = R;
+  Occ.Fresh = true;
+  B.Occurrences.push_back(Occ);
+}
+
+/// \brief Skip the bracketed tokens starting at the opening bracket \p I.
+/// Returns the index after the closing one.
+unsigned UnitIndexer::skipBalanced(unsigned I) const {
+  unsigned Depth = 0;
+  for (unsigned N = Toks.size(); I < N; ++I) {
+    switch (kind(I)) {
+    case tok::l_paren:
+    case tok::l_square:
+    case tok::l_brace:
+      ++Depth;
+      break;
+    case tok::r_paren:
+    case tok::r_square:
+    case tok::r_brace:
+      if (--Depth == 0)
+        return I + 1;
+      break;
+    case tok::eof:
+      return I;
+    default:
+      break;
+    }
+  }
+  return I;
+}
+
+/// \brief Skip to the end of the declaration containing \p I: after the
+/// next ';' outside brackets.
+unsigned UnitIndexer::skipDeclaration(unsigned I) const {
+  for (unsigned N = Toks.size(); I < N; ) {
+    switch (kind(I)) {
+    case tok::l_paren:
+    case tok::l_square:
+    case tok::l_brace:
+      I = skipBalanced(I);
+      break;
+    case tok::semi:
+      return I + 1;
+    case tok::eof:
+      return I;
+    default:
+      ++I;
+      break;
+    }
+  }
+  return I;
+}
+
+/// \brief Whether \p K starts a declaration that ends the one being scanned.
+static bool startsDeclaration(tok::TokenKind K) {
+  switch (K) {
+  case tok::kw_input:
+  case tok::kw_output:
+  case tok::kw_inout:
+  case tok::kw_ref:
+  case tok::kw_parameter:
+  case tok::kw_localparam:
+  case tok::kw_task:
+  case tok::kw_function:
+  case tok::kw_module:
+  case tok::kw_macromodule:
+  case tok::kw_interface:
+  case tok::kw_program:
+  case tok::kw_package:
+  case tok::kw_primitive:
+  case tok::kw_class:
+  case tok::kw_checker:
+  case tok::kw_config:
+  case tok::eof:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// \brief The kind of the design element introduced by keyword \p K, or
+/// NumSymbolKinds.
+static SymbolKind getDesignElementKind(tok::TokenKind K) {
+  switch (K) {
+  case tok::kw_module:
+  case tok::kw_macromodule: return SK_Module;
+  case tok::kw_interface:   return SK_Interface;
+  case tok::kw_program:     return SK_Program;
+  case tok::kw_package:     return SK_Package;
+  case tok::kw_primitive:   return SK_Primitive;
+  case tok::kw_class:       return SK_Class;
+  case tok::kw_checker:     return SK_Checker;
+  case tok::kw_config:      return SK_Config;
+  default:                  return NumSymbolKinds;
+  }
+}
+
+/// \brief Whether \p K declares nets or variables.
+static bool isNetKeyword(tok::TokenKind K) {
+  switch (K) {
+  case tok::kw_wire:
+  case tok::kw_tri:
+  case tok::kw_tri0:
+  case tok::kw_tri1:
+  case tok::kw_wand:
+  case tok::kw_wor:
+  case tok::kw_triand:
+  case tok::kw_trior:
+  case tok::kw_trireg:
+  case tok::kw_supply0:
+  case tok::kw_supply1:
+  case tok::kw_uwire:
+  case tok::kw_reg:
+  case tok::kw_logic:
+  case tok::kw_var:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// \brief Scan the header of the design element whose keyword is at \p I.
+unsigned UnitIndexer::scanDesignElement(unsigned I, SymbolKind K) {
+  unsigned J = I + 1;
+  // 'interface class' is a class.
+  if (kind(I) == tok::kw_interface && kind(J) == tok::kw_class)
+    return J;
+  while (kind(J) == tok::kw_automatic || kind(J) == tok::kw_static)
+    ++J;
+  if (!isIdent(J))
+    return J;
+  record(J, K, SR_Definition);
+  ++J;
+  if (kind(J) == tok::hash && kind(J + 1) == tok::l_paren)
+    J = scanParameters(J + 2, /*InList=*/true);
+  return J;
+}
+
+/// \brief Record the parameters declared from \p I on: the names assigned
+/// to outside brackets.  With \p InList, \p I follows the '#(' of a
+/// parameter port list, and the scan ends after its ')'.
+unsigned UnitIndexer::scanParameters(unsigned I, bool InList) {
+  unsigned Depth = 0;
+  for (unsigned N = Toks.size(); I < N; ++I) {
+    switch (kind(I)) {
+    case tok::l_paren:
+    case tok::l_square:
+    case tok::l_brace:
+      ++Depth;
+      break;
+    case tok::r_paren:
+    case tok::r_square:
+    case tok::r_brace:
+      if (Depth == 0)
+        return InList ? I + 1 : I;
+      --Depth;
+      break;
+    case tok::semi:
+      return I + 1;
+    case tok::identifier:
+      if (Depth == 0 && kind(I + 1) == tok::equal && isIdent(I))
+        record(I, SK_Parameter, SR_Definition);
+      break;
+    case tok::eof:
+      return I;
+    default:
+      break;
+    }
+  }
+  return I;
+}
+
+/// \brief Record the ports or nets declared from \p I on.  A declared name
+/// is an identifier outside brackets and initializers that is followed by
+/// the end of its declarator; the identifiers before it name its type.
+unsigned UnitIndexer::scanDeclarators(unsigned I, SymbolKind K) {
+  unsigned Depth = 0;
+  bool InInitializer = false;
+  for (unsigned N = Toks.size(); I < N; ++I) {
+    tok::TokenKind Kind = kind(I);
+    switch (Kind) {
+    case tok::l_paren:
+      // Outside a delay or an initializer, a parenthesis at the top level
+      // is not part of a declaration.
+      if (Depth == 0 && !InInitializer && kind(I - 1) != tok::hash)
+        return I;
+      ++Depth;
+      break;
+    case tok::l_square:
+    case tok::l_brace:
+      ++Depth;
+      break;
+    case tok::r_paren:
+    case tok::r_square:
+    case tok::r_brace:
+      if (Depth == 0)
+        return I;
+      --Depth;
+      break;
+    case tok::semi:
+      return I + 1;
+    case tok::comma:
+      if (Depth == 0)
+        InInitializer = false;
+      break;
+    case tok::equal:
+      if (Depth == 0)
+        InInitializer = true;
+      break;
+    case tok::identifier: {
+      if (Depth != 0 || InInitializer || !isIdent(I))
+        break;
+      unsigned Next = I + 1;
+      // Unpacked dimensions follow a name; packed ones precede one.
+      while (kind(Next) == tok::l_square)
+        Next = skipBalanced(Next);
+      switch (kind(Next)) {
+      case tok::comma:
+      case tok::semi:
+      case tok::r_paren:
+      case tok::equal:
+      case tok::eof:
+        record(I, K, SR_Definition);
+        break;
+      default:
+        break;
+      }
+      break;
+    }
+    default:
+      if (Depth == 0 && !InInitializer && startsDeclaration(Kind))
+        return I;
+      break;
+    }
+  }
+  return I;
+}
+
+/// \brief Record the task or function whose keyword is at \p I: the last
+/// identifier before its port list or ';'.  Returns the index of that
+/// '(' or ';', so that the ports are scanned next.
+unsigned UnitIndexer::scanSubroutine(unsigned I, SymbolKind K) {
+  unsigned Name = 0;
+  bool HasName = false;
+  for (unsigned J = I + 1, N = Toks.size(); J < N; ) {
+    tok::TokenKind Kind = kind(J);
+    if (Kind == tok::l_paren || Kind == tok::semi || Kind == tok::eof) {
+      if (HasName)
+        record(Name, K, SR_Definition);
+      return J;
+    }
+    if (Kind == tok::l_square) {
+      J = skipBalanced(J);
+      continue;
+    }
+    if (isIdent(J)) {
+      Name = J;
+      HasName = true;
+    }
+    ++J;
+  }
+  return Toks.size();
+}
+
+/// \brief Record the class named after 'extends' or 'implements' at \p I.
+unsigned UnitIndexer::scanBaseClass(unsigned I) {
+  unsigned J = I + 1;
+  while (isIdent(J) && kind(J + 1) == tok::coloncolon) {
+    record(J, SK_Package, SR_Reference);
+    J += 2;
+  }
+  if (!isIdent(J))
+    return J;
+  record(J, SK_Class, SR_Reference);
+  return J + 1;
+}
+
+/// \brief Recognize the use of a symbol starting at identifier \p I.
+unsigned UnitIndexer::scanIdentifier(unsigned I) {
+  if (!isIdent(I))
+    return I + 1;
+  tok::TokenKind Prev = I ? kind(I - 1) : tok::unknown;
+  tok::TokenKind Next = kind(I + 1);
+
+  // pkg::name and cls::name; resolved to a package or a class later.
+  if (Next == tok::coloncolon) {
+    record(I, SK_Package, SR_Reference);
+    return I + 2;
+  }
+
+  // Hierarchical names and named port connections.
+  if (Prev == tok::period)
+    return I + 1;
+
+  // An interface port with a modport: ( bus.master b.
+  if (Next == tok::period && (Prev == tok::l_paren || Prev == tok::comma) &&
+      isIdent(I + 2) && isIdent(I + 3)) {
+    record(I, SK_Interface, SR_Reference);
+    return I + 4;
+  }
+
+  // An instantiation: name [#(...)] instance [dims] (.
+  if (Prev != tok::coloncolon) {
+    unsigned J = I + 1;
+    if (kind(J) == tok::hash && kind(J + 1) == tok::l_paren)
+      J = skipBalanced(J + 1);
+    if (isIdent(J)) {
+      unsigned Instance = J;
+      ++J;
+      while (kind(J) == tok::l_square)
+        J = skipBalanced(J);
+      if (kind(J) == tok::l_paren) {
+        record(I, SK_Module, SR_Instantiation);
+        // Remember the names of the other instances in the list.
+        J = skipBalanced(J);
+        while (kind(J) == tok::comma && isIdent(J + 1)) {
+          unsigned Other = J + 1;
+          J = Other + 1;
+          while (kind(J) == tok::l_square)
+            J = skipBalanced(J);
+          if (kind(J) != tok::l_paren)
+            break;
+          InstanceNames.insert(Other);
+          J = skipBalanced(J);
+        }
+        return Instance + 1;
+      }
+    }
+  }
+
+  // A task or function call; resolved against the definitions later.
+  if (Next == tok::l_paren && Prev != tok::hash && !InstanceNames.count(I))
+    record(I, SK_Function, SR_Reference);
+  return I + 1;
+}
+
+void UnitIndexer::scanTokens() {
+  for (unsigned I = 0, N = Toks.size(); I < N; ) {
+    tok::TokenKind Kind = kind(I);
+    switch (Kind) {
+    case tok::kw_module:
+    case tok::kw_macromodule:
+    case tok::kw_interface:
+    case tok::kw_program:
+    case tok::kw_package:
+    case tok::kw_primitive:
+    case tok::kw_class:
+    case tok::kw_checker:
+    case tok::kw_config:
+      I = scanDesignElement(I, getDesignElementKind(Kind));
+      break;
+    case tok::kw_virtual:
+      // virtual [interface] name declares a virtual interface.
+      if (kind(I + 1) == tok::kw_interface)
+        ++I;
+      if (isIdent(I + 1)) {
+        record(I + 1, SK_Interface, SR_Reference);
+        I += 2;
+      } else {
+        ++I;
+      }
+      break;
+    case tok::kw_typedef:
+    case tok::kw_struct:
+    case tok::kw_union:
+    case tok::kw_enum:
+      // Type declarations name no indexed symbol, and their members are
+      // not nets.
+      if (Kind == tok::kw_typedef) {
+        I = skipDeclaration(I);
+      } else {
+        unsigned J = I + 1;
+        while (J < N && kind(J) != tok::l_brace && kind(J) != tok::semi)
+          ++J;
+        I = kind(J) == tok::l_brace ? skipBalanced(J) : J;
+      }
+      break;
+    case tok::kw_extends:
+    case tok::kw_implements:
+      I = scanBaseClass(I);
+      break;
+    case tok::kw_parameter:
+    case tok::kw_localparam:
+      I = scanParameters(I + 1, /*InList=*/false);
+      break;
+    case tok::kw_input:
+    case tok::kw_output:
+    case tok::kw_inout:
+    case tok::kw_ref:
+      I = scanDeclarators(I + 1, SK_Port);
+      break;
+    case tok::kw_task:
+      I = scanSubroutine(I, SK_Task);
+      break;
+    case tok::kw_function:
+      I = scanSubroutine(I, SK_Function);
+      break;
+    case tok::identifier:
+      I = scanIdentifier(I);
+      break;
+    default:
+      if (isNetKeyword(Kind))
+        I = scanDeclarators(I + 1, SK_Net);
+      else
+        ++I;
+      break;
+    }
+  }
+}
+
+void UnitIndexer::scanMacros() {
+  CompactPreprocessingRecord &Rec = *PP.getCompactPreprocessingRecord();
+  Rec.finalize();
+  for (unsigned S = 0, e = Rec.getNumSegments(); S != e; ++S) {
+    FileID FID = Rec.getSegmentFileID(S);
+    if (getSlot(FID) < 0)
+      continue;
+    SourceLocation FileStart = SM.getLocForStartOfFile(FID);
+    std::pair<unsigned, unsigned> Entities = Rec.getSegmentEntities(S);
+    for (unsigned I = Entities.first; I != Entities.second; ++I) {
+      SymbolRole Role;
+      switch (Rec.getKind(I)) {
+      case PreprocessedEntity::MacroDefinitionKind:
+        Role = SR_Definition;
+        break;
+      case PreprocessedEntity::MacroExpansionKind:
+        Role = SR_Reference;
+        break;
+      default:
+        continue;
+      }
+      record(FileStart.getLocWithOffset(Rec.getBeginOffset(I)), Rec.getName(I),
+             SK_Macro, Role);
+    }
+  }
+}
+
+void UnitIndexer::run(std::vector<unsigned> &Files) {
+  // Decide which of the files the unit read get their occurrences recorded
+  // by it: those not yet indexed by this run whose previous occurrences,
+  // if any, are out of date.
+  for (SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+                                        E = SM.fileinfo_end();
+       I != E; ++I) {
+    const llvm::MemoryBuffer *Buffer = I->second->getRawBuffer();
+    if (!Buffer)
+      continue;
+    const FileEntry *FE = I->first;
+    unsigned File = B.getFileID(getAbsolutePath(FE->getName()));
+    Files.push_back(File);
+
+    IndexBuilder::FileInfo &FI = B.Files[File];
+    if (FI.State == IndexBuilder::FS_Unchecked)
+      B.isFileUnchanged(File);
+    if (FI.State != IndexBuilder::FS_Changed &&
+        FI.State != IndexBuilder::FS_New)
+      continue;
+    FI.Size = FE->getSize();
+    FI.ModTime = FE->getModificationTime();
+    FI.Hash = IndexBuilder::hashContents(Buffer->getBuffer());
+    FI.State = IndexBuilder::FS_Indexed;
+    Slots[FE] = File;
+  }
+  std::sort(Files.begin(), Files.end());
+  Files.erase(std::unique(Files.begin(), Files.end()), Files.end());
+
+  if (!Slots.empty()) {
+    scanTokens();
+    scanMacros();
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// IndexBuilder
+//===----------------------------------------------------------------------===//
+
+IndexBuilder::IndexBuilder(IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts,
+                           IntrusiveRefCntPtr<PreprocessorOptions> PPOpts)
+  : HSOpts(HSOpts), PPOpts(PPOpts),
+    FileMgr(new FileManager(FileSystemOptions())), NumUnitsReused(0),
+    NumUnitsIndexed(0) {}
+
+IndexBuilder::~IndexBuilder() {}
+
+uint64_t IndexBuilder::hashContents(StringRef Data) {
+  // Part of the on-disk format, so it must not change.
+  return hashFNV1a(Data);
+}
+
+unsigned IndexBuilder::getNameID(StringRef Name) {
+  llvm::StringMapEntry<unsigned> &Entry =
+    NameIDs.GetOrCreateValue(Name, Names.size());
+  if (Entry.getValue() == Names.size())
+    Names.push_back(Name.str());
+  return Entry.getValue();
+}
+
+unsigned IndexBuilder::getFileID(StringRef Path) {
+  llvm::StringMapEntry<unsigned> &Entry =
+    FileIDs.GetOrCreateValue(Path, Files.size());
+  if (Entry.getValue() == Files.size()) {
+    FileInfo FI;
+    FI.Path = Path.str();
+    FI.Size = FI.ModTime = FI.Hash = 0;
+    FI.State = FS_New;
+    Files.push_back(FI);
+  }
+  return Entry.getValue();
+}
+
+bool IndexBuilder::isFileUnchanged(unsigned File) {
+  FileInfo &FI = Files[File];
+  if (FI.State != FS_Unchecked)
+    return FI.State != FS_Changed;
+
+  FI.State = FS_Changed;
+  const FileEntry *FE = FileMgr->getFile(FI.Path);
+  if (!FE)
+    return false;
+  if ((uint64_t)FE->getSize() == FI.Size &&
+      (uint64_t)FE->getModificationTime() == FI.ModTime) {
+    FI.State = FS_Unchanged;
+    return true;
+  }
+
+  // The file was touched or rewritten; compare its contents.
+  if ((uint64_t)FE->getSize() != FI.Size)
+    return false;
+  OwningPtr<llvm::MemoryBuffer> Buffer(FileMgr->getBufferForFile(FE));
+  if (!Buffer || hashContents(Buffer->getBuffer()) != FI.Hash)
+    return false;
+  FI.ModTime = FE->getModificationTime();
+  FI.State = FS_Unchanged;
+  return true;
+}
+
+void IndexBuilder::loadFrom(const SymbolIndex &Old) {
+  assert(Files.empty() && Units.empty() && "Builder already in use");
+
+  for (unsigned F = 0, e = Old.getNumFiles(); F != e; ++F) {
+    unsigned File = getFileID(Old.getFilePath(F));
+    assert(File == F && "Duplicate file in index");
+    (void)File;
+    FileInfo &FI = Files[F];
+    FI.Size = Old.getFileSize(F);
+    FI.ModTime = Old.getFileModTime(F);
+    FI.Hash = Old.getFileHash(F);
+    FI.State = FS_Unchecked;
+  }
+
+  for (unsigned U = 0, e = Old.getNumUnits(); U != e; ++U) {
+    UnitInfo UI;
+    UI.MainFile = Old.getUnitMainFile(U);
+    ArrayRef<uint32_t> UnitFiles = Old.getUnitFiles(U);
+    UI.Files.assign(UnitFiles.begin(), UnitFiles.end());
+    UI.Live = false;
+    UnitIDs[Files[UI.MainFile].Path] = Units.size();
+    Units.push_back(UI);
+  }
+
+  for (unsigned S = 0, e = Old.getNumSymbols(); S != e; ++S) {
+    unsigned Name = getNameID(Old.getSymbolName(S));
+    for (unsigned I = 0, N = Old.getNumOccurrences(S); I != N; ++I) {
+      SymbolOccurrence SO = Old.getOccurrence(S, I);
+      Occurrence Occ;
+      Occ.Name = Name;
+      Occ.File = SO.File;
+      Occ.Line = SO.Line;
+      Occ.Column = SO.Column;
+      Occ.Kind = SO.Kind;
+      Occ.Role = SO.Role;
+      Occ.Fresh = false;
+      Occurrences.push_back(Occ);
+    }
+  }
+}
+
+bool IndexBuilder::addUnit(StringRef MainFile, std::string &ErrorStr) {
+  std::string Path = getAbsolutePath(MainFile);
+
+  llvm::StringMap<unsigned>::iterator Known = UnitIDs.find(Path);
+  if (Known != UnitIDs.end()) {
+    UnitInfo &UI = Units[Known->second];
+    if (UI.Live)
+      return false;
+    bool Unchanged = true;
+    for (unsigned i = 0, e = UI.Files.size(); i != e && Unchanged; ++i)
+      Unchanged = isFileUnchanged(UI.Files[i]);
+    if (Unchanged) {
+      UI.Live = true;
+      ++NumUnitsReused;
+      return false;
+    }
+  }
+
+  const FileEntry *Main = FileMgr->getFile(Path);
+  if (!Main) {
+    ErrorStr = "cannot open '" + Path + "'";
+    return true;
+  }
+
+  DiagnosticsEngine Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs()),
+                          new DiagnosticOptions(), new IgnoringDiagConsumer());
+  SourceManager SourceMgr(Diags, *FileMgr);
+  LangOptions LangOpts;
+  HeaderSearch HeaderInfo(HSOpts, *FileMgr, Diags, LangOpts);
+  Preprocessor PP(PPOpts, Diags, LangOpts, SourceMgr, HeaderInfo, 0,
+                  /*OwnsHeaderSearch=*/false);
+  InitializePreprocessor(PP, *PPOpts, *HSOpts);
+  PP.createCompactPreprocessingRecord();
+  SourceMgr.createMainFileID(Main);
+  PP.EnterMainSourceFile();
+  TokenBuffer Toks;
+  Toks.lexAll(PP);
+
+  unsigned Unit;
+  if (Known != UnitIDs.end()) {
+    Unit = Known->second;
+  } else {
+    Unit = Units.size();
+    UnitIDs[Path] = Unit;
+    Units.push_back(UnitInfo());
+    Units.back().MainFile = getFileID(Path);
+  }
+  std::vector<unsigned> UnitFiles;
+  UnitIndexer(*this, PP, Toks).run(UnitFiles);
+  Units[Unit].Files.swap(UnitFiles);
+  Units[Unit].Live = true;
+  ++NumUnitsIndexed;
+  return false;
+}
+
+namespace {
+/// \brief Orders occurrences by name, kind and position.  Names are
+/// compared by their ID in the written string table.
+struct OccurrenceLess {
+  const std::vector<unsigned> &StringIDs;
+
+  explicit OccurrenceLess(const std::vector<unsigned> &StringIDs)
+    : StringIDs(StringIDs) {}
+
+  bool operator()(const IndexBuilder::Occurrence &LHS,
+                  const IndexBuilder::Occurrence &RHS) const {
+    if (LHS.Name != RHS.Name)
+      return StringIDs[LHS.Name] < StringIDs[RHS.Name];
+    if (LHS.Kind != RHS.Kind)
+      return LHS.Kind < RHS.Kind;
+    if (LHS.File != RHS.File)
+      return LHS.File < RHS.File;
+    if (LHS.Line != RHS.Line)
+      return LHS.Line < RHS.Line;
+    if (LHS.Column != RHS.Column)
+      return LHS.Column < RHS.Column;
+    return LHS.Role < RHS.Role;
+  }
+};
+
+struct OccurrenceEqual {
+  bool operator()(const IndexBuilder::Occurrence &LHS,
+                  const IndexBuilder::Occurrence &RHS) const {
+    return LHS.Name == RHS.Name && LHS.Kind == RHS.Kind &&
+           LHS.File == RHS.File && LHS.Line == RHS.Line &&
+           LHS.Column == RHS.Column && LHS.Role == RHS.Role;
+  }
+};
+}
+
+/// \brief Settle the kind of an occurrence whose pattern did not determine
+/// it, given the kinds that \p Defined (a mask of 1 << SymbolKind) has
+/// definitions of.
+static void resolveKind(IndexBuilder::Occurrence &Occ, unsigned Defined) {
+  if (Occ.Role == SR_Instantiation) {
+    static const SymbolKind Instantiable[] = {
+      SK_Module, SK_Interface, SK_Program, SK_Checker, SK_Primitive
+    };
+    Occ.Kind = SK_Module;
+    for (unsigned i = 0; i != llvm::array_lengthof(Instantiable); ++i)
+      if (Defined & (1U << Instantiable[i])) {
+        Occ.Kind = Instantiable[i];
+        break;
+      }
+    return;
+  }
+  if (Occ.Role != SR_Reference)
+    return;
+
+  if (Occ.Kind == SK_Package || Occ.Kind == SK_Class) {
+    Occ.Kind = !(Defined & (1U << SK_Package)) && (Defined & (1U << SK_Class))
+                 ? SK_Class : SK_Package;
+  } else if (Occ.Kind == SK_Function || Occ.Kind == SK_Task) {
+    if (Defined & (1U << SK_Function)) {
+      Occ.Kind = SK_Function;
+    } else if (Defined & (1U << SK_Task)) {
+      Occ.Kind = SK_Task;
+    } else if (Defined & (1U << SK_Primitive)) {
+      // A primitive instance may be unnamed.
+      Occ.Kind = SK_Primitive;
+      Occ.Role = SR_Instantiation;
+    } else {
+      Occ.Kind = SK_Function;
+    }
+  }
+}
+
+void IndexBuilder::finish() {
+  // Keep the files of the units given to this run.
+  std::vector<char> LiveFiles(Files.size());
+  for (unsigned U = 0, e = Units.size(); U != e; ++U)
+    if (Units[U].Live)
+      for (unsigned i = 0, n = Units[U].Files.size(); i != n; ++i)
+        LiveFiles[Units[U].Files[i]] = true;
+
+  // Drop the occurrences of dead files, and the previous occurrences of
+  // files indexed again.
+  unsigned Kept = 0;
+  for (unsigned i = 0, e = Occurrences.size(); i != e; ++i) {
+    const Occurrence &Occ = Occurrences[i];
+    if (!LiveFiles[Occ.File] ||
+        (!Occ.Fresh && Files[Occ.File].State == FS_Indexed))
+      continue;
+    Occurrences[Kept++] = Occ;
+  }
+  Occurrences.erase(Occurrences.begin() + Kept, Occurrences.end());
+
+  llvm::DenseMap<unsigned, unsigned> Defined;
+  for (unsigned i = 0, e = Occurrences.size(); i != e; ++i)
+    if (Occurrences[i].Role == SR_Definition)
+      Defined[Occurrences[i].Name] |= 1U << Occurrences[i].Kind;
+  for (unsigned i = 0, e = Occurrences.size(); i != e; ++i)
+    resolveKind(Occurrences[i], Defined.lookup(Occurrences[i].Name));
+}
+
+bool IndexBuilder::writeToFile(StringRef Path, std::string &ErrorStr) {
+  using namespace ondisk;
+  finish();
+
+  // Number the live files and units.
+  std::vector<unsigned> FileMap(Files.size(), ~0U);
+  std::vector<unsigned> LiveFiles;
+  std::vector<unsigned> LiveUnits;
+  for (unsigned U = 0, e = Units.size(); U != e; ++U) {
+    if (!Units[U].Live)
+      continue;
+    LiveUnits.push_back(U);
+    for (unsigned i = 0, n = Units[U].Files.size(); i != n; ++i) {
+      unsigned F = Units[U].Files[i];
+      if (FileMap[F] == ~0U) {
+        FileMap[F] = LiveFiles.size();
+        LiveFiles.push_back(F);
+      }
+    }
+  }
+
+  // Build the sorted string table of symbol names and file paths.
+  std::vector<StringRef> Strings;
+  std::vector<char> NameUsed(Names.size());
+  for (unsigned i = 0, e = Occurrences.size(); i != e; ++i)
+    if (!NameUsed[Occurrences[i].Name]) {
+      NameUsed[Occurrences[i].Name] = true;
+      Strings.push_back(Names[Occurrences[i].Name]);
+    }
+  for (unsigned i = 0, e = LiveFiles.size(); i != e; ++i)
+    Strings.push_back(Files[LiveFiles[i]].Path);
+  std::sort(Strings.begin(), Strings.end());
+  Strings.erase(std::unique(Strings.begin(), Strings.end()), Strings.end());
+
+  std::vector<uint32_t> StringOffsets;
+  uint32_t StringDataSize = 0;
+  for (unsigned i = 0, e = Strings.size(); i != e; ++i) {
+    StringOffsets.push_back(StringDataSize);
+    StringDataSize += Strings[i].size() + 1;
+  }
+  std::vector<unsigned> StringIDs(Names.size(), ~0U);
+  for (unsigned N = 0, e = Names.size(); N != e; ++N)
+    if (NameUsed[N])
+      StringIDs[N] = std::lower_bound(Strings.begin(), Strings.end(),
+                                      StringRef(Names[N])) - Strings.begin();
+
+  // Group the occurrences into symbols and posting lists.
+  for (unsigned i = 0, e = Occurrences.size(); i != e; ++i)
+    Occurrences[i].File = FileMap[Occurrences[i].File];
+  std::sort(Occurrences.begin(), Occurrences.end(), OccurrenceLess(StringIDs));
+  Occurrences.erase(std::unique(Occurrences.begin(), Occurrences.end(),
+                                OccurrenceEqual()),
+                    Occurrences.end());
+
+  std::vector<SymbolRecord> Symbols;
+  for (unsigned i = 0, e = Occurrences.size(); i != e; ++i) {
+    const Occurrence &Occ = Occurrences[i];
+    if (Symbols.empty() || Symbols.back().Name != StringIDs[Occ.Name] ||
+        Symbols.back().Kind != Occ.Kind) {
+      SymbolRecord S;
+      S.Name = StringIDs[Occ.Name];
+      S.Kind = Occ.Kind;
+      S.FirstOccurrence = i;
+      S.NumOccurrences = 0;
+      Symbols.push_back(S);
+    }
+    ++Symbols.back().NumOccurrences;
+  }
+
+  IndexHeader H;
+  memset(&H, 0, sizeof(H));
+  H.Magic = IndexMagic;
+  H.Version = IndexVersion;
+  H.NumFiles = LiveFiles.size();
+  H.NumUnits = LiveUnits.size();
+  H.NumStrings = Strings.size();
+  H.NumSymbols = Symbols.size();
+  H.NumOccurrences = Occurrences.size();
+  H.StringDataSize = StringDataSize;
+  for (unsigned i = 0, e = LiveUnits.size(); i != e; ++i)
+    H.NumUnitFiles += Units[LiveUnits[i]].Files.size();
+
+  // Write next to the destination and rename, so that readers mapping the
+  // previous index never see a partial file.
+  std::string TempPath = Path.str() + ".tmp";
+  {
+    llvm::raw_fd_ostream OS(TempPath.c_str(), ErrorStr,
+                            llvm::raw_fd_ostream::F_Binary);
+    if (!ErrorStr.empty())
+      return true;
+
+    OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+    for (unsigned i = 0, e = LiveFiles.size(); i != e; ++i) {
+      const FileInfo &FI = Files[LiveFiles[i]];
+      FileRecord R;
+      memset(&R, 0, sizeof(R));
+      R.Path = std::lower_bound(Strings.begin(), Strings.end(),
+                                StringRef(FI.Path)) - Strings.begin();
+      R.Size = FI.Size;
+      R.ModTime = FI.ModTime;
+      R.Hash = FI.Hash;
+      OS.write(reinterpret_cast<const char *>(&R), sizeof(R));
+    }
+    uint32_t FirstFile = 0;
+    for (unsigned i = 0, e = LiveUnits.size(); i != e; ++i) {
+      const UnitInfo &UI = Units[LiveUnits[i]];
+      UnitRecord R;
+      memset(&R, 0, sizeof(R));
+      R.MainFile = FileMap[UI.MainFile];
+      R.FirstFile = FirstFile;
+      R.NumFiles = UI.Files.size();
+      FirstFile += R.NumFiles;
+      OS.write(reinterpret_cast<const char *>(&R), sizeof(R));
+    }
+    for (unsigned i = 0, e = LiveUnits.size(); i != e; ++i) {
+      const UnitInfo &UI = Units[LiveUnits[i]];
+      for (unsigned f = 0, n = UI.Files.size(); f != n; ++f) {
+        uint32_t File = FileMap[UI.Files[f]];
+        OS.write(reinterpret_cast<const char *>(&File), sizeof(File));
+      }
+    }
+    if (!StringOffsets.empty())
+      OS.write(reinterpret_cast<const char *>(&StringOffsets[0]),
+               StringOffsets.size() * sizeof(uint32_t));
+    if (!Symbols.empty())
+      OS.write(reinterpret_cast<const char *>(&Symbols[0]),
+               Symbols.size() * sizeof(SymbolRecord));
+    for (unsigned i = 0, e = Occurrences.size(); i != e; ++i) {
+      OccurrenceRecord R;
+      R.File = Occurrences[i].File;
+      R.Line = Occurrences[i].Line;
+      R.Column = Occurrences[i].Column;
+      R.Role = Occurrences[i].Role;
+      OS.write(reinterpret_cast<const char *>(&R), sizeof(R));
+    }
+    for (unsigned i = 0, e = Strings.size(); i != e; ++i) {
+      OS << Strings[i];
+      OS.write('\0');
+    }
+
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      ErrorStr = "error writing '" + TempPath + "'";
+      return true;
+    }
+  }
+
+  if (llvm::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  return false;
+}
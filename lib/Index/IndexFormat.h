@@ -0,0 +1,108 @@
+//===--- IndexFormat.h - Layout of symbol index files -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the records of a symbol index file, shared by the
+//  reader and the writer.  All fields are in host byte order; the magic
+//  number rejects files written on a host of different endianness.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LIB_INDEX_INDEXFORMAT_H
+#define LLVM_VLANG_LIB_INDEX_INDEXFORMAT_H
+
+#include "llvm/Support/DataTypes.h"
+#include <cstddef>
+
+namespace vlang {
+namespace index {
+namespace ondisk {
+
+static const uint32_t IndexMagic = 0x56495831; // 'VIX1'
+static const uint32_t IndexVersion = 1;
+
+/// \brief The header at the start of the file.  It is followed by the
+/// sections in the order of its counts: file records, unit records, unit
+/// file lists, string offsets, symbol records, occurrence records and
+/// string data.  The 64-bit file records come first so that every section
+/// is naturally aligned.
+struct IndexHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t NumFiles;
+  uint32_t NumUnits;
+  uint32_t NumUnitFiles;
+  uint32_t NumStrings;
+  uint32_t NumSymbols;
+  uint32_t NumOccurrences;
+  uint32_t StringDataSize;
+  uint32_t Padding;
+};
+
+struct FileRecord {
+  uint32_t Path;
+  uint32_t Padding;
+  uint64_t Size;
+  uint64_t ModTime;
+  uint64_t Hash;
+};
+
+struct UnitRecord {
+  uint32_t MainFile;
+  /// \brief The unit's files are UnitFiles[FirstFile, FirstFile + NumFiles).
+  uint32_t FirstFile;
+  uint32_t NumFiles;
+  uint32_t Padding;
+};
+
+struct SymbolRecord {
+  uint32_t Name;
+  uint32_t Kind;
+  /// \brief The symbol's posting list is
+  /// Occurrences[FirstOccurrence, FirstOccurrence + NumOccurrences), sorted
+  /// by file, line and column.
+  uint32_t FirstOccurrence;
+  uint32_t NumOccurrences;
+};
+
+struct OccurrenceRecord {
+  uint32_t File;
+  uint32_t Line;
+  uint32_t Column;
+  uint32_t Role;
+};
+
+inline size_t getFilesOffset() { return sizeof(IndexHeader); }
+inline size_t getUnitsOffset(const IndexHeader &H) {
+  return getFilesOffset() + H.NumFiles * sizeof(FileRecord);
+}
+inline size_t getUnitFilesOffset(const IndexHeader &H) {
+  return getUnitsOffset(H) + H.NumUnits * sizeof(UnitRecord);
+}
+inline size_t getStringOffsetsOffset(const IndexHeader &H) {
+  return getUnitFilesOffset(H) + H.NumUnitFiles * sizeof(uint32_t);
+}
+inline size_t getSymbolsOffset(const IndexHeader &H) {
+  return getStringOffsetsOffset(H) + H.NumStrings * sizeof(uint32_t);
+}
+inline size_t getOccurrencesOffset(const IndexHeader &H) {
+  return getSymbolsOffset(H) + H.NumSymbols * sizeof(SymbolRecord);
+}
+inline size_t getStringDataOffset(const IndexHeader &H) {
+  return getOccurrencesOffset(H) +
+         H.NumOccurrences * sizeof(OccurrenceRecord);
+}
+inline size_t getIndexSize(const IndexHeader &H) {
+  return getStringDataOffset(H) + H.StringDataSize;
+}
+
+} // end namespace ondisk
+} // end namespace index
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,222 @@
+//===--- SymbolIndex.cpp - Design-wide symbol index -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the SymbolIndex class, the reader of symbol index
+//  files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Index/SymbolIndex.h"
+#include "IndexFormat.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include <cassert>
+
+using namespace vlang;
+using namespace vlang::index;
+using namespace vlang::index::ondisk;
+
+const char *index::getSymbolKindName(SymbolKind K) {
+  switch (K) {
+  case SK_Module:    return "module";
+  case SK_Interface: return "interface";
+  case SK_Program:   return "program";
+  case SK_Package:   return "package";
+  case SK_Primitive: return "primitive";
+  case SK_Class:     return "class";
+  case SK_Checker:   return "checker";
+  case SK_Config:    return "config";
+  case SK_Parameter: return "parameter";
+  case SK_Port:      return "port";
+  case SK_Net:       return "net";
+  case SK_Task:      return "task";
+  case SK_Function:  return "function";
+  case SK_Macro:     return "macro";
+  case NumSymbolKinds: break;
+  }
+  llvm_unreachable("Invalid symbol kind");
+}
+
+const char *index::getSymbolRoleName(SymbolRole R) {
+  switch (R) {
+  case SR_Definition:    return "definition";
+  case SR_Reference:     return "reference";
+  case SR_Instantiation: return "instantiation";
+  case NumSymbolRoles: break;
+  }
+  llvm_unreachable("Invalid symbol role");
+}
+
+SymbolIndex::SymbolIndex()
+  : Header(0), StringOffsets(0), StringData(0), Files(0), Units(0),
+    UnitFiles(0), Symbols(0), Occurrences(0) {}
+
+SymbolIndex::~SymbolIndex() {}
+
+bool SymbolIndex::init() {
+  const char *Start = Buffer->getBufferStart();
+  size_t Size = Buffer->getBufferSize();
+  if (Size < sizeof(IndexHeader))
+    return true;
+  const IndexHeader *H = reinterpret_cast<const IndexHeader *>(Start);
+  if (H->Magic != IndexMagic || H->Version != IndexVersion ||
+      Size != getIndexSize(*H))
+    return true;
+  // Every string is NUL-terminated, so the data must end with one.
+  if (H->NumStrings != 0 &&
+      (H->StringDataSize == 0 || Start[Size - 1] != '\0'))
+    return true;
+
+  Header = H;
+  Files = reinterpret_cast<const FileRecord *>(Start + getFilesOffset());
+  Units = reinterpret_cast<const UnitRecord *>(Start + getUnitsOffset(*H));
+  UnitFiles =
+    reinterpret_cast<const uint32_t *>(Start + getUnitFilesOffset(*H));
+  StringOffsets =
+    reinterpret_cast<const uint32_t *>(Start + getStringOffsetsOffset(*H));
+  Symbols =
+    reinterpret_cast<const SymbolRecord *>(Start + getSymbolsOffset(*H));
+  Occurrences = reinterpret_cast<const OccurrenceRecord *>(
+    Start + getOccurrencesOffset(*H));
+  StringData = Start + getStringDataOffset(*H);
+  return false;
+}
+
+SymbolIndex *SymbolIndex::loadFromFile(StringRef Path, std::string &ErrorStr) {
+  OwningPtr<SymbolIndex> Result(new SymbolIndex());
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(
+        Path, Result->Buffer, -1, /*RequiresNullTerminator=*/false)) {
+    ErrorStr = EC.message();
+    return 0;
+  }
+  if (Result->init()) {
+    ErrorStr = "not a valid symbol index";
+    return 0;
+  }
+  return Result.take();
+}
+
+unsigned SymbolIndex::getNumStrings() const { return Header->NumStrings; }
+
+StringRef SymbolIndex::getString(unsigned ID) const {
+  assert(ID < Header->NumStrings && "String ID out of range");
+  return StringRef(StringData + StringOffsets[ID]);
+}
+
+bool SymbolIndex::lookupString(StringRef Str, unsigned &ID) const {
+  unsigned Lo = 0, Hi = Header->NumStrings;
+  while (Lo < Hi) {
+    unsigned Mid = Lo + (Hi - Lo) / 2;
+    int Cmp = getString(Mid).compare(Str);
+    if (Cmp == 0) {
+      ID = Mid;
+      return true;
+    }
+    if (Cmp < 0)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  return false;
+}
+
+unsigned SymbolIndex::getNumFiles() const { return Header->NumFiles; }
+
+StringRef SymbolIndex::getFilePath(unsigned File) const {
+  assert(File < Header->NumFiles && "File out of range");
+  return getString(Files[File].Path);
+}
+
+uint64_t SymbolIndex::getFileSize(unsigned File) const {
+  assert(File < Header->NumFiles && "File out of range");
+  return Files[File].Size;
+}
+
+uint64_t SymbolIndex::getFileModTime(unsigned File) const {
+  assert(File < Header->NumFiles && "File out of range");
+  return Files[File].ModTime;
+}
+
+uint64_t SymbolIndex::getFileHash(unsigned File) const {
+  assert(File < Header->NumFiles && "File out of range");
+  return Files[File].Hash;
+}
+
+unsigned SymbolIndex::getNumUnits() const { return Header->NumUnits; }
+
+unsigned SymbolIndex::getUnitMainFile(unsigned Unit) const {
+  assert(Unit < Header->NumUnits && "Unit out of range");
+  return Units[Unit].MainFile;
+}
+
+ArrayRef<uint32_t> SymbolIndex::getUnitFiles(unsigned Unit) const {
+  assert(Unit < Header->NumUnits && "Unit out of range");
+  return ArrayRef<uint32_t>(UnitFiles + Units[Unit].FirstFile,
+                            Units[Unit].NumFiles);
+}
+
+unsigned SymbolIndex::getNumSymbols() const { return Header->NumSymbols; }
+
+StringRef SymbolIndex::getSymbolName(unsigned Symbol) const {
+  assert(Symbol < Header->NumSymbols && "Symbol out of range");
+  return getString(Symbols[Symbol].Name);
+}
+
+SymbolKind SymbolIndex::getSymbolKind(unsigned Symbol) const {
+  assert(Symbol < Header->NumSymbols && "Symbol out of range");
+  return static_cast<SymbolKind>(Symbols[Symbol].Kind);
+}
+
+unsigned SymbolIndex::getNumOccurrences(unsigned Symbol) const {
+  assert(Symbol < Header->NumSymbols && "Symbol out of range");
+  return Symbols[Symbol].NumOccurrences;
+}
+
+SymbolOccurrence SymbolIndex::getOccurrence(unsigned Symbol,
+                                            unsigned I) const {
+  assert(I < getNumOccurrences(Symbol) && "Occurrence out of range");
+  const OccurrenceRecord &R = Occurrences[Symbols[Symbol].FirstOccurrence + I];
+  SymbolOccurrence Result;
+  Result.File = R.File;
+  Result.Line = R.Line;
+  Result.Column = R.Column;
+  Result.Kind = getSymbolKind(Symbol);
+  Result.Role = static_cast<SymbolRole>(R.Role);
+  return Result;
+}
+
+void SymbolIndex::findOccurrences(StringRef Name,
+                                  std::vector<SymbolOccurrence> &Out,
+                                  SymbolKind Kind, SymbolRole Role) const {
+  unsigned NameID;
+  if (!lookupString(Name, NameID))
+    return;
+
+  // Symbols are sorted by name ID, then kind; find the first one named Name.
+  unsigned Lo = 0, Hi = Header->NumSymbols;
+  while (Lo < Hi) {
+    unsigned Mid = Lo + (Hi - Lo) / 2;
+    if (Symbols[Mid].Name < NameID)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+
+  for (unsigned S = Lo, e = Header->NumSymbols;
+       S != e && Symbols[S].Name == NameID; ++S) {
+    if (Kind != NumSymbolKinds && Symbols[S].Kind != (unsigned)Kind)
+      continue;
+    for (unsigned I = 0, N = Symbols[S].NumOccurrences; I != N; ++I) {
+      SymbolOccurrence Occ = getOccurrence(S, I);
+      if (Role == NumSymbolRoles || Occ.Role == Role)
+        Out.push_back(Occ);
+    }
+  }
+}
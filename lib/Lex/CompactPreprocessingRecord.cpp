@@ -0,0 +1,271 @@
+//===--- CompactPreprocessingRecord.cpp - Columnar PP record --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the CompactPreprocessingRecord class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Lex/CompactPreprocessingRecord.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Lex/MacroInfo.h"
+#include "vlang/Lex/Token.h"
+#include "llvm/Support/Capacity.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <algorithm>
+
+using namespace vlang;
+
+CompactPreprocessingRecord::CompactPreprocessingRecord(SourceManager &SM)
+  : SourceMgr(&SM), Finalized(false), NumSegments(0), NumEntities(0),
+    NumStrings(0), SegmentPaths(0), SegmentFirst(0), StringOffsets(0),
+    StringData(0), Begins(0), Ends(0), Names(0), Kinds(0) {}
+
+CompactPreprocessingRecord::~CompactPreprocessingRecord() {}
+
+unsigned CompactPreprocessingRecord::getStringID(StringRef Str) {
+  llvm::StringMapEntry<unsigned> &Entry =
+    StringIDs.GetOrCreateValue(Str, StringOffsetsStorage.size());
+  if (Entry.getValue() == StringOffsetsStorage.size()) {
+    StringOffsetsStorage.push_back(StringDataStorage.size());
+    StringDataStorage.insert(StringDataStorage.end(), Str.begin(), Str.end());
+    StringDataStorage.push_back('\0');
+  }
+  return Entry.getValue();
+}
+
+void CompactPreprocessingRecord::addEntity(PreprocessedEntity::EntityKind Kind,
+                                           SourceRange Range,
+                                           StringRef Name) {
+  if (Range.getBegin().isInvalid())
+    return;
+  std::pair<FileID, unsigned> Begin =
+    SourceMgr->getDecomposedExpansionLoc(Range.getBegin());
+  if (Begin.first.isInvalid())
+    return;
+  unsigned EndOffset = Begin.second;
+  if (Range.getEnd().isValid()) {
+    std::pair<FileID, unsigned> End =
+      SourceMgr->getDecomposedExpansionLoc(Range.getEnd());
+    if (End.first == Begin.first && End.second > EndOffset)
+      EndOffset = End.second;
+  }
+
+  std::pair<llvm::DenseMap<FileID, unsigned>::iterator, bool> Segment =
+    SegmentIDs.insert(std::make_pair(Begin.first, SegmentFileIDs.size()));
+  if (Segment.second) {
+    StringRef Path;
+    if (const FileEntry *FE = SourceMgr->getFileEntryForID(Begin.first))
+      Path = FE->getName();
+    else
+      Path = SourceMgr->getBuffer(Begin.first)->getBufferIdentifier();
+    SegmentFileIDs.push_back(Begin.first);
+    SegmentPathsStorage.push_back(getStringID(Path));
+  }
+
+  EntitySegments.push_back(Segment.first->second);
+  BeginsStorage.push_back(Begin.second);
+  EndsStorage.push_back(EndOffset);
+  NamesStorage.push_back(getStringID(Name));
+  KindsStorage.push_back(Kind);
+  Finalized = false;
+}
+
+void CompactPreprocessingRecord::MacroExpands(const Token &MacroNameTok,
+                                              const MacroDirective *MD,
+                                              SourceRange Range,
+                                              const MacroArgs *Args) {
+  // As in PreprocessingRecord, nested expansions are not recorded.
+  if (MacroNameTok.getLocation().isMacroID())
+    return;
+  addEntity(PreprocessedEntity::MacroExpansionKind, Range,
+            MacroNameTok.getIdentifierInfo()->getName());
+}
+
+void CompactPreprocessingRecord::MacroDefined(const Token &MacroNameTok,
+                                              const MacroDirective *MD) {
+  const MacroInfo *MI = MD->getMacroInfo();
+  addEntity(PreprocessedEntity::MacroDefinitionKind,
+            SourceRange(MI->getDefinitionLoc(), MI->getDefinitionEndLoc()),
+            MacroNameTok.getIdentifierInfo()->getName());
+}
+
+void CompactPreprocessingRecord::InclusionDirective(
+    SourceLocation HashLoc, const Token &IncludeTok, StringRef FileName,
+    bool IsAngled, CharSourceRange FilenameRange, const FileEntry *File,
+    StringRef SearchPath, StringRef RelativePath) {
+  addEntity(PreprocessedEntity::InclusionDirectiveKind,
+            SourceRange(HashLoc, FilenameRange.getEnd()), FileName);
+}
+
+void CompactPreprocessingRecord::Ifdef(SourceLocation Loc,
+                                       const Token &MacroNameTok,
+                                       const MacroDirective *MD) {
+  // Tests of defined macros are recorded as references, like expansions.
+  if (MD)
+    addEntity(PreprocessedEntity::MacroExpansionKind,
+              MacroNameTok.getLocation(),
+              MacroNameTok.getIdentifierInfo()->getName());
+}
+
+void CompactPreprocessingRecord::Ifndef(SourceLocation Loc,
+                                        const Token &MacroNameTok,
+                                        const MacroDirective *MD) {
+  if (MD)
+    addEntity(PreprocessedEntity::MacroExpansionKind,
+              MacroNameTok.getLocation(),
+              MacroNameTok.getIdentifierInfo()->getName());
+}
+
+void CompactPreprocessingRecord::Defined(const Token &MacroNameTok,
+                                         const MacroDirective *MD) {
+  if (MD)
+    addEntity(PreprocessedEntity::MacroExpansionKind,
+              MacroNameTok.getLocation(),
+              MacroNameTok.getIdentifierInfo()->getName());
+}
+
+void CompactPreprocessingRecord::EndOfMainFile() {
+  finalize();
+}
+
+namespace {
+/// \brief Orders entity indices by segment, then begin offset, then the
+/// order they were recorded in.
+struct EntityLess {
+  const std::vector<uint32_t> &Segments;
+  const std::vector<uint32_t> &Begins;
+
+  EntityLess(const std::vector<uint32_t> &Segments,
+             const std::vector<uint32_t> &Begins)
+    : Segments(Segments), Begins(Begins) {}
+
+  bool operator()(unsigned LHS, unsigned RHS) const {
+    if (Segments[LHS] != Segments[RHS])
+      return Segments[LHS] < Segments[RHS];
+    if (Begins[LHS] != Begins[RHS])
+      return Begins[LHS] < Begins[RHS];
+    return LHS < RHS;
+  }
+};
+
+template <typename T>
+void permute(std::vector<T> &Column, const std::vector<unsigned> &Order) {
+  std::vector<T> Result(Column.size());
+  for (unsigned i = 0, e = Order.size(); i != e; ++i)
+    Result[i] = Column[Order[i]];
+  Column.swap(Result);
+}
+}
+
+void CompactPreprocessingRecord::finalize() {
+  if (Finalized)
+    return;
+
+  // Entities arrive in translation unit order, which interleaves the
+  // segments of included files; sort only if that order is not already
+  // segment-major.
+  unsigned N = EntitySegments.size();
+  bool IsSorted = true;
+  for (unsigned i = 1; i < N && IsSorted; ++i)
+    IsSorted = EntitySegments[i - 1] < EntitySegments[i] ||
+               (EntitySegments[i - 1] == EntitySegments[i] &&
+                BeginsStorage[i - 1] <= BeginsStorage[i]);
+  if (!IsSorted) {
+    std::vector<unsigned> Order(N);
+    for (unsigned i = 0; i != N; ++i)
+      Order[i] = i;
+    std::sort(Order.begin(), Order.end(),
+              EntityLess(EntitySegments, BeginsStorage));
+    permute(EntitySegments, Order);
+    permute(BeginsStorage, Order);
+    permute(EndsStorage, Order);
+    permute(NamesStorage, Order);
+    permute(KindsStorage, Order);
+  }
+
+  SegmentFirstStorage.assign(SegmentFileIDs.size() + 1, 0);
+  for (unsigned i = 0; i != N; ++i)
+    ++SegmentFirstStorage[EntitySegments[i] + 1];
+  for (unsigned S = 0, e = SegmentFileIDs.size(); S != e; ++S)
+    SegmentFirstStorage[S + 1] += SegmentFirstStorage[S];
+
+  setColumns();
+  Finalized = true;
+}
+
+void CompactPreprocessingRecord::setColumns() {
+  NumSegments = SegmentPathsStorage.size();
+  NumEntities = BeginsStorage.size();
+  NumStrings = StringOffsetsStorage.size();
+  SegmentPaths = NumSegments ? &SegmentPathsStorage[0] : 0;
+  SegmentFirst = &SegmentFirstStorage[0];
+  StringOffsets = NumStrings ? &StringOffsetsStorage[0] : 0;
+  StringData = NumStrings ? &StringDataStorage[0] : 0;
+  Begins = NumEntities ? &BeginsStorage[0] : 0;
+  Ends = NumEntities ? &EndsStorage[0] : 0;
+  Names = NumEntities ? &NamesStorage[0] : 0;
+  Kinds = NumEntities ? &KindsStorage[0] : 0;
+}
+
+bool CompactPreprocessingRecord::findSegment(FileID FID, unsigned &S) const {
+  llvm::DenseMap<FileID, unsigned>::const_iterator Pos = SegmentIDs.find(FID);
+  if (Pos == SegmentIDs.end())
+    return false;
+  S = Pos->second;
+  return true;
+}
+
+void CompactPreprocessingRecord::findSegments(
+    StringRef Path, SmallVectorImpl<unsigned> &Out) const {
+  for (unsigned S = 0; S != NumSegments; ++S)
+    if (getSegmentPath(S) == Path)
+      Out.push_back(S);
+}
+
+std::pair<unsigned, unsigned>
+CompactPreprocessingRecord::findEntitiesInRange(unsigned S,
+                                                unsigned BeginOffset,
+                                                unsigned EndOffset) const {
+  assert(Finalized && S < NumSegments && "Invalid segment");
+  const uint32_t *First = Ends + SegmentFirst[S];
+  const uint32_t *Last = Ends + SegmentFirst[S + 1];
+  unsigned Begin = std::lower_bound(First, Last, BeginOffset) - Ends;
+  unsigned End = std::upper_bound(Begins + Begin, Begins + SegmentFirst[S + 1],
+                                  EndOffset) - Begins;
+  return std::make_pair(Begin, std::max(Begin, End));
+}
+
+std::pair<unsigned, unsigned>
+CompactPreprocessingRecord::findEntitiesInRange(SourceRange Range) const {
+  if (Range.isInvalid())
+    return std::make_pair(0U, 0U);
+  std::pair<FileID, unsigned> Begin =
+    SourceMgr->getDecomposedExpansionLoc(Range.getBegin());
+  std::pair<FileID, unsigned> End =
+    SourceMgr->getDecomposedExpansionLoc(Range.getEnd());
+  unsigned S;
+  if (Begin.first != End.first || !findSegment(Begin.first, S))
+    return std::make_pair(0U, 0U);
+  return findEntitiesInRange(S, Begin.second, End.second);
+}
+
+size_t CompactPreprocessingRecord::getTotalMemory() const {
+  return llvm::capacity_in_bytes(SegmentIDs) +
+         llvm::capacity_in_bytes(SegmentFileIDs) +
+         llvm::capacity_in_bytes(SegmentPathsStorage) +
+         llvm::capacity_in_bytes(SegmentFirstStorage) +
+         llvm::capacity_in_bytes(StringOffsetsStorage) +
+         llvm::capacity_in_bytes(StringDataStorage) +
+         llvm::capacity_in_bytes(EntitySegments) +
+         llvm::capacity_in_bytes(BeginsStorage) +
+         llvm::capacity_in_bytes(EndsStorage) +
+         llvm::capacity_in_bytes(NamesStorage) +
+         llvm::capacity_in_bytes(KindsStorage);
+}
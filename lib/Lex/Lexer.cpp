@@ -26,6 +26,7 @@
 
 #include "vlang/Lex/Lexer.h"
 #include "vlang/Basic/CharInfo.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "vlang/Basic/SourceManager.h"
 #include "vlang/Lex/CodeCompletionHandler.h"
 #include "vlang/Lex/LexDiagnostic.h"
@@ -57,6 +58,7 @@ void Lexer::InitLexer(const char *BufStart, const char *BufPtr,
   BufferPtr = BufPtr;
   BufferEnd = BufEnd;
   BufferLast = BufStart;
+  PerfSampleCounter = 0;
 
   assert(BufEnd[0] == 0 &&
          "We assume that the input buffer has a null character at the end"
@@ -1937,12 +1939,21 @@ bool Lexer::isCodeCompletionPoint(const char *CurPtr) const {
   return false;
 }
 
+/// \brief With performance counters enabled, the lexing of one token in
+/// every this many is timed; see perf::PhaseScope.
+static const unsigned LexingSamplePeriod = 64;
+
 /// LexTokenInternal - This implements a simple verilog family lexer.  It is an
 /// extremely performance critical piece of code.  This assumes that the buffer
 /// has a null character at the end of the file.  This returns a preprocessing
 /// token, not a normal token, as such, it is an internal interface.  It assumes
 /// that the Flags of result have been cleared before calling this.
 void Lexer::LexTokenInternal(Token &Result) {
+   // Timing each token would take longer than lexing most of them, so only
+   // one in LexingSamplePeriod is timed.
+   perf::PhaseScope PerfScope(perf::Lexing, PerfSampleCounter,
+                              LexingSamplePeriod);
+
    if( BufferLast ) {
       //printf("%0s", llvm::StringRef(BufferLast, BufferPtr - BufferLast).str().c_str());
    }
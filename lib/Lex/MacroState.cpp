@@ -0,0 +1,307 @@
+//===--- MacroState.cpp - Persistent snapshots of macro state -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the MacroState and MacroStateTable classes.
+//
+//  The trie branches 32 ways on five bits of a key at each level.  The key
+//  is a bijective mix of the IdentifierInfo pointer, so distinct names never
+//  have equal keys and every path ends in a single leaf within 13 levels.
+//  A node holds a bitmap of the slots in use and a second one of those that
+//  hold leaves, followed by one pointer per slot in use.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Lex/MacroState.h"
+#include "vlang/Basic/IdentifierTable.h"
+#include "vlang/Basic/StableHash.h"
+#include "llvm/Support/AlignOf.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace vlang;
+
+namespace {
+
+struct Leaf {
+  const IdentifierInfo *Name;
+  const MacroInfo *Macro;
+  uint64_t Key;
+  /// \brief What the macro adds to the fingerprint of a state.
+  uint64_t EntryHash;
+};
+
+struct Node {
+  uint32_t Bitmap;
+  uint32_t LeafMap;
+  const void *Children[1];
+
+  unsigned size() const { return llvm::CountPopulation_32(Bitmap); }
+  unsigned getIndex(uint32_t Bit) const {
+    return llvm::CountPopulation_32(Bitmap & (Bit - 1));
+  }
+};
+
+} // end anonymous namespace
+
+static const unsigned BitsPerLevel = 5;
+
+/// The 64-bit finalizer of MurmurHash3, which is a bijection.
+static uint64_t mix(uint64_t K) {
+  K ^= K >> 33;
+  K *= 0xff51afd7ed558ccdULL;
+  K ^= K >> 33;
+  K *= 0xc4ceb9fe1a85ec53ULL;
+  K ^= K >> 33;
+  return K;
+}
+
+static uint64_t getKey(const IdentifierInfo *Name) {
+  return mix(reinterpret_cast<uintptr_t>(Name));
+}
+
+static uint32_t getBit(uint64_t Key, unsigned Shift) {
+  return 1U << ((Key >> Shift) & 31);
+}
+
+//===----------------------------------------------------------------------===//
+// Lookup
+//===----------------------------------------------------------------------===//
+
+const MacroInfo *MacroState::lookup(const IdentifierInfo *Name) const {
+  uint64_t Key = getKey(Name);
+  const Node *N = static_cast<const Node *>(Root);
+  for (unsigned Shift = 0; N; Shift += BitsPerLevel) {
+    uint32_t Bit = getBit(Key, Shift);
+    if (!(N->Bitmap & Bit))
+      return 0;
+    const void *Child = N->Children[N->getIndex(Bit)];
+    if (N->LeafMap & Bit) {
+      const Leaf *L = static_cast<const Leaf *>(Child);
+      return L->Name == Name ? L->Macro : 0;
+    }
+    N = static_cast<const Node *>(Child);
+  }
+  return 0;
+}
+
+//===----------------------------------------------------------------------===//
+// Path copying
+//===----------------------------------------------------------------------===//
+
+static Node *allocateNode(llvm::BumpPtrAllocator &Allocator,
+                          unsigned NumChildren) {
+  size_t Size = sizeof(Node) + (NumChildren ? NumChildren - 1 : 0) *
+                                 sizeof(const void *);
+  return static_cast<Node *>(
+    Allocator.Allocate(Size, llvm::AlignOf<Node>::Alignment));
+}
+
+/// Copies \p N with the child at \p Bit replaced by \p Child, or inserted if
+/// \p N has none there.
+static const Node *setChild(llvm::BumpPtrAllocator &Allocator, const Node *N,
+                            uint32_t Bit, const void *Child, bool IsLeaf) {
+  unsigned Size = N ? N->size() : 0;
+  bool Present = N && (N->Bitmap & Bit);
+  Node *Copy = allocateNode(Allocator, Present ? Size : Size + 1);
+  Copy->Bitmap = (N ? N->Bitmap : 0) | Bit;
+  Copy->LeafMap = ((N ? N->LeafMap : 0) & ~Bit) | (IsLeaf ? Bit : 0);
+  unsigned Index = Copy->getIndex(Bit);
+  for (unsigned I = 0, J = 0, E = Copy->size(); I != E; ++I) {
+    if (I == Index) {
+      Copy->Children[I] = Child;
+      if (Present)
+        ++J;
+      continue;
+    }
+    Copy->Children[I] = N->Children[J++];
+  }
+  return Copy;
+}
+
+/// Copies \p N without the child at \p Bit; null if it was the only one.
+static const Node *removeChild(llvm::BumpPtrAllocator &Allocator,
+                               const Node *N, uint32_t Bit) {
+  unsigned Size = N->size();
+  if (Size == 1)
+    return 0;
+  Node *Copy = allocateNode(Allocator, Size - 1);
+  Copy->Bitmap = N->Bitmap & ~Bit;
+  Copy->LeafMap = N->LeafMap & ~Bit;
+  unsigned Index = N->getIndex(Bit);
+  for (unsigned I = 0, J = 0; I != Size; ++I)
+    if (I != Index)
+      Copy->Children[J++] = N->Children[I];
+  return Copy;
+}
+
+/// Makes the subtrie holding the leaves \p A and \p B, whose keys agree
+/// below \p Shift.
+static const Node *makePair(llvm::BumpPtrAllocator &Allocator, const Leaf *A,
+                            const Leaf *B, unsigned Shift) {
+  uint32_t BitA = getBit(A->Key, Shift), BitB = getBit(B->Key, Shift);
+  if (BitA == BitB)
+    return setChild(Allocator, 0, BitA,
+                    makePair(Allocator, A, B, Shift + BitsPerLevel), false);
+  const Node *N = setChild(Allocator, 0, BitA, A, true);
+  return setChild(Allocator, N, BitB, B, true);
+}
+
+static const Node *insert(llvm::BumpPtrAllocator &Allocator, const Node *N,
+                          unsigned Shift, const Leaf *New,
+                          const Leaf *&Replaced) {
+  uint32_t Bit = getBit(New->Key, Shift);
+  if (!N || !(N->Bitmap & Bit))
+    return setChild(Allocator, N, Bit, New, true);
+
+  const void *Child = N->Children[N->getIndex(Bit)];
+  if (N->LeafMap & Bit) {
+    const Leaf *Old = static_cast<const Leaf *>(Child);
+    if (Old->Key == New->Key) {
+      Replaced = Old;
+      return setChild(Allocator, N, Bit, New, true);
+    }
+    return setChild(Allocator, N, Bit,
+                    makePair(Allocator, Old, New, Shift + BitsPerLevel),
+                    false);
+  }
+  const Node *Sub = insert(Allocator, static_cast<const Node *>(Child),
+                           Shift + BitsPerLevel, New, Replaced);
+  return setChild(Allocator, N, Bit, Sub, false);
+}
+
+static const Node *remove(llvm::BumpPtrAllocator &Allocator, const Node *N,
+                          unsigned Shift, uint64_t Key,
+                          const Leaf *&Removed) {
+  uint32_t Bit = getBit(Key, Shift);
+  if (!N || !(N->Bitmap & Bit))
+    return N;
+
+  const void *Child = N->Children[N->getIndex(Bit)];
+  if (N->LeafMap & Bit) {
+    const Leaf *Old = static_cast<const Leaf *>(Child);
+    if (Old->Key != Key)
+      return N;
+    Removed = Old;
+    return removeChild(Allocator, N, Bit);
+  }
+  const Node *Sub = remove(Allocator, static_cast<const Node *>(Child),
+                           Shift + BitsPerLevel, Key, Removed);
+  if (Sub == Child)
+    return N;
+  if (!Sub)
+    return removeChild(Allocator, N, Bit);
+  return setChild(Allocator, N, Bit, Sub, false);
+}
+
+void MacroStateTable::define(const IdentifierInfo *Name,
+                             const MacroInfo *Macro,
+                             uint64_t DefinitionHash) {
+  Leaf *New = new (Allocator.Allocate<Leaf>()) Leaf();
+  New->Name = Name;
+  New->Macro = Macro;
+  New->Key = getKey(Name);
+  New->EntryHash = mix(hashFNV1a(Name->getName()) ^ mix(DefinitionHash));
+
+  const Leaf *Replaced = 0;
+  Current.Root = insert(Allocator, static_cast<const Node *>(Current.Root), 0,
+                        New, Replaced);
+  Current.Fingerprint += New->EntryHash;
+  if (Replaced)
+    Current.Fingerprint -= Replaced->EntryHash;
+  else
+    ++Current.Size;
+}
+
+void MacroStateTable::undefine(const IdentifierInfo *Name) {
+  const Leaf *Removed = 0;
+  Current.Root = remove(Allocator, static_cast<const Node *>(Current.Root), 0,
+                        getKey(Name), Removed);
+  if (!Removed)
+    return;
+  Current.Fingerprint -= Removed->EntryHash;
+  --Current.Size;
+}
+
+//===----------------------------------------------------------------------===//
+// Diffs
+//===----------------------------------------------------------------------===//
+
+static void collectLeaves(const void *P, bool IsLeaf,
+                          SmallVectorImpl<const Leaf *> &Leaves) {
+  if (!P)
+    return;
+  if (IsLeaf) {
+    Leaves.push_back(static_cast<const Leaf *>(P));
+    return;
+  }
+  const Node *N = static_cast<const Node *>(P);
+  for (unsigned Slot = 0, I = 0; Slot != 32; ++Slot) {
+    uint32_t Bit = 1U << Slot;
+    if (N->Bitmap & Bit)
+      collectLeaves(N->Children[I++], N->LeafMap & Bit, Leaves);
+  }
+}
+
+/// Compares two subtries that are not both nodes by their leaves, of which
+/// there are few at the depth this happens.
+static void diffLeaves(const void *A, bool AIsLeaf, const void *B,
+                       bool BIsLeaf,
+                       SmallVectorImpl<MacroStateChange> &Changes) {
+  SmallVector<const Leaf *, 8> OldLeaves, NewLeaves;
+  collectLeaves(A, AIsLeaf, OldLeaves);
+  collectLeaves(B, BIsLeaf, NewLeaves);
+  for (unsigned I = 0, E = OldLeaves.size(); I != E; ++I) {
+    const Leaf *Old = OldLeaves[I];
+    const Leaf *New = 0;
+    for (unsigned J = 0, JE = NewLeaves.size(); J != JE; ++J)
+      if (NewLeaves[J] && NewLeaves[J]->Name == Old->Name) {
+        New = NewLeaves[J];
+        NewLeaves[J] = 0;
+        break;
+      }
+    if (New && New->EntryHash == Old->EntryHash)
+      continue;
+    MacroStateChange C = { Old->Name, Old->Macro, New ? New->Macro : 0 };
+    Changes.push_back(C);
+  }
+  for (unsigned J = 0, JE = NewLeaves.size(); J != JE; ++J) {
+    if (!NewLeaves[J])
+      continue;
+    MacroStateChange C = { NewLeaves[J]->Name, 0, NewLeaves[J]->Macro };
+    Changes.push_back(C);
+  }
+}
+
+static void diffNodes(const Node *A, const Node *B,
+                      SmallVectorImpl<MacroStateChange> &Changes) {
+  if (A == B)
+    return;
+  if (!A || !B) {
+    diffLeaves(A, false, B, false, Changes);
+    return;
+  }
+  for (unsigned Slot = 0, IA = 0, IB = 0; Slot != 32; ++Slot) {
+    uint32_t Bit = 1U << Slot;
+    const void *ChildA = (A->Bitmap & Bit) ? A->Children[IA++] : 0;
+    const void *ChildB = (B->Bitmap & Bit) ? B->Children[IB++] : 0;
+    if (ChildA == ChildB)
+      continue;
+    bool ALeaf = A->LeafMap & Bit, BLeaf = B->LeafMap & Bit;
+    if (ChildA && ChildB && !ALeaf && !BLeaf)
+      diffNodes(static_cast<const Node *>(ChildA),
+                static_cast<const Node *>(ChildB), Changes);
+    else
+      diffLeaves(ChildA, ALeaf, ChildB, BLeaf, Changes);
+  }
+}
+
+void MacroStateTable::diff(const MacroState &Old, const MacroState &New,
+                           SmallVectorImpl<MacroStateChange> &Changes) {
+  diffNodes(static_cast<const Node *>(Old.Root),
+            static_cast<const Node *>(New.Root), Changes);
+}
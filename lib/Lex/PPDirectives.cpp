@@ -14,6 +14,7 @@
 
 #include "vlang/Lex/Preprocessor.h"
 #include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "vlang/Basic/SourceManager.h"
 #include "vlang/Lex/CodeCompletionHandler.h"
 #include "vlang/Lex/HeaderSearch.h"
@@ -419,6 +420,8 @@ const FileEntry *Preprocessor::LookupFile(
     SmallVectorImpl<char> *SearchPath,
     SmallVectorImpl<char> *RelativePath,
     bool SkipCache) {
+  perf::PhaseScope PerfScope(perf::IncludeLookup);
+
   // If the header lookup mechanism may be relative to the current file, pass in
   // info about where the current file is.
   const FileEntry *CurFileEnt = 0;
@@ -474,6 +477,7 @@ private:
 /// lexer/preprocessor state, and advances the lexer(s) so that the next token
 /// read is the correct one.
 bool Preprocessor::HandleDirective(Token &Result) {
+  perf::PhaseScope PerfScope(perf::Directives);
 
   // We just parsed a ` character at the start of a line, so we're in directive
   // mode.  Tell the lexer this so any newlines we see will be converted into an
@@ -565,6 +569,9 @@ bool Preprocessor::HandleDirective(Token &Result) {
     case tok::pp_timescale:
        HandleTimescaleDirective(Result);
        return false;
+    case tok::pp_default_nettype:
+       HandleDefaultNettypeDirective(Result);
+       return false;
     // SV2012-22.6
     case tok::pp_ifdef:
        HandleIfdefDirective(Result, false, true/*not valid for miopt*/);
@@ -859,6 +866,7 @@ void Preprocessor::HandleIncludeDirective(Token &IncludeTok) {
   // Ask HeaderInfo if we should enter this `include file.  If not, `including
   // this file will have no effect.
   if (!HeaderInfo.ShouldEnterIncludeFile(File)) {
+    perf::count(perf::IncludesSkipped);
     if (Callbacks)
       Callbacks->FileSkipped(*File, FilenameTok, FileCharacter);
     return;
@@ -963,7 +971,11 @@ void Preprocessor::HandleTimescaleDirective(Token &Tok){
       Diag(Tok, diag::err_pp_expected_timescale_num) << "time precision";
       goto HandleTimescaleError;
    }
-   TimeUnitNum = Tok;
+   TimePrecNum = Tok;
+
+   Timescale = getSpelling(TimeUnitNum);
+   Timescale += '/';
+   Timescale += getSpelling(TimePrecNum);
 
    LexUnexpandedToken(Tok);
    if( Tok.isNot(tok::eod) ) {
@@ -976,10 +988,30 @@ HandleTimescaleError:
    }
 }
 
+/// HandleDefaultNettypeDirective - Implements \`default_nettype, whose
+/// argument is a net type keyword or \c none.
+void Preprocessor::HandleDefaultNettypeDirective(Token &Tok) {
+  LexUnexpandedToken(Tok);
+  if (Tok.is(tok::eod) || !Tok.getIdentifierInfo()) {
+    Diag(Tok, diag::err_pp_expected_nettype);
+    if (Tok.isNot(tok::eod))
+      DiscardUntilEndOfDirective();
+    return;
+  }
+  DefaultNettype = Tok.getIdentifierInfo()->getName();
+
+  LexUnexpandedToken(Tok);
+  if (Tok.isNot(tok::eod)) {
+    Diag(Tok, diag::err_pp_expected_eol);
+    DiscardUntilEndOfDirective();
+  }
+}
+
 /// HandleDefineDirective - Implements \`define.  This consumes the entire macro
 /// line then lets the caller lex the next real token.
 void Preprocessor::HandleDefineDirective(Token &DefineTok) {
   ++NumDefined;
+  perf::count(perf::MacrosDefined);
 
   Token MacroNameTok;
   ReadMacroName(MacroNameTok, 1);
@@ -14,6 +14,7 @@
 
 #include "vlang/Lex/Preprocessor.h"
 #include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "vlang/Basic/SourceManager.h"
 #include "vlang/Lex/HeaderSearch.h"
 #include "vlang/Lex/LexDiagnostic.h"
@@ -71,6 +72,7 @@ void Preprocessor::EnterSourceFile(FileID FID, const DirectoryLookup *CurDir,
                                    SourceLocation Loc) {
   assert(CurTokenLexer == 0 && "Cannot #include a file inside a macro!");
   ++NumEnteredSourceFiles;
+  perf::count(perf::FilesEntered);
 
   if (MaxIncludeStackDepth < IncludeMacroStack.size())
     MaxIncludeStackDepth = IncludeMacroStack.size();
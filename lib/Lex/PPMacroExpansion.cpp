@@ -15,7 +15,9 @@
 #include "vlang/Lex/Preprocessor.h"
 #include "vlang/Lex/MacroArgs.h"
 #include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "vlang/Basic/SourceManager.h"
+#include "vlang/Basic/StableHash.h"
 #include "vlang/Basic/TargetInfo.h"
 #include "vlang/Lex/CodeCompletionHandler.h"
 #include "vlang/Lex/ExternalPreprocessorSource.h"
@@ -49,6 +51,31 @@ void Preprocessor::appendMacroDirective(IdentifierInfo *II, MacroDirective *MD){
   MD->setPrevious(StoredMD);
   StoredMD = MD;
   II->setHasMacroDefinition(MD->isDefined());
+
+  if (MD->isDefined())
+    MacroStates.define(II, MD->getMacroInfo(),
+                       hashMacroDefinition(MD->getMacroInfo()));
+  else
+    MacroStates.undefine(II);
+}
+
+uint64_t Preprocessor::hashMacroDefinition(const MacroInfo *MI) {
+  uint64_t Hash = hashFNV1a(MI->isFunctionLike() ? "(" : "");
+  for (MacroInfo::arg_iterator I = MI->arg_begin(), E = MI->arg_end(); I != E;
+       ++I) {
+    Hash = hashFNV1a((*I)->getName(), Hash);
+    Hash = hashFNV1a(",", Hash);
+  }
+  // Token boundaries and whether whitespace precedes a token matter, as for
+  // redefinitions; how much whitespace does not.
+  SmallString<64> Buffer;
+  for (MacroInfo::tokens_iterator I = MI->tokens_begin(),
+                                  E = MI->tokens_end();
+       I != E; ++I) {
+    Hash = hashFNV1a(I->hasLeadingSpace() ? " " : "|", Hash);
+    Hash = hashFNV1a(getSpelling(*I, Buffer), Hash);
+  }
+  return Hash;
 }
 
 /// isTrivialSingleTokenExpansion - Return true if MI, which has a single token
@@ -126,6 +153,7 @@ bool Preprocessor::isNextPPTokenLParen() {
 /// expanded as a macro, handle it and return the next token as 'Identifier'.
 bool Preprocessor::HandleMacroExpandedIdentifier(Token &Identifier,
                                                  MacroDirective *MD) {
+  perf::PhaseScope PerfScope(perf::MacroExpansion);
   MacroDirective::DefInfo Def = MD->getDefinition();
   assert(Def.isValid());
   MacroInfo *MI = Def.getMacroInfo();
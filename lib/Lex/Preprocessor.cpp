@@ -30,6 +30,7 @@
 #include "vlang/Basic/FileManager.h"
 #include "vlang/Basic/SourceManager.h"
 #include "vlang/Lex/CodeCompletionHandler.h"
+#include "vlang/Lex/CompactPreprocessingRecord.h"
 #include "vlang/Lex/ExternalPreprocessorSource.h"
 #include "vlang/Lex/HeaderSearch.h"
 #include "vlang/Lex/LexDiagnostic.h"
@@ -64,8 +65,8 @@ Preprocessor::Preprocessor(IntrusiveRefCntPtr<PreprocessorOptions> PPOpts,
       CodeComplete(0), CodeCompletionFile(0), CodeCompletionOffset(0),
       CodeCompletionReached(0), SkipMainFilePreamble(0, true), CurPPLexer(0),
       CurDirLookup(0), CurLexerKind(CLK_Lexer), Callbacks(0),
-      MacroArgCache(0), Record(0), MIChainHead(0), MICache(0),
-      DeserialMIChainHead(0) {
+      MacroArgCache(0), Record(0), CompactRecord(0), MIChainHead(0),
+      MICache(0), DeserialMIChainHead(0) {
   OwnsHeaderSearch = OwnsHeaders;
   
   ScratchBuf = new ScratchBuffer(SourceMgr);
@@ -198,6 +199,7 @@ void Preprocessor::PrintStats() {
   llvm::errs() << (NumFastTokenPaste+NumTokenPaste)
              << " token paste (##) operations performed, "
              << NumFastTokenPaste << " on the fast path.\n";
+  llvm::errs() << ScratchBuf->getNumChunks() << " scratch buffer chunks.\n";
 
   llvm::errs() << "\nPreprocessor Memory: " << getTotalMemory() << "B total";
 
@@ -206,6 +208,7 @@ void Preprocessor::PrintStats() {
                << llvm::capacity_in_bytes(MacroExpandedTokens);
   llvm::errs() << "\n  Predefines Buffer: " << Predefines.capacity();
   llvm::errs() << "\n  Macros: " << llvm::capacity_in_bytes(Macros);
+  llvm::errs() << "\n  Macro States: " << MacroStates.getMemorySize();
   llvm::errs() << "\n  Poison Reasons: "
                << llvm::capacity_in_bytes(PoisonReasons);
   llvm::errs() << "\n  Comment Handlers: "
@@ -228,6 +231,7 @@ size_t Preprocessor::getTotalMemory() const {
     + llvm::capacity_in_bytes(MacroExpandedTokens)
     + Predefines.capacity() /* Predefines buffer. */
     + llvm::capacity_in_bytes(Macros)
+    + MacroStates.getMemorySize()
     + llvm::capacity_in_bytes(PoisonReasons)
     + llvm::capacity_in_bytes(CommentHandlers);
 }
@@ -277,6 +281,36 @@ StringRef Preprocessor::getLastMacroWithSpelling(
   return BestSpelling;
 }
 
+void Preprocessor::getSourceMacroDefinitions(
+    std::vector<std::pair<StringRef, StringRef> > &Result) const {
+  for (macro_iterator I = macro_begin(false), E = macro_end(false); I != E;
+       ++I) {
+    const MacroDirective *MD = I->second;
+    if (!MD->isDefined())
+      continue;
+    const MacroInfo *MI = MD->getMacroInfo();
+    SourceLocation Begin = MI->getDefinitionLoc();
+    SourceLocation End = MI->getDefinitionEndLoc();
+    if (Begin.isInvalid() || End.isInvalid() || !Begin.isFileID() ||
+        !End.isFileID())
+      continue;
+    std::pair<FileID, unsigned> BeginInfo = SourceMgr.getDecomposedLoc(Begin);
+    std::pair<FileID, unsigned> EndInfo = SourceMgr.getDecomposedLoc(End);
+    if (BeginInfo.first != EndInfo.first ||
+        !SourceMgr.getFileEntryForID(BeginInfo.first))
+      continue;
+
+    bool Invalid = false;
+    StringRef Buffer = SourceMgr.getBufferData(BeginInfo.first, &Invalid);
+    unsigned EndOffset =
+      EndInfo.second + Lexer::MeasureTokenLength(End, SourceMgr, LangOpts);
+    if (Invalid || EndOffset > Buffer.size() || EndOffset < BeginInfo.second)
+      continue;
+    Result.push_back(std::make_pair(I->first->getName(),
+                                    Buffer.slice(BeginInfo.second, EndOffset)));
+  }
+}
+
 void Preprocessor::recomputeCurLexerKind() {
   if (CurLexer)
     CurLexerKind = CLK_Lexer;
@@ -569,3 +603,11 @@ void Preprocessor::createPreprocessingRecord() {
   Record = new PreprocessingRecord(getSourceManager());
   addPPCallbacks(Record);
 }
+
+void Preprocessor::createCompactPreprocessingRecord() {
+  if (CompactRecord)
+    return;
+
+  CompactRecord = new CompactPreprocessingRecord(getSourceManager());
+  addPPCallbacks(CompactRecord);
+}
@@ -14,16 +14,23 @@
 #include "vlang/Lex/ScratchBuffer.h"
 #include "vlang/Basic/SourceManager.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include <algorithm>
 #include <cstring>
 using namespace vlang;
 
-// ScratchBufSize - The size of each chunk of scratch memory.  Slightly less
-//than a page, almost certainly enough for anything. :)
+// ScratchBufSize - The size of the first chunk of scratch memory.  Slightly
+// less than a page, almost certainly enough for anything. :)
 static const unsigned ScratchBufSize = 4060;
 
-ScratchBuffer::ScratchBuffer(SourceManager &SM) : SourceMgr(SM), CurBuffer(0) {
+// MaxScratchBufSize - Each chunk is twice the size of the previous one, up to
+// this size.
+static const unsigned MaxScratchBufSize = 1U << 20;
+
+ScratchBuffer::ScratchBuffer(SourceManager &SM)
+  : SourceMgr(SM), CurBuffer(0), NextBufferSize(ScratchBufSize),
+    NumChunks(0) {
   // Set BytesUsed so that the first call to getToken will require an alloc.
-  BytesUsed = ScratchBufSize;
+  BytesUsed = CurBufferSize = 0;
 }
 
 /// getToken - Splat the specified text into a temporary MemoryBuffer and
@@ -32,7 +39,7 @@ ScratchBuffer::ScratchBuffer(SourceManager &SM) : SourceMgr(SM), CurBuffer(0) {
 /// token.
 SourceLocation ScratchBuffer::getToken(const char *Buf, unsigned Len,
                                        const char *&DestPtr) {
-  if (BytesUsed+Len+2 > ScratchBufSize)
+  if (BytesUsed+Len+2 > CurBufferSize)
     AllocScratchBuffer(Len+2);
 
   // Prefix the token with a \n, so that it looks like it is the first thing on
@@ -57,11 +64,14 @@ SourceLocation ScratchBuffer::getToken(const char *Buf, unsigned Len,
 }
 
 void ScratchBuffer::AllocScratchBuffer(unsigned RequestLen) {
-  // Only pay attention to the requested length if it is larger than our default
-  // page size.  If it is, we allocate an entire chunk for it.  This is to
-  // support gigantic tokens, which almost certainly won't happen. :)
-  if (RequestLen < ScratchBufSize)
-    RequestLen = ScratchBufSize;
+  // Only pay attention to the requested length if it is larger than the next
+  // chunk.  If it is, we allocate an entire chunk for it.  This is to support
+  // gigantic tokens, which almost certainly won't happen. :)
+  if (RequestLen < NextBufferSize)
+    RequestLen = NextBufferSize;
+  NextBufferSize = std::min(NextBufferSize * 2, MaxScratchBufSize);
+  CurBufferSize = RequestLen;
+  ++NumChunks;
 
   llvm::MemoryBuffer *Buf =
     llvm::MemoryBuffer::getNewMemBuffer(RequestLen, "<scratch space>");
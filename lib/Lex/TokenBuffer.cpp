@@ -0,0 +1,121 @@
+//===--- TokenBuffer.cpp - Preprocessed token stream ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the TokenBuffer interface.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Lex/TokenBuffer.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "llvm/Support/Capacity.h"
+using namespace vlang;
+
+void TokenBuffer::lexAll(Preprocessor &PP) {
+  Token Tok;
+  do {
+    PP.Lex(Tok);
+
+    // Directives take effect before the token that follows them is returned,
+    // so the state now is the one this token was lexed in.
+    const MacroState &Macros = PP.getMacroState();
+    if (States.empty() || States.back().Macros != Macros ||
+        States.back().Timescale != PP.getTimescale() ||
+        States.back().DefaultNettype != PP.getDefaultNettype()) {
+      DirectiveState State;
+      State.FirstToken = size();
+      State.Macros = Macros;
+      State.Timescale = PP.getTimescale();
+      State.DefaultNettype = PP.getDefaultNettype();
+      States.push_back(State);
+    }
+
+    push_back(Tok);
+  } while (Tok.isNot(tok::eof));
+}
+
+const TokenBuffer::DirectiveState *
+TokenBuffer::getDirectiveState(unsigned Idx) const {
+  // The last state that starts at or before Idx.
+  unsigned Lo = 0, Hi = States.size();
+  while (Lo != Hi) {
+    unsigned Mid = Lo + (Hi - Lo) / 2;
+    if (States[Mid].FirstToken <= Idx)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  return Lo == 0 ? 0 : &States[Lo - 1];
+}
+
+void TokenBuffer::push_back(const Token &Tok) {
+  assert(!Tok.isAnnotation() && "Cannot buffer annotation tokens");
+  Kinds.push_back(Tok.getKind());
+  Flags.push_back(Tok.getFlags());
+  Locations.push_back(Tok.getLocation().getRawEncoding());
+  Lengths.push_back(Tok.getLength());
+
+  if (Tok.isLiteral()) {
+    if (const char *Data = Tok.getLiteralData()) {
+      LiteralData.push_back(Data);
+      DataIndices.push_back(LiteralData.size());
+    } else
+      DataIndices.push_back(0);
+    return;
+  }
+
+  IdentifierInfo *II = Tok.is(tok::raw_identifier) ? 0
+                                                   : Tok.getIdentifierInfo();
+  if (!II) {
+    DataIndices.push_back(0);
+    return;
+  }
+  unsigned &Index = IdentifierIndices[II];
+  if (Index == 0) {
+    Identifiers.push_back(II);
+    Index = Identifiers.size();
+  }
+  DataIndices.push_back(Index);
+}
+
+void TokenBuffer::clear() {
+  Kinds.clear();
+  Flags.clear();
+  Locations.clear();
+  Lengths.clear();
+  DataIndices.clear();
+  Identifiers.clear();
+  IdentifierIndices.clear();
+  LiteralData.clear();
+  States.clear();
+}
+
+void TokenBuffer::getToken(unsigned Idx, Token &Result) const {
+  Result.startToken();
+  Result.setKind(getKind(Idx));
+  Result.setLocation(getLocation(Idx));
+  Result.setLength(Lengths[Idx]);
+  if (unsigned TokFlags = Flags[Idx])
+    Result.setFlag((Token::TokenFlags)TokFlags);
+  if (unsigned DataIdx = DataIndices[Idx]) {
+    if (Result.isLiteral())
+      Result.setLiteralData(LiteralData[DataIdx - 1]);
+    else
+      Result.setIdentifierInfo(Identifiers[DataIdx - 1]);
+  }
+}
+
+size_t TokenBuffer::getMemorySize() const {
+  return llvm::capacity_in_bytes(Kinds) + llvm::capacity_in_bytes(Flags) +
+         llvm::capacity_in_bytes(Locations) + llvm::capacity_in_bytes(Lengths) +
+         llvm::capacity_in_bytes(DataIndices) +
+         llvm::capacity_in_bytes(Identifiers) +
+         llvm::capacity_in_bytes(IdentifierIndices) +
+         llvm::capacity_in_bytes(LiteralData) +
+         llvm::capacity_in_bytes(States);
+}
@@ -13,6 +13,7 @@
 
 #include "vlang/Lex/TokenLexer.h"
 #include "vlang/Lex/MacroArgs.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "vlang/Basic/SourceManager.h"
 #include "vlang/Lex/LexDiagnostic.h"
 #include "vlang/Lex/MacroInfo.h"
@@ -309,6 +310,8 @@ void TokenLexer::ExpandFunctionArguments() {
 /// Lex - Lex and return a token from this macro stream.
 ///
 void TokenLexer::Lex(Token &Tok) {
+  perf::PhaseScope PerfScope(perf::MacroExpansion);
+
   // Lexing off the end of the macro, pop this macro off the expansion stack.
   if (isAtEnd()) {
     // If this is a macro (not a token stream), mark the macro enabled now
@@ -0,0 +1,736 @@
+//===--- NetlistDatabase.cpp - Design connectivity graph ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the NetlistDatabase and CellLibrary classes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Netlist/NetlistDatabase.h"
+#include "NetlistFormat.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Parse/NetlistTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/Capacity.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace vlang;
+
+//===----------------------------------------------------------------------===//
+// CellLibrary
+//===----------------------------------------------------------------------===//
+
+static void getCellPinKey(StringRef Cell, StringRef Pin,
+                          SmallVectorImpl<char> &Key) {
+  Key.append(Cell.begin(), Cell.end());
+  Key.push_back('\0');
+  Key.append(Pin.begin(), Pin.end());
+}
+
+void CellLibrary::addPin(StringRef Cell, StringRef Pin, PortKind Kind) {
+  SmallString<64> Key;
+  getCellPinKey(Cell, Pin, Key);
+  Pins[Key] = Kind;
+}
+
+PortKind CellLibrary::getPinKind(StringRef Cell, StringRef Pin) const {
+  SmallString<64> Key;
+  getCellPinKey(Cell, Pin, Key);
+  llvm::StringMap<PortKind>::const_iterator I = Pins.find(Key);
+  return I == Pins.end() ? PortKind::Unknown : I->getValue();
+}
+
+//===----------------------------------------------------------------------===//
+// Building
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief How the terminals of a cell are directed.
+enum CellClass {
+  CC_Unclassified,
+  CC_Other,         // A library cell or undefined module.
+  CC_Gate,          // and, nand, ..., bufif0, nmos, ...: output, inputs.
+  CC_Buffer,        // buf, not: outputs, input.
+  CC_Tran,          // tran, rtran: inouts.
+  CC_TranIf,        // tranif0, ...: inout, inout, control input.
+  CC_Pull           // pullup, pulldown: outputs.
+};
+
+} // end anonymous namespace
+
+static CellClass classifyCell(StringRef Name) {
+  return llvm::StringSwitch<CellClass>(Name)
+    .Cases("and", "nand", "or", "nor", CC_Gate)
+    .Cases("xor", "xnor", "assign", CC_Gate)
+    .Cases("bufif0", "bufif1", "notif0", "notif1", CC_Gate)
+    .Cases("cmos", "rcmos", "nmos", "rnmos", CC_Gate)
+    .Cases("pmos", "rpmos", CC_Gate)
+    .Cases("buf", "not", CC_Buffer)
+    .Cases("tran", "rtran", CC_Tran)
+    .Cases("tranif0", "tranif1", "rtranif0", "rtranif1", CC_TranIf)
+    .Cases("pullup", "pulldown", CC_Pull)
+    .Default(CC_Other);
+}
+
+static NetlistDatabase::PinRole getTerminalRole(CellClass Class,
+                                                unsigned Position,
+                                                unsigned NumTerminals) {
+  switch (Class) {
+  case CC_Gate:
+    return Position == 0 ? NetlistDatabase::PR_Driver
+                         : NetlistDatabase::PR_Load;
+  case CC_Buffer:
+    return Position + 1 == NumTerminals ? NetlistDatabase::PR_Load
+                                        : NetlistDatabase::PR_Driver;
+  case CC_Tran:
+    return NetlistDatabase::PR_Bidirectional;
+  case CC_TranIf:
+    return Position < 2 ? NetlistDatabase::PR_Bidirectional
+                        : NetlistDatabase::PR_Load;
+  case CC_Pull:
+    return NetlistDatabase::PR_Driver;
+  default:
+    return NetlistDatabase::PR_Unknown;
+  }
+}
+
+/// \brief The role on its nets of a pin connected to a port of direction
+/// \p Kind, seen from outside the module, or from inside if \p Inside.
+static NetlistDatabase::PinRole getPortRole(PortKind Kind, bool Inside) {
+  switch (Kind) {
+  case PortKind::Input:
+    return Inside ? NetlistDatabase::PR_Driver : NetlistDatabase::PR_Load;
+  case PortKind::Output:
+    return Inside ? NetlistDatabase::PR_Load : NetlistDatabase::PR_Driver;
+  case PortKind::Inout:
+  case PortKind::Ref:
+    return NetlistDatabase::PR_Bidirectional;
+  default:
+    return NetlistDatabase::PR_Unknown;
+  }
+}
+
+static uint64_t getPairKey(unsigned Hi, unsigned Lo) {
+  return ((uint64_t)Hi << 32) | Lo;
+}
+
+namespace vlang {
+
+/// \brief Builds a NetlistDatabase from a NetlistTable.
+///
+/// The table lists instances, nets and ports in parse order, which groups
+/// them by module unless a module was defined twice or something was
+/// recorded outside any module.  They are bucketed by module with a stable
+/// counting sort, then the instance pins are copied with their roles, the
+/// port pins are added, and the net-to-pin rows are filled by a second
+/// counting pass over the pins.
+class NetlistDatabaseBuilder {
+  const NetlistTable &Table;
+  const CellLibrary *Library;
+  const SourceManager *SM;
+  NetlistDatabase &DB;
+
+  /// \brief The table's modules, plus one last bucket for items outside
+  /// any module.
+  unsigned NumBuckets;
+
+  std::vector<uint32_t> InstanceOrder;   // New instance -> table instance.
+  std::vector<uint32_t> NetIndex;        // Table net -> new net.
+  std::vector<uint32_t> PortOrder;       // New port -> table port.
+
+  /// \brief By name ID, the module defined with that name, or NoModule.
+  std::vector<uint32_t> ModuleByName;
+  /// \brief By name ID, the CellClass of cells of that name.
+  std::vector<uint8_t> CellClasses;
+  /// \brief (module, port name) -> port.
+  llvm::DenseMap<uint64_t, unsigned> PortsByName;
+  /// \brief (cell name, pin name) -> PinRole, for library cells.
+  llvm::DenseMap<uint64_t, unsigned> LibraryRoles;
+  /// \brief The files instances were found in -> their index in FileNames.
+  llvm::DenseMap<FileID, unsigned> FileIndex;
+
+  unsigned getBucket(unsigned Module) const {
+    return Module == NetlistTable::NoModule ? NumBuckets - 1 : Module;
+  }
+
+  template <typename GetModuleFn>
+  static void sortByModule(unsigned NumItems, unsigned NumBuckets,
+                           GetModuleFn GetBucket, std::vector<uint32_t> &Begin,
+                           std::vector<uint32_t> &NewIndex);
+
+  void copyNames();
+  unsigned addName(StringRef Name);
+  void addModules();
+  void setInstanceLoc(unsigned I, SourceLocation Loc);
+  NetlistDatabase::PinRole getPinRole(unsigned Cell, unsigned Template,
+                                      unsigned Pin, unsigned NumPins);
+  void addInstances();
+  void addNets();
+  void addPortPins();
+  void addNetPins();
+
+public:
+  NetlistDatabaseBuilder(const NetlistTable &Table, const CellLibrary *Library,
+                         const SourceManager *SM, NetlistDatabase &DB)
+    : Table(Table), Library(Library), SM(SM), DB(DB),
+      NumBuckets(Table.getNumModules() + 1) {}
+
+  void build();
+};
+
+} // end namespace vlang
+
+/// Computes, for NumItems items whose buckets GetBucket gives, the start of
+/// each bucket in Begin (with NumBuckets + 1 entries) and each item's index
+/// once the items are ordered by bucket, keeping their order within one.
+template <typename GetModuleFn>
+void NetlistDatabaseBuilder::sortByModule(unsigned NumItems,
+                                          unsigned NumBuckets,
+                                          GetModuleFn GetBucket,
+                                          std::vector<uint32_t> &Begin,
+                                          std::vector<uint32_t> &NewIndex) {
+  Begin.assign(NumBuckets + 1, 0);
+  for (unsigned I = 0; I != NumItems; ++I)
+    ++Begin[GetBucket(I) + 1];
+  for (unsigned B = 0; B != NumBuckets; ++B)
+    Begin[B + 1] += Begin[B];
+
+  std::vector<uint32_t> Next(Begin.begin(), Begin.end() - 1);
+  NewIndex.resize(NumItems);
+  for (unsigned I = 0; I != NumItems; ++I)
+    NewIndex[I] = Next[GetBucket(I)]++;
+}
+
+void NetlistDatabaseBuilder::copyNames() {
+  unsigned NumNames = Table.getNumNames();
+  DB.NameOffsets.Storage.reserve(NumNames + 1);
+  DB.NameOffsets.Storage.push_back(0);
+  for (unsigned ID = 0; ID != NumNames; ++ID)
+    addName(Table.getName(ID));
+
+  ModuleByName.assign(NumNames, NetlistDatabase::NoModule);
+  CellClasses.assign(NumNames, CC_Unclassified);
+}
+
+/// Appends \p Name, which gets the next name ID.
+unsigned NetlistDatabaseBuilder::addName(StringRef Name) {
+  std::vector<char> &Data = DB.NameData.Storage;
+  Data.insert(Data.end(), Name.begin(), Name.end());
+  DB.NameOffsets.Storage.push_back(Data.size());
+  return DB.NameOffsets.Storage.size() - 2;
+}
+
+void NetlistDatabaseBuilder::addModules() {
+  for (unsigned M = 0, e = Table.getNumModules(); M != e; ++M) {
+    DB.ModuleNames.Storage.push_back(Table.getModuleName(M));
+    // Instances of a module defined twice refer to its first definition.
+    if (ModuleByName[Table.getModuleName(M)] == NetlistDatabase::NoModule)
+      ModuleByName[Table.getModuleName(M)] = M;
+  }
+  DB.ModuleNames.Storage.push_back(NetlistTable::NoName);
+
+  std::vector<uint32_t> PortIndex;
+  sortByModule(Table.getNumPorts(), NumBuckets,
+               [&](unsigned P) { return getBucket(Table.getPort(P).Module); },
+               DB.ModulePortBegin.Storage, PortIndex);
+  unsigned NumPorts = Table.getNumPorts();
+  PortOrder.resize(NumPorts);
+  for (unsigned P = 0; P != NumPorts; ++P)
+    PortOrder[PortIndex[P]] = P;
+
+  DB.PortNames.Storage.resize(NumPorts);
+  DB.PortKinds.Storage.resize(NumPorts);
+  for (unsigned P = 0; P != NumPorts; ++P) {
+    const NetlistTable::Port &Port = Table.getPort(PortOrder[P]);
+    DB.PortNames.Storage[P] = Port.Name;
+    DB.PortKinds.Storage[P] = Port.Kind;
+    PortsByName[getPairKey(getBucket(Port.Module), Port.Name)] = P;
+  }
+}
+
+NetlistDatabase::PinRole
+NetlistDatabaseBuilder::getPinRole(unsigned Cell, unsigned Template,
+                                   unsigned Pin, unsigned NumPins) {
+  bool Ordered = NetlistTable::isOrderedPin(Pin);
+  unsigned Position = Pin & ~(unsigned)NetlistTable::OrderedPinFlag;
+
+  // A module of the design: the direction of the port connected.
+  if (Template != NetlistDatabase::NoModule) {
+    unsigned Port = NetlistDatabase::NoPort;
+    if (Ordered) {
+      if (Position < DB.ModulePortBegin.Storage[Template + 1] -
+                     DB.ModulePortBegin.Storage[Template])
+        Port = DB.ModulePortBegin.Storage[Template] + Position;
+    } else {
+      llvm::DenseMap<uint64_t, unsigned>::const_iterator I =
+        PortsByName.find(getPairKey(Template, Pin));
+      if (I != PortsByName.end())
+        Port = I->second;
+    }
+    return Port == NetlistDatabase::NoPort
+             ? NetlistDatabase::PR_Unknown
+             : getPortRole(DB.PortKinds.Storage[Port], /*Inside=*/false);
+  }
+
+  uint8_t &Class = CellClasses[Cell];
+  if (Class == CC_Unclassified)
+    Class = classifyCell(Table.getName(Cell));
+  if (Class != CC_Other)
+    return Ordered ? getTerminalRole(CellClass(Class), Position, NumPins)
+                   : NetlistDatabase::PR_Unknown;
+
+  // A library cell.
+  if (!Library || Ordered)
+    return NetlistDatabase::PR_Unknown;
+  std::pair<llvm::DenseMap<uint64_t, unsigned>::iterator, bool> Entry =
+    LibraryRoles.insert(std::make_pair(getPairKey(Cell, Pin), 0U));
+  if (Entry.second)
+    Entry.first->second =
+      getPortRole(Library->getPinKind(Table.getName(Cell), Table.getName(Pin)),
+                  /*Inside=*/false);
+  return NetlistDatabase::PinRole(Entry.first->second);
+}
+
+/// Resolves \p Loc, the location of instance \p I, to the file and offset
+/// it was expanded at, numbering files in the order they are first seen.
+void NetlistDatabaseBuilder::setInstanceLoc(unsigned I, SourceLocation Loc) {
+  DB.InstanceFiles.Storage[I] = NetlistDatabase::NoFile;
+  DB.InstanceOffsets.Storage[I] = 0;
+  if (!SM || Loc.isInvalid())
+    return;
+
+  std::pair<FileID, unsigned> Decomposed = SM->getDecomposedExpansionLoc(Loc);
+  std::pair<llvm::DenseMap<FileID, unsigned>::iterator, bool> Entry =
+    FileIndex.insert(std::make_pair(Decomposed.first, 0U));
+  if (Entry.second) {
+    const FileEntry *File = SM->getFileEntryForID(Decomposed.first);
+    if (File) {
+      Entry.first->second = DB.FileNames.Storage.size();
+      DB.FileNames.Storage.push_back(addName(File->getName()));
+    } else
+      Entry.first->second = NetlistDatabase::NoFile;
+  }
+  DB.InstanceFiles.Storage[I] = Entry.first->second;
+  DB.InstanceOffsets.Storage[I] = Decomposed.second;
+}
+
+void NetlistDatabaseBuilder::addNets() {
+  unsigned NumNets = Table.getNumNets();
+  sortByModule(NumNets, NumBuckets,
+               [&](unsigned N) { return getBucket(Table.getNet(N).Module); },
+               DB.ModuleNetBegin.Storage, NetIndex);
+
+  DB.NetModules.Storage.resize(NumNets);
+  DB.NetNames.Storage.resize(NumNets);
+  DB.NetBits.Storage.resize(NumNets);
+  for (unsigned N = 0; N != NumNets; ++N) {
+    const NetlistTable::Net &Net = Table.getNet(N);
+    unsigned New = NetIndex[N];
+    DB.NetModules.Storage[New] = getBucket(Net.Module);
+    DB.NetNames.Storage[New] = Net.Name;
+    DB.NetBits.Storage[New] = Net.Bit;
+  }
+}
+
+void NetlistDatabaseBuilder::addInstances() {
+  unsigned NumInstances = Table.getNumInstances();
+  std::vector<uint32_t> InstanceIndex;
+  sortByModule(NumInstances, NumBuckets,
+               [&](unsigned I) {
+                 return getBucket(Table.getInstance(I).Module);
+               },
+               DB.ModuleInstanceBegin.Storage, InstanceIndex);
+  InstanceOrder.resize(NumInstances);
+  for (unsigned I = 0; I != NumInstances; ++I)
+    InstanceOrder[InstanceIndex[I]] = I;
+  std::vector<uint32_t>().swap(InstanceIndex);
+
+  unsigned NumPins = Table.getNumConnections();
+  DB.InstanceNames.Storage.resize(NumInstances);
+  DB.InstanceCells.Storage.resize(NumInstances);
+  DB.InstanceTemplates.Storage.resize(NumInstances);
+  DB.InstanceFiles.Storage.resize(NumInstances);
+  DB.InstanceOffsets.Storage.resize(NumInstances);
+  DB.InstancePinBegin.Storage.resize(NumInstances + 1);
+  std::vector<uint32_t> &PinNets = DB.PinNets.Storage;
+  PinNets.reserve(NumPins);
+  DB.PinNames.Storage.reserve(NumPins);
+  DB.PinInstances.Storage.reserve(NumPins);
+  DB.PinRoles.Storage.reserve(NumPins);
+
+  for (unsigned I = 0; I != NumInstances; ++I) {
+    const NetlistTable::Instance &Inst = Table.getInstance(InstanceOrder[I]);
+    unsigned Template = ModuleByName[Inst.Cell];
+    DB.InstanceNames.Storage[I] = Inst.Name;
+    DB.InstanceCells.Storage[I] = Inst.Cell;
+    DB.InstanceTemplates.Storage[I] = Template;
+    setInstanceLoc(I, SourceLocation::getFromRawEncoding(Inst.Loc));
+    DB.InstancePinBegin.Storage[I] = PinNets.size();
+
+    ArrayRef<NetlistTable::Connection> Conns =
+      Table.getConnections(InstanceOrder[I]);
+    for (unsigned C = 0, e = Conns.size(); C != e; ++C) {
+      unsigned Net = Conns[C].Net;
+      PinNets.push_back(Net == NetlistTable::NoNet ? NetlistDatabase::NoNet
+                                                   : NetIndex[Net]);
+      DB.PinNames.Storage.push_back(Conns[C].Pin);
+      DB.PinInstances.Storage.push_back(I);
+      DB.PinRoles.Storage.push_back(
+        getPinRole(Inst.Cell, Template, Conns[C].Pin, e));
+    }
+  }
+  DB.InstancePinBegin.Storage[NumInstances] = PinNets.size();
+}
+
+void NetlistDatabaseBuilder::addPortPins() {
+  unsigned NumPorts = DB.PortNames.Storage.size();
+  DB.PortNets.Storage.assign(NumPorts, NetlistDatabase::NoNet);
+  DB.ModulePortPinBegin.Storage.resize(NumBuckets + 1);
+
+  const std::vector<uint32_t> &NetBegin = DB.ModuleNetBegin.Storage;
+  for (unsigned M = 0; M != NumBuckets; ++M) {
+    DB.ModulePortPinBegin.Storage[M] = DB.PinNets.Storage.size();
+    for (unsigned N = NetBegin[M], e = NetBegin[M + 1]; N != e; ++N) {
+      if (DB.NetBits.Storage[N] == NetlistTable::ConstantBit ||
+          DB.NetBits.Storage[N] == NetlistTable::OpaqueBit)
+        continue;
+      llvm::DenseMap<uint64_t, unsigned>::const_iterator I =
+        PortsByName.find(getPairKey(M, DB.NetNames.Storage[N]));
+      if (I == PortsByName.end())
+        continue;
+      unsigned Port = I->second;
+      if (DB.NetBits.Storage[N] == NetlistTable::NoBit)
+        DB.PortNets.Storage[Port] = N;
+      DB.PinNets.Storage.push_back(N);
+      DB.PinNames.Storage.push_back(DB.PortNames.Storage[Port]);
+      DB.PinInstances.Storage.push_back(NetlistDatabase::NoInstance);
+      DB.PinRoles.Storage.push_back(
+        getPortRole(DB.PortKinds.Storage[Port], /*Inside=*/true));
+    }
+  }
+  DB.ModulePortPinBegin.Storage[NumBuckets] = DB.PinNets.Storage.size();
+}
+
+void NetlistDatabaseBuilder::addNetPins() {
+  unsigned NumNets = DB.NetNames.Storage.size();
+  unsigned NumPins = DB.PinNets.Storage.size();
+  std::vector<uint32_t> &Begin = DB.NetPinBegin.Storage;
+  Begin.assign(NumNets + 1, 0);
+  for (unsigned P = 0; P != NumPins; ++P)
+    if (DB.PinNets.Storage[P] != NetlistDatabase::NoNet)
+      ++Begin[DB.PinNets.Storage[P] + 1];
+  for (unsigned N = 0; N != NumNets; ++N)
+    Begin[N + 1] += Begin[N];
+
+  std::vector<uint32_t> Next(Begin.begin(), Begin.end() - 1);
+  DB.NetPins.Storage.resize(Begin[NumNets]);
+  for (unsigned P = 0; P != NumPins; ++P)
+    if (DB.PinNets.Storage[P] != NetlistDatabase::NoNet)
+      DB.NetPins.Storage[Next[DB.PinNets.Storage[P]]++] = P;
+}
+
+void NetlistDatabaseBuilder::build() {
+  copyNames();
+  addModules();
+  addNets();
+  addInstances();
+  addPortPins();
+  addNetPins();
+
+  // Drop the bucket of items outside any module if it is empty.
+  unsigned Last = NumBuckets - 1;
+  if (DB.ModuleInstanceBegin.Storage[Last] == Table.getNumInstances() &&
+      DB.ModuleNetBegin.Storage[Last] == Table.getNumNets() &&
+      DB.ModulePortBegin.Storage[Last] == Table.getNumPorts()) {
+    DB.ModuleNames.Storage.pop_back();
+    DB.ModuleInstanceBegin.Storage.pop_back();
+    DB.ModuleNetBegin.Storage.pop_back();
+    DB.ModulePortBegin.Storage.pop_back();
+    DB.ModulePortPinBegin.Storage.pop_back();
+  }
+  DB.sealColumns();
+}
+
+NetlistDatabase *NetlistDatabase::build(const NetlistTable &Table,
+                                        const CellLibrary *Library,
+                                        const SourceManager *SM) {
+  OwningPtr<NetlistDatabase> DB(new NetlistDatabase());
+  NetlistDatabaseBuilder(Table, Library, SM, *DB).build();
+  return DB.take();
+}
+
+NetlistDatabase::~NetlistDatabase() {}
+
+void NetlistDatabase::sealColumns() {
+#define NETLIST_COLUMN(Name, Type) Name.seal();
+#include "NetlistColumns.def"
+}
+
+//===----------------------------------------------------------------------===//
+// Queries
+//===----------------------------------------------------------------------===//
+
+StringRef NetlistDatabase::getModuleName(unsigned M) const {
+  return ModuleNames[M] == NetlistTable::NoName ? StringRef()
+                                                : getName(ModuleNames[M]);
+}
+
+unsigned NetlistDatabase::findModule(StringRef Name) const {
+  for (unsigned M = 0, e = ModuleNames.size(); M != e; ++M)
+    if (getModuleName(M) == Name)
+      return M;
+  return NoModule;
+}
+
+StringRef NetlistDatabase::getInstanceName(unsigned I) const {
+  return InstanceNames[I] == NetlistTable::NoName ? StringRef()
+                                                  : getName(InstanceNames[I]);
+}
+
+StringRef NetlistDatabase::getPinName(unsigned P) const {
+  if (NetlistTable::isOrderedPin(PinNames[P]))
+    return StringRef();
+  return getName(PinNames[P]);
+}
+
+bool NetlistDatabase::getPinPosition(unsigned P, unsigned &Position) const {
+  if (!NetlistTable::isOrderedPin(PinNames[P]))
+    return false;
+  Position = PinNames[P] & ~(unsigned)NetlistTable::OrderedPinFlag;
+  return true;
+}
+
+unsigned NetlistDatabase::getChildNet(unsigned P) const {
+  unsigned I = PinInstances[P];
+  if (I == NoInstance || InstanceTemplates[I] == NoModule)
+    return NoNet;
+
+  // Templates rarely have enough ports for a search to pay for an index.
+  unsigned M = InstanceTemplates[I];
+  unsigned Position;
+  if (getPinPosition(P, Position)) {
+    if (Position >= ModulePortBegin[M + 1] - ModulePortBegin[M])
+      return NoNet;
+    return PortNets[ModulePortBegin[M] + Position];
+  }
+  for (unsigned Port = ModulePortBegin[M], e = ModulePortBegin[M + 1];
+       Port != e; ++Port)
+    if (PortNames[Port] == PinNames[P])
+      return PortNets[Port];
+  return NoNet;
+}
+
+void NetlistDatabase::getFanin(unsigned N,
+                               SmallVectorImpl<unsigned> &Pins) const {
+  for (unsigned I = NetPinBegin[N], e = NetPinBegin[N + 1]; I != e; ++I) {
+    PinRole Role = getPinRole(NetPins[I]);
+    if (Role == PR_Driver || Role == PR_Bidirectional)
+      Pins.push_back(NetPins[I]);
+  }
+}
+
+void NetlistDatabase::getFanout(unsigned N,
+                                SmallVectorImpl<unsigned> &Pins) const {
+  for (unsigned I = NetPinBegin[N], e = NetPinBegin[N + 1]; I != e; ++I) {
+    PinRole Role = getPinRole(NetPins[I]);
+    if (Role == PR_Load || Role == PR_Bidirectional)
+      Pins.push_back(NetPins[I]);
+  }
+}
+
+/// \brief Append the instances of the pins that have role \p Far on the
+/// nets on which instance \p I has role \p Near, skipping \p I itself.
+static void getAdjacentInstances(const NetlistDatabase &DB, unsigned I,
+                                 NetlistDatabase::PinRole Near,
+                                 NetlistDatabase::PinRole Far,
+                                 SmallVectorImpl<unsigned> &Out) {
+  unsigned Start = Out.size();
+  std::pair<unsigned, unsigned> Pins = DB.getInstancePins(I);
+  for (unsigned P = Pins.first; P != Pins.second; ++P) {
+    NetlistDatabase::PinRole Role = DB.getPinRole(P);
+    unsigned Net = DB.getPinNet(P);
+    if (Net == NetlistDatabase::NoNet ||
+        (Role != Near && Role != NetlistDatabase::PR_Bidirectional))
+      continue;
+    ArrayRef<uint32_t> NetPins = DB.getNetPins(Net);
+    for (unsigned J = 0, e = NetPins.size(); J != e; ++J) {
+      NetlistDatabase::PinRole Other = DB.getPinRole(NetPins[J]);
+      unsigned Inst = DB.getPinInstance(NetPins[J]);
+      if ((Other == Far || Other == NetlistDatabase::PR_Bidirectional) &&
+          Inst != NetlistDatabase::NoInstance && Inst != I)
+        Out.push_back(Inst);
+    }
+  }
+  std::sort(Out.begin() + Start, Out.end());
+  Out.erase(std::unique(Out.begin() + Start, Out.end()), Out.end());
+}
+
+void NetlistDatabase::getFaninInstances(unsigned I,
+                                        SmallVectorImpl<unsigned> &Out) const {
+  getAdjacentInstances(*this, I, PR_Load, PR_Driver, Out);
+}
+
+void NetlistDatabase::getFanoutInstances(unsigned I,
+                                         SmallVectorImpl<unsigned> &Out) const {
+  getAdjacentInstances(*this, I, PR_Driver, PR_Load, Out);
+}
+
+size_t NetlistDatabase::getMemorySize() const {
+  size_t Size = Buffer ? Buffer->getBufferSize() : 0;
+#define NETLIST_COLUMN(Name, Type) \
+  Size += llvm::capacity_in_bytes(Name.Storage);
+#include "NetlistColumns.def"
+  return Size;
+}
+
+//===----------------------------------------------------------------------===//
+// Serialization
+//===----------------------------------------------------------------------===//
+
+using namespace vlang::netlist::ondisk;
+
+static uint64_t alignColumn(uint64_t Offset) {
+  return (Offset + ColumnAlignment - 1) & ~(ColumnAlignment - 1);
+}
+
+bool NetlistDatabase::writeToFile(StringRef Path,
+                                  std::string &ErrorStr) const {
+  struct ColumnData {
+    const void *Data;
+    uint64_t Size;
+    uint64_t Bytes;
+  };
+  const ColumnData Columns[] = {
+#define NETLIST_COLUMN(Name, Type) \
+    { Name.Data, Name.size(), Name.size() * sizeof(Type) },
+#include "NetlistColumns.def"
+  };
+  const unsigned NumColumns = sizeof(Columns) / sizeof(Columns[0]);
+
+  NetlistHeader H;
+  memset(&H, 0, sizeof(H));
+  H.Magic = NetlistMagic;
+  H.Version = NetlistVersion;
+  H.NumColumns = NumColumns;
+
+  ColumnRecord Records[NumColumns];
+  uint64_t Offset = sizeof(H) + sizeof(Records);
+  for (unsigned C = 0; C != NumColumns; ++C) {
+    Offset = alignColumn(Offset);
+    Records[C].Offset = Offset;
+    Records[C].Size = Columns[C].Size;
+    Offset += Columns[C].Bytes;
+  }
+
+  // Write next to the destination and rename, so that readers mapping the
+  // previous database never see a partial file.
+  std::string TempPath = Path.str() + ".tmp";
+  {
+    llvm::raw_fd_ostream OS(TempPath.c_str(), ErrorStr,
+                            llvm::raw_fd_ostream::F_Binary);
+    if (!ErrorStr.empty())
+      return true;
+
+    OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+    OS.write(reinterpret_cast<const char *>(Records), sizeof(Records));
+    static const char Zeros[ColumnAlignment] = {};
+    uint64_t Pos = sizeof(H) + sizeof(Records);
+    for (unsigned C = 0; C != NumColumns; ++C) {
+      OS.write(Zeros, Records[C].Offset - Pos);
+      if (Columns[C].Bytes)
+        OS.write(static_cast<const char *>(Columns[C].Data), Columns[C].Bytes);
+      Pos = Records[C].Offset + Columns[C].Bytes;
+    }
+
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      ErrorStr = "error writing '" + TempPath + "'";
+      return true;
+    }
+  }
+
+  if (llvm::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  return false;
+}
+
+/// Points the columns into Buffer.  Returns true if it is not a netlist
+/// database, or if its columns are out of bounds or inconsistent.
+bool NetlistDatabase::init() {
+  static const size_t ElementSizes[] = {
+#define NETLIST_COLUMN(Name, Type) sizeof(Type),
+#include "NetlistColumns.def"
+  };
+  const unsigned NumColumns = sizeof(ElementSizes) / sizeof(ElementSizes[0]);
+
+  const char *Start = Buffer->getBufferStart();
+  uint64_t Size = Buffer->getBufferSize();
+  if (Size < sizeof(NetlistHeader) + NumColumns * sizeof(ColumnRecord))
+    return true;
+  const NetlistHeader *H = reinterpret_cast<const NetlistHeader *>(Start);
+  if (H->Magic != NetlistMagic || H->Version != NetlistVersion ||
+      H->NumColumns != NumColumns)
+    return true;
+
+  const ColumnRecord *Records =
+    reinterpret_cast<const ColumnRecord *>(Start + sizeof(NetlistHeader));
+  for (unsigned C = 0; C != NumColumns; ++C)
+    if (Records[C].Offset % ColumnAlignment != 0 ||
+        Records[C].Offset > Size ||
+        Records[C].Size > (Size - Records[C].Offset) / ElementSizes[C])
+      return true;
+
+  unsigned C = 0;
+#define NETLIST_COLUMN(Name, Type) \
+  Name.map(reinterpret_cast<const Type *>(Start + Records[C].Offset), \
+           Records[C].Size); \
+  ++C;
+#include "NetlistColumns.def"
+
+  // The row arrays must have one more entry than the rows they delimit;
+  // the queries trust the indexes in them.
+  unsigned NumModules = ModuleNames.size();
+  return NameOffsets.size() == 0 ||
+         NameOffsets[NameOffsets.size() - 1] != NameData.size() ||
+         ModuleInstanceBegin.size() != NumModules + 1 ||
+         ModuleNetBegin.size() != NumModules + 1 ||
+         ModulePortBegin.size() != NumModules + 1 ||
+         ModulePortPinBegin.size() != NumModules + 1 ||
+         InstancePinBegin.size() != InstanceNames.size() + 1 ||
+         NetPinBegin.size() != NetNames.size() + 1 ||
+         PinRoles.size() != PinNets.size() ||
+         NetPins.size() != NetPinBegin[NetNames.size()];
+}
+
+NetlistDatabase *NetlistDatabase::loadFromFile(StringRef Path,
+                                               std::string &ErrorStr) {
+  OwningPtr<NetlistDatabase> Result(new NetlistDatabase());
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(
+        Path, Result->Buffer, -1, /*RequiresNullTerminator=*/false)) {
+    ErrorStr = EC.message();
+    return 0;
+  }
+  if (Result->init()) {
+    ErrorStr = "not a valid netlist database";
+    return 0;
+  }
+  return Result.take();
+}
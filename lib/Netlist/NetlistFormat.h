@@ -0,0 +1,54 @@
+//===--- NetlistFormat.h - Layout of netlist database files -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the records of a netlist database file.  All fields
+//  are in host byte order; the magic number rejects files written on a host
+//  of different endianness.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LIB_NETLIST_NETLISTFORMAT_H
+#define LLVM_VLANG_LIB_NETLIST_NETLISTFORMAT_H
+
+#include "llvm/Support/DataTypes.h"
+
+namespace vlang {
+namespace netlist {
+namespace ondisk {
+
+static const uint32_t NetlistMagic = 0x564E4C31; // 'VNL1'
+static const uint32_t NetlistVersion = 1;
+
+/// \brief Every column starts at a multiple of this many bytes.
+static const uint64_t ColumnAlignment = 8;
+
+/// \brief The header at the start of the file.  It is followed by one
+/// ColumnRecord per column, in the order of NetlistColumns.def, then by the
+/// column data.
+struct NetlistHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t NumColumns;
+  uint32_t Padding;
+};
+
+/// \brief Where a column is.  Offsets are 64-bit so that a file may exceed
+/// 4GB; the indexes stored in the columns are 32-bit.
+struct ColumnRecord {
+  /// \brief The offset of the first element from the start of the file.
+  uint64_t Offset;
+  /// \brief The number of elements.
+  uint64_t Size;
+};
+
+} // end namespace ondisk
+} // end namespace netlist
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,63 @@
+//===--- ConfigTable.cpp - Configurations of a design ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the ConfigTable class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Parse/ConfigTable.h"
+using namespace vlang;
+
+StringRef ConfigTable::copyString(StringRef Str) {
+  if (Str.empty())
+    return StringRef();
+  return Strings.GetOrCreateValue(Str).getKey();
+}
+
+ConfigCell ConfigTable::copyCell(const ConfigCell &Cell) {
+  ConfigCell Result;
+  Result.Library = copyString(Cell.Library);
+  Result.Cell = copyString(Cell.Cell);
+  return Result;
+}
+
+void ConfigTable::addConfig(const Configuration &Config) {
+  ++NumDeclarations;
+  Configuration Copy;
+  Copy.Name = copyString(Config.Name);
+  for (unsigned I = 0, E = Config.Design.size(); I != E; ++I)
+    Copy.Design.push_back(copyCell(Config.Design[I]));
+  for (unsigned I = 0, E = Config.Rules.size(); I != E; ++I) {
+    const ConfigRule &Rule = Config.Rules[I];
+    ConfigRule R;
+    R.Kind = Rule.Kind;
+    R.InstancePath = copyString(Rule.InstancePath);
+    R.Cell = copyCell(Rule.Cell);
+    R.HasUse = Rule.HasUse;
+    R.Use = copyCell(Rule.Use);
+    R.UseIsConfig = Rule.UseIsConfig;
+    for (unsigned L = 0, LE = Rule.Liblist.size(); L != LE; ++L)
+      R.Liblist.push_back(copyString(Rule.Liblist[L]));
+    Copy.Rules.push_back(R);
+  }
+
+  llvm::StringMapEntry<unsigned> &Entry =
+    ConfigsByName.GetOrCreateValue(Copy.Name, Configs.size());
+  if (Entry.getValue() != Configs.size()) {
+    Configs[Entry.getValue()] = Copy;
+    return;
+  }
+  Configs.push_back(Copy);
+}
+
+const Configuration *ConfigTable::findConfig(StringRef Name) const {
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator>::const_iterator I =
+    ConfigsByName.find(Name);
+  return I == ConfigsByName.end() ? 0 : &Configs[I->getValue()];
+}
@@ -0,0 +1,72 @@
+//===--- DesignUnitTable.cpp - Defined and instantiated units -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the DesignUnitTable class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Parse/DesignUnitTable.h"
+using namespace vlang;
+
+void DesignUnitTable::addDefinition(StringRef Name) {
+  llvm::StringMapEntry<unsigned> &Entry =
+    Units.GetOrCreateValue(Name, NoDefinition);
+  if (Entry.getValue() != NoDefinition) {
+    CurDefinition = NoDefinition;
+    return;
+  }
+  CurDefinition = Definitions.size();
+  Entry.setValue(CurDefinition);
+  Definition D;
+  D.Name = Entry.getKey();
+  Definitions.push_back(D);
+}
+
+StringRef DesignUnitTable::addReference(StringRef Name) {
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator>::iterator I =
+    Units.find(Name);
+  if (I != Units.end())
+    return I->getKey();
+  llvm::StringMapEntry<unsigned> &Entry =
+    Units.GetOrCreateValue(Name, NoDefinition);
+  References.push_back(Entry.getKey());
+  return Entry.getKey();
+}
+
+void DesignUnitTable::addInstance(StringRef Cell, StringRef Name) {
+  Instance I;
+  I.Cell = addReference(Cell);
+  if (CurDefinition == NoDefinition)
+    return;
+  I.Name = Name.empty() ? StringRef()
+                        : InstanceNames.GetOrCreateValue(Name).getKey();
+  Definitions[CurDefinition].Instances.push_back(I);
+}
+
+void DesignUnitTable::append(const DesignUnitTable &Other) {
+  for (unsigned D = 0, E = Other.Definitions.size(); D != E; ++D) {
+    addDefinition(Other.Definitions[D].Name);
+    ArrayRef<Instance> Instances = Other.Definitions[D].Instances;
+    for (unsigned I = 0, IE = Instances.size(); I != IE; ++I)
+      addInstance(Instances[I].Cell, Instances[I].Name);
+  }
+  CurDefinition = NoDefinition;
+}
+
+unsigned DesignUnitTable::findDefinition(StringRef Name) const {
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator>::const_iterator I =
+    Units.find(Name);
+  return I == Units.end() ? NoDefinition : I->getValue();
+}
+
+void DesignUnitTable::getUnresolved(SmallVectorImpl<StringRef> &Names) const {
+  for (unsigned I = 0, E = References.size(); I != E; ++I)
+    if (!isDefined(References[I]))
+      Names.push_back(References[I]);
+}
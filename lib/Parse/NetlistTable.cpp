@@ -0,0 +1,75 @@
+//===--- NetlistTable.cpp - Cell instance connectivity --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the NetlistTable class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Parse/NetlistTable.h"
+#include "vlang/Basic/IdentifierTable.h"
+#include "llvm/Support/Capacity.h"
+using namespace vlang;
+
+NetlistTable::NetlistTable()
+  : CurModule(NoModule), NumComplexItems(0) {}
+
+StringRef NetlistTable::getIdentifierName(const IdentifierInfo *II) {
+  return II->getName();
+}
+
+void NetlistTable::beginModule(StringRef Name) {
+  CurModule = Modules.size();
+  Modules.push_back(getNameID(Name));
+  ModuleNets.clear();
+  ModulePorts.clear();
+}
+
+void NetlistTable::addPort(StringRef Name, PortKind Kind) {
+  unsigned NameID = getNameID(Name);
+  unsigned &Index = ModulePorts[NameID];
+  if (Index == 0) {
+    Port P = { CurModule, NameID, Kind };
+    Ports.push_back(P);
+    Index = Ports.size();
+  } else if (Kind != PortKind::Unknown)
+    Ports[Index - 1].Kind = Kind;
+}
+
+unsigned NetlistTable::getNameID(StringRef Name) {
+  llvm::StringMapEntry<unsigned> &Entry =
+    NameIDs.GetOrCreateValue(Name, Names.size());
+  if (Entry.getValue() == Names.size())
+    Names.push_back(Entry.getKey());
+  return Entry.getValue();
+}
+
+unsigned NetlistTable::getNetID(unsigned Name, unsigned Bit) {
+  uint64_t Key = ((uint64_t)Name << 32) | (uint32_t)(Bit + 1);
+  unsigned &ID = ModuleNets[Key];
+  if (ID == 0) {
+    Net N = { CurModule, Name, Bit };
+    Nets.push_back(N);
+    ID = Nets.size();
+  }
+  return ID - 1;
+}
+
+size_t NetlistTable::getMemorySize() const {
+  return NameIDs.getAllocator().getTotalMemory() +
+         NameIDs.getNumBuckets() * sizeof(void *) +
+         llvm::capacity_in_bytes(Names) +
+         llvm::capacity_in_bytes(IdentifierNames) +
+         llvm::capacity_in_bytes(Modules) +
+         llvm::capacity_in_bytes(Ports) +
+         llvm::capacity_in_bytes(Instances) +
+         llvm::capacity_in_bytes(Connections) +
+         llvm::capacity_in_bytes(Nets) +
+         llvm::capacity_in_bytes(ModuleNets) +
+         llvm::capacity_in_bytes(ModulePorts);
+}
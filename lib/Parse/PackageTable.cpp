@@ -0,0 +1,224 @@
+//===--- PackageTable.cpp - Packages and imports of a unit ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the PackageTable class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Parse/PackageTable.h"
+#include "llvm/ADT/SmallString.h"
+using namespace vlang;
+
+ExternalPackageSource::~ExternalPackageSource() {}
+
+PackageTable::PackageTable()
+  : CurPackage(NoPackage), External(0), NumMaterialized(0) {}
+
+static void getSymbolKey(StringRef Package, StringRef Name,
+                         SmallVectorImpl<char> &Key) {
+  Key.append(Package.begin(), Package.end());
+  Key.push_back(':');
+  Key.push_back(':');
+  Key.append(Name.begin(), Name.end());
+}
+
+void PackageTable::beginPackage(StringRef Name, unsigned FirstToken) {
+  assert(CurPackage == NoPackage && "Packages do not nest");
+  CurPackage = Packages.size();
+  llvm::StringMapEntry<unsigned> &Entry =
+    PackagesByName.GetOrCreateValue(Name, CurPackage);
+  // A package declared twice is replaced, as a later compilation would.
+  Entry.setValue(CurPackage);
+
+  Package P;
+  P.Name = Entry.getKey();
+  P.External = false;
+  P.FirstToken = FirstToken;
+  P.EndToken = FirstToken;
+  P.Searching = false;
+  Packages.push_back(P);
+}
+
+void PackageTable::addSymbol(StringRef Name, PackageSymbolKind Kind,
+                             unsigned FirstToken, unsigned EndToken) {
+  assert(CurPackage != NoPackage && "Symbol outside a package");
+  PackageSymbol S;
+  S.Name = Name;
+  S.Kind = Kind;
+  S.FirstToken = FirstToken;
+  S.EndToken = EndToken;
+
+  SmallString<64> Key;
+  getSymbolKey(Packages[CurPackage].Name, Name, Key);
+  llvm::StringMapEntry<unsigned> &Entry =
+    SymbolsByName.GetOrCreateValue(Key, Symbols.size());
+  // The first declaration of a name wins; later ones are errors that a
+  // semantic pass would report.
+  if (Entry.getValue() != Symbols.size())
+    return;
+  Packages[CurPackage].Symbols.push_back(Symbols.size());
+  Symbols.push_back(S);
+}
+
+void PackageTable::endPackage(unsigned EndToken) {
+  assert(CurPackage != NoPackage && "No package to end");
+  Packages[CurPackage].EndToken = EndToken;
+  CurPackage = NoPackage;
+}
+
+unsigned PackageTable::findPackage(StringRef Name) {
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator>::iterator I =
+    PackagesByName.find(Name);
+  if (I != PackagesByName.end())
+    return I->getValue();
+
+  // Ask the external source once; a miss is remembered as NoPackage.
+  llvm::StringMapEntry<unsigned> &Entry =
+    PackagesByName.GetOrCreateValue(Name, NoPackage);
+  if (!External || !External->findPackage(Name))
+    return NoPackage;
+
+  Package P;
+  P.Name = Entry.getKey();
+  P.External = true;
+  P.FirstToken = P.EndToken = 0;
+  P.Searching = false;
+  Entry.setValue(Packages.size());
+  Packages.push_back(P);
+  return Entry.getValue();
+}
+
+/// Finds symbol \p Name of package \p P, materializing it from the external
+/// source the first time it is asked for.
+unsigned PackageTable::findSymbol(unsigned P, StringRef Name) {
+  SmallString<64> Key;
+  getSymbolKey(Packages[P].Name, Name, Key);
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator>::iterator I =
+    SymbolsByName.find(Key);
+  if (I != SymbolsByName.end())
+    return I->getValue();
+  if (!Packages[P].External)
+    return findExportedSymbol(P, Name);
+
+  llvm::StringMapEntry<unsigned> &Entry =
+    SymbolsByName.GetOrCreateValue(Key, NoSymbol);
+  PackageSymbol S;
+  if (!External->findSymbol(Packages[P].Name, Name, S))
+    return NoSymbol;
+  Entry.setValue(Symbols.size());
+  Symbols.push_back(S);
+  ++NumMaterialized;
+  return Entry.getValue();
+}
+
+/// Finds symbol \p Name among the exports of parsed package \p P.
+unsigned PackageTable::findExportedSymbol(unsigned P, StringRef Name) {
+  if (Packages[P].Exports.empty() || Packages[P].Searching)
+    return NoSymbol;
+  Packages[P].Searching = true;
+  unsigned S = NoSymbol;
+  // Copies, as a lookup may add packages and move these vectors.
+  std::vector<Export> Exports = Packages[P].Exports;
+  std::vector<Import> Imports = Packages[P].Imports;
+  for (unsigned E = 0; E != Exports.size() && S == NoSymbol; ++E) {
+    if (Exports[E].Package != NoPackage) {
+      if (Exports[E].Name.empty() || Exports[E].Name == Name)
+        S = findSymbol(Exports[E].Package, Name);
+      continue;
+    }
+    for (unsigned I = 0; I != Imports.size() && S == NoSymbol; ++I)
+      if (Imports[I].Name.empty() || Imports[I].Name == Name)
+        S = findSymbol(Imports[I].Package, Name);
+  }
+  Packages[P].Searching = false;
+  return S;
+}
+
+void PackageTable::endScope() {
+  assert(!ScopeStarts.empty() && "Unbalanced scope");
+  unsigned Start = ScopeStarts.pop_back_val();
+  // A package keeps its own imports, which export *::* refers to.
+  if (CurPackage != NoPackage && ScopeStarts.empty())
+    Packages[CurPackage].Imports.assign(Imports.begin() + Start,
+                                        Imports.end());
+  Imports.resize(Start);
+}
+
+bool PackageTable::importAll(StringRef Package) {
+  unsigned P = findPackage(Package);
+  if (P == NoPackage)
+    return false;
+  Import I = { P, StringRef() };
+  Imports.push_back(I);
+  return true;
+}
+
+bool PackageTable::importName(StringRef Package, StringRef Name) {
+  unsigned P = findPackage(Package);
+  if (P == NoPackage || findSymbol(P, Name) == NoSymbol)
+    return false;
+  Import I = { P, Name };
+  Imports.push_back(I);
+  return true;
+}
+
+bool PackageTable::addExport(StringRef Package, StringRef Name) {
+  assert(CurPackage != NoPackage && "Export outside a package");
+  Export E = { NoPackage, Name };
+  if (!Package.empty()) {
+    E.Package = findPackage(Package);
+    if (E.Package == NoPackage ||
+        (!Name.empty() && findSymbol(E.Package, Name) == NoSymbol))
+      return false;
+  }
+  Packages[CurPackage].Exports.push_back(E);
+  return true;
+}
+
+void PackageTable::getPackageExports(
+    unsigned P, SmallVectorImpl<std::pair<StringRef, StringRef> > &Exports)
+    const {
+  const Package &Pkg = Packages[P];
+  for (unsigned E = 0, EE = Pkg.Exports.size(); E != EE; ++E) {
+    if (Pkg.Exports[E].Package != NoPackage) {
+      Exports.push_back(std::make_pair(Packages[Pkg.Exports[E].Package].Name,
+                                       Pkg.Exports[E].Name));
+      continue;
+    }
+    for (unsigned I = 0, IE = Pkg.Imports.size(); I != IE; ++I)
+      Exports.push_back(std::make_pair(Packages[Pkg.Imports[I].Package].Name,
+                                       Pkg.Imports[I].Name));
+  }
+}
+
+unsigned PackageTable::lookup(StringRef Name) {
+  // Explicit imports hide wildcard ones, and inner scopes hide outer ones.
+  for (unsigned I = Imports.size(); I != 0; --I)
+    if (Imports[I - 1].Name == Name)
+      return findSymbol(Imports[I - 1].Package, Name);
+
+  unsigned End = Imports.size();
+  for (unsigned Scope = ScopeStarts.size() + 1; Scope != 0; --Scope) {
+    unsigned Begin = Scope == 1 ? 0 : ScopeStarts[Scope - 2];
+    for (unsigned I = Begin; I != End; ++I) {
+      if (!Imports[I].Name.empty())
+        continue;
+      unsigned S = findSymbol(Imports[I].Package, Name);
+      if (S != NoSymbol)
+        return S;
+    }
+    End = Begin;
+  }
+  return NoSymbol;
+}
+
+unsigned PackageTable::lookupQualified(StringRef Package, StringRef Name) {
+  unsigned P = findPackage(Package);
+  return P == NoPackage ? NoSymbol : findSymbol(P, Name);
+}
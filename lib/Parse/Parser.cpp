@@ -15,11 +15,15 @@
 #include "vlang/Sema/Sema.h"
 #include "RAIIObjectsForParser.h"
 #include "vlang/Parse/ParseDiagnostic.h"
+#include "vlang/Basic/PerfCounters.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace vlang;
 
 #define UNIMPLEMENTED_PARSE(n) bool Parser::n(){ return false; }
 
+ElementCache::~ElementCache() {}
+
 namespace {
 /// \brief A comment handler that passes comments found by the preprocessor
 /// to the parser action.
@@ -36,7 +40,10 @@ public:
 } // end anonymous namespace
 
 Parser::Parser(Preprocessor &pp, Sema &actions, bool skipFunctionBodies)
-  : PP(pp), Actions(actions), Diags(PP.getDiagnostics()) {
+  : PP(pp), TokBuf(0), TokBufPos(0), Netlist(0), Packages(0), Units(0),
+    Configs(0), Elements(0),
+    Actions(actions),
+    Diags(PP.getDiagnostics()) {
   Tok.startToken();
   Tok.setKind(tok::eof);
   Actions.CurScope = 0;
@@ -337,6 +344,7 @@ Parser::~Parser() {
   for (unsigned i = 0, e = NumCachedScopes; i != e; ++i)
     delete ScopeCache[i];
 
+  PP.removeCommentHandler(CommentSemaHandler.get());
   PP.clearCodeCompletionHandler();
 }
 
@@ -371,6 +379,17 @@ bool Parser::ParseTopLevelDecl() {
     return true;
   }
 
+  if (Elements) {
+    unsigned First = getTokenBufferIndex();
+    if (unsigned End = Elements->replayElement(First)) {
+      SkipToTokenBufferIndex(End);
+      return false;
+    }
+    ParseDescription();
+    Elements->parsedElement(First, getTokenBufferIndex());
+    return false;
+  }
+
   ParseDescription();
   return false;
 }
@@ -412,6 +431,19 @@ bool Parser::ParseDescription()
       ParseDesignElementDeclaration();
       break;
 
+   case tok::kw_package:
+      ParsePackageDeclaration();
+      break;
+
+   case tok::kw_config:
+      ParseConfigDeclaration();
+      break;
+
+   // Imports outside any design element apply to the rest of the unit.
+   case tok::kw_import:
+      ParsePackageImportDeclaration();
+      break;
+
    default:
       Diag(Tok, diag::err_expected_top_decl);
       //process_error();
@@ -486,15 +518,24 @@ bool Parser::ParseDesignElementDeclaration()
       // Skip until semicolon or hit "#" or "(", or ";"
       SkipUntil(tok::hash, tok::l_paren, true);
    }
+   if( Units && !module_name.empty() ) {
+      Units->addDefinition(module_name);
+   }
+   if( Netlist ) {
+      Netlist->beginModule(module_name);
+   }
+   if( Packages ) {
+      Packages->beginScope();
+   }
 
    // Call semantic analysis of design declaration start
    //	if( !actions->ActOnDesignDeclaration(module_name, type, lifetime ) ) {
    // TODO: Support error handling if needed
    //	}
 
-   // TODO: support package_import_list
-   //if( ParsePackageImportList() ) {
-   //}
+   while( Tok.is(tok::kw_import) ) {
+      ParsePackageImportDeclaration();
+   }
 
    // Parse parameters
    if( Tok.is(tok::hash) ) {
@@ -543,12 +584,83 @@ bool Parser::ParseDesignElementDeclaration()
          // TODO: Check it matches start name
       }
    }
+   if( Packages ) {
+      Packages->endScope();
+   }
    return true;
 }
 UNIMPLEMENTED_PARSE(ParseUdpDeclaration)
-UNIMPLEMENTED_PARSE(ParsePackageDeclaration)
+
+// package_declaration ::= { attribute_instance } package [ lifetime ] package_identifier ;
+//                         [ timeunits_declaration ] { { attribute_instance } package_item }
+//                         endpackage [ : package_identifier ]
+bool Parser::ParsePackageDeclaration()
+{
+   llvm::StringRef package_name;
+   llvm::StringRef package_end_name;
+   assert(Tok.is(tok::kw_package) && "");
+   unsigned first_token = TokBuf ? getTokenBufferIndex() : 0;
+   ConsumeToken();
+   ParseLifetime();
+
+   if( Tok.isNot(tok::identifier) ) {
+      Diag(Tok, diag::err_expected_ident_for) << "Package";
+      SkipUntil(tok::semi, true, true);
+   } else {
+      ParseIdentifier(&package_name);
+   }
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+
+   // Symbols are found by a scan of the token buffer.
+   bool record = Packages && !package_name.empty();
+   if( record ) {
+      Packages->beginPackage(package_name, first_token);
+   }
+   if( Packages ) {
+      Packages->beginScope();
+   }
+
+   while( Tok.isNot(tok::kw_endpackage) && Tok.isNot(tok::eof) ) {
+      SourceLocation item_loc = Tok.getLocation();
+      unsigned item_start = TokBuf ? getTokenBufferIndex() : 0;
+      if( !ParsePackageItem() ) {
+         Diag(Tok, diag::err_expected_package_item);
+         SkipUntil(tok::semi);
+      }
+      // Never stall on a token no production consumed.
+      if( Tok.getLocation() == item_loc && Tok.isNot(tok::eof) ) {
+         ConsumeAnyToken();
+      }
+      if( record && TokBuf ) {
+         recordPackageItem(item_start, getTokenBufferIndex());
+      }
+   }
+
+   if( Packages ) {
+      Packages->endScope();
+   }
+   if( Tok.is(tok::kw_endpackage) ) {
+      ConsumeToken();
+   } else {
+      Diag(Tok, diag::err_expected_end_design) << "package";
+   }
+   if( record ) {
+      Packages->endPackage(TokBuf ? getTokenBufferIndex() : 0);
+   }
+
+   if( ConsumeIfMatch( tok::colon ) ) {
+      if( Tok.isNot(tok::identifier)) {
+         Diag(Tok, diag::err_expected_matching_ident);
+      } else {
+         ParseIdentifier(&package_end_name);
+         if( package_end_name != package_name ) {
+            Diag(PrevTokLocation, diag::err_expected_matching_ident);
+         }
+      }
+   }
+   return true;
+}
 UNIMPLEMENTED_PARSE(ParseBindDirective)
-UNIMPLEMENTED_PARSE(ParseConfigDeclaration)
 
 // parameter_port_list ::=
 //   # ( list_of_param_assignments { , parameter_port_declaration } )
@@ -608,6 +720,9 @@ bool Parser::ParseListOfPorts()
       // TODO: Handle port expression correctly
       case tok::identifier:
          ParseIdentifier(&ident);
+         if( Netlist ) {
+            Netlist->addPort(ident, PortKind::Unknown);
+         }
          break;
 
       case tok::period:
@@ -617,6 +732,9 @@ bool Parser::ParseListOfPorts()
             // TODO: Handle error
          }
          ParseIdentifier(&ident);
+         if( Netlist && !ident.empty() ) {
+            Netlist->addPort(ident, PortKind::Unknown);
+         }
 
          if( !ExpectAndConsume(tok::l_paren, diag::err_expected_lparen_after, "port identifier", tok::comma) ){
             break;
@@ -731,6 +849,9 @@ bool Parser::ParseListOfPortDeclarations()
          Diag(Tok, diag::err_expected_ident_for) << "port";
       }
       ParseIdentifier(&ident);
+      if( Netlist && !ident.empty() ) {
+         Netlist->addPort(ident, portKind);
+      }
 
       // Check if a dimension is specified
       if( Tok.is(tok::l_square) ){
@@ -848,6 +969,12 @@ bool Parser::ParseModuleCommonItem()
 
 bool Parser::ParseModuleItem()
 {
+   perf::PhaseScope PerfScope(perf::ParseModuleItem);
+
+   if( Netlist && ParseNetlistInstantiation() ) {
+      return true;
+   }
+
    if( Tok.is(tok::kw_generate) ) {
       ParseGenerateRegion();
    }else if( ParsePortDeclaration(  ) ) {
@@ -910,7 +1037,231 @@ UNIMPLEMENTED_PARSE(ParseBindTargetInstanceList)
 UNIMPLEMENTED_PARSE(ParseBindInstantiation)
 
 // Section A.1.5 - Configuration source text
-// TODO
+
+// config_declaration ::=
+//   config config_identifier ;
+//   { local_parameter_declaration ; }
+//   design_statement
+//   { config_rule_statement }
+//   endconfig [ : config_identifier ]
+bool Parser::ParseConfigDeclaration()
+{
+   Configuration config;
+   llvm::StringRef config_end_name;
+   assert(Tok.is(tok::kw_config) && "");
+   ConsumeToken();
+
+   if( Tok.isNot(tok::identifier) ) {
+      Diag(Tok, diag::err_expected_ident_for) << "Config";
+      SkipUntil(tok::semi, true, true);
+   } else {
+      ParseIdentifier(&config.Name);
+   }
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+
+   // The parameters of a configuration are not recorded.
+   while( Tok.is(tok::kw_localparam) ) {
+      SkipUntil(tok::semi);
+   }
+
+   if( !ParseDesignStatement(config) ) {
+      Diag(Tok, diag::err_expected_design_statement);
+   }
+
+   while( Tok.isNot(tok::kw_endconfig) && Tok.isNot(tok::eof) ) {
+      if( !ParseConfigRuleStatement(config) ) {
+         Diag(Tok, diag::err_expected_config_rule);
+         SkipUntil(tok::semi);
+      }
+   }
+
+   if( Tok.is(tok::kw_endconfig) ) {
+      ConsumeToken();
+   } else {
+      Diag(Tok, diag::err_expected_end_design) << "config";
+   }
+   if( ConsumeIfMatch( tok::colon ) ) {
+      if( Tok.isNot(tok::identifier)) {
+         Diag(Tok, diag::err_expected_matching_ident);
+      } else {
+         ParseIdentifier(&config_end_name);
+         if( config_end_name != config.Name ) {
+            Diag(PrevTokLocation, diag::err_expected_matching_ident);
+         }
+      }
+   }
+
+   if( Configs && !config.Name.empty() ) {
+      Configs->addConfig(config);
+   }
+   return true;
+}
+
+// design_statement ::= design { [ library_identifier . ] cell_identifier } ;
+bool Parser::ParseDesignStatement(Configuration &Config)
+{
+   if( Tok.isNot(tok::kw_design) ) {
+      return false;
+   }
+   ConsumeToken();
+   while( Tok.is(tok::identifier) ) {
+      ConfigCell cell;
+      ParseConfigCell(cell);
+      Config.Design.push_back(cell);
+   }
+   ExpectAndConsume(tok::semi, diag::err_expected_semi_after, "design statement");
+   return true;
+}
+
+// config_rule_statement ::=
+//   default_clause liblist_clause ;
+// | inst_clause liblist_clause ;
+// | inst_clause use_clause ;
+// | cell_clause liblist_clause ;
+// | cell_clause use_clause ;
+// default_clause ::= default
+// inst_clause ::= instance inst_name
+// cell_clause ::= cell [ library_identifier . ] cell_identifier
+bool Parser::ParseConfigRuleStatement(Configuration &Config)
+{
+   ConfigRule rule;
+   rule.HasUse = false;
+   rule.UseIsConfig = false;
+   SmallString<64> path;
+
+   switch( Tok.getKind() ) {
+   case tok::kw_default:
+      ConsumeToken();
+      rule.Kind = ConfigRule::RK_Default;
+      if( Tok.isNot(tok::kw_liblist) ) {
+         Diag(Tok, diag::err_expected_liblist_or_use) << "default";
+         SkipUntil(tok::semi);
+         return true;
+      }
+      break;
+
+   case tok::kw_instance:
+      ConsumeToken();
+      rule.Kind = ConfigRule::RK_Instance;
+      if( !ParseInstName(path) ) {
+         Diag(Tok, diag::err_expected_ident_for) << "Instance";
+         SkipUntil(tok::semi);
+         return true;
+      }
+      // Keep the path as long as the identifiers, until the table copies
+      // the configuration.
+      rule.InstancePath = PP.getIdentifierInfo(path.str())->getName();
+      break;
+
+   case tok::kw_cell:
+      ConsumeToken();
+      rule.Kind = ConfigRule::RK_Cell;
+      if( !ParseConfigCell(rule.Cell) ) {
+         Diag(Tok, diag::err_expected_ident_for) << "Cell";
+         SkipUntil(tok::semi);
+         return true;
+      }
+      break;
+
+   default:
+      return false;
+   }
+
+   if( Tok.is(tok::kw_liblist) ) {
+      ParseLiblistClause(rule);
+   } else if( Tok.is(tok::kw_use) && rule.Kind != ConfigRule::RK_Default ) {
+      ParseUseClause(rule);
+   } else {
+      Diag(Tok, diag::err_expected_liblist_or_use)
+         << (rule.Kind == ConfigRule::RK_Cell ? "cell" : "instance");
+      SkipUntil(tok::semi);
+      return true;
+   }
+   ExpectAndConsume(tok::semi, diag::err_expected_semi_after, "config rule");
+
+   Config.Rules.push_back(rule);
+   return true;
+}
+
+// [ library_identifier . ] cell_identifier
+bool Parser::ParseConfigCell(ConfigCell &Cell)
+{
+   if( Tok.isNot(tok::identifier) ) {
+      return false;
+   }
+   ParseIdentifier(&Cell.Cell);
+   if( Tok.is(tok::period) && NextToken().is(tok::identifier) ) {
+      ConsumeToken();
+      Cell.Library = Cell.Cell;
+      ParseIdentifier(&Cell.Cell);
+   }
+   return true;
+}
+
+// inst_name ::= topmodule_identifier { . instance_identifier }
+bool Parser::ParseInstName(SmallVectorImpl<char> &Path)
+{
+   if( Tok.isNot(tok::identifier) ) {
+      return false;
+   }
+   llvm::StringRef ident;
+   ParseIdentifier(&ident);
+   Path.append(ident.begin(), ident.end());
+   while( Tok.is(tok::period) && NextToken().is(tok::identifier) ) {
+      ConsumeToken();
+      ParseIdentifier(&ident);
+      Path.push_back('.');
+      Path.append(ident.begin(), ident.end());
+   }
+   return true;
+}
+
+// liblist_clause ::= liblist { library_identifier }
+void Parser::ParseLiblistClause(ConfigRule &Rule)
+{
+   assert(Tok.is(tok::kw_liblist) && "");
+   ConsumeToken();
+   while( Tok.is(tok::identifier) ) {
+      llvm::StringRef library;
+      ParseIdentifier(&library);
+      Rule.Liblist.push_back(library);
+   }
+}
+
+// use_clause ::=
+//   use [ library_identifier . ] cell_identifier [ : config ]
+// | use named_parameter_assignment { , named_parameter_assignment }
+//       [ : config ]
+// | use [ library_identifier . ] cell_identifier
+//       named_parameter_assignment { , named_parameter_assignment }
+//       [ : config ]
+void Parser::ParseUseClause(ConfigRule &Rule)
+{
+   assert(Tok.is(tok::kw_use) && "");
+   ConsumeToken();
+   Rule.HasUse = true;
+   ParseConfigCell(Rule.Use);
+
+   // Parameter overrides are not recorded.
+   while( Tok.is(tok::period) ) {
+      ConsumeToken();
+      if( Tok.is(tok::identifier) ) {
+         ConsumeToken();
+      }
+      if( Tok.is(tok::l_paren) ) {
+         SkipBlock(tok::l_paren, tok::r_paren);
+      }
+      if( !ConsumeIfMatch( tok::comma ) ) {
+         break;
+      }
+   }
+
+   if( Tok.is(tok::colon) && NextToken().is(tok::kw_config) ) {
+      ConsumeToken();
+      ConsumeToken();
+      Rule.UseIsConfig = true;
+   }
+}
 
 // Section A.1.6 - Interface items
 UNIMPLEMENTED_PARSE(ParseInterfaceOrGenerateItem)
@@ -934,7 +1285,273 @@ UNIMPLEMENTED_PARSE(ParseProgramGenerateItem)
 
 // Section A.1.11 - Package items
 
-UNIMPLEMENTED_PARSE(ParsePackageItem)
+// package_item ::= package_or_generate_item_declaration
+//                | anonymous_program -- TODO
+//                | package_export_declaration
+//                | timeunits_declaration -- TODO
+bool Parser::ParsePackageItem()
+{
+   switch( Tok.getKind() ) {
+   case tok::kw_export:
+      return ParsePackageExportDeclaration();
+
+   // There is nothing to hold class members or coverage models, so classes
+   // and covergroups are skipped, and only their names are recorded.
+   case tok::kw_virtual:
+      if( NextToken().isNot(tok::kw_class) ) {
+         return false;
+      }
+      ConsumeToken();
+      // Fall through.
+   case tok::kw_class:
+      DiagUnparsedPackageItem(0);
+      SkipBlock(tok::kw_class, tok::kw_endclass);
+      return true;
+   case tok::kw_covergroup:
+      DiagUnparsedPackageItem(1);
+      SkipBlock(tok::kw_covergroup, tok::kw_endgroup);
+      return true;
+
+   case tok::identifier:
+      return ParseUserTypeDataDeclaration();
+
+   case tok::semi:
+      ConsumeToken();
+      return true;
+
+   default:
+      return ParsePackageOrGenerateItemDeclaration();
+   }
+}
+
+/// DiagUnparsedPackageItem - Warn that the class (\p Kind 0) or covergroup
+/// (\p Kind 1) at Tok is skipped.
+void Parser::DiagUnparsedPackageItem(unsigned Kind)
+{
+   const Token &Name = NextToken();
+   llvm::StringRef name;
+   if( Name.is(tok::identifier) ) {
+      name = Name.getIdentifierInfo()->getName();
+   }
+   Diag(Tok, diag::warn_unparsed_package_item) << Kind << name;
+}
+
+/// SkipBlock - Skip from the \p Begin keyword at Tok past its matching \p End
+/// keyword and any ": name" label after it.
+void Parser::SkipBlock(tok::TokenKind Begin, tok::TokenKind End)
+{
+   assert(Tok.is(Begin) && "");
+   unsigned depth = 0;
+   bool after_typedef = false;
+   do {
+      // "typedef class c;" forward declares a class without a body.
+      if( Tok.is(Begin) && !after_typedef ) {
+         ++depth;
+      } else if( Tok.is(End) ) {
+         --depth;
+      }
+      after_typedef = Tok.is(tok::kw_typedef);
+      ConsumeAnyToken();
+   } while( depth != 0 && Tok.isNot(tok::eof) );
+
+   if( Tok.is(tok::colon) && NextToken().is(tok::identifier) ) {
+      ConsumeToken();
+      ConsumeToken();
+   }
+}
+
+static bool isNetTypeKeyword(tok::TokenKind K) {
+   switch( K ) {
+   case tok::kw_supply0:
+   case tok::kw_supply1:
+   case tok::kw_tri:
+   case tok::kw_triand:
+   case tok::kw_trior:
+   case tok::kw_trireg:
+   case tok::kw_tri0:
+   case tok::kw_tri1:
+   case tok::kw_uwire:
+   case tok::kw_wire:
+   case tok::kw_wand:
+   case tok::kw_wor:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/// Appends to \p Names the declarators of tokens [Idx, End) of \p Toks at
+/// bracket depth \p Depth: identifiers followed by '=', ',', ';', '}' or an
+/// unpacked dimension.  Initializers are skipped, so that "a = b, c" yields
+/// a and c.
+static void scanDeclarators(const TokenBuffer &Toks, unsigned Idx,
+                            unsigned End, unsigned Depth,
+                            SmallVectorImpl<unsigned> &Names) {
+   unsigned depth = 0;
+   bool in_initializer = false;
+   tok::TokenKind prev = tok::unknown;
+   for( ; Idx + 1 < End; ++Idx ) {
+      tok::TokenKind K = Toks.getKind(Idx);
+      switch( K ) {
+      case tok::l_paren: case tok::l_square: case tok::l_brace:
+         ++depth;
+         break;
+      case tok::r_paren: case tok::r_square: case tok::r_brace:
+         if( depth == 0 ) {
+            return;
+         }
+         --depth;
+         break;
+      case tok::comma:
+         if( depth == Depth ) {
+            in_initializer = false;
+         }
+         break;
+      case tok::equal:
+         if( depth == Depth ) {
+            in_initializer = true;
+         }
+         break;
+      case tok::identifier: {
+         if( depth != Depth || in_initializer ) {
+            break;
+         }
+         tok::TokenKind next = Toks.getKind(Idx + 1);
+         // A type name can be followed by its packed dimensions, so '['
+         // ends a declarator only after a type.
+         if( next == tok::equal || next == tok::comma || next == tok::semi ||
+             next == tok::r_brace ||
+             (next == tok::l_square && prev != tok::unknown &&
+              prev != tok::coloncolon && prev != tok::kw_const &&
+              prev != tok::kw_var) ) {
+            Names.push_back(Idx);
+         }
+         break;
+      }
+      default:
+         break;
+      }
+      if( depth == Depth ) {
+         prev = K;
+      }
+   }
+}
+
+/// recordPackageItem - Add the symbols that package item [Idx, End) of the
+/// token buffer declares to the current package.
+void Parser::recordPackageItem(unsigned Idx, unsigned End)
+{
+   if( Idx == End ) {
+      return;
+   }
+   SmallVector<unsigned, 8> names;
+   PackageSymbolKind kind = PackageSymbolKind::Variable;
+   unsigned decl = Idx;
+   tok::TokenKind K = TokBuf->getKind(Idx);
+   // A DPI import declares the function or task it imports; a package
+   // import declares nothing.
+   if( K == tok::kw_import && Idx + 1 < End &&
+       TokBuf->getKind(Idx + 1) == tok::string_literal ) {
+      while( Idx < End && TokBuf->getKind(Idx) != tok::kw_function &&
+             TokBuf->getKind(Idx) != tok::kw_task ) {
+         ++Idx;
+      }
+      if( Idx == End ) {
+         return;
+      }
+      K = TokBuf->getKind(Idx);
+   }
+   switch( K ) {
+   case tok::kw_import:
+   case tok::kw_export:
+   case tok::semi:
+      return;
+
+   case tok::kw_parameter:
+   case tok::kw_localparam:
+      kind = PackageSymbolKind::Parameter;
+      scanDeclarators(*TokBuf, Idx + 1, End, 0, names);
+      break;
+
+   case tok::kw_typedef: {
+      kind = PackageSymbolKind::Type;
+      scanDeclarators(*TokBuf, Idx + 1, End, 0, names);
+      // The constants of an enumerated type belong to the package too.
+      if( Idx + 1 < End && TokBuf->getKind(Idx + 1) == tok::kw_enum ) {
+         unsigned brace = Idx + 2;
+         while( brace < End && TokBuf->getKind(brace) != tok::l_brace ) {
+            ++brace;
+         }
+         SmallVector<unsigned, 16> constants;
+         scanDeclarators(*TokBuf, brace, End, 1, constants);
+         for( unsigned i = 0; i != constants.size(); ++i ) {
+            Packages->addSymbol(TokBuf->getIdentifierInfo(constants[i])->getName(),
+                                PackageSymbolKind::EnumConstant, Idx, End);
+         }
+      }
+      break;
+   }
+
+   case tok::kw_function:
+   case tok::kw_task: {
+      // The name is the last identifier before the ports or the ';'.
+      kind = K == tok::kw_function ? PackageSymbolKind::Function
+                                   : PackageSymbolKind::Task;
+      unsigned name = End;
+      for( unsigned i = Idx + 1; i < End; ++i ) {
+         tok::TokenKind T = TokBuf->getKind(i);
+         if( T == tok::l_paren || T == tok::semi ) {
+            break;
+         }
+         if( T == tok::l_square ) {
+            while( i < End && TokBuf->getKind(i) != tok::r_square ) {
+               ++i;
+            }
+         } else if( T == tok::identifier ) {
+            name = i;
+         }
+      }
+      if( name != End ) {
+         names.push_back(name);
+      }
+      break;
+   }
+
+   case tok::kw_virtual:
+   case tok::kw_class:
+   case tok::kw_covergroup:
+      kind = K == tok::kw_covergroup ? PackageSymbolKind::Type
+                                     : PackageSymbolKind::Class;
+      for( unsigned i = Idx + 1; i < End; ++i ) {
+         if( TokBuf->getKind(i) == tok::identifier ) {
+            names.push_back(i);
+            break;
+         }
+      }
+      break;
+
+   default: {
+      // A data or net declaration, possibly with qualifiers.
+      unsigned first = Idx;
+      while( first < End && (TokBuf->getKind(first) == tok::kw_const ||
+                             TokBuf->getKind(first) == tok::kw_var ||
+                             TokBuf->getKind(first) == tok::kw_static ||
+                             TokBuf->getKind(first) == tok::kw_automatic) ) {
+         ++first;
+      }
+      if( first < End && isNetTypeKeyword(TokBuf->getKind(first)) ) {
+         kind = PackageSymbolKind::Net;
+      }
+      scanDeclarators(*TokBuf, first, End, 0, names);
+      break;
+   }
+   }
+
+   for( unsigned i = 0; i != names.size(); ++i ) {
+      Packages->addSymbol(TokBuf->getIdentifierInfo(names[i])->getName(), kind,
+                          decl, End);
+   }
+}
 
 // package_or_generate_item_declaration ::=
 //   net_declaration
@@ -993,6 +1610,12 @@ bool Parser::ParsePackageOrGenerateItemDeclaration()
    case tok::kw_function:
       ParseTaskOrFunctionDeclaration();
       break;
+   case tok::kw_import:
+      ParsePackageImportDeclaration();
+      break;
+   case tok::kw_typedef:
+      ParseTypeDeclaration();
+      break;
    default:
       return false;
       break;
@@ -1027,11 +1650,19 @@ UNIMPLEMENTED_PARSE(ParseRefDeclaration)
 bool Parser::ParsePortDeclaration(  )
 {
    bool require_net_port_type = false;
+   PortKind kind;
    switch( Tok.getKind() ) {
    case tok::kw_inout:
       require_net_port_type = true;
+      kind = PortKind::Inout;
+      ConsumeToken();
+      break;
    case tok::kw_input:
+      kind = PortKind::Input;
+      ConsumeToken();
+      break;
    case tok::kw_output:
+      kind = PortKind::Output;
       ConsumeToken();
       break;
    default:
@@ -1039,6 +1670,10 @@ bool Parser::ParsePortDeclaration(  )
       break;
    }
 
+   if( Netlist ) {
+      recordNetlistPorts(kind);
+   }
+
    auto netType = ParseNetType();
    ParseDataTypeOrImplicit( netType );
 
@@ -1052,6 +1687,40 @@ bool Parser::ParsePortDeclaration(  )
    return true;
 }
 
+// Records the ports named by the port declaration whose direction was just
+// consumed: the identifiers outside brackets that end a declarator.
+void Parser::recordNetlistPorts(PortKind Kind)
+{
+   const TokenBuffer &Buf = *TokBuf;
+   unsigned Depth = 0;
+   for( unsigned Idx = TokBufPos - 1; ; ++Idx ) {
+      switch( Buf.getKind(Idx) ) {
+      case tok::l_square:
+         ++Depth;
+         break;
+      case tok::r_square:
+         if( Depth ) {
+            --Depth;
+         }
+         break;
+      case tok::identifier:
+         if( Depth == 0 ) {
+            tok::TokenKind Next = Buf.getKind(Idx + 1);
+            if( Next == tok::comma || Next == tok::semi ||
+                Next == tok::l_square || Next == tok::equal ) {
+               Netlist->addPort(Buf.getIdentifierInfo(Idx)->getName(), Kind);
+            }
+         }
+         break;
+      case tok::semi:
+      case tok::eof:
+         return;
+      default:
+         break;
+      }
+   }
+}
+
 // Section A.2.2.2 - Strengnths
 // TODO
 
@@ -1301,7 +1970,62 @@ DimResult Parser::ParseDimension()
 
 // Section A.2.6 - Function declarations
 
-UNIMPLEMENTED_PARSE(ParseDpiImportExport)
+// dpi_import_export ::=
+//   import dpi_spec_string [ dpi_function_import_property ] [ c_identifier = ] dpi_function_proto ;
+// | import dpi_spec_string [ dpi_task_import_property ] [ c_identifier = ] dpi_task_proto ;
+// | export dpi_spec_string [ c_identifier = ] function function_identifier ;
+// | export dpi_spec_string [ c_identifier = ] task task_identifier ;
+// dpi_function_import_property ::= context | pure
+// dpi_task_import_property ::= context
+// dpi_function_proto ::= function data_type_or_void function_identifier [ ( [ tf_port_list ] ) ]
+// dpi_task_proto ::= task task_identifier [ ( [ tf_port_list ] ) ]
+bool Parser::ParseDpiImportExport()
+{
+   assert((Tok.is(tok::kw_import) || Tok.is(tok::kw_export)) && "");
+   bool is_import = Tok.is(tok::kw_import);
+   ConsumeToken();
+   assert(Tok.is(tok::string_literal) && "Expected the DPI spec string");
+   ConsumeStringToken();
+
+   if( is_import && !ConsumeIfMatch(tok::kw_context) ) {
+      ConsumeIfMatch(tok::kw_pure);
+   }
+   if( Tok.is(tok::identifier) && NextToken().is(tok::equal) ) {
+      ConsumeToken();
+      ConsumeToken();
+   }
+
+   bool is_task = Tok.is(tok::kw_task);
+   if( !is_task && Tok.isNot(tok::kw_function) ) {
+      Diag(Tok, diag::err_expected_dpi_prototype) << !is_import;
+      SkipUntil(tok::semi);
+      return true;
+   }
+   ConsumeToken();
+
+   // The return type of an imported function; an export names the routine
+   // only.
+   if( is_import && !is_task &&
+       !(Tok.is(tok::identifier) &&
+         (NextToken().is(tok::l_paren) || NextToken().is(tok::semi))) &&
+       !ParseDataTypeForDeclaration() ) {
+      SkipUntil(tok::semi);
+      return true;
+   }
+   if( Tok.isNot(tok::identifier) ) {
+      Diag(Tok, diag::err_expected_ident_for) << (is_task ? "task" : "function");
+      SkipUntil(tok::semi);
+      return true;
+   }
+   ParseIdentifier(0);
+
+   if( is_import && Tok.is(tok::l_paren) ) {
+      // TODO: Make sure list_of_port_declarations is compatabile with tf_port_list
+      ParseListOfPortDeclarations();
+   }
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+   return true;
+}
 UNIMPLEMENTED_PARSE(ParseDpiSpecString)
 UNIMPLEMENTED_PARSE(ParseDpiFunctionImportProperty)
 UNIMPLEMENTED_PARSE(ParseDpiTaskImportProperty)
@@ -1544,6 +2268,8 @@ UNIMPLEMENTED_PARSE(ParseOverloadProtoFormals)
 // TODO: pullup/pulldown
 bool Parser::ParseGateInstantiation()
 {
+   IdentifierInfo *gate = Tok.getIdentifierInfo();
+   SourceLocation gate_loc = Tok.getLocation();
    switch(Tok.getKind()){
    case tok::kw_buf:   case tok::kw_bufif0:   case tok::kw_bufif1:
    case tok::kw_not:   case tok::kw_notif0:   case tok::kw_notif1:
@@ -1573,9 +2299,21 @@ bool Parser::ParseGateInstantiation()
       ParseDelay3();
    }
 
+   unsigned cell = NetlistTable::NoName;
+   if( Netlist ) {
+      cell = Netlist->getNameID(gate);
+      Netlist->noteComplexItem();
+   }
+
    do{
       // Parse instance name
+      unsigned name = NetlistTable::NoName;
+      SourceLocation loc = gate_loc;
       if( Tok.is(tok::identifier) ){
+         if( Netlist ) {
+            name = Netlist->getNameID(Tok.getIdentifierInfo());
+            loc = Tok.getLocation();
+         }
          ParseIdentifier(&ident);
       }
 
@@ -1586,8 +2324,17 @@ bool Parser::ParseGateInstantiation()
       }
       ConsumeParen();
 
+      if( Netlist ) {
+         Netlist->addInstance(cell, name, loc);
+      }
+      unsigned pos = 0;
       do{
-         ParseExpression(prec::Assignment);
+         if( Netlist ) {
+            Netlist->addConnection(NetlistTable::getOrderedPin(pos++),
+                                   ParseNetlistConnection());
+         } else {
+            ParseExpression(prec::Assignment);
+         }
       } while(ConsumeIfMatch(tok::comma));
 
       ExpectAndConsume(tok::r_paren, diag::err_expected_rparen, "", tok::semi);
@@ -1597,6 +2344,343 @@ bool Parser::ParseGateInstantiation()
    return true;
 }
 
+// Netlist mode fast path.
+//
+// A gate-level netlist is almost entirely instantiations like
+//    NAND2X1 U12 (.A(n3), .B(n7[2]), .Y(n12));
+// Rather than going through ParseModuleItem and ParseExpression for every
+// connection, scanNetlistInstantiation checks the token kinds of the whole
+// instantiation in the token buffer, and if every connection is simple,
+// recordNetlistInstantiation enters it in the netlist table and the
+// parser skips past the ';'.  Continuous assignments between simple
+// connections are handled the same way.  Parameter assignments, delays,
+// strengths, attributes, part-selects and expressions take the general
+// path, which records them in the netlist table as well, with a net of its
+// own for each connection that is not a plain identifier.
+
+static bool isNetlistCell(tok::TokenKind K) {
+   switch(K){
+   case tok::identifier:
+   case tok::kw_buf:   case tok::kw_bufif0:   case tok::kw_bufif1:
+   case tok::kw_not:   case tok::kw_notif0:   case tok::kw_notif1:
+   case tok::kw_tran:  case tok::kw_tranif0:  case tok::kw_tranif1:
+   case tok::kw_rtran: case tok::kw_rtranif0: case tok::kw_rtranif1:
+   case tok::kw_cmos:  case tok::kw_rcmos:
+   case tok::kw_nmos:  case tok::kw_rnmos:
+   case tok::kw_and:   case tok::kw_or:       case tok::kw_xor:
+   case tok::kw_nand:  case tok::kw_nor:      case tok::kw_xnor:
+   case tok::kw_pulldown: case tok::kw_pullup:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static bool isBaseSpecifier(tok::TokenKind K) {
+   switch(K){
+   case tok::base_signed_binary: case tok::base_signed_decimal:
+   case tok::base_signed_oct:    case tok::base_signed_hex:
+   case tok::base_binary:        case tok::base_decimal:
+   case tok::base_oct:           case tok::base_hex:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/// \brief Read the decimal bit index at \p Idx into \p Bit.  Returns true
+/// if it is not a plain decimal number.
+static bool getNetlistBit(const TokenBuffer &Buf, unsigned Idx, unsigned &Bit) {
+   const char *Data = Buf.getLiteralData(Idx);
+   return !Data || StringRef(Data, Buf.getLength(Idx)).getAsInteger(10, Bit) ||
+          Bit >= NetlistTable::OpaqueBit;
+}
+
+bool Parser::ParseNetlistInstantiation()
+{
+   unsigned Idx = TokBufPos - 1;
+   unsigned End;
+   if( Tok.is(tok::kw_assign) ) {
+      End = scanNetlistAssign(Idx);
+      if( !End ) {
+         return false;
+      }
+      recordNetlistAssign(Idx, End);
+   } else {
+      if( !isNetlistCell(Tok.getKind()) ) {
+         return false;
+      }
+      End = scanNetlistInstantiation(Idx);
+      if( !End ) {
+         return false;
+      }
+      recordNetlistInstantiation(Idx, End);
+   }
+
+   PrevTokLocation = TokBuf->getLocation(End);
+   TokBufPos = End + 1;
+   LexToken();
+   return true;
+}
+
+// Returns the index of the ';' ending the simple instantiation at Idx, or 0.
+// Every test stops at the buffer's final eof, so no index runs past it.
+unsigned Parser::scanNetlistInstantiation(unsigned Idx) const
+{
+   const TokenBuffer &Buf = *TokBuf;
+   bool IsGate = Buf.getKind(Idx) != tok::identifier;
+   if( !Buf.getIdentifierInfo(Idx) ) {
+      return 0;
+   }
+   ++Idx;
+
+   for(;;) {
+      // Only gate instances may be unnamed.
+      if( Buf.getKind(Idx) == tok::identifier ) {
+         ++Idx;
+      } else if( !IsGate ) {
+         return 0;
+      }
+      if( Buf.getKind(Idx) != tok::l_paren ) {
+         return 0;
+      }
+      ++Idx;
+
+      if( Buf.getKind(Idx) == tok::period ) {
+         for(;;) {
+            if( Buf.getKind(Idx) != tok::period ||
+                Buf.getKind(Idx + 1) != tok::identifier ||
+                Buf.getKind(Idx + 2) != tok::l_paren ) {
+               return 0;
+            }
+            Idx += 3;
+            if( Buf.getKind(Idx) != tok::r_paren &&
+                !(Idx = scanNetlistConnection(Idx)) ) {
+               return 0;
+            }
+            if( Buf.getKind(Idx) != tok::r_paren ) {
+               return 0;
+            }
+            if( Buf.getKind(++Idx) != tok::comma ) {
+               break;
+            }
+            ++Idx;
+         }
+      } else if( Buf.getKind(Idx) != tok::r_paren ) {
+         for(;;) {
+            if( !(Idx = scanNetlistConnection(Idx)) ) {
+               return 0;
+            }
+            if( Buf.getKind(Idx) != tok::comma ) {
+               break;
+            }
+            ++Idx;
+         }
+      }
+
+      if( Buf.getKind(Idx) != tok::r_paren ) {
+         return 0;
+      }
+      ++Idx;
+      if( Buf.getKind(Idx) == tok::semi ) {
+         return Idx;
+      }
+      if( Buf.getKind(Idx) != tok::comma ) {
+         return 0;
+      }
+      ++Idx;
+   }
+}
+
+// Returns the index after the identifier, bit-select or constant at Idx,
+// or 0.
+unsigned Parser::scanNetlistConnection(unsigned Idx) const
+{
+   const TokenBuffer &Buf = *TokBuf;
+   unsigned Bit;
+   switch(Buf.getKind(Idx)){
+   case tok::identifier:
+      if( Buf.getKind(Idx + 1) != tok::l_square ) {
+         return Idx + 1;
+      }
+      if( Buf.getKind(Idx + 2) != tok::numeric_constant ||
+          getNetlistBit(Buf, Idx + 2, Bit) ||
+          Buf.getKind(Idx + 3) != tok::r_square ) {
+         return 0;
+      }
+      return Idx + 4;
+   case tok::numeric_constant:
+      if( !isBaseSpecifier(Buf.getKind(Idx + 1)) ) {
+         return Idx + 1;
+      }
+      ++Idx;
+      // Fall through to the base and value of a sized constant.
+   default:
+      if( !isBaseSpecifier(Buf.getKind(Idx)) ||
+          (Buf.getKind(Idx + 1) != tok::numeric_constant &&
+           Buf.getKind(Idx + 1) != tok::numeric_constant_xz) ) {
+         return 0;
+      }
+      return Idx + 2;
+   }
+}
+
+// Returns the index of the ';' ending the continuous assignment at Idx if
+// every assignment in it is of an identifier or bit-select to a simple
+// connection, or 0.
+unsigned Parser::scanNetlistAssign(unsigned Idx) const
+{
+   const TokenBuffer &Buf = *TokBuf;
+   if( !Buf.getIdentifierInfo(Idx) ) {
+      return 0;
+   }
+   ++Idx;
+   for(;;) {
+      if( Buf.getKind(Idx) != tok::identifier ||
+          !(Idx = scanNetlistConnection(Idx)) ||
+          Buf.getKind(Idx) != tok::equal ||
+          !(Idx = scanNetlistConnection(Idx + 1)) ) {
+         return 0;
+      }
+      if( Buf.getKind(Idx) == tok::semi ) {
+         return Idx;
+      }
+      if( Buf.getKind(Idx) != tok::comma ) {
+         return 0;
+      }
+      ++Idx;
+   }
+}
+
+// Records the instantiation at Idx that scanNetlistInstantiation accepted
+// up to the ';' at End.
+void Parser::recordNetlistInstantiation(unsigned Idx, unsigned End)
+{
+   const TokenBuffer &Buf = *TokBuf;
+   NetlistTable &Table = *Netlist;
+   unsigned Cell = Table.getNameID(Buf.getIdentifierInfo(Idx));
+   SourceLocation Loc = Buf.getLocation(Idx);
+   bool is_module = Buf.getKind(Idx) == tok::identifier;
+   ++Idx;
+
+   while( Idx < End ) {
+      unsigned Name = NetlistTable::NoName;
+      if( Buf.getKind(Idx) == tok::identifier ) {
+         Loc = Buf.getLocation(Idx);
+         Name = Table.getNameID(Buf.getIdentifierInfo(Idx));
+         ++Idx;
+      }
+      Table.addInstance(Cell, Name, Loc);
+      if( Units && is_module ) {
+         Units->addInstance(Table.getName(Cell), Name == NetlistTable::NoName ?
+                            StringRef() : Table.getName(Name));
+      }
+      ++Idx;
+
+      for( unsigned Pos = 0; Buf.getKind(Idx) != tok::r_paren; ++Pos ) {
+         unsigned Net = NetlistTable::NoNet;
+         if( Buf.getKind(Idx) == tok::period ) {
+            unsigned Pin = Table.getNameID(Buf.getIdentifierInfo(Idx + 1));
+            Idx += 3;
+            if( Buf.getKind(Idx) != tok::r_paren ) {
+               Idx = recordNetlistConnection(Idx, Net);
+            }
+            Table.addConnection(Pin, Net);
+            ++Idx;
+         } else {
+            Idx = recordNetlistConnection(Idx, Net);
+            Table.addConnection(NetlistTable::getOrderedPin(Pos), Net);
+         }
+         if( Buf.getKind(Idx) == tok::comma ) {
+            ++Idx;
+         }
+      }
+
+      // Skip the ')' and the ',' or ';' after it.
+      Idx += 2;
+   }
+}
+
+// Records each assignment of the continuous assignment at Idx that
+// scanNetlistAssign accepted up to the ';' at End, as an "assign" cell
+// driving its left-hand side from its right-hand side.
+void Parser::recordNetlistAssign(unsigned Idx, unsigned End)
+{
+   const TokenBuffer &Buf = *TokBuf;
+   NetlistTable &Table = *Netlist;
+   unsigned Cell = Table.getNameID(Buf.getIdentifierInfo(Idx));
+   ++Idx;
+
+   while( Idx < End ) {
+      unsigned LHS, RHS;
+      Table.addInstance(Cell, NetlistTable::NoName, Buf.getLocation(Idx));
+      Idx = recordNetlistConnection(Idx, LHS);
+      Idx = recordNetlistConnection(Idx + 1, RHS);
+      Table.addConnection(NetlistTable::getOrderedPin(0), LHS);
+      Table.addConnection(NetlistTable::getOrderedPin(1), RHS);
+
+      // Skip the ',' or ';'.
+      ++Idx;
+   }
+}
+
+// Sets Net to the net of the connection at Idx and returns the index after
+// it.
+unsigned Parser::recordNetlistConnection(unsigned Idx, unsigned &Net)
+{
+   const TokenBuffer &Buf = *TokBuf;
+   if( Buf.getKind(Idx) == tok::identifier ) {
+      unsigned Bit = NetlistTable::NoBit;
+      unsigned Next = Idx + 1;
+      if( Buf.getKind(Next) == tok::l_square ) {
+         getNetlistBit(Buf, Idx + 2, Bit);
+         Next = Idx + 4;
+      }
+      Net = Netlist->getNetID(Buf.getIdentifierInfo(Idx), Bit);
+      return Next;
+   }
+
+   // A constant is spelled by its tokens, which may come from a macro.
+   unsigned Next = scanNetlistConnection(Idx);
+   SmallString<32> Spelling;
+   Token T;
+   for( unsigned I = Idx; I != Next; ++I ) {
+      SmallString<16> Buffer;
+      TokBuf->getToken(I, T);
+      Spelling += PP.getSpelling(T, Buffer);
+   }
+   Net = Netlist->getConstantNetID(Spelling);
+   return Next;
+}
+
+// Parses the expression connected to a pin, or assigned, by an item the
+// general parser records in the netlist table, and returns its net.  A
+// plain identifier is the net of its name; any other expression is a net
+// of its own, named by its spelling.
+unsigned Parser::ParseNetlistConnection()
+{
+   if( Tok.is(tok::identifier) &&
+       (NextToken().is(tok::comma) || NextToken().is(tok::r_paren) ||
+        NextToken().is(tok::semi)) ) {
+      unsigned Net = Netlist->getNetID(Tok.getIdentifierInfo(),
+                                       NetlistTable::NoBit);
+      ConsumeToken();
+      return Net;
+   }
+
+   SourceLocation Start = Tok.getLocation();
+   ParseExpression(prec::Assignment);
+   if( Tok.getLocation() == Start ) {
+      return NetlistTable::NoNet;
+   }
+   // The expression may come from a macro; it is spelled as expanded.
+   SourceManager &SM = PP.getSourceManager();
+   CharSourceRange Range = CharSourceRange::getTokenRange(
+      SM.getExpansionLoc(Start), SM.getExpansionRange(PrevTokLocation).second);
+   return Netlist->getOpaqueNetID(
+      Lexer::getSourceText(Range, SM, getLangOpts()));
+}
+
 // Section A.4 - Instantiations
 // Section A.4.1.1 - Module instantiation
 // module_instantiation ::= module_identifier [ parameter_value_assignment ] hierarchical_instance { , hierarchical_instance } ;
@@ -1610,8 +2694,28 @@ bool Parser::ParseModuleInstantiation()
    }
    ParseIdentifier(&ident);
 
+   // Only what looks like an instantiation, not a declaration of a user
+   // defined type, names a cell.
+   bool is_instantiation = Tok.is(tok::hash) ||
+      (Tok.is(tok::identifier) && NextToken().is(tok::l_paren));
+   unsigned cell = NetlistTable::NoName;
+   if( Netlist && is_instantiation ) {
+      cell = Netlist->getNameID(ident);
+      Netlist->noteComplexItem();
+   }
+
+   // Parameter value assignments are not parsed yet; skip them so that the
+   // instances after them are.
+   if( Tok.is(tok::hash) && NextToken().is(tok::l_paren) ) {
+      ConsumeToken();
+      SkipBlock(tok::l_paren, tok::r_paren);
+   }
+
    do {
-      if( ParseHierarchicalInstance() ) {
+      if( Units && is_instantiation && Tok.is(tok::identifier) ) {
+         Units->addInstance(ident, Tok.getIdentifierInfo()->getName());
+      }
+      if( ParseHierarchicalInstance(cell) ) {
          require_ident = true;
       } else if ( require_ident ) {
          // TODO: Error handling
@@ -1629,15 +2733,24 @@ UNIMPLEMENTED_PARSE(ParseOrderedParameterAssignment)
 UNIMPLEMENTED_PARSE(ParseNamedParameterAssignment)
 
 //  hierarchical_instance ::= name_of_instance ( [ list_of_port_connections ] )
-bool Parser::ParseHierarchicalInstance()
+//
+// Records the instance of Cell in the netlist table, unless it is NoName.
+bool Parser::ParseHierarchicalInstance(unsigned Cell)
 {
    llvm::StringRef ident;
    if( Tok.isNot(tok::identifier)){
       return false;
    }
+   bool record = Cell != NetlistTable::NoName;
+   if( record ) {
+      Netlist->addInstance(Cell, Netlist->getNameID(Tok.getIdentifierInfo()),
+                           Tok.getLocation());
+   }
   ParseIdentifier( &ident );
   ExpectAndConsume(tok::l_paren, diag::err_expected_lparen_after, "module instance name");
-  ParseListOfPortConnections();
+  if( !record || Tok.isNot(tok::r_paren) ) {
+     ParseListOfPortConnections(record);
+  }
   ExpectAndConsume(tok::r_paren, diag::err_expected_rparen);
    return true;
 }
@@ -1653,12 +2766,16 @@ bool Parser::ParseNameOfInstance()
 // named_port_connection ::=
 //      { attribute_instance } . port_identifier [ ( [ expression ] ) ]
 //    | { attribute_instance } .*   // TODO
-bool Parser::ParseListOfPortConnections()
+//
+// With Record, the connections are added to the last instance of the
+// netlist table.
+bool Parser::ParseListOfPortConnections(bool Record)
 {
    llvm::StringRef ident;
 
    // Named port connection
    bool namedPortConnection = Tok.is(tok::period);
+   unsigned pos = 0;
 
    do {
 
@@ -1667,7 +2784,16 @@ bool Parser::ParseListOfPortConnections()
             Diag(Tok, diag::err_cant_mix_port_connection);
          }
 
-         ParseExpression(prec::Assignment);
+         if( !Record ) {
+            ParseExpression(prec::Assignment);
+         } else if( Tok.is(tok::comma) || Tok.is(tok::r_paren) ) {
+            Netlist->addConnection(NetlistTable::getOrderedPin(pos),
+                                   NetlistTable::NoNet);
+         } else {
+            Netlist->addConnection(NetlistTable::getOrderedPin(pos),
+                                   ParseNetlistConnection());
+         }
+         ++pos;
          continue;
       }
 
@@ -1684,10 +2810,17 @@ bool Parser::ParseListOfPortConnections()
          continue;
       }
 
+      unsigned pin = Record ? Netlist->getNameID(Tok.getIdentifierInfo()) : 0;
       ParseIdentifier(&ident);
 
       ExpectAndConsume(tok::l_paren, diag::err_expected_lparen_after, "port identifier");
-      ParseExpression(prec::Assignment);
+      if( !Record ) {
+         ParseExpression(prec::Assignment);
+      } else if( Tok.is(tok::r_paren) ) {
+         Netlist->addConnection(pin, NetlistTable::NoNet);
+      } else {
+         Netlist->addConnection(pin, ParseNetlistConnection());
+      }
       ExpectAndConsume(tok::r_paren, diag::err_expected_rparen);
    } while( ConsumeIfMatch( tok::comma ) );
 
@@ -1745,6 +2878,24 @@ bool Parser::ParseHierarchicalIdentifier()
    }
 #endif
 
+   // A package-qualified name, or an unqualified first name that may come
+   // from an imported package.
+   if( Tok.is(tok::identifier) && NextToken().is(tok::coloncolon) ) {
+      ParsePackageScope();
+      if( Tok.is(tok::identifier) ) {
+         ParseIdentifier( &ident );
+         found_ident = true;
+         if( Tok.is( tok::l_square ) ) {
+            ParseSelectOrRange();
+         }
+         if( !ConsumeIfMatch(tok::period) ) {
+            return true;
+         }
+      }
+   } else if( Packages && Tok.is(tok::identifier) ) {
+      Packages->lookup(Tok.getIdentifierInfo()->getName());
+   }
+
    do{
       if( Tok.isNot(tok::identifier)){
          break;
@@ -1767,13 +2918,35 @@ bool Parser::ParseHierarchicalIdentifier()
    }
    return found_ident;
 }
+// package_scope ::= package_identifier :: | $unit ::
+// Consumes the scope and, for a package, resolves the name after it.
 bool Parser::ParsePackageScope()
 {
-   return false;
+   if( Tok.isNot(tok::identifier) || NextToken().isNot(tok::coloncolon) ) {
+      return false;
+   }
+   llvm::StringRef package_name;
+   SourceLocation package_loc = Tok.getLocation();
+   ParseIdentifier(&package_name);
+   ConsumeToken();
+
+   if( Packages && Tok.is(tok::identifier) ) {
+      llvm::StringRef name = Tok.getIdentifierInfo()->getName();
+      if( Packages->findPackage(package_name) == PackageTable::NoPackage ) {
+         Diag(package_loc, diag::err_unknown_package) << package_name;
+      } else if( Packages->lookupQualified(package_name, name) ==
+                 PackageTable::NoSymbol ) {
+         Diag(Tok, diag::err_unknown_package_symbol) << package_name << name;
+      }
+   }
+   return true;
 }
 
 bool Parser::ParseIdentifier(llvm::StringRef *ref){
    assert(Tok.is(tok::identifier));
+   if( ref && Tok.getIdentifierInfo() ) {
+      *ref = Tok.getIdentifierInfo()->getName();
+   }
    ConsumeToken();
    return true;
 }
\ No newline at end of file
@@ -168,26 +168,192 @@ bool Parser::ParseDataDeclarationList(){
 	return true;
 }
 
+// package_import_declaration ::= import package_import_item { , package_import_item } ;
 bool Parser::ParsePackageImportDeclaration()
 {
-	return false;
+   if( Tok.isNot(tok::kw_import) ) {
+      return false;
+   }
+
+   if( NextToken().is(tok::string_literal) ) {
+      return ParseDpiImportExport();
+   }
+
+   ConsumeToken();
+   do {
+      if( !ParseImportItem() ) {
+         SkipUntil(tok::comma, tok::semi, true, true);
+      }
+   } while( ConsumeIfMatch(tok::comma) );
+
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+   return true;
 }
+
+// package_import_item ::= package_identifier :: identifier
+//                       | package_identifier :: *
 bool Parser::ParseImportItem()
 {
-	return false;
+   llvm::StringRef package_name;
+   llvm::StringRef ident;
+   if( Tok.isNot(tok::identifier) ) {
+      Diag(Tok, diag::err_expected_ident_for) << "package";
+      return false;
+   }
+   SourceLocation package_loc = Tok.getLocation();
+   ParseIdentifier(&package_name);
+
+   if( ExpectAndConsume(tok::coloncolon, diag::err_expected_coloncolon_after, "package name") ) {
+      return false;
+   }
+
+   SourceLocation item_loc = Tok.getLocation();
+   bool wildcard = false;
+   if( Tok.is(tok::star) ) {
+      ConsumeToken();
+      wildcard = true;
+   } else if( Tok.is(tok::identifier) ) {
+      ParseIdentifier(&ident);
+   } else {
+      Diag(Tok, diag::err_expected_ident);
+      return false;
+   }
+
+   if( !Packages ) {
+      return true;
+   }
+   if( Packages->findPackage(package_name) == PackageTable::NoPackage ) {
+      Diag(package_loc, diag::err_unknown_package) << package_name;
+   } else if( wildcard ) {
+      Packages->importAll(package_name);
+   } else if( !Packages->importName(package_name, ident) ) {
+      Diag(item_loc, diag::err_unknown_package_symbol) << package_name << ident;
+   }
+   return true;
 }
+
+// package_export_declaration ::= export *::* ;
+//                              | export package_import_item { , package_import_item } ;
 bool Parser::ParsePackageExportDeclaration()
 {
-	return false;
+   if( Tok.isNot(tok::kw_export) ) {
+      return false;
+   }
+   if( NextToken().is(tok::string_literal) ) {
+      return ParseDpiImportExport();
+   }
+   ConsumeToken();
+
+   // export *::*
+   if( Tok.is(tok::star) ) {
+      ConsumeToken();
+      if( !ExpectAndConsume(tok::coloncolon, diag::err_expected_coloncolon_after, "'*'") &&
+          !ExpectAndConsume(tok::star, diag::err_expected_ident) &&
+          Packages && Packages->isInPackage() ) {
+         Packages->addExport(llvm::StringRef(), llvm::StringRef());
+      }
+      ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+      return true;
+   }
+
+   do {
+      llvm::StringRef package_name;
+      llvm::StringRef ident;
+      if( Tok.isNot(tok::identifier) ) {
+         Diag(Tok, diag::err_expected_ident_for) << "package";
+         SkipUntil(tok::comma, tok::semi, true, true);
+         continue;
+      }
+      SourceLocation package_loc = Tok.getLocation();
+      ParseIdentifier(&package_name);
+      if( ExpectAndConsume(tok::coloncolon, diag::err_expected_coloncolon_after, "package name") ) {
+         SkipUntil(tok::comma, tok::semi, true, true);
+         continue;
+      }
+      SourceLocation item_loc = Tok.getLocation();
+      if( !ConsumeIfMatch(tok::star) ) {
+         if( Tok.isNot(tok::identifier) ) {
+            Diag(Tok, diag::err_expected_ident);
+            SkipUntil(tok::comma, tok::semi, true, true);
+            continue;
+         }
+         ParseIdentifier(&ident);
+      }
+
+      if( !Packages || !Packages->isInPackage() ) {
+         continue;
+      }
+      if( Packages->findPackage(package_name) == PackageTable::NoPackage ) {
+         Diag(package_loc, diag::err_unknown_package) << package_name;
+      } else if( !Packages->addExport(package_name, ident) ) {
+         Diag(item_loc, diag::err_unknown_package_symbol) << package_name << ident;
+      }
+   } while( ConsumeIfMatch(tok::comma) );
+
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+   return true;
 }
 bool Parser::ParseGenvarDeclaration()
 {
 	return false;
 }
 
+// type_declaration ::= typedef data_type type_identifier { variable_dimension } ;
+//                    | typedef [ enum | struct | union | class ] type_identifier ;
 bool Parser::ParseTypeDeclaration()
 {
-	return false;
+   if( Tok.isNot(tok::kw_typedef) ) {
+      return false;
+   }
+   ConsumeToken();
+
+   // A forward declaration names a type defined later.
+   bool forward = false;
+   if( Tok.is(tok::kw_interface) && NextToken().is(tok::kw_class) ) {
+      ConsumeToken();
+      forward = true;
+   }
+   if( Tok.is(tok::kw_class) ||
+       ((Tok.is(tok::kw_enum) || Tok.is(tok::kw_struct) || Tok.is(tok::kw_union)) &&
+        NextToken().is(tok::identifier) && GetLookAheadToken(2).is(tok::semi)) ) {
+      forward = true;
+   }
+   if( forward ) {
+      ConsumeToken();
+   } else if( !ParseDataTypeForDeclaration() ) {
+      SkipUntil(tok::semi);
+      return true;
+   }
+
+   if( Tok.isNot(tok::identifier) ) {
+      Diag(Tok, diag::err_expected_ident_for) << "type";
+      SkipUntil(tok::semi);
+      return true;
+   }
+   ParseIdentifier(0);
+   while( !forward && Tok.is(tok::l_square) ) {
+      ParseDimension();
+   }
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+   return true;
+}
+
+// data_declaration ::= data_type list_of_variable_decl_assignments ;
+// where data_type is a [ package_scope ] type_identifier { packed_dimension }
+bool Parser::ParseUserTypeDataDeclaration()
+{
+   assert(Tok.is(tok::identifier) && "Expected a type identifier");
+   if( !ParseDataTypeForDeclaration() ) {
+      SkipUntil(tok::semi);
+      return true;
+   }
+   if( !ParseListOfVariableDeclAssignments() ) {
+      Diag(Tok, diag::err_expected_list_of_decl_assign);
+      SkipUntil(tok::semi);
+      return true;
+   }
+   ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
+   return true;
 }
 
 DeclLifetime Parser::ParseLifetime(){
@@ -211,14 +377,14 @@ bool Parser::ParseCastingType()
 //   integer_vector_type [ signing ] { packed_dimension }
 // | integer_atom_type [ signing ]
 // | non_integer_type
-// | struct_union [ packed [ signing ] ] { struct_union_member { struct_union_member } } -- TODO
-//   { packed_dimension }
-// | enum [ enum_base_type ] { enum_name_declaration { , enum_name_declaration } } -- TODO
-//   { packed_dimension }
-// | string -- TODO
-// | chandle -- TODO
+// | struct_union [ packed [ signing ] ] { struct_union_member { struct_union_member } }
+//   { packed_dimension } -- ParseDataTypeForDeclaration
+// | enum [ enum_base_type ] { enum_name_declaration { , enum_name_declaration } }
+//   { packed_dimension } -- ParseDataTypeForDeclaration
+// | string -- ParseDataTypeForDeclaration
+// | chandle -- ParseDataTypeForDeclaration
 // | virtual [ interface ] interface_identifier -- TODO
-// | [ class_scope | package_scope ] type_identifier { packed_dimension } -- TODO
+// | [ class_scope | package_scope ] type_identifier { packed_dimension } -- ParseDataTypeForDeclaration
 // | class_type -- TODO
 // | event
 // | ps_covergroup_identifier -- TODO
@@ -304,13 +470,100 @@ TypeResult Parser::ParseDataType(NetType nType)
    return TypeResult(false);
 }
 
+// The data_type of a type, member or data declaration.  Besides the types
+// ParseDataType knows, this takes enums and structs with their bodies, void
+// and a [ package_scope ] type_identifier { packed_dimension }.  Returns false
+// after a diagnostic if there is no type.
+bool Parser::ParseDataTypeForDeclaration()
+{
+   switch( Tok.getKind() ) {
+   case tok::kw_enum:
+      ConsumeToken();
+      if( Tok.isNot(tok::l_brace) && !ParseEnumBaseType() ) {
+         Diag(Tok, diag::err_expected_type);
+         return false;
+      }
+      if( ExpectAndConsume(tok::l_brace, diag::err_expected_lbrace) ) {
+         return false;
+      }
+      do {
+         if( !ParseEnumNameDeclaration() ) {
+            SkipUntil(tok::r_brace, true, true);
+            break;
+         }
+      } while( ConsumeIfMatch(tok::comma) );
+      if( ExpectAndConsume(tok::r_brace, diag::err_expected_rbrace) ) {
+         return false;
+      }
+      break;
+
+   case tok::kw_struct:
+   case tok::kw_union:
+      if( !ParseStructUnion() ) {
+         return false;
+      }
+      break;
+
+   case tok::kw_string:
+   case tok::kw_chandle:
+   case tok::kw_void:
+      ConsumeToken();
+      return true;
+
+   case tok::identifier:
+      ParsePackageScope();
+      if( Tok.isNot(tok::identifier) ) {
+         Diag(Tok, diag::err_expected_ident_for) << "type";
+         return false;
+      }
+      ParseIdentifier(0);
+      break;
+
+   default:
+      if( ParseDataType(NetType::Unknown).isInvalid() ) {
+         Diag(Tok, diag::err_expected_type);
+         return false;
+      }
+      return true;
+   }
+
+   while( Tok.is(tok::l_square) ) {
+      ParseDimension();
+   }
+   return true;
+}
+
+// enum_base_type ::= integer_atom_type [ signing ]
+//                  | integer_vector_type [ signing ] [ packed_dimension ]
+//                  | type_identifier [ packed_dimension ]
 bool Parser::ParseEnumBaseType()
 {
-	return false;
+   if( Tok.is(tok::identifier) ) {
+      ParseIdentifier(0);
+      if( Tok.is(tok::l_square) ) {
+         ParseDimension();
+      }
+      return true;
+   }
+   return !ParseDataType(NetType::Unknown).isInvalid();
 }
+
+// enum_name_declaration ::=
+//   enum_identifier [ [ integral_number [ : integral_number ] ] ] [ = constant_expression ]
 bool Parser::ParseEnumNameDeclaration()
 {
-	return false;
+   if( Tok.isNot(tok::identifier) ) {
+      Diag(Tok, diag::err_expected_ident_for) << "enum constant";
+      return false;
+   }
+   ParseIdentifier(0);
+   if( Tok.is(tok::l_square) ) {
+      ParseDimension();
+   }
+   if( ConsumeIfMatch(tok::equal) ) {
+      ParseExpression(prec::Assignment);
+   }
+   return true;
 }
 bool Parser::ParseClassScope()
 {
@@ -385,14 +638,46 @@ SigningType Parser::ParseSigning()
 
 	return SigningType::Unknown;
 }
+// struct_union_member ::=
+//   { attribute_instance } [ random_qualifier ] data_type_or_void list_of_variable_decl_assignments ;
 bool Parser::ParseStructUnionMember()
 {
-	return false;
+   if( !ConsumeIfMatch(tok::kw_rand) ) {
+      ConsumeIfMatch(tok::kw_randc);
+   }
+   if( !ParseDataTypeForDeclaration() ) {
+      return false;
+   }
+   if( !ParseListOfVariableDeclAssignments() ) {
+      Diag(Tok, diag::err_expected_list_of_decl_assign);
+      return false;
+   }
+   return !ExpectAndConsumeSemi(diag::err_expected_semi_after_decl);
 }
 
+// struct_union [ packed [ signing ] ] { struct_union_member { struct_union_member } }
+// struct_union ::= struct | union [ tagged ]
 bool Parser::ParseStructUnion()
 {
-	return false;
+   assert((Tok.is(tok::kw_struct) || Tok.is(tok::kw_union)) && "");
+   bool is_union = Tok.is(tok::kw_union);
+   ConsumeToken();
+   if( is_union ) {
+      ConsumeIfMatch(tok::kw_tagged);
+   }
+   if( ConsumeIfMatch(tok::kw_packed) ) {
+      ParseSigning();
+   }
+   if( ExpectAndConsume(tok::l_brace, diag::err_expected_lbrace) ) {
+      return false;
+   }
+   while( Tok.isNot(tok::r_brace) && Tok.isNot(tok::eof) ) {
+      if( !ParseStructUnionMember() ) {
+         SkipUntil(tok::semi, tok::r_brace, true, true);
+         ConsumeIfMatch(tok::semi);
+      }
+   }
+   return !ExpectAndConsume(tok::r_brace, diag::err_expected_rbrace);
 }
 bool Parser::ParseTypeReference()
 {
@@ -7,6 +7,7 @@
 #include "vlang/Parse/ParseDiagnostic.h"
 #include "vlang/Sema/Sema.h"
 #include "vlang/Basic/OperatorPrecedence.h"
+#include "vlang/Basic/PerfCounters.h"
 
 #include <llvm/ADT/APInt.h>
 #include <llvm/ADT/ArrayRef.h>
@@ -160,6 +161,7 @@ UNIMPLMENETED_PARSE_EXPR(ParseIncOrDecExpression)
 // conditional_expression ::= cond_predicate ? { attribute_instance } expression : expression
 ExprResult Parser::ParseExpression(prec::Level minPrec)
 {
+	perf::PhaseScope PerfScope(perf::ParseExpression);
 
 	// TODO: Check for unary operators
 	// Check for primary
@@ -172,72 +174,160 @@ ExprResult Parser::ParseExpression(prec::Level minPrec)
 
 }
 
+namespace {
+/// An operator whose right operand is still being parsed.
+struct PendingOperator {
+	tok::TokenKind Kind;
+	prec::Level Prec;
+	ExprResult LHS;
+	ExprResult ConditionalMiddle;
+
+	PendingOperator(tok::TokenKind Kind, prec::Level Prec, ExprResult LHS,
+	                ExprResult ConditionalMiddle)
+		: Kind(Kind), Prec(Prec), LHS(LHS), ConditionalMiddle(ConditionalMiddle) {}
+};
+}
+
+/// Combine a pending operator with its right operand.
+static ExprResult reduceOperator(const PendingOperator &Op, ExprResult RHS) {
+	ExprResult LHS = Op.LHS;
+	if( !LHS.isInvalid() ) {
+		if( Op.Kind != tok::question ) {
+			//LHS = sema->ActOnBinaryOperation(llvm::SMRange(), Op.Kind, LHS.get(), RHS.get());
+		} else {
+			//LHS = sema->ActOnConditionalOperation(llvm::SMRange(), llvm::SMRange(), LHS.get(), Op.ConditionalMiddle.get(), RHS.get());
+		}
+	}
+	return LHS;
+}
+
+// Operator precedence parsing with an explicit operator stack, so that long
+// machine generated chains (CRC and ECC XOR trees, ?: chains) use a bounded
+// amount of native stack.  Operators bind according to getBinOpPrecedence;
+// assignments, implications and ?: group from the right.
 ExprResult Parser::ParseRhsExpression(ExprResult LHS, prec::Level minPrec){
-	//while cur token is a binary operator with precedence >/= min_prec:prec,
-	//		assoc = precedence and associativity of current token
-	//   if assoc is left:
-	//     next_min_prec = prec + 1
-	//   else:
-	//     next_min_prec = prec
-	//	rhs = compute_expr(next_min_prec)
-	//	result = compute operator(result, rhs)
-	auto nextTokPrec = getBinOpPrecedence(Tok.getKind());
+	SmallVector<PendingOperator, 16> Stack;
 
 	while(1){
 		// Finish if precedence is less then MinPrec
 		//   Should never get a ":" here
-		if( nextTokPrec < minPrec || Tok.is(tok::colon) || Tok.is(tok::r_brace) || Tok.is(tok::l_brace))
+		prec::Level nextTokPrec = getBinOpPrecedence(Tok.getKind());
+		bool done = nextTokPrec == prec::Unknown || nextTokPrec < minPrec ||
+		            Tok.is(tok::colon) || Tok.is(tok::r_brace) || Tok.is(tok::l_brace);
+
+		// Fold every pending operator that binds at least as tightly as the next
+		// one into the operand to its right.
+		while( !Stack.empty() &&
+		       (done || Stack.back().Prec > nextTokPrec ||
+		        (Stack.back().Prec == nextTokPrec && !isRightAssociative(nextTokPrec))) ) {
+			LHS = reduceOperator(Stack.back(), LHS);
+			Stack.pop_back();
+		}
+		if( done )
 			return LHS;
 
 		// Grab the token value
 		auto opTokenKind = Tok.getKind();
 		ConsumeAnyToken();
 
-		ExprResult ConditionalMiddle(true);
-		if( nextTokPrec == prec::Conditional) {
-         // LHS is select for condition, now we need to parse actual conditional
-         ConditionalMiddle = ParseExpression(prec::Conditional);
-                
-         if( ExpectAndConsume(tok::colon, diag::err_expected_ternery_colon)){
-            SkipUntil(tok::colon, true, true);
-            // Handle semicolon case
-         }
+		// inside and dist take a braced list, which binds like a primary.
+		if( opTokenKind == tok::kw_inside || opTokenKind == tok::kw_dist ) {
+			ExprResult RHS = opTokenKind == tok::kw_inside ? ParseInsideExpression()
+			                                                : ParseDistList();
+			LHS = reduceOperator(PendingOperator(opTokenKind, nextTokPrec, LHS,
+			                                     ExprResult(true)), RHS);
+			continue;
 		}
 
-		// Parse another leaf here for the RHS of the operator.
-		ExprResult RHS =  ParsePrimaryWithUnary();
-
-		// Remember the precedence of this operator and get the precedence of the
-		// operator immediately to the right of the RHS.
-		auto currentPrec = nextTokPrec;
-		nextTokPrec = getBinOpPrecedence(Tok.getKind());
-		bool isRightAssoc = false;
-
-		// Get the precedence of the operator to the right of the RHS.  If it binds
-		// more tightly with RHS than we do, evaluate it completely first.
-		if( (currentPrec < nextTokPrec) ||
-			((currentPrec == nextTokPrec) && isRightAssoc)) {
-				RHS = ParseRhsExpression(RHS,static_cast<prec::Level>(static_cast<int>(currentPrec) + !isRightAssoc));
-				nextTokPrec = getBinOpPrecedence(Tok.getKind());
-		}
-		assert(nextTokPrec <= currentPrec && "Recursion didn't work!");
+		ExprResult ConditionalMiddle(true);
+		if( opTokenKind == tok::question ) {
+			// LHS is select for condition, now we need to parse actual conditional
+			ConditionalMiddle = ParseExpression(prec::Conditional);
 
-		if( !LHS.isInvalid() ) {
-			if(ConditionalMiddle.isInvalid() ) {
-				//LHS = sema->ActOnBinaryOperation(llvm::SMRange(), opTokenKind, LHS.get(), RHS.get());
-			} else {
-				//LHS = sema->ActOnConditionalOperation(llvm::SMRange(), llvm::SMRange(), LHS.get(), ConditionalMiddle.get(), RHS.get());
+			if( ExpectAndConsume(tok::colon, diag::err_expected_ternery_colon)){
+				SkipUntil(tok::colon, true, true);
+				// Handle semicolon case
 			}
 		}
-	}
 
-	return LHS;
+		Stack.push_back(PendingOperator(opTokenKind, nextTokPrec, LHS,
+		                                ConditionalMiddle));
+
+		// Parse another leaf here for the RHS of the operator.
+		LHS = ParsePrimaryWithUnary();
+	}
 }
 
 
 UNIMPLMENETED_PARSE_EXPR(ParseTaggedUnionExpression)
-UNIMPLMENETED_PARSE_EXPR(ParseInsideExpression)
-UNIMPLMENETED_PARSE_EXPR(ParseValueRange)
+
+// inside_expression ::= expression inside { open_range_list }
+// open_range_list ::= open_value_range { , open_value_range }
+//
+// Parses the braced open_range_list; the caller has consumed 'inside'.
+ExprResult Parser::ParseInsideExpression()
+{
+	if( Tok.isNot(tok::l_brace) ) {
+		Diag(Tok, diag::err_expected_lbrace);
+		return ExprResult(true);
+	}
+	ConsumeBrace();
+
+	do {
+		ParseValueRange();
+	} while( ConsumeIfMatch(tok::comma) );
+
+	if( ExpectAndConsume(tok::r_brace, diag::err_expected_rbrace) ) {
+		SkipUntil(tok::r_brace, true, true);
+		ConsumeIfMatch(tok::r_brace);
+	}
+	return ExprResult(false);
+}
+
+// value_range ::= expression | [ expression : expression ]
+ExprResult Parser::ParseValueRange()
+{
+	if( Tok.isNot(tok::l_square) ) {
+		return ParseExpression(prec::Conditional);
+	}
+	ConsumeBracket();
+
+	auto low = ParseExpression(prec::Assignment);
+	ExpectAndConsume(tok::colon, diag::err_expected_colon);
+	auto high = ParseExpression(prec::Assignment);
+
+	ExpectAndConsume(tok::r_square, diag::err_expected_rsquare);
+	return ExprResult(low.isInvalid() || high.isInvalid());
+}
+
+// expression_or_dist ::= expression [ dist { dist_list } ]
+// dist_list ::= dist_item { , dist_item }
+// dist_item ::= value_range [ dist_weight ]
+// dist_weight ::= := expression | :/ expression
+//
+// Parses the braced dist_list; the caller has consumed 'dist'.
+ExprResult Parser::ParseDistList()
+{
+	if( Tok.isNot(tok::l_brace) ) {
+		Diag(Tok, diag::err_expected_lbrace);
+		return ExprResult(true);
+	}
+	ConsumeBrace();
+
+	do {
+		ParseValueRange();
+		if( Tok.is(tok::colonequal) || Tok.is(tok::colonslash) ) {
+			ConsumeToken();
+			ParseExpression(prec::Conditional);
+		}
+	} while( ConsumeIfMatch(tok::comma) );
+
+	if( ExpectAndConsume(tok::r_brace, diag::err_expected_rbrace) ) {
+		SkipUntil(tok::r_brace, true, true);
+		ConsumeIfMatch(tok::r_brace);
+	}
+	return ExprResult(false);
+}
 
 // mintypmax_expression ::=
 //   expression
@@ -15,6 +15,7 @@
 #include "vlang/Sema/Sema.h"
 #include "RAIIObjectsForParser.h"
 #include "vlang/Parse/ParseDiagnostic.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace vlang;
 
@@ -31,12 +32,17 @@ using namespace vlang;
 bool Parser::ParseContinuousAssign()
 {
    assert( Tok.is(tok::kw_assign));
+   unsigned cell = NetlistTable::NoName;
+   if( Netlist ) {
+      cell = Netlist->getNameID(Tok.getIdentifierInfo());
+      Netlist->noteComplexItem();
+   }
    ConsumeToken();
 
    // TODO: Parse drive_strenght or delay_control
    if( ParseDelayControl() ) {}
 
-   ParseListOfAssignments();
+   ParseListOfAssignments(cell);
 
    ExpectAndConsumeSemi(diag::err_expected_semi_decl_list);
    return true;
@@ -46,7 +52,11 @@ bool Parser::ParseContinuousAssign()
 // list_of_variable_assignments ::= variable_assignment { , variable_assignment }
 // net_assignment               ::= net_lvalue      = expression
 // variable_assignment          ::= variable_lvalue = expression
-bool Parser::ParseListOfAssignments(){
+//
+// Unless Cell is NoName, each assignment is recorded in the netlist table
+// as an instance of Cell driving its left-hand side from its right-hand
+// side, as recordNetlistAssign does.
+bool Parser::ParseListOfAssignments(unsigned Cell){
    llvm::StringRef ident;
    do{
       // TODO: Check for netlvalue
@@ -57,6 +67,8 @@ bool Parser::ParseListOfAssignments(){
          SkipUntil(tok::comma);
          continue;
       }
+      IdentifierInfo *lhs = Tok.getIdentifierInfo();
+      SourceLocation loc = Tok.getLocation();
       ParseIdentifier(&ident);
 
       // Skip to next entry if there is no assignment
@@ -66,6 +78,15 @@ bool Parser::ParseListOfAssignments(){
       // Consume the assignment
       ConsumeToken();
 
+      if( Cell != NetlistTable::NoName ) {
+         Netlist->addInstance(Cell, NetlistTable::NoName, loc);
+         Netlist->addConnection(NetlistTable::getOrderedPin(0),
+                                Netlist->getNetID(lhs, NetlistTable::NoBit));
+         Netlist->addConnection(NetlistTable::getOrderedPin(1),
+                                ParseNetlistConnection());
+         continue;
+      }
+
       auto result = ParseExpression(prec::Assignment);
       // TODO: Handle expression failing
 
@@ -292,6 +313,8 @@ bool Parser::ParseStatementOrNull()
 // statement ::= [ block_identifier : ] { attribute_instance } statement_item
 bool Parser::ParseStatement()
 {
+   perf::PhaseScope PerfScope(perf::ParseStatement);
+
    if( Tok.is(tok::eof) ) {
       return false;
    }
@@ -0,0 +1,354 @@
+//===--- LibraryCache.cpp - Parsed design units of libraries --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the ParsedLibrary and LibraryCache classes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Serialization/LibraryCache.h"
+#include "LibraryFormat.h"
+#include "PackageFormat.h"
+#include "StringDataBuilder.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Parse/DesignUnitTable.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace vlang;
+using namespace vlang::serialization;
+using namespace vlang::serialization::ondisk;
+
+//===----------------------------------------------------------------------===//
+// ParsedLibrary writing
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct LibraryFilePathLess {
+  bool operator()(const LibraryFile *LHS, const LibraryFile *RHS) const {
+    return LHS->Path < RHS->Path;
+  }
+};
+} // end anonymous namespace
+
+uint64_t ParsedLibrary::hashContents(StringRef Data) {
+  return ondisk::hashContents(Data);
+}
+
+void ParsedLibrary::getDependencies(
+    const SourceManager &SM, std::vector<LibraryDependency> &Dependencies) {
+  const FileEntry *MainFile = SM.getFileEntryForID(SM.getMainFileID());
+  for (SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+                                        E = SM.fileinfo_end();
+       I != E; ++I) {
+    const llvm::MemoryBuffer *Buffer = I->second->getRawBuffer();
+    if (!Buffer || I->first == MainFile)
+      continue;
+    // Absolute, so that a run from another directory finds the same file.
+    SmallString<256> Path(I->first->getName());
+    llvm::sys::fs::make_absolute(Path);
+    LibraryDependency D;
+    D.Path = Path.str().str();
+    D.Size = Buffer->getBufferSize();
+    D.Hash = hashContents(Buffer->getBuffer());
+    Dependencies.push_back(D);
+  }
+}
+
+bool ParsedLibrary::writeToFile(StringRef Path, StringRef Name,
+                                ArrayRef<LibraryFile> Files,
+                                std::string &ErrorStr) {
+  StringDataBuilder Strings;
+
+  std::vector<const LibraryFile *> Sorted;
+  for (unsigned I = 0, E = Files.size(); I != E; ++I)
+    Sorted.push_back(&Files[I]);
+  std::sort(Sorted.begin(), Sorted.end(), LibraryFilePathLess());
+
+  std::vector<LibraryFileRecord> FileRecords(Sorted.size());
+  std::vector<FileRecord> Dependencies;
+  std::vector<DefinitionRecord> Definitions;
+  std::vector<InstanceRecord> Instances;
+  for (unsigned I = 0, E = Sorted.size(); I != E; ++I) {
+    const LibraryFile &F = *Sorted[I];
+    LibraryFileRecord &FR = FileRecords[I];
+    memset(&FR, 0, sizeof(FR));
+    FR.Path = Strings.add(F.Path);
+    FR.PathSize = F.Path.size();
+    FR.Size = F.Size;
+    FR.Hash = F.Hash;
+    FR.OptionsHash = F.OptionsHash;
+    FR.FirstDependency = Dependencies.size();
+    FR.NumDependencies = F.Dependencies.size();
+    FR.FirstDefinition = Definitions.size();
+
+    for (unsigned D = 0, DE = F.Dependencies.size(); D != DE; ++D) {
+      const LibraryDependency &Dep = F.Dependencies[D];
+      FileRecord DR;
+      DR.Path = Strings.add(Dep.Path);
+      DR.PathSize = Dep.Path.size();
+      DR.Size = Dep.Size;
+      DR.Hash = Dep.Hash;
+      Dependencies.push_back(DR);
+    }
+    FR.NumDefinitions = F.Units->getNumDefinitions();
+
+    for (unsigned D = 0, DE = F.Units->getNumDefinitions(); D != DE; ++D) {
+      StringRef DefName = F.Units->getDefinitionName(D);
+      ArrayRef<DesignUnitTable::Instance> Insts = F.Units->getInstances(D);
+      DefinitionRecord DR;
+      DR.Name = Strings.add(DefName);
+      DR.NameSize = DefName.size();
+      DR.FirstInstance = Instances.size();
+      DR.NumInstances = Insts.size();
+      Definitions.push_back(DR);
+
+      for (unsigned N = 0, NE = Insts.size(); N != NE; ++N) {
+        InstanceRecord IR;
+        IR.Cell = Strings.add(Insts[N].Cell);
+        IR.CellSize = Insts[N].Cell.size();
+        IR.Name = Strings.add(Insts[N].Name);
+        IR.NameSize = Insts[N].Name.size();
+        Instances.push_back(IR);
+      }
+    }
+  }
+
+  LibraryHeader H;
+  memset(&H, 0, sizeof(H));
+  H.Magic = LibraryMagic;
+  H.Version = LibraryVersion;
+  H.Name = Strings.add(Name);
+  H.NameSize = Name.size();
+  H.NumFiles = FileRecords.size();
+  H.NumDependencies = Dependencies.size();
+  H.NumDefinitions = Definitions.size();
+  H.NumInstances = Instances.size();
+  H.StringDataSize = Strings.getData().size();
+
+  // Write next to the destination and rename, so that a run loading the
+  // previous library never sees a partial file.
+  std::string TempPath = Path.str() + ".tmp";
+  {
+    llvm::raw_fd_ostream OS(TempPath.c_str(), ErrorStr,
+                            llvm::raw_fd_ostream::F_Binary);
+    if (!ErrorStr.empty())
+      return true;
+
+    OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+    if (!FileRecords.empty())
+      OS.write(reinterpret_cast<const char *>(&FileRecords[0]),
+               FileRecords.size() * sizeof(LibraryFileRecord));
+    if (!Dependencies.empty())
+      OS.write(reinterpret_cast<const char *>(&Dependencies[0]),
+               Dependencies.size() * sizeof(FileRecord));
+    if (!Definitions.empty())
+      OS.write(reinterpret_cast<const char *>(&Definitions[0]),
+               Definitions.size() * sizeof(DefinitionRecord));
+    if (!Instances.empty())
+      OS.write(reinterpret_cast<const char *>(&Instances[0]),
+               Instances.size() * sizeof(InstanceRecord));
+    OS << Strings.getData();
+
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      ErrorStr = "error writing '" + TempPath + "'";
+      return true;
+    }
+  }
+
+  if (llvm::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  return false;
+}
+
+//===----------------------------------------------------------------------===//
+// ParsedLibrary reading
+//===----------------------------------------------------------------------===//
+
+ParsedLibrary::ParsedLibrary()
+  : Header(0), Files(0), Dependencies(0), Definitions(0), Instances(0),
+    StringData(0) {}
+
+ParsedLibrary::~ParsedLibrary() {}
+
+/// Points the records into Buffer.  Returns true if it is not a parsed
+/// library, or if a record is out of bounds.
+bool ParsedLibrary::init() {
+  const char *Start = Buffer->getBufferStart();
+  size_t Size = Buffer->getBufferSize();
+  if (Size < sizeof(LibraryHeader))
+    return true;
+  Header = reinterpret_cast<const LibraryHeader *>(Start);
+  if (Header->Magic != LibraryMagic || Header->Version != LibraryVersion ||
+      getLibrarySize(*Header) != Size)
+    return true;
+
+  Files = reinterpret_cast<const LibraryFileRecord *>(
+    Start + getLibraryFilesOffset());
+  Dependencies = reinterpret_cast<const FileRecord *>(
+    Start + getDependenciesOffset(*Header));
+  Definitions = reinterpret_cast<const DefinitionRecord *>(
+    Start + getDefinitionsOffset(*Header));
+  Instances = reinterpret_cast<const InstanceRecord *>(
+    Start + getInstancesOffset(*Header));
+  StringData = Start + getLibraryStringDataOffset(*Header);
+
+  uint64_t DataSize = Header->StringDataSize;
+  if ((uint64_t)Header->Name + Header->NameSize > DataSize)
+    return true;
+  for (unsigned I = 0, E = Header->NumFiles; I != E; ++I)
+    if ((uint64_t)Files[I].Path + Files[I].PathSize > DataSize ||
+        (uint64_t)Files[I].FirstDependency + Files[I].NumDependencies >
+          Header->NumDependencies ||
+        (uint64_t)Files[I].FirstDefinition + Files[I].NumDefinitions >
+          Header->NumDefinitions)
+      return true;
+  for (unsigned I = 0, E = Header->NumDependencies; I != E; ++I)
+    if ((uint64_t)Dependencies[I].Path + Dependencies[I].PathSize > DataSize)
+      return true;
+  for (unsigned I = 0, E = Header->NumDefinitions; I != E; ++I)
+    if ((uint64_t)Definitions[I].Name + Definitions[I].NameSize > DataSize ||
+        (uint64_t)Definitions[I].FirstInstance + Definitions[I].NumInstances >
+          Header->NumInstances)
+      return true;
+  for (unsigned I = 0, E = Header->NumInstances; I != E; ++I)
+    if ((uint64_t)Instances[I].Cell + Instances[I].CellSize > DataSize ||
+        (uint64_t)Instances[I].Name + Instances[I].NameSize > DataSize)
+      return true;
+  return false;
+}
+
+ParsedLibrary *ParsedLibrary::loadFromFile(StringRef Path,
+                                           std::string &ErrorStr) {
+  OwningPtr<ParsedLibrary> Result(new ParsedLibrary());
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(
+        Path, Result->Buffer, -1, /*RequiresNullTerminator=*/false)) {
+    ErrorStr = EC.message();
+    return 0;
+  }
+  if (Result->init()) {
+    ErrorStr = "not a valid parsed library";
+    return 0;
+  }
+  return Result.take();
+}
+
+StringRef ParsedLibrary::getName() const {
+  return getString(Header->Name, Header->NameSize);
+}
+
+unsigned ParsedLibrary::getNumFiles() const { return Header->NumFiles; }
+
+namespace {
+/// \brief Orders file records by path, for the binary search.
+class FilePathLess {
+  const char *StringData;
+
+public:
+  explicit FilePathLess(const char *StringData) : StringData(StringData) {}
+
+  bool operator()(const LibraryFileRecord &F, StringRef Path) const {
+    return StringRef(StringData + F.Path, F.PathSize) < Path;
+  }
+};
+} // end anonymous namespace
+
+bool ParsedLibrary::getUnits(const LibraryFile &File,
+                             DesignUnitTable &Units) const {
+  const LibraryFileRecord *End = Files + Header->NumFiles;
+  const LibraryFileRecord *F =
+    std::lower_bound(Files, End, File.Path, FilePathLess(StringData));
+  if (F == End || getString(F->Path, F->PathSize) != File.Path ||
+      F->Size != File.Size || F->Hash != File.Hash ||
+      F->OptionsHash != File.OptionsHash)
+    return false;
+
+  // An `include changes what the file defines as much as the file does.
+  for (unsigned D = F->FirstDependency, DE = D + F->NumDependencies; D != DE;
+       ++D) {
+    const FileRecord &DR = Dependencies[D];
+    OwningPtr<llvm::MemoryBuffer> Dep;
+    if (llvm::MemoryBuffer::getFile(getString(DR.Path, DR.PathSize), Dep) ||
+        Dep->getBufferSize() != DR.Size ||
+        hashContents(Dep->getBuffer()) != DR.Hash)
+      return false;
+  }
+
+  for (unsigned D = F->FirstDefinition, DE = D + F->NumDefinitions; D != DE;
+       ++D) {
+    const DefinitionRecord &DR = Definitions[D];
+    Units.addDefinition(getString(DR.Name, DR.NameSize));
+    for (unsigned I = DR.FirstInstance, IE = I + DR.NumInstances; I != IE;
+         ++I)
+      Units.addInstance(getString(Instances[I].Cell, Instances[I].CellSize),
+                        getString(Instances[I].Name, Instances[I].NameSize));
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// LibraryCache
+//===----------------------------------------------------------------------===//
+
+LibraryCache::~LibraryCache() {
+  for (llvm::StringMap<ParsedLibrary *>::iterator I = Libraries.begin(),
+                                                  E = Libraries.end();
+       I != E; ++I)
+    delete I->getValue();
+}
+
+std::string LibraryCache::getLibraryPath(StringRef Name) const {
+  SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, Name + ".vlib");
+  return Path.str().str();
+}
+
+const ParsedLibrary *LibraryCache::getLibrary(StringRef Name) {
+  llvm::StringMap<ParsedLibrary *>::iterator I = Libraries.find(Name);
+  if (I != Libraries.end())
+    return I->getValue();
+
+  // Remember a missing library too, so that it is looked for once.
+  llvm::StringMapEntry<ParsedLibrary *> &Entry =
+    Libraries.GetOrCreateValue(Name, 0);
+  std::string ErrorStr;
+  OwningPtr<ParsedLibrary> Library(
+    ParsedLibrary::loadFromFile(getLibraryPath(Name), ErrorStr));
+  if (!Library || Library->getName() != Name)
+    return 0;
+  Entry.setValue(Library.take());
+  return Entry.getValue();
+}
+
+bool LibraryCache::writeLibrary(StringRef Name, ArrayRef<LibraryFile> Files,
+                                std::string &ErrorStr) {
+  if (llvm::error_code EC = llvm::sys::fs::create_directories(Directory)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  if (ParsedLibrary::writeToFile(getLibraryPath(Name), Name, Files, ErrorStr))
+    return true;
+  // A later getLibrary() loads the new file.
+  llvm::StringMap<ParsedLibrary *>::iterator I = Libraries.find(Name);
+  if (I != Libraries.end()) {
+    delete I->getValue();
+    Libraries.erase(I);
+  }
+  return false;
+}
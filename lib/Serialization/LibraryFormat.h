@@ -0,0 +1,97 @@
+//===--- LibraryFormat.h - Layout of parsed library files -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the records of a parsed library file, shared by the
+//  reader and the writer.  All fields are in host byte order; the magic
+//  number rejects files written on a host of different endianness.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LIB_SERIALIZATION_LIBRARYFORMAT_H
+#define LLVM_VLANG_LIB_SERIALIZATION_LIBRARYFORMAT_H
+
+#include "PackageFormat.h"
+#include "llvm/Support/DataTypes.h"
+#include <cstddef>
+
+namespace vlang {
+namespace serialization {
+namespace ondisk {
+
+static const uint32_t LibraryMagic = 0x564C4231; // 'VLB1'
+static const uint32_t LibraryVersion = 2;
+
+/// \brief The header at the start of the file.  It is followed by the file
+/// records sorted by path, the dependency records, the definition records,
+/// the instance records, and the string data all other records point into.
+struct LibraryHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t Name;
+  uint32_t NameSize;
+  uint32_t NumFiles;
+  uint32_t NumDependencies;
+  uint32_t NumDefinitions;
+  uint32_t NumInstances;
+  uint32_t StringDataSize;
+  uint32_t Padding;
+};
+
+/// \brief A source file of the library, with the definitions parsed from
+/// it when it had this size and content hash, the files it read had theirs,
+/// and the macros and include directories had the fingerprint OptionsHash.
+/// The files it read are FileRecords, as in a precompiled package.
+struct LibraryFileRecord {
+  uint32_t Path;
+  uint32_t PathSize;
+  uint64_t Size;
+  uint64_t Hash;
+  uint64_t OptionsHash;
+  uint32_t FirstDependency;
+  uint32_t NumDependencies;
+  uint32_t FirstDefinition;
+  uint32_t NumDefinitions;
+};
+
+struct DefinitionRecord {
+  uint32_t Name;
+  uint32_t NameSize;
+  uint32_t FirstInstance;
+  uint32_t NumInstances;
+};
+
+struct InstanceRecord {
+  uint32_t Cell;
+  uint32_t CellSize;
+  uint32_t Name;
+  uint32_t NameSize;
+};
+
+inline size_t getLibraryFilesOffset() { return sizeof(LibraryHeader); }
+inline size_t getDependenciesOffset(const LibraryHeader &H) {
+  return getLibraryFilesOffset() + H.NumFiles * sizeof(LibraryFileRecord);
+}
+inline size_t getDefinitionsOffset(const LibraryHeader &H) {
+  return getDependenciesOffset(H) + H.NumDependencies * sizeof(FileRecord);
+}
+inline size_t getInstancesOffset(const LibraryHeader &H) {
+  return getDefinitionsOffset(H) + H.NumDefinitions * sizeof(DefinitionRecord);
+}
+inline size_t getLibraryStringDataOffset(const LibraryHeader &H) {
+  return getInstancesOffset(H) + H.NumInstances * sizeof(InstanceRecord);
+}
+inline size_t getLibrarySize(const LibraryHeader &H) {
+  return getLibraryStringDataOffset(H) + H.StringDataSize;
+}
+
+} // end namespace ondisk
+} // end namespace serialization
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,496 @@
+//===--- PackageCache.cpp - Precompiled SystemVerilog packages ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the PrecompiledPackage and PackageCache classes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Serialization/PackageCache.h"
+#include "PackageFormat.h"
+#include "StringDataBuilder.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/FileSystemOptions.h"
+#include "vlang/Basic/MacroBuilder.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace vlang;
+using namespace vlang::serialization;
+using namespace vlang::serialization::ondisk;
+
+static std::string getAbsolutePath(StringRef Path) {
+  SmallString<256> Result(Path);
+  llvm::sys::fs::make_absolute(Result);
+  return Result.str().str();
+}
+
+//===----------------------------------------------------------------------===//
+// PrecompiledPackage writing
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+struct FileEntryInfo {
+  std::string Path;
+  uint64_t Size;
+  uint64_t Hash;
+
+  bool operator<(const FileEntryInfo &RHS) const { return Path < RHS.Path; }
+};
+
+struct NamedText {
+  StringRef Name;
+  std::string Text;
+  unsigned Kind;
+
+  bool operator<(const NamedText &RHS) const { return Name < RHS.Name; }
+};
+
+} // end anonymous namespace
+
+static bool isIdentifierBody(char C) {
+  return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') ||
+         (C >= '0' && C <= '9') || C == '_' || C == '$';
+}
+
+/// Appends the spellings of tokens [Begin, End) of \p Toks to \p Text, with
+/// a space wherever the source had whitespace or two tokens would otherwise
+/// run together.
+static void getDeclarationText(const TokenBuffer &Toks, unsigned Begin,
+                               unsigned End, Preprocessor &PP,
+                               std::string &Text) {
+  SmallString<64> Buffer;
+  Token Tok;
+  for (unsigned I = Begin; I != End; ++I) {
+    Toks.getToken(I, Tok);
+    StringRef Spelling = PP.getSpelling(Tok, Buffer);
+    if (Spelling.empty())
+      continue;
+    if (!Text.empty() &&
+        (Tok.hasLeadingSpace() || Tok.isAtStartOfLine() ||
+         (isIdentifierBody(Text[Text.size() - 1]) &&
+          isIdentifierBody(Spelling[0]))))
+      Text += ' ';
+    Text.append(Spelling.begin(), Spelling.end());
+  }
+}
+
+/// Collects the macros defined in source files, with the text of their
+/// definitions after `define.
+static void getMacroDefinitions(Preprocessor &PP,
+                                std::vector<NamedText> &Macros) {
+  std::vector<std::pair<StringRef, StringRef> > Definitions;
+  PP.getSourceMacroDefinitions(Definitions);
+  for (unsigned I = 0, E = Definitions.size(); I != E; ++I) {
+    NamedText M;
+    M.Name = Definitions[I].first;
+    M.Text = Definitions[I].second.str();
+    M.Kind = 0;
+    Macros.push_back(M);
+  }
+  std::sort(Macros.begin(), Macros.end());
+}
+
+bool PrecompiledPackage::writeToFile(StringRef Path, const PackageTable &Table,
+                                     unsigned P, const TokenBuffer &Toks,
+                                     Preprocessor &PP, std::string &ErrorStr) {
+  assert(!Table.isExternal(P) && "Package was not parsed");
+  SourceManager &SM = PP.getSourceManager();
+  StringDataBuilder Strings;
+
+  // Every file of the unit: the package may depend on any `define or
+  // `include before it.
+  std::vector<FileEntryInfo> FileInfos;
+  for (SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+                                        E = SM.fileinfo_end();
+       I != E; ++I) {
+    const llvm::MemoryBuffer *Buffer = I->second->getRawBuffer();
+    if (!Buffer)
+      continue;
+    FileEntryInfo FI;
+    FI.Path = getAbsolutePath(I->first->getName());
+    FI.Size = Buffer->getBufferSize();
+    FI.Hash = hashContents(Buffer->getBuffer());
+    FileInfos.push_back(FI);
+  }
+  std::sort(FileInfos.begin(), FileInfos.end());
+
+  std::vector<NamedText> SymbolTexts;
+  ArrayRef<unsigned> PackageSymbols = Table.getPackageSymbols(P);
+  for (unsigned I = 0, E = PackageSymbols.size(); I != E; ++I) {
+    const PackageSymbol &S = Table.getSymbol(PackageSymbols[I]);
+    NamedText T;
+    T.Name = S.Name;
+    T.Kind = static_cast<unsigned>(S.Kind);
+    getDeclarationText(Toks, S.FirstToken, S.EndToken, PP, T.Text);
+    SymbolTexts.push_back(T);
+  }
+  std::sort(SymbolTexts.begin(), SymbolTexts.end());
+
+  std::vector<NamedText> MacroTexts;
+  getMacroDefinitions(PP, MacroTexts);
+
+  SmallVector<std::pair<StringRef, StringRef>, 4> ExportNames;
+  Table.getPackageExports(P, ExportNames);
+
+  PackageHeader H;
+  memset(&H, 0, sizeof(H));
+  H.Magic = PackageMagic;
+  H.Version = PackageVersion;
+  StringRef Name = Table.getPackageName(P);
+  H.Name = Strings.add(Name);
+  H.NameSize = Name.size();
+  H.NumFiles = FileInfos.size();
+  H.NumSymbols = SymbolTexts.size();
+  H.NumMacros = MacroTexts.size();
+  H.NumExports = ExportNames.size();
+
+  std::vector<FileRecord> Files(FileInfos.size());
+  for (unsigned I = 0, E = FileInfos.size(); I != E; ++I) {
+    Files[I].Path = Strings.add(FileInfos[I].Path);
+    Files[I].PathSize = FileInfos[I].Path.size();
+    Files[I].Size = FileInfos[I].Size;
+    Files[I].Hash = FileInfos[I].Hash;
+  }
+
+  std::vector<SymbolRecord> Symbols(SymbolTexts.size());
+  for (unsigned I = 0, E = SymbolTexts.size(); I != E; ++I) {
+    memset(&Symbols[I], 0, sizeof(SymbolRecord));
+    Symbols[I].Name = Strings.add(SymbolTexts[I].Name);
+    Symbols[I].NameSize = SymbolTexts[I].Name.size();
+    Symbols[I].Definition = Strings.add(SymbolTexts[I].Text);
+    Symbols[I].DefinitionSize = SymbolTexts[I].Text.size();
+    Symbols[I].Kind = SymbolTexts[I].Kind;
+  }
+
+  std::vector<MacroRecord> Macros(MacroTexts.size());
+  for (unsigned I = 0, E = MacroTexts.size(); I != E; ++I) {
+    Macros[I].Name = Strings.add(MacroTexts[I].Name);
+    Macros[I].NameSize = MacroTexts[I].Name.size();
+    Macros[I].Definition = Strings.add(MacroTexts[I].Text);
+    Macros[I].DefinitionSize = MacroTexts[I].Text.size();
+  }
+
+  std::vector<ExportRecord> Exports(ExportNames.size());
+  for (unsigned I = 0, E = ExportNames.size(); I != E; ++I) {
+    Exports[I].Package = Strings.add(ExportNames[I].first);
+    Exports[I].PackageSize = ExportNames[I].first.size();
+    Exports[I].Name = Strings.add(ExportNames[I].second);
+    Exports[I].NameSize = ExportNames[I].second.size();
+  }
+  H.StringDataSize = Strings.getData().size();
+
+  // Write next to the destination and rename, so that a unit loading the
+  // previous package never sees a partial file.
+  std::string TempPath = Path.str() + ".tmp";
+  {
+    llvm::raw_fd_ostream OS(TempPath.c_str(), ErrorStr,
+                            llvm::raw_fd_ostream::F_Binary);
+    if (!ErrorStr.empty())
+      return true;
+
+    OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+    if (!Files.empty())
+      OS.write(reinterpret_cast<const char *>(&Files[0]),
+               Files.size() * sizeof(FileRecord));
+    if (!Symbols.empty())
+      OS.write(reinterpret_cast<const char *>(&Symbols[0]),
+               Symbols.size() * sizeof(SymbolRecord));
+    if (!Macros.empty())
+      OS.write(reinterpret_cast<const char *>(&Macros[0]),
+               Macros.size() * sizeof(MacroRecord));
+    if (!Exports.empty())
+      OS.write(reinterpret_cast<const char *>(&Exports[0]),
+               Exports.size() * sizeof(ExportRecord));
+    OS << Strings.getData();
+
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      ErrorStr = "error writing '" + TempPath + "'";
+      return true;
+    }
+  }
+
+  if (llvm::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  return false;
+}
+
+//===----------------------------------------------------------------------===//
+// PrecompiledPackage reading
+//===----------------------------------------------------------------------===//
+
+PrecompiledPackage::PrecompiledPackage()
+  : Header(0), Files(0), Symbols(0), Macros(0), Exports(0), StringData(0) {}
+
+PrecompiledPackage::~PrecompiledPackage() {}
+
+/// Points the records into Buffer.  Returns true if it is not a precompiled
+/// package, or if a record is out of bounds.
+bool PrecompiledPackage::init() {
+  const char *Start = Buffer->getBufferStart();
+  size_t Size = Buffer->getBufferSize();
+  if (Size < sizeof(PackageHeader))
+    return true;
+  Header = reinterpret_cast<const PackageHeader *>(Start);
+  if (Header->Magic != PackageMagic || Header->Version != PackageVersion ||
+      getPackageSize(*Header) != Size)
+    return true;
+
+  Files = reinterpret_cast<const FileRecord *>(Start + getFilesOffset());
+  Symbols =
+    reinterpret_cast<const SymbolRecord *>(Start + getSymbolsOffset(*Header));
+  Macros =
+    reinterpret_cast<const MacroRecord *>(Start + getMacrosOffset(*Header));
+  Exports =
+    reinterpret_cast<const ExportRecord *>(Start + getExportsOffset(*Header));
+  StringData = Start + getStringDataOffset(*Header);
+
+  uint64_t DataSize = Header->StringDataSize;
+  if ((uint64_t)Header->Name + Header->NameSize > DataSize)
+    return true;
+  for (unsigned I = 0, E = Header->NumFiles; I != E; ++I)
+    if ((uint64_t)Files[I].Path + Files[I].PathSize > DataSize)
+      return true;
+  for (unsigned I = 0, E = Header->NumSymbols; I != E; ++I)
+    if ((uint64_t)Symbols[I].Name + Symbols[I].NameSize > DataSize ||
+        (uint64_t)Symbols[I].Definition + Symbols[I].DefinitionSize >
+          DataSize ||
+        Symbols[I].Kind > static_cast<unsigned>(PackageSymbolKind::Class))
+      return true;
+  for (unsigned I = 0, E = Header->NumMacros; I != E; ++I)
+    if ((uint64_t)Macros[I].Name + Macros[I].NameSize > DataSize ||
+        (uint64_t)Macros[I].Definition + Macros[I].DefinitionSize > DataSize)
+      return true;
+  for (unsigned I = 0, E = Header->NumExports; I != E; ++I)
+    if ((uint64_t)Exports[I].Package + Exports[I].PackageSize > DataSize ||
+        (uint64_t)Exports[I].Name + Exports[I].NameSize > DataSize)
+      return true;
+  return false;
+}
+
+PrecompiledPackage *PrecompiledPackage::loadFromFile(StringRef Path,
+                                                     std::string &ErrorStr) {
+  OwningPtr<PrecompiledPackage> Result(new PrecompiledPackage());
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(
+        Path, Result->Buffer, -1, /*RequiresNullTerminator=*/false)) {
+    ErrorStr = EC.message();
+    return 0;
+  }
+  if (Result->init()) {
+    ErrorStr = "not a valid precompiled package";
+    return 0;
+  }
+  return Result.take();
+}
+
+StringRef PrecompiledPackage::getName() const {
+  return getString(Header->Name, Header->NameSize);
+}
+
+unsigned PrecompiledPackage::getNumFiles() const { return Header->NumFiles; }
+
+StringRef PrecompiledPackage::getFilePath(unsigned File) const {
+  assert(File < Header->NumFiles && "Invalid file");
+  return getString(Files[File].Path, Files[File].PathSize);
+}
+
+bool PrecompiledPackage::isUpToDate(FileManager &FileMgr,
+                                    std::string &Changed) const {
+  for (unsigned I = 0, E = Header->NumFiles; I != E; ++I) {
+    StringRef Path = getFilePath(I);
+    const FileEntry *FE = FileMgr.getFile(Path);
+    // The size is enough to catch most edits without reading the file.
+    if (!FE || (uint64_t)FE->getSize() != Files[I].Size) {
+      Changed = Path;
+      return false;
+    }
+    OwningPtr<llvm::MemoryBuffer> Buffer(FileMgr.getBufferForFile(FE));
+    if (!Buffer || hashContents(Buffer->getBuffer()) != Files[I].Hash) {
+      Changed = Path;
+      return false;
+    }
+  }
+  return true;
+}
+
+unsigned PrecompiledPackage::getNumSymbols() const {
+  return Header->NumSymbols;
+}
+
+namespace {
+/// \brief Orders symbol records by name, for the binary search.
+class SymbolNameLess {
+  const char *StringData;
+
+public:
+  explicit SymbolNameLess(const char *StringData) : StringData(StringData) {}
+
+  bool operator()(const SymbolRecord &S, StringRef Name) const {
+    return StringRef(StringData + S.Name, S.NameSize) < Name;
+  }
+};
+} // end anonymous namespace
+
+bool PrecompiledPackage::lookup(StringRef Name, PackageSymbol &Symbol) const {
+  const SymbolRecord *End = Symbols + Header->NumSymbols;
+  const SymbolRecord *S =
+    std::lower_bound(Symbols, End, Name, SymbolNameLess(StringData));
+  if (S == End || getString(S->Name, S->NameSize) != Name)
+    return false;
+
+  Symbol.Name = getString(S->Name, S->NameSize);
+  Symbol.Kind = static_cast<PackageSymbolKind>(S->Kind);
+  Symbol.FirstToken = Symbol.EndToken = 0;
+  Symbol.Definition = getString(S->Definition, S->DefinitionSize);
+  return true;
+}
+
+unsigned PrecompiledPackage::getNumMacros() const {
+  return Header->NumMacros;
+}
+
+StringRef PrecompiledPackage::getMacroName(unsigned M) const {
+  assert(M < Header->NumMacros && "Invalid macro");
+  return getString(Macros[M].Name, Macros[M].NameSize);
+}
+
+StringRef PrecompiledPackage::getMacroDefinition(unsigned M) const {
+  assert(M < Header->NumMacros && "Invalid macro");
+  return getString(Macros[M].Definition, Macros[M].DefinitionSize);
+}
+
+unsigned PrecompiledPackage::getNumExports() const {
+  return Header->NumExports;
+}
+
+StringRef PrecompiledPackage::getExportPackage(unsigned E) const {
+  assert(E < Header->NumExports && "Invalid export");
+  return getString(Exports[E].Package, Exports[E].PackageSize);
+}
+
+StringRef PrecompiledPackage::getExportName(unsigned E) const {
+  assert(E < Header->NumExports && "Invalid export");
+  return getString(Exports[E].Name, Exports[E].NameSize);
+}
+
+//===----------------------------------------------------------------------===//
+// PackageCache
+//===----------------------------------------------------------------------===//
+
+PackageCache::PackageCache(StringRef Directory)
+  : Directory(Directory), FileMgr(new FileManager(FileSystemOptions())),
+    NumStale(0) {}
+
+PackageCache::~PackageCache() {
+  for (llvm::StringMap<PrecompiledPackage *>::iterator I = Packages.begin(),
+                                                       E = Packages.end();
+       I != E; ++I)
+    delete I->getValue();
+}
+
+std::string PackageCache::getPackagePath(StringRef Name) const {
+  SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, Name + ".vpk");
+  return Path.str().str();
+}
+
+const PrecompiledPackage *PackageCache::getPackage(StringRef Name) {
+  llvm::StringMap<PrecompiledPackage *>::iterator I = Packages.find(Name);
+  if (I != Packages.end())
+    return I->getValue();
+
+  // Remember a missing or stale package too, so that it is checked once.
+  llvm::StringMapEntry<PrecompiledPackage *> &Entry =
+    Packages.GetOrCreateValue(Name, 0);
+  std::string ErrorStr;
+  OwningPtr<PrecompiledPackage> Package(
+    PrecompiledPackage::loadFromFile(getPackagePath(Name), ErrorStr));
+  if (!Package || Package->getName() != Name)
+    return 0;
+  std::string Changed;
+  if (!Package->isUpToDate(*FileMgr, Changed)) {
+    ++NumStale;
+    return 0;
+  }
+  Entry.setValue(Package.take());
+  return Entry.getValue();
+}
+
+bool PackageCache::writePackages(const PackageTable &Table,
+                                 const TokenBuffer &Toks, Preprocessor &PP,
+                                 std::string &ErrorStr) {
+  if (llvm::error_code EC = llvm::sys::fs::create_directories(Directory)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  for (unsigned P = 0, E = Table.getNumPackages(); P != E; ++P) {
+    if (Table.isExternal(P))
+      continue;
+    StringRef Name = Table.getPackageName(P);
+    if (PrecompiledPackage::writeToFile(getPackagePath(Name), Table, P, Toks,
+                                        PP, ErrorStr))
+      return true;
+    // Units compiled later load the new package, not a remembered miss.
+    llvm::StringMap<PrecompiledPackage *>::iterator I = Packages.find(Name);
+    if (I != Packages.end()) {
+      delete I->getValue();
+      Packages.erase(I);
+    }
+  }
+  return false;
+}
+
+bool PackageCache::addMacros(StringRef Name, MacroBuilder &Builder) {
+  const PrecompiledPackage *Package = getPackage(Name);
+  if (!Package)
+    return false;
+  for (unsigned M = 0, E = Package->getNumMacros(); M != E; ++M)
+    Builder.append("`define " + Package->getMacroDefinition(M));
+  return true;
+}
+
+bool PackageCache::findPackage(StringRef Name) {
+  return getPackage(Name) != 0;
+}
+
+bool PackageCache::findSymbol(StringRef Package, StringRef Name,
+                              PackageSymbol &Symbol) {
+  const PrecompiledPackage *P = getPackage(Package);
+  if (!P)
+    return false;
+  if (P->lookup(Name, Symbol))
+    return true;
+
+  // An exported name is found in the package it comes from, which must be
+  // up to date itself.
+  if (!P->getNumExports() || !Searching.insert(P))
+    return false;
+  bool Found = false;
+  for (unsigned E = 0, EE = P->getNumExports(); E != EE && !Found; ++E) {
+    StringRef Exported = P->getExportName(E);
+    if (Exported.empty() || Exported == Name)
+      Found = findSymbol(P->getExportPackage(E), Name, Symbol);
+  }
+  Searching.erase(P);
+  return Found;
+}
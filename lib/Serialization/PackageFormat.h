@@ -0,0 +1,114 @@
+//===--- PackageFormat.h - Layout of precompiled packages -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the records of a precompiled package file, shared by
+//  the reader and the writer.  All fields are in host byte order; the magic
+//  number rejects files written on a host of different endianness.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LIB_SERIALIZATION_PACKAGEFORMAT_H
+#define LLVM_VLANG_LIB_SERIALIZATION_PACKAGEFORMAT_H
+
+#include "vlang/Basic/StableHash.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <cstddef>
+
+namespace vlang {
+namespace serialization {
+namespace ondisk {
+
+static const uint32_t PackageMagic = 0x56504B31; // 'VPK1'
+static const uint32_t PackageVersion = 2;
+
+/// \brief The header at the start of the file.  It is followed by the file
+/// records, the symbol records sorted by name, the macro records sorted by
+/// name, the export records, and the string data all other records point
+/// into.
+struct PackageHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t Name;
+  uint32_t NameSize;
+  uint32_t NumFiles;
+  uint32_t NumSymbols;
+  uint32_t NumMacros;
+  uint32_t NumExports;
+  uint32_t StringDataSize;
+  uint32_t Padding;
+};
+
+/// \brief A file the package was compiled from.
+struct FileRecord {
+  uint32_t Path;
+  uint32_t PathSize;
+  uint64_t Size;
+  uint64_t Hash;
+};
+
+struct SymbolRecord {
+  uint32_t Name;
+  uint32_t NameSize;
+  /// \brief The declaration, as preprocessed tokens separated by spaces
+  /// where the source had whitespace.
+  uint32_t Definition;
+  uint32_t DefinitionSize;
+  uint32_t Kind;
+  uint32_t Padding;
+};
+
+/// \brief A macro defined when the package was compiled.  Its definition
+/// is the source text after `define: the name, any formal arguments and the
+/// body, escaped newlines included.
+struct MacroRecord {
+  uint32_t Name;
+  uint32_t NameSize;
+  uint32_t Definition;
+  uint32_t DefinitionSize;
+};
+
+/// \brief A name the package exports from a package it imports: Package::Name,
+/// or Package::* if the name is empty.  export *::* is written as the
+/// imports it covers.
+struct ExportRecord {
+  uint32_t Package;
+  uint32_t PackageSize;
+  uint32_t Name;
+  uint32_t NameSize;
+};
+
+inline size_t getFilesOffset() { return sizeof(PackageHeader); }
+inline size_t getSymbolsOffset(const PackageHeader &H) {
+  return getFilesOffset() + H.NumFiles * sizeof(FileRecord);
+}
+inline size_t getMacrosOffset(const PackageHeader &H) {
+  return getSymbolsOffset(H) + H.NumSymbols * sizeof(SymbolRecord);
+}
+inline size_t getExportsOffset(const PackageHeader &H) {
+  return getMacrosOffset(H) + H.NumMacros * sizeof(MacroRecord);
+}
+inline size_t getStringDataOffset(const PackageHeader &H) {
+  return getExportsOffset(H) + H.NumExports * sizeof(ExportRecord);
+}
+inline size_t getPackageSize(const PackageHeader &H) {
+  return getStringDataOffset(H) + H.StringDataSize;
+}
+
+/// \brief The content hash of a file, FNV-1a; part of the format, so it
+/// must not change.
+inline uint64_t hashContents(llvm::StringRef Data) {
+  return hashFNV1a(Data);
+}
+
+} // end namespace ondisk
+} // end namespace serialization
+} // end namespace vlang
+
+#endif
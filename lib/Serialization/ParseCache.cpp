@@ -0,0 +1,588 @@
+//===--- ParseCache.cpp - Cached results of parsing design elements -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the ParseCache and ParseCacheSession classes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Serialization/ParseCache.h"
+#include "PackageFormat.h"
+#include "ParseCacheFormat.h"
+#include "StringDataBuilder.h"
+#include "vlang/Basic/LangOptions.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Basic/StableHash.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "vlang/Parse/DesignUnitTable.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sys/stat.h>
+#include <utime.h>
+
+using namespace vlang;
+using namespace vlang::serialization;
+using namespace vlang::serialization::ondisk;
+
+/// \brief Temporary files older than this, in seconds, were left by writers
+/// that died, and are removed by prune().
+static const time_t AbandonedTempFileAge = 3600;
+
+namespace {
+/// \brief FNV-1a over the fields of a key.  Strings are prefixed with their
+/// length, so that different splits of the same characters differ.
+class KeyHasher {
+  uint64_t Hash;
+
+  void addBytes(const void *Data, size_t Size) {
+    Hash = hashFNV1a(StringRef(static_cast<const char *>(Data), Size), Hash);
+  }
+
+public:
+  KeyHasher() : Hash(FNV1aOffsetBasis) {}
+
+  void add(uint64_t Value) { addBytes(&Value, sizeof(Value)); }
+  void add(StringRef Str) {
+    add((uint64_t)Str.size());
+    addBytes(Str.data(), Str.size());
+  }
+
+  uint64_t get() const { return Hash; }
+};
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// ParseCache
+//===----------------------------------------------------------------------===//
+
+ParseCache::ParseCache(StringRef Directory, uint64_t SizeLimit)
+  : Directory(Directory), SizeLimit(SizeLimit), NumReplayed(0), NumParsed(0),
+    NumStored(0) {}
+
+std::string ParseCache::getEntryPath(uint64_t Key) const {
+  char Name[32];
+  snprintf(Name, sizeof(Name), "%016llx.vpc", (unsigned long long)Key);
+  SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, Name);
+  return Path.str().str();
+}
+
+llvm::MemoryBuffer *ParseCache::lookup(uint64_t Key) {
+  std::string Path = getEntryPath(Key);
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::MemoryBuffer::getFile(Path, Buffer, -1,
+                                  /*RequiresNullTerminator=*/false))
+    return 0;
+  // The modification time of an entry is the time it was last used; a
+  // prune() that removed it meanwhile makes this fail, harmlessly.
+  ::utime(Path.c_str(), 0);
+  return Buffer.take();
+}
+
+bool ParseCache::store(uint64_t Key, StringRef Data, std::string &ErrorStr) {
+  if (llvm::error_code EC = llvm::sys::fs::create_directories(Directory)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+
+  // Write to a file of our own and rename it into place, so that readers
+  // and other writers of the same entry never see a partial one.
+  SmallString<256> Model(Directory);
+  llvm::sys::path::append(Model, "%%%%%%%%%%%%.tmp");
+  SmallString<256> TempPath;
+  int FD;
+  if (llvm::error_code EC =
+        llvm::sys::fs::unique_file(Model.str(), FD, TempPath)) {
+    ErrorStr = EC.message();
+    return true;
+  }
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Data;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      bool Existed;
+      llvm::sys::fs::remove(TempPath.str(), Existed);
+      ErrorStr = "error writing '" + TempPath.str().str() + "'";
+      return true;
+    }
+  }
+
+  if (llvm::error_code EC =
+        llvm::sys::fs::rename(TempPath.str(), getEntryPath(Key))) {
+    bool Existed;
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+    ErrorStr = EC.message();
+    return true;
+  }
+  return false;
+}
+
+namespace {
+struct EntryFile {
+  std::string Path;
+  uint64_t Size;
+  time_t LastUsed;
+};
+
+struct EntryFileUsedBefore {
+  bool operator()(const EntryFile &LHS, const EntryFile &RHS) const {
+    return LHS.LastUsed < RHS.LastUsed;
+  }
+};
+} // end anonymous namespace
+
+unsigned ParseCache::prune() {
+  std::vector<EntryFile> Entries;
+  uint64_t TotalSize = 0;
+  time_t Now = time(0);
+  llvm::error_code EC;
+  for (llvm::sys::fs::directory_iterator I(Directory, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    const std::string &Path = I->path();
+    // Another process may have removed the file since it was listed.
+    struct stat Status;
+    if (::stat(Path.c_str(), &Status) != 0 || !S_ISREG(Status.st_mode))
+      continue;
+
+    StringRef Extension = llvm::sys::path::extension(Path);
+    if (Extension == ".tmp") {
+      if (Now - Status.st_mtime > AbandonedTempFileAge) {
+        bool Existed;
+        llvm::sys::fs::remove(Path, Existed);
+      }
+      continue;
+    }
+    if (Extension != ".vpc")
+      continue;
+
+    EntryFile Entry;
+    Entry.Path = Path;
+    Entry.Size = Status.st_size;
+    Entry.LastUsed = Status.st_mtime;
+    Entries.push_back(Entry);
+    TotalSize += Entry.Size;
+  }
+  if (TotalSize <= SizeLimit)
+    return 0;
+
+  std::sort(Entries.begin(), Entries.end(), EntryFileUsedBefore());
+  unsigned NumRemoved = 0;
+  for (unsigned I = 0, E = Entries.size(); I != E && TotalSize > SizeLimit;
+       ++I) {
+    bool Existed;
+    if (llvm::sys::fs::remove(Entries[I].Path, Existed))
+      continue;
+    TotalSize -= Entries[I].Size;
+    if (Existed)
+      ++NumRemoved;
+  }
+  return NumRemoved;
+}
+
+void ParseCache::addStatistics(unsigned Replayed, unsigned Parsed,
+                               unsigned Stored) {
+  llvm::sys::ScopedLock Guard(Lock);
+  NumReplayed += Replayed;
+  NumParsed += Parsed;
+  NumStored += Stored;
+}
+
+unsigned ParseCache::getNumReplayed() const {
+  llvm::sys::ScopedLock Guard(Lock);
+  return NumReplayed;
+}
+
+unsigned ParseCache::getNumParsed() const {
+  llvm::sys::ScopedLock Guard(Lock);
+  return NumParsed;
+}
+
+unsigned ParseCache::getNumStored() const {
+  llvm::sys::ScopedLock Guard(Lock);
+  return NumStored;
+}
+
+//===----------------------------------------------------------------------===//
+// ParseCacheSession
+//===----------------------------------------------------------------------===//
+
+/// \brief Passes diagnostics on to the unit's client, and shows those of the
+/// element being recorded to the session.
+class ParseCacheSession::DiagRecorder : public ForwardingDiagnosticConsumer {
+  ParseCacheSession &S;
+
+public:
+  DiagRecorder(ParseCacheSession &S, DiagnosticConsumer &Target)
+    : ForwardingDiagnosticConsumer(Target), S(S) {}
+
+  virtual void HandleDiagnostic(DiagnosticsEngine::Level Level,
+                                const Diagnostic &Info) {
+    ForwardingDiagnosticConsumer::HandleDiagnostic(Level, Info);
+    if (S.Recording)
+      S.recordDiagnostic(Level, Info);
+  }
+};
+
+uint64_t ParseCacheSession::ElementKey::getHash() const {
+  KeyHasher Hash;
+  Hash.add(TokenHash);
+  Hash.add(FileHash);
+  Hash.add(MacroFingerprint);
+  Hash.add(OptionsHash);
+  Hash.add(DirectiveHash);
+  Hash.add((uint64_t)NumTokens);
+  return Hash.get();
+}
+
+/// Hashes the language options, and the diagnostic options that decide which
+/// diagnostics are reported and at what level, since those are stored as
+/// they were reported.
+static uint64_t hashOptions(const LangOptions &LangOpts,
+                            const DiagnosticsEngine &Diags) {
+  KeyHasher Hash;
+#define LANGOPT(Name, Bits, Default, Description) \
+  Hash.add((uint64_t)LangOpts.Name);
+#define ENUM_LANGOPT(Name, Type, Bits, Default, Description) \
+  Hash.add((uint64_t)LangOpts.get##Name());
+#include "vlang/Basic/LangOptions.def"
+
+  Hash.add((uint64_t)Diags.getIgnoreAllWarnings());
+  Hash.add((uint64_t)Diags.getEnableAllWarnings());
+  Hash.add((uint64_t)Diags.getWarningsAsErrors());
+  Hash.add((uint64_t)Diags.getErrorsAsFatal());
+  Hash.add((uint64_t)Diags.getSuppressSystemWarnings());
+  Hash.add((uint64_t)Diags.getSuppressAllDiagnostics());
+  return Hash.get();
+}
+
+ParseCacheSession::ParseCacheSession(ParseCache &Cache, Preprocessor &PP,
+                                     const TokenBuffer &Toks,
+                                     DesignUnitTable &Units)
+  : Cache(Cache), PP(PP), Toks(Toks), Units(Units),
+    Diags(PP.getDiagnostics()), Client(Diags.getClient()),
+    OwnsClient(Diags.ownsClient()), Recording(false), Uncacheable(false),
+    FirstToken(0), EndToken(0), NumDefinitions(0), NumReplayed(0),
+    NumParsed(0), NumStored(0) {
+  assert(Client && "Diagnostics need a client");
+  OptionsHash = hashOptions(PP.getLangOpts(), Diags);
+  Diags.takeClient();
+  Diags.setClient(new DiagRecorder(*this, *Client), /*ShouldOwnClient=*/true);
+}
+
+ParseCacheSession::~ParseCacheSession() {
+  Cache.addStatistics(NumReplayed, NumParsed, NumStored);
+  // Hand the unit's client back, which deletes the recorder.
+  Diags.setClient(Client, OwnsClient);
+}
+
+/// Finds the token after the element at \p First by matching its end keyword,
+/// counting the elements nested in it.  Returns 0 if it is not an element
+/// that is cached, or has no end.
+unsigned ParseCacheSession::findElementEnd(unsigned First) const {
+  tok::TokenKind Begin = Toks.getKind(First);
+  tok::TokenKind End;
+  switch (Begin) {
+  case tok::kw_module:
+  case tok::kw_macromodule: End = tok::kw_endmodule; break;
+  case tok::kw_interface:   End = tok::kw_endinterface; break;
+  case tok::kw_program:     End = tok::kw_endprogram; break;
+  default:                  return 0;
+  }
+
+  unsigned Depth = 0;
+  for (unsigned I = First, E = Toks.size(); I != E; ++I) {
+    tok::TokenKind Kind = Toks.getKind(I);
+    if (Kind == tok::eof)
+      return 0;
+    if (Kind == End) {
+      if (--Depth != 0)
+        continue;
+      // endmodule : name
+      unsigned After = I + 1;
+      if (After + 1 < E && Toks.getKind(After) == tok::colon &&
+          Toks.getKind(After + 1) == tok::identifier)
+        After += 2;
+      return After;
+    }
+
+    bool Nests;
+    if (Begin == tok::kw_interface)
+      // Neither an interface class nor a virtual interface has an end.
+      Nests = Kind == tok::kw_interface &&
+              (I + 1 == E || Toks.getKind(I + 1) != tok::kw_class) &&
+              (I == First || Toks.getKind(I - 1) != tok::kw_virtual);
+    else if (Begin == tok::kw_program)
+      Nests = Kind == tok::kw_program;
+    else
+      Nests = Kind == tok::kw_module || Kind == tok::kw_macromodule;
+    if (Nests)
+      ++Depth;
+    else if (I == First)
+      return 0;
+  }
+  return 0;
+}
+
+uint64_t ParseCacheSession::getFileHash(SourceLocation Loc) {
+  SourceManager &SM = PP.getSourceManager();
+  FileID FID = SM.getFileID(SM.getExpansionLoc(Loc));
+  std::pair<llvm::DenseMap<FileID, uint64_t>::iterator, bool> Result =
+    FileHashes.insert(std::make_pair(FID, 0));
+  if (Result.second) {
+    bool Invalid = false;
+    const llvm::MemoryBuffer *Buffer = SM.getBuffer(FID, &Invalid);
+    if (!Invalid)
+      Result.first->second = hashContents(Buffer->getBuffer());
+  }
+  return Result.first->second;
+}
+
+void ParseCacheSession::computeKey(unsigned First, unsigned End,
+                                   ElementKey &Result) {
+  // The token after the element is included, as the parser looks at it to
+  // find where the element ends.
+  KeyHasher Tokens;
+  for (unsigned I = First; I <= End; ++I) {
+    Tokens.add((uint64_t)Toks.getKind(I));
+    if (const char *Data = Toks.getLiteralData(I))
+      Tokens.add(StringRef(Data, Toks.getLength(I)));
+    else if (IdentifierInfo *II = Toks.getIdentifierInfo(I))
+      Tokens.add(II->getName());
+  }
+  Result.TokenHash = Tokens.get();
+  Result.NumTokens = End - First;
+  Result.FileHash = getFileHash(Toks.getLocation(First));
+  Result.OptionsHash = OptionsHash;
+
+  KeyHasher Directives;
+  const TokenBuffer::DirectiveState *State = Toks.getDirectiveState(First);
+  Result.MacroFingerprint = State ? State->Macros.getFingerprint() : 0;
+  if (State) {
+    Directives.add(State->Timescale);
+    Directives.add(State->DefaultNettype);
+  }
+  Result.DirectiveHash = Directives.get();
+}
+
+unsigned ParseCacheSession::replayElement(unsigned First) {
+  Recording = false;
+  unsigned End = findElementEnd(First);
+  if (!End)
+    return 0;
+
+  computeKey(First, End, Key);
+  OwningPtr<llvm::MemoryBuffer> Entry(Cache.lookup(Key.getHash()));
+  if (Entry && replay(*Entry, Key, First)) {
+    ++NumReplayed;
+    return End;
+  }
+
+  // Parse the element, and see what parsing it does.
+  ++NumParsed;
+  Recording = true;
+  Uncacheable = false;
+  FirstToken = First;
+  EndToken = End;
+  NumDefinitions = Units.getNumDefinitions();
+  Diagnostics.clear();
+  return 0;
+}
+
+void ParseCacheSession::parsedElement(unsigned First, unsigned End) {
+  if (!Recording || First != FirstToken)
+    return;
+  Recording = false;
+  // A duplicate definition adds nothing, and a replay of the first one
+  // would not know it is one.
+  if (Uncacheable || End != EndToken ||
+      Units.getNumDefinitions() != NumDefinitions + 1)
+    return;
+  store();
+}
+
+/// Reports the diagnostics and adds the design units of \p Entry, if it is a
+/// valid entry for \p Expected.  Nothing is done otherwise.
+bool ParseCacheSession::replay(const llvm::MemoryBuffer &Entry,
+                               const ElementKey &Expected, unsigned First) {
+  const char *Start = Entry.getBufferStart();
+  size_t Size = Entry.getBufferSize();
+  if (Size < sizeof(ElementHeader))
+    return false;
+  const ElementHeader *H = reinterpret_cast<const ElementHeader *>(Start);
+  if (H->Magic != ElementMagic || H->Version != ElementVersion ||
+      getElementSize(*H) != Size)
+    return false;
+  if (H->TokenHash != Expected.TokenHash ||
+      H->FileHash != Expected.FileHash ||
+      H->MacroFingerprint != Expected.MacroFingerprint ||
+      H->OptionsHash != Expected.OptionsHash ||
+      H->DirectiveHash != Expected.DirectiveHash ||
+      H->NumTokens != Expected.NumTokens)
+    return false;
+
+  const DiagnosticRecord *DiagRecords =
+    reinterpret_cast<const DiagnosticRecord *>(Start + getDiagnosticsOffset());
+  const InstanceRecord *Instances = reinterpret_cast<const InstanceRecord *>(
+    Start + getElementInstancesOffset(*H));
+  const char *StringData = Start + getElementStringDataOffset(*H);
+
+  // Check every record before acting on any.
+  uint64_t DataSize = H->StringDataSize;
+  if ((uint64_t)H->Definition + H->DefinitionSize > DataSize)
+    return false;
+  for (unsigned I = 0, E = H->NumDiagnostics; I != E; ++I) {
+    const DiagnosticRecord &D = DiagRecords[I];
+    if (D.Level < DiagnosticsEngine::Note || D.Level > DiagnosticsEngine::Error ||
+        (D.Token != NoToken && D.Token >= H->NumTokens) ||
+        (uint64_t)D.Message + D.MessageSize > DataSize)
+      return false;
+  }
+  for (unsigned I = 0, E = H->NumInstances; I != E; ++I)
+    if ((uint64_t)Instances[I].Cell + Instances[I].CellSize > DataSize ||
+        (uint64_t)Instances[I].Name + Instances[I].NameSize > DataSize)
+      return false;
+
+  for (unsigned I = 0, E = H->NumDiagnostics; I != E; ++I) {
+    const DiagnosticRecord &D = DiagRecords[I];
+    SourceLocation Loc;
+    if (D.Token != NoToken)
+      Loc = Toks.getLocation(First + D.Token).getLocWithOffset(D.Offset);
+    unsigned DiagID =
+      Diags.getCustomDiagID((DiagnosticsEngine::Level)D.Level, "%0");
+    Diags.Report(Loc, DiagID) << StringRef(StringData + D.Message,
+                                           D.MessageSize);
+  }
+
+  Units.addDefinition(StringRef(StringData + H->Definition,
+                                H->DefinitionSize));
+  for (unsigned I = 0, E = H->NumInstances; I != E; ++I)
+    Units.addInstance(
+      StringRef(StringData + Instances[I].Cell, Instances[I].CellSize),
+      StringRef(StringData + Instances[I].Name, Instances[I].NameSize));
+  return true;
+}
+
+void ParseCacheSession::recordDiagnostic(DiagnosticsEngine::Level Level,
+                                         const Diagnostic &Info) {
+  if (Level == DiagnosticsEngine::Ignored)
+    return;
+  // A fatal error stops the diagnostics after it, which a replay could not.
+  if (Level == DiagnosticsEngine::Fatal) {
+    Uncacheable = true;
+    return;
+  }
+
+  RecordedDiagnostic D;
+  D.Level = Level;
+  D.Token = NoToken;
+  D.Offset = 0;
+  SourceLocation Loc = Info.getLocation();
+  if (Loc.isValid()) {
+    // Diagnostics are at a token, or within one, e.g. just past the token
+    // before one that is missing.  Those anywhere else, such as a note at
+    // an earlier declaration, cannot be replayed relative to the element.
+    unsigned Raw = Loc.getRawEncoding();
+    for (unsigned I = FirstToken; I != EndToken; ++I) {
+      SourceLocation TokLoc = Toks.getLocation(I);
+      if (TokLoc == Loc) {
+        D.Token = I - FirstToken;
+        D.Offset = 0;
+        break;
+      }
+      unsigned TokRaw = TokLoc.getRawEncoding();
+      if (D.Token == NoToken && Loc.isFileID() && TokLoc.isFileID() &&
+          Raw > TokRaw && Raw - TokRaw <= Toks.getLength(I)) {
+        D.Token = I - FirstToken;
+        D.Offset = Raw - TokRaw;
+      }
+    }
+    if (D.Token == NoToken) {
+      Uncacheable = true;
+      return;
+    }
+  }
+
+  SmallString<100> Message;
+  Info.FormatDiagnostic(Message);
+  D.Message = Message.str().str();
+  Diagnostics.push_back(D);
+}
+
+void ParseCacheSession::store() {
+  StringDataBuilder Strings;
+  StringRef Name = Units.getDefinitionName(NumDefinitions);
+  ArrayRef<DesignUnitTable::Instance> Insts =
+    Units.getInstances(NumDefinitions);
+
+  std::vector<DiagnosticRecord> DiagRecords;
+  for (unsigned I = 0, E = Diagnostics.size(); I != E; ++I) {
+    const RecordedDiagnostic &D = Diagnostics[I];
+    DiagnosticRecord DR;
+    DR.Level = D.Level;
+    DR.Token = D.Token;
+    DR.Offset = D.Offset;
+    DR.Message = Strings.add(D.Message);
+    DR.MessageSize = D.Message.size();
+    DiagRecords.push_back(DR);
+  }
+
+  std::vector<InstanceRecord> Instances;
+  for (unsigned I = 0, E = Insts.size(); I != E; ++I) {
+    InstanceRecord IR;
+    IR.Cell = Strings.add(Insts[I].Cell);
+    IR.CellSize = Insts[I].Cell.size();
+    IR.Name = Strings.add(Insts[I].Name);
+    IR.NameSize = Insts[I].Name.size();
+    Instances.push_back(IR);
+  }
+
+  ElementHeader H;
+  memset(&H, 0, sizeof(H));
+  H.Magic = ElementMagic;
+  H.Version = ElementVersion;
+  H.TokenHash = Key.TokenHash;
+  H.FileHash = Key.FileHash;
+  H.MacroFingerprint = Key.MacroFingerprint;
+  H.OptionsHash = Key.OptionsHash;
+  H.DirectiveHash = Key.DirectiveHash;
+  H.NumTokens = Key.NumTokens;
+  H.Definition = Strings.add(Name);
+  H.DefinitionSize = Name.size();
+  H.NumDiagnostics = DiagRecords.size();
+  H.NumInstances = Instances.size();
+  H.StringDataSize = Strings.getData().size();
+
+  std::string Data;
+  llvm::raw_string_ostream OS(Data);
+  OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+  if (!DiagRecords.empty())
+    OS.write(reinterpret_cast<const char *>(&DiagRecords[0]),
+             DiagRecords.size() * sizeof(DiagnosticRecord));
+  if (!Instances.empty())
+    OS.write(reinterpret_cast<const char *>(&Instances[0]),
+             Instances.size() * sizeof(InstanceRecord));
+  OS << Strings.getData();
+  OS.flush();
+
+  // An entry that cannot be written only costs the next run a parse.
+  std::string ErrorStr;
+  if (!Cache.store(Key.getHash(), Data, ErrorStr))
+    ++NumStored;
+}
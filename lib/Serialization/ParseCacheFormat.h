@@ -0,0 +1,79 @@
+//===--- ParseCacheFormat.h - Layout of parse cache entries -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the records of a parse cache entry, the results of
+//  parsing one design element, shared by the reader and the writer.  All
+//  fields are in host byte order; the magic number rejects files written on
+//  a host of different endianness.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LIB_SERIALIZATION_PARSECACHEFORMAT_H
+#define LLVM_VLANG_LIB_SERIALIZATION_PARSECACHEFORMAT_H
+
+#include "LibraryFormat.h"
+#include "llvm/Support/DataTypes.h"
+#include <cstddef>
+
+namespace vlang {
+namespace serialization {
+namespace ondisk {
+
+static const uint32_t ElementMagic = 0x56504331; // 'VPC1'
+static const uint32_t ElementVersion = 1;
+
+/// \brief The header at the start of an entry.  The key fields repeat what
+/// the file name is a hash of, so that a collision is not taken for a hit.
+/// It is followed by the diagnostic records, the instance records of the
+/// element's definition, and the string data all other records point into.
+struct ElementHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint64_t TokenHash;
+  uint64_t FileHash;
+  uint64_t MacroFingerprint;
+  uint64_t OptionsHash;
+  uint64_t DirectiveHash;
+  uint32_t NumTokens;
+  uint32_t Definition;
+  uint32_t DefinitionSize;
+  uint32_t NumDiagnostics;
+  uint32_t NumInstances;
+  uint32_t StringDataSize;
+};
+
+static const uint32_t NoToken = ~0U;
+
+/// \brief A diagnostic reported while parsing the element, at \p Offset
+/// characters into token \p Token, counted from the element's first, or
+/// with no location if \p Token is NoToken.
+struct DiagnosticRecord {
+  uint32_t Level;
+  uint32_t Token;
+  uint32_t Offset;
+  uint32_t Message;
+  uint32_t MessageSize;
+};
+
+inline size_t getDiagnosticsOffset() { return sizeof(ElementHeader); }
+inline size_t getElementInstancesOffset(const ElementHeader &H) {
+  return getDiagnosticsOffset() + H.NumDiagnostics * sizeof(DiagnosticRecord);
+}
+inline size_t getElementStringDataOffset(const ElementHeader &H) {
+  return getElementInstancesOffset(H) + H.NumInstances * sizeof(InstanceRecord);
+}
+inline size_t getElementSize(const ElementHeader &H) {
+  return getElementStringDataOffset(H) + H.StringDataSize;
+}
+
+} // end namespace ondisk
+} // end namespace serialization
+} // end namespace vlang
+
+#endif
@@ -0,0 +1,47 @@
+//===--- StringDataBuilder.h - String data of a file written ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the StringDataBuilder class, which collects the strings
+//  that the records of a serialized file point into.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_LIB_SERIALIZATION_STRINGDATABUILDER_H
+#define LLVM_VLANG_LIB_SERIALIZATION_STRINGDATABUILDER_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+
+namespace vlang {
+namespace serialization {
+
+/// \brief The string data of a file under construction.
+class StringDataBuilder {
+  std::string Data;
+  llvm::StringMap<uint32_t> Offsets;
+
+public:
+  /// \brief Add \p Str, once, and return its offset.
+  uint32_t add(llvm::StringRef Str) {
+    llvm::StringMapEntry<uint32_t> &Entry =
+      Offsets.GetOrCreateValue(Str, Data.size());
+    if (Entry.getValue() == Data.size())
+      Data.append(Str.begin(), Str.end());
+    return Entry.getValue();
+  }
+
+  const std::string &getData() const { return Data; }
+};
+
+} // end namespace serialization
+} // end namespace vlang
+
+#endif
@@ -10,26 +10,50 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cassert>
+#include <atomic>
+#include <thread>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 
 //===----------------------------------------------------------------------===//
 // Lexer
 //===----------------------------------------------------------------------===//
 #include "vlang/Lex/Preprocessor.h"
 #include "vlang/Lex/Lexer.h"
+#include "vlang/Lex/TokenBuffer.h"
 #include "vlang/Diag/Diagnostic.h"
 #include "vlang/Diag/DiagnosticOptions.h"
 #include "vlang/Diag/TextDiagnosticPrinter.h"
 #include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/FrozenIdentifierTable.h"
+#include "vlang/Basic/MacroBuilder.h"
+#include "vlang/Basic/PerfCounters.h"
 #include "vlang/Basic/SourceManager.h"
+#include "vlang/Basic/StableHash.h"
 #include "vlang/Basic/TargetInfo.h"
 #include "vlang/Basic/TargetOptions.h"
+#include "vlang/Frontend/CommandFiles.h"
+#include "vlang/Frontend/CompilationUnit.h"
+#include "vlang/Frontend/ConfigResolver.h"
+#include "vlang/Frontend/InputUnit.h"
+#include "vlang/Frontend/LibraryMap.h"
+#include "vlang/Frontend/LibraryResolver.h"
 #include "vlang/Lex/PreprocessorOptions.h"
 #include "vlang/Lex/HeaderSearchOptions.h"
 #include "vlang/Lex/HeaderSearch.h"
+#include "vlang/Netlist/NetlistDatabase.h"
+#include "vlang/Parse/ConfigTable.h"
+#include "vlang/Parse/DesignUnitTable.h"
+#include "vlang/Parse/NetlistTable.h"
 #include "vlang/Parse/Parser.h"
 #include "vlang/Sema/Sema.h"
+#include "vlang/Serialization/LibraryCache.h"
+#include "vlang/Serialization/PackageCache.h"
+#include "vlang/Serialization/ParseCache.h"
 #include <llvm/Support/system_error.h>
 #include <llvm/Support/raw_ostream.h>
 #include "vlang/Frontend/Utils.h"
@@ -47,50 +71,688 @@ static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
 static cl::list<std::string> HeaderSearchPaths("I", cl::NormalFormatting, cl::ZeroOrMore,
                                  cl::desc("Path to Headers"));
 
+static cl::list<std::string> LibraryDirs("y", cl::ZeroOrMore,
+                                 cl::desc("Look for undefined cells in the files of <dir> named after them"),
+                                 cl::value_desc("dir"));
+
+static cl::list<std::string> LibraryFiles("v", cl::ZeroOrMore,
+                                 cl::desc("Look for undefined cells in library <file>"),
+                                 cl::value_desc("file"));
+
+static cl::opt<bool> CompilationUnitMode("compilation-unit",
+                                 cl::desc("Parse all inputs as one compilation unit, sharing macros and $unit declarations"));
+
+static cl::opt<unsigned> UnitThreads("unit-threads", cl::init(0),
+                                 cl::desc("Parse the inputs of -compilation-unit on <n> threads, each after replaying the macros of the inputs before it"),
+                                 cl::value_desc("n"));
+
+static cl::opt<std::string> LibraryMapFile("libmap",
+                                 cl::desc("Compile the libraries of library map <file>; other inputs go to library 'work'"),
+                                 cl::value_desc("file"));
+
+static cl::opt<std::string> ConfigName("config",
+                                 cl::desc("Bind the design of configuration <name> (with -libmap)"),
+                                 cl::value_desc("name"));
+
+static cl::opt<std::string> LibraryCacheDir("library-cache",
+                                 cl::desc("Reuse the design units parsed from unchanged library files, cached in <dir> (with -libmap)"),
+                                 cl::value_desc("dir"));
+
+static cl::opt<std::string> LineTableCacheDir("line-table-cache",
+                                 cl::desc("Directory for cached line tables of large files"),
+                                 cl::value_desc("dir"));
+
+static cl::opt<std::string> IdentifierBaseFile("identifier-base",
+                                 cl::desc("Share the identifier table stored in <file> between inputs"),
+                                 cl::value_desc("file"));
+
+static cl::opt<std::string> WriteIdentifierBaseFile("write-identifier-base",
+                                 cl::desc("Write the identifiers seen in all inputs to <file>"),
+                                 cl::value_desc("file"));
+
+static cl::opt<bool> PreprocessOnly("E",
+                                 cl::desc("Only run the preprocessor, printing its output"));
+
+static cl::opt<bool> PrintDependencies("M",
+                                 cl::desc("Only print the files each input reads, as a make rule"));
+
+static cl::opt<bool> UseTokenBuffer("token-buffer",
+                                 cl::desc("Preprocess each input fully before parsing it"));
+
+static cl::opt<bool> NetlistMode("netlist",
+                                 cl::desc("Record simple cell instances in a netlist table (implies -token-buffer)"));
+
+static cl::opt<std::string> WriteNetlistFile("write-netlist",
+                                 cl::desc("Write the netlist database of the input to <file> (implies -netlist)"),
+                                 cl::value_desc("file"));
+
+static cl::opt<std::string> PackageCacheDir("package-cache",
+                                 cl::desc("Precompile the packages of each input into <dir> and resolve imports from it (implies -token-buffer)"),
+                                 cl::value_desc("dir"));
+
+static cl::list<std::string> UsePackages("use-package", cl::ZeroOrMore,
+                                 cl::desc("Define the macros of precompiled package <name> before each input"),
+                                 cl::value_desc("name"));
+
+static cl::opt<std::string> ParseCacheDir("parse-cache",
+                                 cl::desc("Replay the design elements parsed by earlier runs from <dir>, and record those parsed (implies -token-buffer)"),
+                                 cl::value_desc("dir"));
+
+static cl::opt<unsigned> ParseCacheSize("parse-cache-size", cl::init(512),
+                                 cl::desc("Keep the parse cache under <n> MB by evicting the elements used least recently (default 512)"),
+                                 cl::value_desc("n"));
+
+static cl::opt<bool> PerfSummary("perf-summary",
+                                 cl::desc("Print the time spent in each front end phase"));
+
+static cl::opt<std::string> PerfTraceFile("perf-trace",
+                                 cl::desc("Write a Chrome trace of the front end phases to <file>"),
+                                 cl::value_desc("file"));
+
+/// \brief What the inputs of one run share.
+struct DriverState {
+   PlusArgs Plus;
+   OwningPtr<FrozenIdentifierTable> IdentifierBase;
+   OwningPtr<PackageCache> Packages;
+   OwningPtr<ParseCache> Parses;
+   DesignUnitTable Units;
+   ConfigTable Configs;
+   bool RecordNetlist;
+   std::string errString;
+};
+
+/// \brief The header search options of an input: the -I directories, the
+/// +incdir+ ones, then \p IncludeDirs.
+static HeaderSearchOptions *getHeaderSearchOptions(const DriverState &State,
+                                                   ArrayRef<std::string> IncludeDirs)
+{
+   HeaderSearchOptions *Opts = new HeaderSearchOptions();
+   for (auto &Dir : HeaderSearchPaths)
+      Opts->AddPath(Dir, frontend::Quoted, true);
+   for (auto &Dir : State.Plus.IncludeDirs)
+      Opts->AddPath(Dir, frontend::Quoted, true);
+   for (auto &Dir : IncludeDirs)
+      Opts->AddPath(Dir, frontend::Quoted, true);
+   return Opts;
+}
+
+/// \brief An InputUnit with a file manager, diagnostics and header search of
+/// its own, set up from the options all inputs share.
+class DriverUnit {
+public:
+   FileSystemOptions FileMgrOpts;
+   FileManager FileMgr;
+   LangOptions LangOpts;
+   DiagnosticConsumer *DiagClient;
+   DiagnosticsEngine Diags;
+   IntrusiveRefCntPtr<HeaderSearchOptions> HeadSearch;
+   HeaderSearch HeaderInfo;
+   InputUnit Input;
+
+   /// Diagnostics are printed to \p DiagOS, or dropped if it is null.
+   DriverUnit(const DriverState &State, ArrayRef<std::string> IncludeDirs,
+              raw_ostream *DiagOS)
+     : FileMgr(FileMgrOpts),
+       DiagClient(DiagOS ? static_cast<DiagnosticConsumer *>(
+                             new TextDiagnosticPrinter(*DiagOS, new DiagnosticOptions()))
+                         : new IgnoringDiagConsumer()),
+       Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs()),
+             new DiagnosticOptions(), DiagClient),
+       HeadSearch(getHeaderSearchOptions(State, IncludeDirs)),
+       HeaderInfo(HeadSearch, FileMgr, Diags, LangOpts),
+       Input(Diags, FileMgr, LangOpts, HeaderInfo, State.Plus.Defines,
+             State.IdentifierBase.get()) {
+      if (!LineTableCacheDir.empty())
+         Input.SourceMgr.setLineTableCacheDir(LineTableCacheDir);
+   }
+};
+
+/// The definitions of the macros the -use-package packages were compiled
+/// with, to be read as if their files were included first.  Packages that
+/// are not up to date are warned about if \p Warn is set.
+static std::string getPackagePredefines(DriverState &State, bool Warn)
+{
+   std::string Predefines;
+   if (UsePackages.empty())
+      return Predefines;
+   raw_string_ostream PredefinesOS(Predefines);
+   MacroBuilder Builder(PredefinesOS);
+   for (auto Name : UsePackages)
+      if (!State.Packages->addMacros(Name, Builder) && Warn)
+         errs() << "warning: no up-to-date precompiled package '"
+                << Name << "'\n";
+   PredefinesOS.flush();
+   return Predefines;
+}
+
+/// Parses \p file in a unit of its own; see ParseInput.  Sets \p NewBase to
+/// the identifiers of the unit if they are to be folded into the base, which
+/// the unit refers to until it is destroyed.
+static bool ParseInputInUnit(const std::string &file, bool IsLibrary,
+                             DriverState &State, DesignUnitTable &Units,
+                             ArrayRef<std::string> IncludeDirs,
+                             StringRef Source, LibraryFile *Record,
+                             OwningPtr<FrozenIdentifierTable> &NewBase)
+{
+   std::string &errString = State.errString;
+   OwningPtr<PackageCache> &Packages = State.Packages;
+   bool RecordNetlist = State.RecordNetlist;
+
+   DriverUnit Driver(State, IncludeDirs, &llvm::errs());
+   InputUnit &Unit = Driver.Input;
+
+   // Precompiled packages record the files they depend on, the input
+   // among them, so it must be read as a file entry.
+   if (Unit.createMainFile(file, Source, Packages.get() != 0, errString)) {
+      errs() << "error: " << errString << "\n";
+      return true;
+   }
+
+   Unit.enterMainFile(getPackagePredefines(State, /*Warn=*/true));
+
+   InputParseOptions ParseOpts;
+   ParseOpts.Units = &Units;
+   ParseOpts.Configs = &State.Configs;
+   ParseOpts.Parses = State.Parses.get();
+   ParseOpts.UseTokenBuffer = UseTokenBuffer;
+   NetlistTable Netlist;
+   if (RecordNetlist)
+      ParseOpts.Netlist = &Netlist;
+   PackageTable PackageSymbols;
+   if (Packages) {
+      PackageSymbols.setExternalSource(Packages.get());
+      ParseOpts.Packages = &PackageSymbols;
+   }
+   InputParseResult Parsed = parseInput(Unit, ParseOpts);
+   printf("\nFINISHED parsing\n");
+   if (Parsed.UsedParseCache)
+      printf("parse cache: %u elements replayed, %u parsed, %u stored\n",
+             Parsed.NumReplayed, Parsed.NumParsed, Parsed.NumStored);
+   if (RecordNetlist)
+      printf("netlist: %u instances, %u connections, %u nets; "
+             "%u items parsed in full\n",
+             Netlist.getNumInstances(), Netlist.getNumConnections(),
+             Netlist.getNumNets(), Netlist.getNumComplexItems());
+   if (!WriteNetlistFile.empty() && !IsLibrary) {
+      OwningPtr<NetlistDatabase> DB(NetlistDatabase::build(Netlist, 0, &Unit.SourceMgr));
+      if (DB->writeToFile(WriteNetlistFile, errString))
+         errs() << "error: cannot write '" << WriteNetlistFile << "': "
+                << errString << "\n";
+   }
+   if (Packages) {
+      printf("packages: %u known, %u symbols loaded from the cache\n",
+             PackageSymbols.getNumPackages(),
+             PackageSymbols.getNumMaterialized());
+      if (Packages->writePackages(PackageSymbols, Unit.Toks, Unit.PP, errString))
+         errs() << "error: cannot write precompiled packages to '"
+                << PackageCacheDir << "': " << errString << "\n";
+   }
+
+   if (Record)
+      ParsedLibrary::getDependencies(Unit.SourceMgr, Record->Dependencies);
+
+   // Fold this input's identifiers into the base used by the next ones.
+   if (!WriteIdentifierBaseFile.empty())
+      NewBase.reset(FrozenIdentifierTable::create(Unit.PP.getIdentifierTable()));
+   return Driver.Diags.hasErrorOccurred() || Driver.Diags.getNumWarnings();
+}
+
+/// Parses \p file as a compilation unit of its own, adding its design units
+/// to \p Units.  \p IsLibrary is set for a library file parsed for the cells
+/// it defines, and \p IncludeDirs are the include directories of its library.
+/// If \p Source is not empty, it is parsed as the contents of \p file.  If
+/// \p Record is not null, the other files the input reads are added to its
+/// dependencies.  Returns true if the input was diagnosed.
+static bool ParseInput(const std::string &file, bool IsLibrary,
+                       DriverState &State, DesignUnitTable &Units,
+                       ArrayRef<std::string> IncludeDirs = ArrayRef<std::string>(),
+                       StringRef Source = StringRef(),
+                       LibraryFile *Record = 0)
+{
+   OwningPtr<FrozenIdentifierTable> NewBase;
+   bool Diagnosed = ParseInputInUnit(file, IsLibrary, State, Units,
+                                     IncludeDirs, Source, Record, NewBase);
+   // The old base can go only now that the unit that refers to it is gone.
+   if (NewBase)
+      State.IdentifierBase.reset(NewBase.take());
+   return Diagnosed;
+}
+
+/// Preprocesses \p file, printing its output for -E, or the make rule of the
+/// files it reads for -M.
+static void PreprocessInput(const std::string &file, DriverState &State)
+{
+   DriverUnit Driver(State, ArrayRef<std::string>(), &llvm::errs());
+
+   // The input is among the files it reads only as a file entry.
+   if (Driver.Input.createMainFile(file, StringRef(), /*AsFileEntry=*/true,
+                                   State.errString)) {
+      errs() << "error: " << State.errString << "\n";
+      return;
+   }
+   preprocessInput(Driver.Input, file, PrintDependencies, outs());
+   outs().flush();
+}
+
+/// Parses all inputs as one compilation unit, whose main file includes them
+/// in order: a `define in one input is visible in those after it, and so
+/// are the imports of its $unit scope.
+static void ParseCompilationUnit(DriverState &State)
+{
+   ParseInput("<compilation-unit>", /*IsLibrary=*/false, State, State.Units,
+              ArrayRef<std::string>(), getCompilationUnitSource(InputFilenames));
+}
+
+/// Parses the inputs of a compilation unit on \p NumThreads threads, each
+/// input in a Preprocessor of its own that first replays the macros the
+/// inputs before it left defined.  Those are found by preprocessing the
+/// unit once without parsing it; diagnostics come from the workers only,
+/// and are printed in input order.
+static void ParseCompilationUnitInParallel(DriverState &State,
+                                           unsigned NumThreads)
+{
+   std::vector<std::string> Snapshots;
+   {
+      DriverUnit Driver(State, ArrayRef<std::string>(), 0);
+      InputUnit &Unit = Driver.Input;
+      if (Unit.createMainFile("<compilation-unit>",
+                              getCompilationUnitSource(InputFilenames), false,
+                              State.errString))
+         return;
+      MacroSnapshotRecorder *Recorder = new MacroSnapshotRecorder(Unit.PP);
+      Unit.PP.addPPCallbacks(Recorder);
+      Unit.enterMainFile(StringRef());
+      Token Tok;
+      do
+         Unit.PP.Lex(Tok);
+      while (Tok.isNot(tok::eof));
+      Snapshots = Recorder->getSnapshots();
+   }
+   unsigned NumFiles = InputFilenames.size();
+   if (Snapshots.size() != NumFiles) {
+      errs() << "error: cannot read every input of the compilation unit\n";
+      return;
+   }
+
+   std::vector<DesignUnitTable *> Units;
+   for (unsigned I = 0; I != NumFiles; ++I)
+      Units.push_back(new DesignUnitTable());
+   std::vector<std::string> Diagnostics(NumFiles);
+   std::atomic<unsigned> NextFile(0);
+   std::vector<std::thread> Workers;
+   for (unsigned T = 0; T != NumThreads; ++T)
+      Workers.push_back(std::thread([&]() {
+         for (unsigned I; (I = NextFile++) < NumFiles;) {
+            raw_string_ostream DiagOS(Diagnostics[I]);
+            DriverUnit Driver(State, ArrayRef<std::string>(), &DiagOS);
+            InputUnit &Unit = Driver.Input;
+            std::string ErrorStr;
+            if (Unit.createMainFile(InputFilenames[I], StringRef(), false,
+                                    ErrorStr)) {
+               DiagOS << "error: " << ErrorStr << "\n";
+               continue;
+            }
+            Unit.enterMainFile(Snapshots[I]);
+            InputParseOptions ParseOpts;
+            ParseOpts.Units = Units[I];
+            ParseOpts.Parses = State.Parses.get();
+            ParseOpts.UseTokenBuffer = UseTokenBuffer;
+            parseInput(Unit, ParseOpts);
+         }
+      }));
+   for (unsigned T = 0; T != NumThreads; ++T)
+      Workers[T].join();
+
+   for (unsigned I = 0; I != NumFiles; ++I) {
+      errs() << Diagnostics[I];
+      State.Units.append(*Units[I]);
+   }
+   DeleteContainerPointers(Units);
+   printf("compilation unit: %u files parsed on %u threads\n", NumFiles,
+          NumThreads);
+}
+
+/// Parses the library files defining the cells the inputs instantiate but
+/// do not define, and those of the cells the library cells instantiate in
+/// turn.  Cells no library has are reported.
+static void ParseLibraryCells(LibraryResolver &Libraries, DriverState &State)
+{
+   StringSet<> Tried;
+   StringSet<> ParsedFiles;
+   unsigned NumCells = 0;
+   for (;;) {
+      SmallVector<StringRef, 32> Unresolved;
+      State.Units.getUnresolved(Unresolved);
+
+      // Find every file first: parsing adds to the table.
+      std::vector<std::string> Files;
+      for (auto Name : Unresolved) {
+         if (!Tried.insert(Name))
+            continue;
+         StringRef File = Libraries.findCell(Name);
+         if (File.empty()) {
+            errs() << "warning: cannot find cell '" << Name
+                   << "' in the libraries\n";
+            continue;
+         }
+         ++NumCells;
+         if (ParsedFiles.insert(File))
+            Files.push_back(File);
+      }
+      if (Files.empty())
+         break;
+      for (auto File : Files)
+         ParseInput(File, /*IsLibrary=*/true, State, State.Units);
+   }
+   printf("libraries: %u cells indexed from %u files scanned; "
+          "%u cells resolved from %u files parsed\n",
+          Libraries.getNumCells(), Libraries.getNumFilesScanned(), NumCells,
+          ParsedFiles.size());
+}
+
+/// The fingerprint of what a library file parses differently with, besides
+/// the files it reads: the +define+ macros, the include directories with
+/// \p IncludeDirs those of its library, and the macros of the -use-package
+/// packages.
+static uint64_t getLibraryOptionsHash(DriverState &State,
+                                      ArrayRef<std::string> IncludeDirs)
+{
+   std::string Options;
+   raw_string_ostream OS(Options);
+   for (auto &Define : State.Plus.Defines)
+      OS << "+define+" << Define << '\0';
+   for (auto &Dir : HeaderSearchPaths)
+      OS << "-I" << Dir << '\0';
+   for (auto &Dir : State.Plus.IncludeDirs)
+      OS << "+incdir+" << Dir << '\0';
+   for (auto &Dir : IncludeDirs)
+      OS << "-incdir" << Dir << '\0';
+   OS << getPackagePredefines(State, /*Warn=*/false);
+   return hashFNV1a(OS.str());
+}
+
+/// Parses the files of library \p L of \p Map into \p Units, one unit per
+/// file, reusing the design units \p Cache holds for files that have not
+/// changed, and neither have the files they include nor the options they
+/// are parsed with.  Files that declare a configuration are parsed every
+/// time, as the cache holds no configurations, and so are files with
+/// diagnostics, as it holds none of those either.
+static void ParseLibrary(const LibraryMap &Map, unsigned L,
+                         const std::vector<std::string> &Files,
+                         const std::vector<bool> &IsInput,
+                         LibraryCache *Cache, DesignUnitTable &Units,
+                         DriverState &State)
+{
+   const LibraryMap::Library &Lib = Map.getLibrary(L);
+   const ParsedLibrary *Cached = Cache ? Cache->getLibrary(Lib.Name) : 0;
+   std::vector<DesignUnitTable *> FileUnits;
+   std::vector<LibraryFile> Recorded;
+   unsigned NumReused = 0;
+   bool Changed = !Cached;
+   uint64_t OptionsHash =
+      Cache ? getLibraryOptionsHash(State, Lib.IncludeDirs) : 0;
+   for (unsigned I = 0, E = Files.size(); I != E; ++I) {
+      OwningPtr<MemoryBuffer> Buffer;
+      if (MemoryBuffer::getFile(Files[I], Buffer)) {
+         errs() << "error: cannot read '" << Files[I] << "'\n";
+         Changed = true;
+         continue;
+      }
+      LibraryFile F;
+      F.Path = Files[I];
+      F.Size = Buffer->getBufferSize();
+      F.Hash = ParsedLibrary::hashContents(Buffer->getBuffer());
+      F.OptionsHash = OptionsHash;
+      FileUnits.push_back(new DesignUnitTable());
+      F.Units = FileUnits.back();
+
+      // The units of every file go into the library; only whether the file
+      // is recorded for reuse depends on what it held.
+      bool Reusable = true;
+      if (Cached && Cached->getUnits(F, *FileUnits.back())) {
+         ++NumReused;
+      } else {
+         unsigned NumConfigs = State.Configs.getNumDeclarations();
+         bool Diagnosed = ParseInput(Files[I], !IsInput[I], State,
+                                     *FileUnits.back(), Lib.IncludeDirs,
+                                     StringRef(), &F);
+         Changed = true;
+         Reusable = !Diagnosed &&
+                    State.Configs.getNumDeclarations() == NumConfigs;
+      }
+      if (Reusable)
+         Recorded.push_back(F);
+      Units.append(*FileUnits.back());
+   }
+   // Config files and diagnosed files are parsed but not recorded, so they
+   // do not count.
+   if (Cached && Cached->getNumFiles() != Recorded.size())
+      Changed = true;
+   if (Cache && Changed &&
+       Cache->writeLibrary(Lib.Name, Recorded, State.errString))
+      errs() << "error: cannot write parsed library '" << Lib.Name << "': "
+             << State.errString << "\n";
+   DeleteContainerPointers(FileUnits);
+
+   printf("library %s: %u files, %u parsed, %u reused; %u definitions\n",
+          Lib.Name.c_str(), (unsigned)Files.size(),
+          (unsigned)Files.size() - NumReused, NumReused,
+          Units.getNumDefinitions());
+}
+
+/// Compiles the libraries of \p Map, with each input in the library its
+/// path maps to or else in library "work", and binds the design of the
+/// selected configuration to their cells.
+static void CompileLibraries(LibraryMap &Map, DriverState &State)
+{
+   // Inputs are files of their libraries like the others.
+   std::vector<std::vector<std::string> > Files(Map.getNumLibraries());
+   std::vector<std::vector<bool> > IsInput(Map.getNumLibraries());
+   StringSet<> Seen;
+   for (unsigned L = 0, E = Map.getNumLibraries(); L != E; ++L) {
+      Map.getLibraryFiles(L, Files[L]);
+      for (auto &File : Files[L])
+         Seen.insert(File);
+      IsInput[L].resize(Files[L].size(), false);
+   }
+   for (auto &Input : InputFilenames) {
+      std::string Path = LibraryMap::getNormalizedPath(Input);
+      if (!Seen.insert(Path))
+         continue;
+      unsigned L = Map.getLibraryForFile(Path);
+      if (L == LibraryMap::NoLibrary)
+         L = Map.addLibrary("work");
+      Files.resize(Map.getNumLibraries());
+      IsInput.resize(Map.getNumLibraries());
+      Files[L].push_back(Path);
+      IsInput[L].push_back(true);
+   }
+   for (auto &Warning : Map.getWarnings())
+      errs() << "warning: " << Warning << "\n";
+
+   OwningPtr<LibraryCache> Cache;
+   if (!LibraryCacheDir.empty())
+      Cache.reset(new LibraryCache(LibraryCacheDir));
+
+   std::vector<DesignUnitTable *> LibraryUnits;
+   ConfigResolver Resolver(State.Configs);
+   for (unsigned L = 0, E = Map.getNumLibraries(); L != E; ++L) {
+      LibraryUnits.push_back(new DesignUnitTable());
+      ParseLibrary(Map, L, Files[L], IsInput[L], Cache.get(),
+                   *LibraryUnits.back(), State);
+      Resolver.addLibrary(Map.getLibrary(L).Name, *LibraryUnits.back());
+      State.Units.append(*LibraryUnits.back());
+   }
+
+   // Without -config, a design with one configuration is bound by it.
+   const Configuration *Config = 0;
+   if (!ConfigName.empty()) {
+      Config = State.Configs.findConfig(ConfigName);
+      if (!Config)
+         errs() << "error: no configuration '" << ConfigName << "'\n";
+   } else if (State.Configs.getNumConfigs() == 1) {
+      Config = &State.Configs.getConfig(0);
+   }
+   if (Config || ConfigName.empty()) {
+      Resolver.resolve(Config);
+      for (auto &U : Resolver.getUnresolved())
+         errs() << "warning: cannot bind instance '" << U.Path << "' of cell '"
+                << U.Cell << "'\n";
+      printf("configuration %s: %u instances bound, %u unresolved\n",
+             Config ? Config->Name.str().c_str() : "(default)",
+             (unsigned)Resolver.getBindings().size(),
+             (unsigned)Resolver.getUnresolved().size());
+   }
+   DeleteContainerPointers(LibraryUnits);
+}
+
 int main( int argc, char *argv[] )
 {
-	cl::ParseCommandLineOptions(argc, argv, " Vlang Parser\n");
+   // -f command files and plusargs are not in a form the option parser
+   // takes, so expand and extract them first.
+   DriverState State;
+   std::vector<std::string> Args;
+   std::vector<std::string> UnknownPlusArgs;
+   std::vector<const char *> Argv(argv, argv + argc);
+   if (ExpandCommandFiles(Argv, Args, State.errString)) {
+      errs() << "error: " << State.errString << "\n";
+      exit(1);
+   }
+   ExtractPlusArgs(Args, State.Plus, UnknownPlusArgs);
+   for (auto Arg : UnknownPlusArgs)
+      errs() << "warning: ignoring unknown argument '" << Arg << "'\n";
+   std::vector<const char *> ArgPtrs;
+   for (auto &Arg : Args)
+      ArgPtrs.push_back(Arg.c_str());
+
+	cl::ParseCommandLineOptions(ArgPtrs.size(), &ArgPtrs[0], " Vlang Parser\n");
 
 	if( InputFilenames.size() == 0 ){
 		printf("ERROR: Expected at least on input\n");
 		exit(1);
 	}
+   if (!WriteNetlistFile.empty() && InputFilenames.size() != 1 &&
+       !CompilationUnitMode) {
+      errs() << "error: -write-netlist expects a single input\n";
+      exit(1);
+   }
+   State.RecordNetlist = NetlistMode || !WriteNetlistFile.empty();
+   if (UnitThreads && !CompilationUnitMode) {
+      errs() << "error: -unit-threads requires -compilation-unit\n";
+      exit(1);
+   }
+   if (CompilationUnitMode && !LibraryMapFile.empty()) {
+      errs() << "error: -compilation-unit cannot be combined with -libmap\n";
+      exit(1);
+   }
+   // The workers share nothing they write to.
+   if (UnitThreads && (State.RecordNetlist || !PackageCacheDir.empty() ||
+                       !WriteIdentifierBaseFile.empty())) {
+      errs() << "error: -unit-threads cannot be combined with -netlist, "
+                "-package-cache or -write-identifier-base\n";
+      exit(1);
+   }
+   if ((!ConfigName.empty() || !LibraryCacheDir.empty()) &&
+       LibraryMapFile.empty()) {
+      errs() << "error: -config and -library-cache require -libmap\n";
+      exit(1);
+   }
+   // Replaying an element only reproduces its diagnostics and design units.
+   if (!ParseCacheDir.empty() &&
+       (State.RecordNetlist || !PackageCacheDir.empty())) {
+      errs() << "error: -parse-cache cannot be combined with -netlist or "
+                "-package-cache\n";
+      exit(1);
+   }
+   // Each input is preprocessed on its own, and nothing is parsed.
+   bool PreprocessMode = PreprocessOnly || PrintDependencies;
+   if (PreprocessMode &&
+       (CompilationUnitMode || !LibraryMapFile.empty() || State.RecordNetlist ||
+        !PackageCacheDir.empty() || !ParseCacheDir.empty())) {
+      errs() << "error: -E and -M cannot be combined with -compilation-unit, "
+                "-libmap, -netlist, -package-cache or -parse-cache\n";
+      exit(1);
+   }
+   if (!UsePackages.empty() && PackageCacheDir.empty()) {
+      errs() << "error: -use-package requires -package-cache\n";
+      exit(1);
+   }
 
 
-   std::string errString;
-   for (auto file : InputFilenames) {
-      FileSystemOptions FileMgrOpts;
-      FileManager       FileMgr(FileMgrOpts);
-
-      IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
-      LangOptions LangOpts;
-      HeaderSearchOptions HeadSearch;
-      TextDiagnosticPrinter *DiagPrinter = new TextDiagnosticPrinter(llvm::errs(), new DiagnosticOptions());
-      DiagnosticsEngine Diags(DiagID, new DiagnosticOptions, DiagPrinter);
-      SourceManager SourceMgr(Diags,FileMgr);
-      IntrusiveRefCntPtr<TargetOptions> TargetOpts(new TargetOptions);
-      IntrusiveRefCntPtr<TargetInfo> Target;
-
-      auto buf = FileMgr.getBufferForFile(file.c_str(), &errString);
-      SourceMgr.createMainFileIDForMemBuffer(buf);
-      
-      // Add search paths for `include
-      for( auto header : HeaderSearchPaths){
-         HeadSearch.AddPath(header.c_str(), frontend::Quoted, true);
+   std::string &errString = State.errString;
+   if (PerfSummary || !PerfTraceFile.empty())
+      perf::enable(!PerfTraceFile.empty());
+
+   if (!IdentifierBaseFile.empty()) {
+      State.IdentifierBase.reset(FrozenIdentifierTable::loadFromFile(IdentifierBaseFile, errString));
+      if (!State.IdentifierBase)
+         errs() << "warning: ignoring identifier table '" << IdentifierBaseFile
+                << "': " << errString << "\n";
+   }
+
+   if (!PackageCacheDir.empty())
+      State.Packages.reset(new PackageCache(PackageCacheDir));
+   if (!ParseCacheDir.empty())
+      State.Parses.reset(new ParseCache(ParseCacheDir,
+                                        (uint64_t)ParseCacheSize << 20));
+
+   // Libraries are searched in the order given, -y and -v interleaved.
+   LibraryResolver Libraries;
+   for (unsigned Y = 0, V = 0; Y != LibraryDirs.size() || V != LibraryFiles.size();) {
+      if (V == LibraryFiles.size() ||
+          (Y != LibraryDirs.size() &&
+           LibraryDirs.getPosition(Y) < LibraryFiles.getPosition(V)))
+         Libraries.addLibraryDirectory(LibraryDirs[Y++]);
+      else
+         Libraries.addLibraryFile(LibraryFiles[V++]);
+   }
+   for (auto Ext : State.Plus.LibraryExtensions)
+      Libraries.addExtension(Ext);
+
+   if (PreprocessMode) {
+      for (auto file : InputFilenames)
+         PreprocessInput(file, State);
+   } else if (!LibraryMapFile.empty()) {
+      LibraryMap Map;
+      if (Map.loadFromFile(LibraryMapFile, errString)) {
+         errs() << "error: cannot read library map '" << LibraryMapFile
+                << "': " << errString << "\n";
+         exit(1);
       }
+      CompileLibraries(Map, State);
+   } else if (UnitThreads) {
+      ParseCompilationUnitInParallel(State, UnitThreads);
+   } else if (CompilationUnitMode) {
+      ParseCompilationUnit(State);
+   } else {
+      for (auto file : InputFilenames)
+         ParseInput(file, /*IsLibrary=*/false, State, State.Units);
+   }
+   if (!Libraries.empty() && !PreprocessMode)
+      ParseLibraryCells(Libraries, State);
 
-      HeaderSearch HeaderInfo(&HeadSearch, FileMgr, Diags, LangOpts);
-      PreprocessorOptions PPopts;
-      Preprocessor PP(&PPopts, Diags, LangOpts, SourceMgr, HeaderInfo,0, false, false);
+   if (State.Parses) {
+      unsigned Evicted = State.Parses->prune();
+      printf("parse cache: %u elements replayed, %u parsed, %u stored, "
+             "%u evicted\n", State.Parses->getNumReplayed(),
+             State.Parses->getNumParsed(), State.Parses->getNumStored(),
+             Evicted);
+   }
 
-      InitializePreprocessor(PP, PPopts, HeadSearch);
+   if (!WriteIdentifierBaseFile.empty() && State.IdentifierBase &&
+       State.IdentifierBase->writeToFile(WriteIdentifierBaseFile, errString))
+      errs() << "error: cannot write '" << WriteIdentifierBaseFile << "': "
+             << errString << "\n";
 
-      DiagPrinter->BeginSourceFile(LangOpts, &PP);
-      PP.EnterMainSourceFile();
-      Parser P(PP, Sema(PP, TU_Complete, nullptr),false);
-      P.Initialize();
-      while(!P.ParseTopLevelDecl()){}
-      printf("\nFINISHED parsing\n");
+   if (PerfSummary)
+      perf::printSummary(errs());
+   if (!PerfTraceFile.empty()) {
+      raw_fd_ostream TraceOS(PerfTraceFile.c_str(), errString);
+      if (errString.empty())
+         perf::writeChromeTrace(TraceOS);
+      else
+         errs() << "error: cannot write '" << PerfTraceFile << "': "
+                << errString << "\n";
    }
 
     return 0;
@@ -0,0 +1,1235 @@
+//===--- VlangBench.cpp - Front end throughput benchmarks -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// vlang-bench generates synthetic SystemVerilog designs of a requested size
+// and times the raw lexer, the preprocessor and the parser on them
+// separately.  Results are written as JSON so that they can be collected and
+// compared between revisions.
+//
+// Each workload is written as one or more compilation units of at most
+// -unit-size megabytes, since a single unit must fit the 32-bit source
+// location space.  Every phase is run -iterations times on a fresh front end
+// and the fastest run is reported.
+//
+// The daemon workload instead compares the latency of running vlang on a
+// small design as a new process each time with that of having the vlangd
+// compile server run the same job through vlangc.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Diag/Diagnostic.h"
+#include "vlang/Diag/DiagnosticOptions.h"
+#include "vlang/Frontend/Utils.h"
+#include "vlang/Lex/HeaderSearch.h"
+#include "vlang/Lex/HeaderSearchOptions.h"
+#include "vlang/Lex/LexDiagnostic.h"
+#include "vlang/Lex/Lexer.h"
+#include "vlang/Lex/Preprocessor.h"
+#include "vlang/Lex/PreprocessorOptions.h"
+#include "vlang/Lex/TokenBuffer.h"
+#include "vlang/Netlist/NetlistDatabase.h"
+#include "vlang/Parse/NetlistTable.h"
+#include "vlang/Parse/Parser.h"
+#include "vlang/Sema/Sema.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+using namespace llvm;
+using namespace vlang;
+
+//===----------------------------------------------------------------------===//
+// Command line options.
+//===----------------------------------------------------------------------===//
+
+static cl::list<std::string>
+Workloads("workload", cl::CommaSeparated,
+          cl::desc("Workloads to run: include-tree, uvm-macros, "
+                   "macro-stringify, netlist, wide-ports, generate, "
+                   "diag-states, concurrent, "
+                   "netlist-db, daemon (default: all but netlist-db and "
+                   "daemon)"),
+          cl::value_desc("name,..."));
+
+static cl::opt<unsigned>
+SizeMB("size", cl::init(1),
+       cl::desc("Amount of source to generate per workload, in megabytes"),
+       cl::value_desc("MB"));
+
+static cl::opt<unsigned>
+UnitSizeMB("unit-size", cl::init(256),
+           cl::desc("Largest compilation unit to generate, in megabytes"),
+           cl::value_desc("MB"));
+
+static cl::opt<unsigned>
+Iterations("iterations", cl::init(3),
+           cl::desc("Number of times each phase is run"));
+
+static cl::opt<unsigned>
+IncludeDepth("include-depth", cl::init(8),
+             cl::desc("Depth of the include-tree workload"));
+
+static cl::opt<unsigned>
+IncludeFanout("include-fanout", cl::init(2),
+              cl::desc("Files included by each file of the include tree"));
+
+static cl::opt<unsigned>
+NumPorts("ports", cl::init(1024),
+         cl::desc("Ports per module in the wide-ports workload"));
+
+static cl::opt<unsigned>
+DiagTransitions("diag-transitions", cl::init(100000),
+                cl::desc("Diagnostic state changes in the diag-states "
+                         "workload"));
+
+static cl::opt<unsigned>
+NetlistInstances("instances", cl::init(50000000),
+                 cl::desc("Cell instances in the netlist-db workload"));
+
+static cl::opt<unsigned>
+NumThreads("threads", cl::init(64),
+           cl::desc("Units parsed in parallel by the concurrent workload"));
+
+static cl::opt<unsigned>
+NumRequests("requests", cl::init(20),
+            cl::desc("Jobs run per phase by the daemon workload"));
+
+static cl::opt<std::string>
+BinDir("bin-dir",
+       cl::desc("Directory of the vlang, vlangd and vlangc the daemon workload "
+                "runs (default: that of vlang-bench)"),
+       cl::value_desc("dir"));
+
+static cl::opt<std::string>
+InputDir("dir", cl::init("vlang-bench.inputs"),
+         cl::desc("Directory the generated sources are written to"),
+         cl::value_desc("dir"));
+
+static cl::opt<std::string>
+OutputFilename("o", cl::init("-"),
+               cl::desc("Write the JSON results to <file>"),
+               cl::value_desc("file"));
+
+//===----------------------------------------------------------------------===//
+// Allocation counting.
+//===----------------------------------------------------------------------===//
+
+// Count every allocation made through operator new.  Memory the front end
+// carves out of BumpPtrAllocators is reported separately, as arena bytes.
+static std::atomic<uint64_t> NumAllocations(0);
+static std::atomic<uint64_t> NumAllocatedBytes(0);
+
+static void *countedAlloc(size_t Size) {
+  ++NumAllocations;
+  NumAllocatedBytes += Size;
+  if (void *P = std::malloc(Size ? Size : 1))
+    return P;
+  report_fatal_error("out of memory");
+}
+
+void *operator new(size_t Size) { return countedAlloc(Size); }
+void *operator new[](size_t Size) { return countedAlloc(Size); }
+void operator delete(void *P) throw() { std::free(P); }
+void operator delete[](void *P) throw() { std::free(P); }
+
+/// \brief Returns the peak resident set size of the process, in kilobytes.
+static uint64_t getPeakRSS() {
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage))
+    return 0;
+  return Usage.ru_maxrss;
+}
+
+//===----------------------------------------------------------------------===//
+// Results.
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief The measurements of one phase of one workload.
+struct BenchResult {
+  std::string Workload;
+  std::string Phase;
+  unsigned Units;
+  uint64_t Bytes;
+  uint64_t Tokens;       // Or operations, for the diag-states workload.
+  double Seconds;
+  uint64_t PeakRSS;      // In kilobytes, for the whole process so far.
+  uint64_t Allocations;
+  uint64_t AllocatedBytes;
+  uint64_t ArenaBytes;   // Preprocessor and SourceManager arenas.
+  uint64_t SLocEntries;
+  uint64_t ResultBytes;  // Size of the structure the phase built, if any.
+
+  BenchResult()
+    : Units(0), Bytes(0), Tokens(0), Seconds(0), PeakRSS(0), Allocations(0),
+      AllocatedBytes(0), ArenaBytes(0), SLocEntries(0), ResultBytes(0) {}
+};
+
+/// \brief Measures the wall time and allocations of one run of a phase.
+class PhaseTimer {
+  double StartTime;
+  uint64_t StartAllocations, StartBytes;
+
+public:
+  PhaseTimer()
+    : StartTime(TimeRecord::getCurrentTime(true).getWallTime()),
+      StartAllocations(NumAllocations), StartBytes(NumAllocatedBytes) {}
+
+  /// \brief Add the time and allocations since construction to \p R.
+  void addTo(BenchResult &R) const {
+    R.Seconds += TimeRecord::getCurrentTime(false).getWallTime() - StartTime;
+    R.Allocations += NumAllocations - StartAllocations;
+    R.AllocatedBytes += NumAllocatedBytes - StartBytes;
+  }
+};
+
+/// \brief The files making up one generated compilation unit.
+struct GeneratedUnit {
+  std::string MainFile;
+  /// \brief Every file the unit reads, the main file first.
+  std::vector<std::string> Files;
+  uint64_t Bytes;
+
+  GeneratedUnit() : Bytes(0) {}
+};
+
+} // end anonymous namespace
+
+static void printResults(raw_ostream &OS,
+                         const std::vector<BenchResult> &Results) {
+  OS << "{\n  \"schema\": 1,\n  \"config\": {\"size_mb\": " << SizeMB
+     << ", \"unit_size_mb\": " << UnitSizeMB
+     << ", \"iterations\": " << Iterations << "},\n  \"results\": [";
+  for (unsigned i = 0, e = Results.size(); i != e; ++i) {
+    const BenchResult &R = Results[i];
+    double MB = R.Bytes / (1024.0 * 1024.0);
+    double Secs = R.Seconds > 0 ? R.Seconds : 1e-9;
+    OS << (i ? ",\n" : "\n") << "    {\"workload\": \"" << R.Workload
+       << "\", \"phase\": \"" << R.Phase << "\", \"units\": " << R.Units
+       << ", \"bytes\": " << R.Bytes << ", \"tokens\": " << R.Tokens
+       << ", \"seconds\": " << format("%.6f", R.Seconds)
+       << ", \"mb_per_s\": " << format("%.2f", MB / Secs)
+       << ", \"tokens_per_s\": " << format("%.0f", R.Tokens / Secs)
+       << ", \"peak_rss_kb\": " << R.PeakRSS
+       << ", \"allocations\": " << R.Allocations
+       << ", \"allocated_bytes\": " << R.AllocatedBytes
+       << ", \"arena_bytes\": " << R.ArenaBytes
+       << ", \"sloc_entries\": " << R.SLocEntries
+       << ", \"result_bytes\": " << R.ResultBytes
+       << ", \"result_bytes_per_token\": "
+       << format("%.1f", R.Tokens ? (double)R.ResultBytes / R.Tokens : 0.0)
+       << "}";
+  }
+  OS << "\n  ]\n}\n";
+}
+
+//===----------------------------------------------------------------------===//
+// Front end setup.
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief A preprocessor, and everything it needs, for one unit.
+class CompilationUnit {
+public:
+  FileSystemOptions FileMgrOpts;
+  FileManager FileMgr;
+  DiagnosticsEngine Diags;
+  SourceManager SourceMgr;
+  LangOptions LangOpts;
+  IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts;
+  HeaderSearch HeaderInfo;
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts;
+  Preprocessor PP;
+
+  explicit CompilationUnit(StringRef IncludeDir)
+    : FileMgr(FileMgrOpts),
+      Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs()),
+            new DiagnosticOptions(), new IgnoringDiagConsumer()),
+      SourceMgr(Diags, FileMgr), HSOpts(new HeaderSearchOptions()),
+      HeaderInfo(HSOpts, FileMgr, Diags, LangOpts),
+      PPOpts(new PreprocessorOptions()),
+      PP(PPOpts, Diags, LangOpts, SourceMgr, HeaderInfo) {
+    HSOpts->AddPath(IncludeDir, frontend::Quoted, true);
+    InitializePreprocessor(PP, *PPOpts, *HSOpts);
+  }
+
+  /// \brief Make \p Path the main file and enter it.  Returns true on error.
+  bool enterMainFile(StringRef Path) {
+    const FileEntry *File = FileMgr.getFile(Path);
+    if (!File)
+      return true;
+    SourceMgr.createMainFileID(File);
+    PP.EnterMainSourceFile();
+    return false;
+  }
+
+  uint64_t getArenaBytes() const {
+    return PP.getTotalMemory() + SourceMgr.getContentCacheSize() +
+           SourceMgr.getDataStructureSizes();
+  }
+};
+
+/// \brief A preprocessor for one worker thread of a shared SourceManager.
+/// The thread must have called SourceManager::beginWorker with \p Diags.
+class WorkerUnit {
+public:
+  LangOptions LangOpts;
+  IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts;
+  HeaderSearch HeaderInfo;
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts;
+  Preprocessor PP;
+
+  WorkerUnit(DiagnosticsEngine &Diags, SourceManager &SourceMgr,
+             StringRef IncludeDir)
+    : HSOpts(new HeaderSearchOptions()),
+      HeaderInfo(HSOpts, SourceMgr.getFileManager(), Diags, LangOpts),
+      PPOpts(new PreprocessorOptions()),
+      PP(PPOpts, Diags, LangOpts, SourceMgr, HeaderInfo) {
+    HSOpts->AddPath(IncludeDir, frontend::Quoted, true);
+    InitializePreprocessor(PP, *PPOpts, *HSOpts);
+  }
+};
+
+} // end anonymous namespace
+
+/// \brief Keep \p Run in \p Best if it is the first or the fastest so far.
+static void keepFastest(BenchResult &Best, const BenchResult &Run,
+                        bool FirstRun) {
+  if (FirstRun || Run.Seconds < Best.Seconds)
+    Best = Run;
+}
+
+/// \brief Time the raw lexer over every file of every unit.
+static void benchLexer(const std::vector<GeneratedUnit> &Units,
+                       BenchResult &R) {
+  for (unsigned Iter = 0; Iter != Iterations; ++Iter) {
+    BenchResult Run;
+    for (unsigned u = 0, ue = Units.size(); u != ue; ++u) {
+      CompilationUnit CU(InputDir);
+      std::vector<FileID> FIDs;
+      for (unsigned f = 0, fe = Units[u].Files.size(); f != fe; ++f) {
+        const FileEntry *File = CU.FileMgr.getFile(Units[u].Files[f]);
+        if (!File)
+          report_fatal_error("cannot open '" + Units[u].Files[f] + "'");
+        FileID FID = CU.SourceMgr.createFileID(File, SourceLocation(),
+                                               SrcMgr::C_User);
+        // Read the file now, so that only lexing is timed.
+        CU.SourceMgr.getBuffer(FID);
+        FIDs.push_back(FID);
+      }
+
+      PhaseTimer Timer;
+      for (unsigned i = 0, e = FIDs.size(); i != e; ++i) {
+        Lexer L(FIDs[i], CU.SourceMgr.getBuffer(FIDs[i]), CU.SourceMgr,
+                CU.LangOpts);
+        Token Tok;
+        do {
+          L.LexFromRawLexer(Tok);
+          ++Run.Tokens;
+        } while (Tok.isNot(tok::eof));
+      }
+      Timer.addTo(Run);
+      Run.ArenaBytes += CU.getArenaBytes();
+      Run.SLocEntries += CU.SourceMgr.local_sloc_entry_size();
+    }
+    keepFastest(R, Run, Iter == 0);
+  }
+}
+
+/// \brief Time Preprocessor::Lex over each unit.
+static void benchPreprocessor(const std::vector<GeneratedUnit> &Units,
+                              BenchResult &R) {
+  for (unsigned Iter = 0; Iter != Iterations; ++Iter) {
+    BenchResult Run;
+    for (unsigned u = 0, ue = Units.size(); u != ue; ++u) {
+      CompilationUnit CU(InputDir);
+      PhaseTimer Timer;
+      if (CU.enterMainFile(Units[u].MainFile))
+        report_fatal_error("cannot open '" + Units[u].MainFile + "'");
+      Token Tok;
+      do {
+        CU.PP.Lex(Tok);
+        ++Run.Tokens;
+      } while (Tok.isNot(tok::eof));
+      Timer.addTo(Run);
+      Run.ArenaBytes += CU.getArenaBytes();
+      Run.SLocEntries += CU.SourceMgr.local_sloc_entry_size();
+    }
+    keepFastest(R, Run, Iter == 0);
+  }
+}
+
+/// \brief Time Parser::ParseTopLevelDecl over each unit.  The unit is
+/// preprocessed into a TokenBuffer first, so that only parsing is timed.
+/// With \p NetlistMode, simple instantiations are recorded in a
+/// NetlistTable.
+static void benchParser(const std::vector<GeneratedUnit> &Units,
+                        BenchResult &R, bool NetlistMode = false) {
+  for (unsigned Iter = 0; Iter != Iterations; ++Iter) {
+    BenchResult Run;
+    for (unsigned u = 0, ue = Units.size(); u != ue; ++u) {
+      CompilationUnit CU(InputDir);
+      if (CU.enterMainFile(Units[u].MainFile))
+        report_fatal_error("cannot open '" + Units[u].MainFile + "'");
+      Sema Actions(CU.PP, TU_Complete, 0);
+      Parser P(CU.PP, Actions, false);
+      TokenBuffer Toks;
+      Toks.lexAll(CU.PP);
+      P.setTokenBuffer(&Toks);
+      NetlistTable Netlist;
+      if (NetlistMode)
+        P.setNetlistTable(&Netlist);
+
+      PhaseTimer Timer;
+      P.Initialize();
+      while (!P.ParseTopLevelDecl()) {}
+      Timer.addTo(Run);
+      Run.Tokens += Toks.size();
+      Run.ArenaBytes += CU.getArenaBytes();
+      Run.SLocEntries += CU.SourceMgr.local_sloc_entry_size();
+    }
+    keepFastest(R, Run, Iter == 0);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Synthetic source generators.
+//===----------------------------------------------------------------------===//
+
+/// \brief A small deterministic generator, so that runs are comparable.
+static unsigned nextRandom(unsigned &State) {
+  State = State * 1103515245 + 12345;
+  return (State >> 8) & 0xFFFFFF;
+}
+
+static std::string getInputPath(const Twine &Name) {
+  SmallString<128> Path(InputDir);
+  sys::path::append(Path, Name);
+  return Path.str();
+}
+
+namespace {
+
+/// \brief Writes one generated file and records it in its unit.
+class SourceFile {
+  GeneratedUnit &Unit;
+  std::string ErrorInfo;
+
+public:
+  raw_fd_ostream OS;
+
+  SourceFile(GeneratedUnit &Unit, const std::string &Path)
+    : Unit(Unit), OS(Path.c_str(), ErrorInfo) {
+    if (!ErrorInfo.empty())
+      report_fatal_error("cannot write '" + Path + "': " + ErrorInfo);
+    if (Unit.Files.empty())
+      Unit.MainFile = Path;
+    Unit.Files.push_back(Path);
+  }
+
+  ~SourceFile() {
+    Unit.Bytes += OS.tell();
+  }
+};
+
+} // end anonymous namespace
+
+/// \brief Write modules of ordinary RTL until \p OS has grown by \p Bytes.
+static void writeRTLModules(raw_ostream &OS, StringRef Prefix,
+                            uint64_t Bytes) {
+  uint64_t End = OS.tell() + Bytes;
+  for (unsigned M = 0; OS.tell() < End; ++M) {
+    OS << "module " << Prefix << "_m" << M
+       << "(input logic clk, input logic [31:0] a, output logic [31:0] y);\n";
+    for (unsigned i = 0; i != 64 && OS.tell() < End; ++i) {
+      OS << "  logic [31:0] r" << i << ";\n"
+         << "  assign r" << i << " = a ^ 32'h" << format("%08x", i * 2654435761U)
+         << ";\n";
+    }
+    OS << "  always_ff @(posedge clk) y <= r0 + a;\n"
+       << "endmodule\n\n";
+  }
+}
+
+/// \brief A tree of guarded include files, -include-depth deep with
+/// -include-fanout children per file, all sharing a common header.
+static void generateIncludeTree(unsigned Index, uint64_t Bytes,
+                                GeneratedUnit &Unit) {
+  std::string Prefix = "itree" + utostr(Index);
+  unsigned Fanout = std::max(1U, (unsigned)IncludeFanout);
+  uint64_t NumFiles = 0;
+  for (uint64_t Level = 0, Width = 1; Level <= IncludeDepth;
+       ++Level, Width *= Fanout)
+    NumFiles += Width;
+  uint64_t FileBytes = Bytes / (NumFiles + 1);
+
+  {
+    SourceFile Main(Unit, getInputPath(Prefix + ".sv"));
+    Main.OS << "`include \"" << Prefix << "_0_0.svh\"\n\n";
+    writeRTLModules(Main.OS, Prefix + "_top", FileBytes);
+  }
+  {
+    SourceFile Common(Unit, getInputPath(Prefix + "_common.svh"));
+    Common.OS << "`ifndef " << Prefix << "_COMMON\n"
+              << "`define " << Prefix << "_COMMON\n"
+              << "`define " << Prefix << "_WIDTH 32\n"
+              << "`endif\n";
+  }
+
+  uint64_t Width = 1;
+  for (unsigned Level = 0; Level <= IncludeDepth; ++Level, Width *= Fanout)
+    for (uint64_t Idx = 0; Idx != Width; ++Idx) {
+      std::string Name = Prefix + "_" + utostr(Level) + "_" + utostr(Idx);
+      SourceFile File(Unit, getInputPath(Name + ".svh"));
+      File.OS << "`ifndef " << Name << "_SVH\n"
+              << "`define " << Name << "_SVH\n"
+              << "`include \"" << Prefix << "_common.svh\"\n\n";
+      writeRTLModules(File.OS, Name, FileBytes);
+      if (Level != IncludeDepth)
+        for (unsigned c = 0; c != Fanout; ++c)
+          File.OS << "`include \"" << Prefix << "_" << (Level + 1) << "_"
+                  << (Idx * Fanout + c) << ".svh\"\n";
+      File.OS << "`endif\n";
+    }
+}
+
+/// \brief Nested function-like macros in the style of UVM field and
+/// reporting macros, with conditional blocks around them.
+static void generateUVMMacros(unsigned Index, uint64_t Bytes,
+                              GeneratedUnit &Unit) {
+  std::string Prefix = "uvm" + utostr(Index);
+  SourceFile Main(Unit, getInputPath(Prefix + ".sv"));
+  raw_ostream &OS = Main.OS;
+  OS << "`define VB_WIDTH 32\n"
+     << "`define VB_ENABLE_INFO\n"
+     << "`define vb_field(NAME, W) logic [W-1:0] NAME;\n"
+     << "`define vb_assign(LHS, RHS) assign LHS = RHS;\n"
+     << "`define vb_xor(A, B) ((A) ^ (B))\n"
+     << "`define vb_info(ID, MSG) initial $display(\"%s: %s\", ID, MSG);\n"
+     << "`define vb_pipe(Q, D, W) \\\n"
+     << "  `vb_field(Q, W) \\\n"
+     << "  `vb_field(D, W) \\\n"
+     << "  `vb_assign(Q, `vb_xor(D, 32'h5a))\n\n";
+
+  uint64_t End = OS.tell() + Bytes;
+  for (unsigned M = 0; OS.tell() < End; ++M) {
+    OS << "module " << Prefix << "_m" << M << ";\n";
+    for (unsigned i = 0; i != 128 && OS.tell() < End; ++i) {
+      OS << "  `vb_pipe(q" << i << ", d" << i << ", `VB_WIDTH)\n";
+      if (i % 16 == 0)
+        OS << "`ifdef VB_ENABLE_INFO\n"
+           << "  `vb_info(\"" << Prefix << "_m" << M << "\", \"stage " << i
+           << "\")\n"
+           << "`else\n"
+           << "  `vb_assign(d" << i << ", q" << i << ")\n"
+           << "`endif\n";
+    }
+    OS << "endmodule\n\n";
+  }
+}
+
+/// \brief Tracing and checking macros that stringify their arguments on
+/// every line.  Each stringified argument is written to the scratch buffer
+/// of the preprocessor, which this workload fills with megabytes of text.
+static void generateStringifyMacros(unsigned Index, uint64_t Bytes,
+                                    GeneratedUnit &Unit) {
+  std::string Prefix = "str" + utostr(Index);
+  SourceFile Main(Unit, getInputPath(Prefix + ".sv"));
+  raw_ostream &OS = Main.OS;
+  OS << "`define vb_signal(NAME, W) \\\n"
+     << "  logic [W-1:0] NAME; \\\n"
+     << "  initial $display(\"%s = %h\", `NAME, NAME);\n"
+     << "`define vb_check(LHS, RHS) \\\n"
+     << "  initial $display(\"%s == %s: %b\", `LHS, `RHS, (LHS) == (RHS));\n"
+     << "`define vb_stage(NAME, W) \\\n"
+     << "  `vb_signal(NAME, W) \\\n"
+     << "  `vb_check(NAME, NAME)\n\n";
+
+  uint64_t End = OS.tell() + Bytes;
+  for (unsigned M = 0; OS.tell() < End; ++M) {
+    OS << "module " << Prefix << "_m" << M << ";\n";
+    for (unsigned i = 0; i != 128 && OS.tell() < End; ++i) {
+      OS << "  `vb_stage(" << Prefix << "_m" << M << "_s" << i << ", 8)\n";
+      if (i != 0)
+        OS << "  `vb_check(" << Prefix << "_m" << M << "_s" << i << ", "
+           << Prefix << "_m" << M << "_s" << (i - 1) << ")\n";
+    }
+    OS << "endmodule\n\n";
+  }
+}
+
+/// \brief Flat gate-level netlists: primitive gates and standard cell
+/// instances with named port connections.
+static void generateNetlist(unsigned Index, uint64_t Bytes,
+                            GeneratedUnit &Unit) {
+  std::string Prefix = "netlist" + utostr(Index);
+  SourceFile Main(Unit, getInputPath(Prefix + ".v"));
+  raw_ostream &OS = Main.OS;
+  unsigned Seed = Index + 1;
+  uint64_t End = OS.tell() + Bytes;
+  for (unsigned M = 0; OS.tell() < End; ++M) {
+    const unsigned NumCells = 4096;
+    OS << "module " << Prefix << "_m" << M
+       << " (input wire [63:0] pi, output wire [63:0] po);\n";
+    for (unsigned i = 0; i != NumCells; i += 16) {
+      OS << "  wire";
+      for (unsigned j = 0; j != 16; ++j)
+        OS << (j ? ", n" : " n") << (i + j);
+      OS << ";\n";
+    }
+    OS << "  assign n0 = pi[0];\n  assign n1 = pi[1];\n";
+    for (unsigned i = 2; i != NumCells && OS.tell() < End; ++i) {
+      unsigned A = nextRandom(Seed) % i, B = nextRandom(Seed) % i;
+      if (i % 3 == 0)
+        OS << "  nand g" << i << " (n" << i << ", n" << A << ", n" << B
+           << ");\n";
+      else
+        OS << "  NAND2X1 U" << i << " (.A(n" << A << "), .B(n" << B
+           << "), .Y(n" << i << "));\n";
+    }
+    OS << "  assign po = {64{n" << (NumCells - 1) << "}};\n"
+       << "endmodule\n\n";
+  }
+}
+
+/// \brief Modules with -ports ANSI ports each, and instances of them that
+/// connect every port by name.
+static void generateWidePorts(unsigned Index, uint64_t Bytes,
+                              GeneratedUnit &Unit) {
+  std::string Prefix = "wide" + utostr(Index);
+  SourceFile Main(Unit, getInputPath(Prefix + ".sv"));
+  raw_ostream &OS = Main.OS;
+  unsigned Ports = std::max(2U, (unsigned)NumPorts) / 2;
+  uint64_t End = OS.tell() + Bytes;
+  for (unsigned M = 0; OS.tell() < End; ++M) {
+    OS << "module " << Prefix << "_m" << M << " (\n";
+    for (unsigned i = 0; i != Ports; ++i)
+      OS << "  input logic [7:0] i" << i << ",\n";
+    for (unsigned i = 0; i != Ports; ++i)
+      OS << "  output logic [7:0] o" << i << (i + 1 == Ports ? "\n" : ",\n");
+    OS << ");\n";
+    for (unsigned i = 0; i != Ports; ++i)
+      OS << "  assign o" << i << " = i" << i << ";\n";
+    OS << "endmodule\n\n";
+
+    OS << "module " << Prefix << "_top" << M << ";\n";
+    for (unsigned i = 0; i != Ports; ++i)
+      OS << "  logic [7:0] s" << i << ";\n";
+    OS << "  " << Prefix << "_m" << M << " u0 (\n";
+    for (unsigned i = 0; i != Ports; ++i)
+      OS << "    .i" << i << "(s" << i << "),\n";
+    for (unsigned i = 0; i != Ports; ++i)
+      OS << "    .o" << i << "(s" << (Ports - 1 - i) << ")"
+         << (i + 1 == Ports ? "\n" : ",\n");
+    OS << "  );\nendmodule\n\n";
+  }
+}
+
+/// \brief Parameterized modules built from generate loops.
+static void generateLoops(unsigned Index, uint64_t Bytes,
+                          GeneratedUnit &Unit) {
+  std::string Prefix = "gen" + utostr(Index);
+  SourceFile Main(Unit, getInputPath(Prefix + ".sv"));
+  raw_ostream &OS = Main.OS;
+  uint64_t End = OS.tell() + Bytes;
+  for (unsigned M = 0; OS.tell() < End; ++M) {
+    OS << "module " << Prefix << "_m" << M
+       << " #(parameter N = 8) (input logic [N-1:0] a, "
+          "output logic [N-1:0] y);\n"
+       << "  genvar i;\n";
+    for (unsigned j = 0; j != 32 && OS.tell() < End; ++j)
+      OS << "  generate\n"
+         << "    for (i = 0; i < N; i = i + 1) begin : g" << j << "\n"
+         << "      assign y[i] = a[i] ^ a[(i + " << j << ") % N];\n"
+         << "    end\n"
+         << "  endgenerate\n";
+    OS << "endmodule\n\n";
+  }
+}
+
+typedef void (*GeneratorFn)(unsigned Index, uint64_t Bytes,
+                            GeneratedUnit &Unit);
+
+/// \brief Generate -size megabytes of source with \p Generate, split into
+/// units of at most -unit-size megabytes.
+static void generateUnits(GeneratorFn Generate, uint64_t TotalBytes,
+                          std::vector<GeneratedUnit> &Units) {
+  uint64_t UnitBytes = (uint64_t)std::max(1U, (unsigned)UnitSizeMB) << 20;
+  uint64_t NumUnits = std::max<uint64_t>(1, (TotalBytes + UnitBytes - 1) /
+                                                UnitBytes);
+  Units.resize(NumUnits);
+  for (unsigned i = 0; i != NumUnits; ++i)
+    Generate(i, TotalBytes / NumUnits, Units[i]);
+}
+
+//===----------------------------------------------------------------------===//
+// Workloads.
+//===----------------------------------------------------------------------===//
+
+static void addResult(std::vector<BenchResult> &Results, BenchResult R,
+                      StringRef Workload, StringRef Phase,
+                      const std::vector<GeneratedUnit> &Units) {
+  R.Workload = Workload;
+  R.Phase = Phase;
+  R.Units = Units.size();
+  for (unsigned i = 0, e = Units.size(); i != e; ++i)
+    R.Bytes += Units[i].Bytes;
+  R.PeakRSS = getPeakRSS();
+  Results.push_back(R);
+}
+
+static void runSourceWorkload(StringRef Name, GeneratorFn Generate,
+                              std::vector<BenchResult> &Results,
+                              bool NetlistMode = false) {
+  std::vector<GeneratedUnit> Units;
+  generateUnits(Generate, (uint64_t)SizeMB << 20, Units);
+
+  BenchResult Lex, PP, Parse;
+  benchLexer(Units, Lex);
+  addResult(Results, Lex, Name, "lex", Units);
+  benchPreprocessor(Units, PP);
+  addResult(Results, PP, Name, "preprocess", Units);
+  benchParser(Units, Parse);
+  addResult(Results, Parse, Name, "parse", Units);
+  if (NetlistMode) {
+    BenchResult NetlistParse;
+    benchParser(Units, NetlistParse, true);
+    addResult(Results, NetlistParse, Name, "parse-netlist-mode", Units);
+  }
+}
+
+/// \brief Set the mapping of a warning at -diag-transitions increasing
+/// locations, then look it up in order and at random.
+static void runDiagStates(std::vector<BenchResult> &Results) {
+  std::string Text;
+  raw_string_ostream TextOS(Text);
+  for (unsigned i = 0; i != DiagTransitions; ++i)
+    TextOS << "wire w" << i << ";\n";
+  TextOS.flush();
+
+  std::vector<GeneratedUnit> Units(1);
+  Units[0].Bytes = Text.size();
+
+  BenchResult Map, Lookup, RandomLookup;
+  for (unsigned Iter = 0; Iter != Iterations; ++Iter) {
+    CompilationUnit CU(InputDir);
+    FileID FID = CU.SourceMgr.createMainFileIDForMemBuffer(
+      MemoryBuffer::getMemBufferCopy(Text, "diag-states.sv"));
+    SourceLocation Start = CU.SourceMgr.getLocForStartOfFile(FID);
+    std::vector<SourceLocation> Locs;
+    for (size_t Pos = 0; Pos < Text.size(); Pos = Text.find('\n', Pos) + 1)
+      Locs.push_back(Start.getLocWithOffset(Pos));
+
+    BenchResult MapRun, LookupRun, RandomRun;
+    MapRun.Tokens = LookupRun.Tokens = RandomRun.Tokens = Locs.size();
+
+    PhaseTimer MapTimer;
+    for (unsigned i = 0, e = Locs.size(); i != e; ++i)
+      CU.Diags.setDiagnosticMapping(diag::warn_nested_block_comment,
+                                    i % 2 ? diag::MAP_IGNORE
+                                          : diag::MAP_WARNING,
+                                    Locs[i]);
+    MapTimer.addTo(MapRun);
+
+    unsigned NumIgnored = 0;
+    PhaseTimer LookupTimer;
+    for (unsigned i = 0, e = Locs.size(); i != e; ++i)
+      NumIgnored += CU.Diags.getDiagnosticLevel(
+        diag::warn_nested_block_comment, Locs[i]) == DiagnosticsEngine::Ignored;
+    LookupTimer.addTo(LookupRun);
+
+    unsigned Seed = 1;
+    PhaseTimer RandomTimer;
+    for (unsigned i = 0, e = Locs.size(); i != e; ++i)
+      NumIgnored += CU.Diags.getDiagnosticLevel(
+        diag::warn_nested_block_comment,
+        Locs[nextRandom(Seed) % e]) == DiagnosticsEngine::Ignored;
+    RandomTimer.addTo(RandomRun);
+    (void)NumIgnored;
+
+    keepFastest(Map, MapRun, Iter == 0);
+    keepFastest(Lookup, LookupRun, Iter == 0);
+    keepFastest(RandomLookup, RandomRun, Iter == 0);
+  }
+  addResult(Results, Map, "diag-states", "map", Units);
+  addResult(Results, Lookup, "diag-states", "lookup", Units);
+  addResult(Results, RandomLookup, "diag-states", "lookup-random", Units);
+}
+
+/// \brief Compare every column of two databases through their accessors.
+/// Returns the name of the first column that differs, or null.
+static const char *findDatabaseMismatch(const NetlistDatabase &A,
+                                        const NetlistDatabase &B) {
+  if (A.getNumNames() != B.getNumNames())
+    return "names";
+  for (unsigned i = 0, e = A.getNumNames(); i != e; ++i)
+    if (A.getName(i) != B.getName(i))
+      return "names";
+
+  if (A.getNumFiles() != B.getNumFiles())
+    return "files";
+  for (unsigned F = 0, e = A.getNumFiles(); F != e; ++F)
+    if (A.getFileName(F) != B.getFileName(F))
+      return "files";
+
+  if (A.getNumModules() != B.getNumModules())
+    return "modules";
+  unsigned NumPorts = 0;
+  for (unsigned M = 0, e = A.getNumModules(); M != e; ++M) {
+    if (A.getModuleName(M) != B.getModuleName(M))
+      return "module names";
+    if (A.getModuleInstances(M) != B.getModuleInstances(M) ||
+        A.getModuleNets(M) != B.getModuleNets(M) ||
+        A.getModulePorts(M) != B.getModulePorts(M) ||
+        A.getModulePortPins(M) != B.getModulePortPins(M))
+      return "module rows";
+    NumPorts = A.getModulePorts(M).second;
+  }
+  for (unsigned P = 0; P != NumPorts; ++P)
+    if (A.getPortName(P) != B.getPortName(P) ||
+        A.getPortKind(P) != B.getPortKind(P) ||
+        A.getPortNet(P) != B.getPortNet(P))
+      return "ports";
+
+  if (A.getNumInstances() != B.getNumInstances())
+    return "instances";
+  for (unsigned I = 0, e = A.getNumInstances(); I != e; ++I) {
+    if (A.getInstanceName(I) != B.getInstanceName(I) ||
+        A.getInstanceCell(I) != B.getInstanceCell(I) ||
+        A.getInstanceTemplate(I) != B.getInstanceTemplate(I))
+      return "instances";
+    if (A.getInstanceFile(I) != B.getInstanceFile(I) ||
+        A.getInstanceOffset(I) != B.getInstanceOffset(I))
+      return "instance locations";
+    if (A.getInstancePins(I) != B.getInstancePins(I))
+      return "instance rows";
+  }
+
+  if (A.getNumPins() != B.getNumPins())
+    return "pins";
+  for (unsigned P = 0, e = A.getNumPins(); P != e; ++P) {
+    unsigned PositionA = 0, PositionB = 0;
+    if (A.getPinNet(P) != B.getPinNet(P) ||
+        A.getPinInstance(P) != B.getPinInstance(P) ||
+        A.getPinName(P) != B.getPinName(P) ||
+        A.getPinPosition(P, PositionA) != B.getPinPosition(P, PositionB) ||
+        PositionA != PositionB)
+      return "pins";
+    if (A.getPinRole(P) != B.getPinRole(P))
+      return "pin roles";
+  }
+
+  if (A.getNumNets() != B.getNumNets())
+    return "nets";
+  for (unsigned N = 0, e = A.getNumNets(); N != e; ++N) {
+    if (A.getNetModule(N) != B.getNetModule(N) ||
+        A.getNetName(N) != B.getNetName(N) ||
+        A.getNetBit(N) != B.getNetBit(N))
+      return "nets";
+    if (A.getNetPins(N) != B.getNetPins(N))
+      return "net rows";
+  }
+  return 0;
+}
+
+/// \brief Record a flat netlist of -instances two-input cells, in modules of
+/// 4096 cells, into a NetlistTable the way the parser does in netlist mode,
+/// build a NetlistDatabase from it, and find the fanout of every instance.
+/// The database written and loaded back must equal the built one.
+/// The netlist is made in memory, since source text for this many
+/// instances would not fit a compilation unit.  A token is an instance.
+static void runNetlistDatabase(std::vector<BenchResult> &Results) {
+  const unsigned CellsPerModule = 4096;
+  CellLibrary Library;
+  Library.addPin("NAND2X1", "A", PortKind::Input);
+  Library.addPin("NAND2X1", "B", PortKind::Input);
+  Library.addPin("NAND2X1", "Y", PortKind::Output);
+  std::vector<GeneratedUnit> Units;
+  std::string Path = getInputPath("netlist-db.vnl");
+
+  BenchResult Record, Build, Fanout, Write, Load;
+  for (unsigned Iter = 0; Iter != Iterations; ++Iter) {
+    BenchResult RecordRun, BuildRun, FanoutRun, WriteRun, LoadRun;
+    NetlistTable Table;
+
+    PhaseTimer RecordTimer;
+    unsigned Cell = Table.getNameID("NAND2X1");
+    unsigned PinA = Table.getNameID("A"), PinB = Table.getNameID("B"),
+             PinY = Table.getNameID("Y"), Input = Table.getNameID("pi");
+    std::vector<unsigned> InstanceNames(CellsPerModule);
+    std::vector<unsigned> NetNames(CellsPerModule);
+    for (unsigned i = 0; i != CellsPerModule; ++i) {
+      InstanceNames[i] = Table.getNameID("U" + utostr(i));
+      NetNames[i] = Table.getNameID("n" + utostr(i));
+    }
+    unsigned Seed = 1;
+    for (unsigned M = 0, Done = 0; Done < NetlistInstances; ++M) {
+      Table.beginModule("blk" + utostr(M));
+      Table.addPort("pi", PortKind::Input);
+      Table.addPort("po", PortKind::Output);
+      for (unsigned i = 0; i != CellsPerModule && Done < NetlistInstances;
+           ++i, ++Done) {
+        Table.addInstance(Cell, InstanceNames[i], SourceLocation());
+        for (unsigned Pin = 0; Pin != 2; ++Pin) {
+          unsigned Net = i < 2 ? Table.getNetID(Input, 2 * i + Pin)
+                               : Table.getNetID(
+                                   NetNames[nextRandom(Seed) % i],
+                                   NetlistTable::NoBit);
+          Table.addConnection(Pin ? PinB : PinA, Net);
+        }
+        Table.addConnection(PinY, Table.getNetID(NetNames[i],
+                                                 NetlistTable::NoBit));
+      }
+    }
+    RecordTimer.addTo(RecordRun);
+    RecordRun.ResultBytes = Table.getMemorySize();
+
+    PhaseTimer BuildTimer;
+    OwningPtr<NetlistDatabase> DB(NetlistDatabase::build(Table, &Library));
+    BuildTimer.addTo(BuildRun);
+    BuildRun.ResultBytes = DB->getMemorySize();
+
+    uint64_t NumEdges = 0;
+    SmallVector<unsigned, 16> Fanouts;
+    PhaseTimer FanoutTimer;
+    for (unsigned I = 0, e = DB->getNumInstances(); I != e; ++I) {
+      Fanouts.clear();
+      DB->getFanoutInstances(I, Fanouts);
+      NumEdges += Fanouts.size();
+    }
+    FanoutTimer.addTo(FanoutRun);
+
+    std::string ErrorStr;
+    PhaseTimer WriteTimer;
+    if (DB->writeToFile(Path, ErrorStr))
+      report_fatal_error("cannot write '" + Path + "': " + ErrorStr);
+    WriteTimer.addTo(WriteRun);
+
+    // Loading maps the file; touch every pin so that the pages are read.
+    PhaseTimer LoadTimer;
+    OwningPtr<NetlistDatabase> Loaded(
+      NetlistDatabase::loadFromFile(Path, ErrorStr));
+    if (!Loaded)
+      report_fatal_error("cannot load '" + Path + "': " + ErrorStr);
+    for (unsigned P = 0, e = Loaded->getNumPins(); P != e; ++P)
+      NumEdges += Loaded->getPinNet(P);
+    LoadTimer.addTo(LoadRun);
+    (void)NumEdges;
+
+    // Outside the timed phases: a fast load of the wrong data is no result.
+    if (const char *Column = findDatabaseMismatch(*DB, *Loaded))
+      report_fatal_error("'" + Path + "' loads with different " +
+                         std::string(Column) + " than were written");
+    LoadRun.ResultBytes = WriteRun.ResultBytes = Loaded->getMemorySize();
+
+    RecordRun.Tokens = BuildRun.Tokens = FanoutRun.Tokens = WriteRun.Tokens =
+      LoadRun.Tokens = DB->getNumInstances();
+    keepFastest(Record, RecordRun, Iter == 0);
+    keepFastest(Build, BuildRun, Iter == 0);
+    keepFastest(Fanout, FanoutRun, Iter == 0);
+    keepFastest(Write, WriteRun, Iter == 0);
+    keepFastest(Load, LoadRun, Iter == 0);
+  }
+  addResult(Results, Record, "netlist-db", "record", Units);
+  addResult(Results, Build, "netlist-db", "build", Units);
+  addResult(Results, Fanout, "netlist-db", "fanout", Units);
+  addResult(Results, Write, "netlist-db", "write", Units);
+  addResult(Results, Load, "netlist-db", "load", Units);
+}
+
+/// \brief Preprocess and parse -threads netlist units at once, one thread
+/// per unit, all of them sharing one FileManager and one SourceManager.  The
+/// locations each thread created are then checked from the main thread.
+static void runConcurrent(std::vector<BenchResult> &Results) {
+  unsigned Threads = std::max(1U, (unsigned)NumThreads);
+  uint64_t TotalBytes = (uint64_t)SizeMB << 20;
+  std::vector<GeneratedUnit> Units(Threads);
+  for (unsigned i = 0; i != Threads; ++i)
+    generateNetlist(i, TotalBytes / Threads, Units[i]);
+
+  BenchResult R;
+  for (unsigned Iter = 0; Iter != Iterations; ++Iter) {
+    FileSystemOptions FileMgrOpts;
+    FileManager FileMgr(FileMgrOpts);
+    DiagnosticsEngine Diags(IntrusiveRefCntPtr<DiagnosticIDs>(
+                              new DiagnosticIDs()),
+                            new DiagnosticOptions(),
+                            new IgnoringDiagConsumer());
+    SourceManager SourceMgr(Diags, FileMgr);
+    if (SourceMgr.enableWorkers(Threads))
+      report_fatal_error("cannot share a source manager between " +
+                         Twine(Threads) + " threads");
+
+    std::vector<uint64_t> NumTokens(Threads), SLocEntries(Threads);
+    std::vector<const FileEntry *> MainFiles(Threads);
+    std::vector<FileID> MainFIDs(Threads);
+    std::vector<std::thread> Workers;
+
+    BenchResult Run;
+    PhaseTimer Timer;
+    for (unsigned i = 0; i != Threads; ++i)
+      Workers.push_back(std::thread([&, i]() {
+        DiagnosticsEngine WorkerDiags(IntrusiveRefCntPtr<DiagnosticIDs>(
+                                        new DiagnosticIDs()),
+                                      new DiagnosticOptions(),
+                                      new IgnoringDiagConsumer());
+        if (SourceMgr.beginWorker(WorkerDiags))
+          report_fatal_error("no partition left for a worker");
+        {
+          WorkerUnit WU(WorkerDiags, SourceMgr, InputDir);
+          MainFiles[i] = FileMgr.getFile(Units[i].MainFile);
+          if (!MainFiles[i])
+            report_fatal_error("cannot open '" + Units[i].MainFile + "'");
+          MainFIDs[i] = SourceMgr.createMainFileID(MainFiles[i]);
+          WU.PP.EnterMainSourceFile();
+          Sema Actions(WU.PP, TU_Complete, 0);
+          Parser P(WU.PP, Actions, false);
+          TokenBuffer Toks;
+          Toks.lexAll(WU.PP);
+          P.setTokenBuffer(&Toks);
+          P.Initialize();
+          while (!P.ParseTopLevelDecl()) {}
+          NumTokens[i] = Toks.size();
+          SLocEntries[i] = SourceMgr.local_sloc_entry_size();
+        }
+        SourceMgr.endWorker();
+      }));
+    for (unsigned i = 0; i != Threads; ++i)
+      Workers[i].join();
+    Timer.addTo(Run);
+
+    // Outside the timed phase: every thread's locations must resolve from
+    // this one to the file that thread read.
+    for (unsigned i = 0; i != Threads; ++i) {
+      SourceLocation Start = SourceMgr.getLocForStartOfFile(MainFIDs[i]);
+      SourceLocation End = SourceMgr.getLocForEndOfFile(MainFIDs[i]);
+      if (SourceMgr.getFileEntryForID(MainFIDs[i]) != MainFiles[i] ||
+          SourceMgr.getFileID(Start) != MainFIDs[i] ||
+          SourceMgr.getFileID(End) != MainFIDs[i])
+        report_fatal_error("the locations of '" + Units[i].MainFile +
+                           "' do not resolve to it after the workers ended");
+      Run.Tokens += NumTokens[i];
+      Run.SLocEntries += SLocEntries[i];
+    }
+    keepFastest(R, Run, Iter == 0);
+  }
+  addResult(Results, R, "concurrent", "preprocess+parse", Units);
+}
+
+static std::string getToolPath(StringRef Name) {
+  if (BinDir.empty())
+    return Name.str();
+  SmallString<128> Path(BinDir);
+  sys::path::append(Path, Name);
+  return Path.str();
+}
+
+/// \brief Start \p Program, found through the PATH if it has no directory,
+/// with \p Args and its output discarded.  Returns its pid, or -1.
+static pid_t startProcess(const std::string &Program,
+                          const std::vector<std::string> &Args) {
+  std::vector<char *> Argv;
+  Argv.push_back(const_cast<char *>(Program.c_str()));
+  for (unsigned i = 0, e = Args.size(); i != e; ++i)
+    Argv.push_back(const_cast<char *>(Args[i].c_str()));
+  Argv.push_back(0);
+
+  posix_spawn_file_actions_t Actions;
+  posix_spawn_file_actions_init(&Actions);
+  posix_spawn_file_actions_addopen(&Actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&Actions, STDERR_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  pid_t Pid;
+  int Error = posix_spawnp(&Pid, Program.c_str(), &Actions, 0, &Argv[0],
+                           environ);
+  posix_spawn_file_actions_destroy(&Actions);
+  return Error ? -1 : Pid;
+}
+
+/// \brief Wait for \p Pid to exit.  Returns its exit status, or -1 if it
+/// was killed.
+static int waitForProcess(pid_t Pid) {
+  int Status;
+  while (waitpid(Pid, &Status, 0) < 0)
+    if (errno != EINTR)
+      return -1;
+  return WIFEXITED(Status) ? WEXITSTATUS(Status) : -1;
+}
+
+/// \brief Run \p Program on \p Args -requests times, adding the median
+/// latency to \p R.
+static void timeJobs(const std::string &Program,
+                     const std::vector<std::string> &Args, BenchResult &R) {
+  std::vector<double> Latencies;
+  for (unsigned i = 0, e = std::max(1U, (unsigned)NumRequests); i != e; ++i) {
+    BenchResult Run;
+    PhaseTimer Timer;
+    pid_t Pid = startProcess(Program, Args);
+    if (Pid < 0 || waitForProcess(Pid) != 0)
+      report_fatal_error("'" + Program + "' failed");
+    Timer.addTo(Run);
+    Latencies.push_back(Run.Seconds);
+  }
+  std::sort(Latencies.begin(), Latencies.end());
+  R.Seconds = Latencies[Latencies.size() / 2];
+}
+
+/// \brief Parse an include tree of -size megabytes, with vlang started anew
+/// for every job, and with jobs sent through vlangc to a vlangd started for
+/// the workload.  The seconds reported are those of the median job; the
+/// first job the server runs, on its cold caches, is reported on its own.
+static void runDaemon(std::vector<BenchResult> &Results) {
+  std::vector<GeneratedUnit> Units;
+  generateUnits(generateIncludeTree, (uint64_t)SizeMB << 20, Units);
+  std::vector<std::string> Args;
+  Args.push_back("-I");
+  Args.push_back(InputDir);
+  for (unsigned i = 0, e = Units.size(); i != e; ++i)
+    Args.push_back(Units[i].MainFile);
+
+  BenchResult Cold;
+  timeJobs(getToolPath("vlang"), Args, Cold);
+  addResult(Results, Cold, "daemon", "cold-process", Units);
+
+  // The client must not quietly run vlang itself when it cannot reach the
+  // server.
+  std::string Socket = getInputPath("vlangd.sock");
+  ::unlink(Socket.c_str());
+  ::setenv("VLANGD_SOCKET", Socket.c_str(), 1);
+  ::setenv("VLANGC_NO_FALLBACK", "1", 1);
+
+  std::vector<std::string> DaemonArgs;
+  DaemonArgs.push_back("-socket");
+  DaemonArgs.push_back(Socket);
+  pid_t Daemon = startProcess(getToolPath("vlangd"), DaemonArgs);
+  if (Daemon < 0)
+    report_fatal_error("cannot start '" + getToolPath("vlangd") + "'");
+
+  // The server renames its socket into place once it accepts connections.
+  struct stat Status;
+  for (unsigned Waited = 0; ::stat(Socket.c_str(), &Status) != 0; ++Waited) {
+    int ExitStatus;
+    if (Waited == 1000 || waitpid(Daemon, &ExitStatus, WNOHANG) == Daemon)
+      report_fatal_error("vlangd did not start listening on '" + Socket + "'");
+    usleep(10000);
+  }
+
+  std::string Client = getToolPath("vlangc");
+  BenchResult First, Warm;
+  {
+    PhaseTimer Timer;
+    pid_t Pid = startProcess(Client, Args);
+    if (Pid < 0 || waitForProcess(Pid) != 0)
+      report_fatal_error("'" + Client + "' failed");
+    Timer.addTo(First);
+  }
+  addResult(Results, First, "daemon", "first-request", Units);
+  timeJobs(Client, Args, Warm);
+  addResult(Results, Warm, "daemon", "warm-request", Units);
+
+  ::kill(Daemon, SIGTERM);
+  waitForProcess(Daemon);
+  ::unsetenv("VLANGC_NO_FALLBACK");
+}
+
+//===----------------------------------------------------------------------===//
+// Main driver code.
+//===----------------------------------------------------------------------===//
+
+int main(int argc, char *argv[]) {
+  cl::ParseCommandLineOptions(argc, argv, " Vlang front end benchmarks\n");
+
+  if (Workloads.empty()) {
+    const char *All[] = { "include-tree", "uvm-macros", "macro-stringify",
+                          "netlist", "wide-ports", "generate",
+                          "diag-states", "concurrent" };
+    Workloads.insert(Workloads.end(), All, All + 8);
+  }
+  if (Iterations == 0)
+    Iterations = 1;
+  if (BinDir.empty())
+    BinDir = sys::path::parent_path(argv[0]).str();
+
+  bool Existed;
+  if (error_code EC = sys::fs::create_directories(InputDir, Existed)) {
+    errs() << "error: cannot create '" << InputDir << "': " << EC.message()
+           << "\n";
+    return 1;
+  }
+
+  std::vector<BenchResult> Results;
+  for (unsigned i = 0, e = Workloads.size(); i != e; ++i) {
+    StringRef Name = Workloads[i];
+    if (Name == "include-tree")
+      runSourceWorkload(Name, generateIncludeTree, Results);
+    else if (Name == "uvm-macros")
+      runSourceWorkload(Name, generateUVMMacros, Results);
+    else if (Name == "macro-stringify")
+      runSourceWorkload(Name, generateStringifyMacros, Results);
+    else if (Name == "netlist")
+      runSourceWorkload(Name, generateNetlist, Results, true);
+    else if (Name == "wide-ports")
+      runSourceWorkload(Name, generateWidePorts, Results);
+    else if (Name == "generate")
+      runSourceWorkload(Name, generateLoops, Results);
+    else if (Name == "diag-states")
+      runDiagStates(Results);
+    else if (Name == "concurrent")
+      runConcurrent(Results);
+    else if (Name == "netlist-db")
+      runNetlistDatabase(Results);
+    else if (Name == "daemon")
+      runDaemon(Results);
+    else {
+      errs() << "error: unknown workload '" << Name << "'\n";
+      return 1;
+    }
+  }
+
+  std::string ErrorInfo;
+  raw_fd_ostream OS(OutputFilename.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << "error: cannot write '" << OutputFilename << "': " << ErrorInfo
+           << "\n";
+    return 1;
+  }
+  printResults(OS, Results);
+  return 0;
+}
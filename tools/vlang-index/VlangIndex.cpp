@@ -0,0 +1,183 @@
+//===--- VlangIndex.cpp - Build and query design symbol indexes ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// vlang-index builds a symbol index of a design and answers queries on it.
+//
+//   vlang-index -o design.idx -Irtl/include rtl/*.sv   build or update
+//   vlang-index -o design.idx -find fifo               find occurrences
+//
+// Each input file is a compilation unit.  When the index already exists it
+// is updated: units none of whose files changed are kept, and only the
+// others are preprocessed and scanned again.  Units of the old index that
+// are not given again are dropped.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Index/SymbolIndex.h"
+#include "vlang/Lex/HeaderSearchOptions.h"
+#include "vlang/Lex/PreprocessorOptions.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+using namespace llvm;
+using namespace vlang;
+using namespace vlang::index;
+
+static cl::list<std::string>
+InputFiles(cl::Positional, cl::ZeroOrMore,
+           cl::desc("<compilation units>"));
+
+static cl::opt<std::string>
+IndexFile("o", cl::Required, cl::desc("The index to build or query"),
+          cl::value_desc("index"));
+
+static cl::list<std::string>
+IncludePaths("I", cl::Prefix, cl::ZeroOrMore,
+             cl::desc("Add <dir> to the `include search path"),
+             cl::value_desc("dir"));
+
+static cl::list<std::string>
+MacroDefs("D", cl::Prefix, cl::ZeroOrMore,
+          cl::desc("Define <macro> (or <macro>=<value>) in every unit"),
+          cl::value_desc("macro"));
+
+static cl::opt<std::string>
+FindName("find", cl::desc("Print the occurrences of the symbols named <name>"),
+         cl::value_desc("name"));
+
+static cl::opt<std::string>
+FindKind("kind", cl::desc("Only find symbols of kind <kind> "
+                          "(module, port, macro, ...)"),
+         cl::value_desc("kind"));
+
+static cl::opt<std::string>
+FindRole("role", cl::desc("Only find occurrences with role <role> "
+                          "(definition, reference or instantiation)"),
+         cl::value_desc("role"));
+
+static cl::opt<bool>
+PrintStats("stats", cl::desc("Print what was reindexed and how long it took"));
+
+static double getWallTime() {
+  return TimeRecord::getCurrentTime(false).getWallTime();
+}
+
+/// \brief Build the index, or bring it up to date.  Returns true on error.
+static bool buildIndex() {
+  double Start = getWallTime();
+
+  IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts(new HeaderSearchOptions());
+  for (unsigned i = 0, e = IncludePaths.size(); i != e; ++i)
+    HSOpts->AddPath(IncludePaths[i], frontend::Quoted, true);
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts(new PreprocessorOptions());
+  for (unsigned i = 0, e = MacroDefs.size(); i != e; ++i)
+    PPOpts->addMacroDef(MacroDefs[i]);
+
+  IndexBuilder Builder(HSOpts, PPOpts);
+  bool Exists = false;
+  if (!sys::fs::exists(IndexFile, Exists) && Exists) {
+    std::string ErrorStr;
+    OwningPtr<SymbolIndex> Old(SymbolIndex::loadFromFile(IndexFile, ErrorStr));
+    if (Old)
+      Builder.loadFrom(*Old);
+    else
+      errs() << "vlang-index: rebuilding '" << IndexFile << "': " << ErrorStr
+             << "\n";
+  }
+
+  bool HadError = false;
+  for (unsigned i = 0, e = InputFiles.size(); i != e; ++i) {
+    std::string ErrorStr;
+    if (Builder.addUnit(InputFiles[i], ErrorStr)) {
+      errs() << "vlang-index: " << ErrorStr << "\n";
+      HadError = true;
+    }
+  }
+
+  std::string ErrorStr;
+  if (Builder.writeToFile(IndexFile, ErrorStr)) {
+    errs() << "vlang-index: cannot write '" << IndexFile << "': " << ErrorStr
+           << "\n";
+    return true;
+  }
+
+  if (PrintStats)
+    errs() << Builder.getNumUnitsIndexed() << " units indexed, "
+           << Builder.getNumUnitsReused() << " reused in "
+           << format("%.1f", (getWallTime() - Start) * 1000) << " ms\n";
+  return HadError;
+}
+
+/// \brief Print the occurrences of FindName.  Returns true on error.
+static bool queryIndex() {
+  SymbolKind Kind = NumSymbolKinds;
+  if (!FindKind.empty()) {
+    unsigned K = 0;
+    while (K != NumSymbolKinds && FindKind != getSymbolKindName(SymbolKind(K)))
+      ++K;
+    if (K == NumSymbolKinds) {
+      errs() << "vlang-index: unknown symbol kind '" << FindKind << "'\n";
+      return true;
+    }
+    Kind = SymbolKind(K);
+  }
+  SymbolRole Role = NumSymbolRoles;
+  if (!FindRole.empty()) {
+    unsigned R = 0;
+    while (R != NumSymbolRoles && FindRole != getSymbolRoleName(SymbolRole(R)))
+      ++R;
+    if (R == NumSymbolRoles) {
+      errs() << "vlang-index: unknown role '" << FindRole << "'\n";
+      return true;
+    }
+    Role = SymbolRole(R);
+  }
+
+  double Start = getWallTime();
+  std::string ErrorStr;
+  OwningPtr<SymbolIndex> Index(SymbolIndex::loadFromFile(IndexFile, ErrorStr));
+  if (!Index) {
+    errs() << "vlang-index: cannot load '" << IndexFile << "': " << ErrorStr
+           << "\n";
+    return true;
+  }
+  std::vector<SymbolOccurrence> Found;
+  Index->findOccurrences(FindName, Found, Kind, Role);
+  double Elapsed = getWallTime() - Start;
+
+  for (unsigned i = 0, e = Found.size(); i != e; ++i) {
+    const SymbolOccurrence &Occ = Found[i];
+    outs() << Index->getFilePath(Occ.File) << ':' << Occ.Line << ':'
+           << Occ.Column << ": " << getSymbolRoleName(Occ.Role) << ' '
+           << getSymbolKindName(Occ.Kind) << ' ' << FindName << '\n';
+  }
+  if (PrintStats)
+    errs() << Found.size() << " occurrences in "
+           << format("%.3f", Elapsed * 1000) << " ms\n";
+  return false;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, " Vlang symbol indexer\n");
+
+  if (InputFiles.empty() && FindName.empty()) {
+    errs() << "vlang-index: no input files and no query\n";
+    return 1;
+  }
+  if (!InputFiles.empty() && buildIndex())
+    return 1;
+  if (!FindName.empty() && queryIndex())
+    return 1;
+  return 0;
+}
@@ -0,0 +1,982 @@
+//===--- VlangLsp.cpp - Language server over stdio -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// vlang-lsp is a Language Server Protocol server speaking JSON-RPC over
+// stdin and stdout.  It serves diagnostics, document symbols and
+// go-to-definition for SystemVerilog.
+//
+// The process stays up for the whole editing session, so nothing is set up
+// per request: the file manager (and with it every stat and directory
+// lookup made for `include), the header search options and the optional
+// frozen identifier table are shared by all documents.  Each open document
+// keeps an IncrementalParser, so that an edit only reparses the design
+// elements it touches.  Modules and other design elements of files that
+// are not open are found through an index of the workspace, built on the
+// first request that needs it.  A lookup that misses rescans the changed
+// files, but only once the client reported a saved or changed file, or
+// some seconds after the last scan.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/FrozenIdentifierTable.h"
+#include "vlang/Frontend/IncrementalParser.h"
+#include "vlang/Lex/HeaderSearchOptions.h"
+#include "vlang/Lex/PreprocessorOptions.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace llvm;
+using namespace vlang;
+
+static cl::list<std::string>
+IncludePaths("I", cl::Prefix, cl::ZeroOrMore,
+             cl::desc("Add <dir> to the `include search path"),
+             cl::value_desc("dir"));
+
+static cl::list<std::string>
+LibraryDirs("y", cl::ZeroOrMore,
+            cl::desc("Also index the design elements of files in <dir>"),
+            cl::value_desc("dir"));
+
+static cl::opt<std::string>
+IdentifierBaseFile("identifier-base",
+                   cl::desc("Share the identifier table stored in <file> "
+                            "between documents"),
+                   cl::value_desc("file"));
+
+static cl::opt<bool>
+LogRequests("log", cl::desc("Log each request and its latency to stderr"));
+
+//===----------------------------------------------------------------------===//
+// JSON
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief A parsed JSON value.  JSON is read with the YAML parser, of which
+/// it is a subset; numbers, true, false and null are kept as scalars.
+class JSONValue {
+public:
+  enum ValueKind { Scalar, Object, Array };
+
+  ValueKind Kind;
+  bool Quoted;
+  std::string Str;
+  std::vector<std::pair<std::string, JSONValue> > Members;
+  std::vector<JSONValue> Elements;
+
+  JSONValue() : Kind(Scalar), Quoted(false) {}
+
+  const JSONValue *get(StringRef Key) const {
+    if (Kind != Object)
+      return 0;
+    for (unsigned i = 0, e = Members.size(); i != e; ++i)
+      if (Members[i].first == Key)
+        return &Members[i].second;
+    return 0;
+  }
+
+  StringRef getString(StringRef Key) const {
+    const JSONValue *V = get(Key);
+    return V && V->Kind == Scalar ? StringRef(V->Str) : StringRef();
+  }
+
+  bool getUnsigned(StringRef Key, unsigned &N) const {
+    const JSONValue *V = get(Key);
+    return V && V->Kind == Scalar && !StringRef(V->Str).getAsInteger(10, N);
+  }
+};
+
+} // end anonymous namespace
+
+static bool convertNode(yaml::Node *N, JSONValue &V) {
+  if (!N)
+    return false;
+  if (yaml::ScalarNode *S = dyn_cast<yaml::ScalarNode>(N)) {
+    SmallString<64> Storage;
+    V.Kind = JSONValue::Scalar;
+    V.Quoted = S->getRawValue().startswith("\"");
+    V.Str = S->getValue(Storage).str();
+    return true;
+  }
+  if (isa<yaml::NullNode>(N)) {
+    V.Kind = JSONValue::Scalar;
+    V.Str = "null";
+    return true;
+  }
+  if (yaml::MappingNode *M = dyn_cast<yaml::MappingNode>(N)) {
+    V.Kind = JSONValue::Object;
+    for (yaml::MappingNode::iterator I = M->begin(), E = M->end(); I != E;
+         ++I) {
+      yaml::ScalarNode *Key = dyn_cast_or_null<yaml::ScalarNode>(I->getKey());
+      if (!Key)
+        return false;
+      SmallString<32> Storage;
+      V.Members.push_back(std::make_pair(Key->getValue(Storage).str(),
+                                         JSONValue()));
+      if (!convertNode(I->getValue(), V.Members.back().second))
+        return false;
+    }
+    return true;
+  }
+  if (yaml::SequenceNode *Seq = dyn_cast<yaml::SequenceNode>(N)) {
+    V.Kind = JSONValue::Array;
+    for (yaml::SequenceNode::iterator I = Seq->begin(), E = Seq->end();
+         I != E; ++I) {
+      V.Elements.push_back(JSONValue());
+      if (!convertNode(&*I, V.Elements.back()))
+        return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+static bool parseJSON(StringRef Text, JSONValue &V) {
+  SourceMgr SM;
+  yaml::Stream Stream(Text, SM);
+  yaml::document_iterator Doc = Stream.begin();
+  if (Doc == Stream.end())
+    return false;
+  return convertNode(Doc->getRoot(), V) && !Stream.failed();
+}
+
+static void writeString(raw_ostream &OS, StringRef S) {
+  OS << '"';
+  for (unsigned i = 0, e = S.size(); i != e; ++i) {
+    unsigned char C = S[i];
+    switch (C) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\r': OS << "\\r"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if (C < 0x20)
+        OS << "\\u00" << hexdigit(C >> 4, true) << hexdigit(C & 15, true);
+      else
+        OS << C;
+    }
+  }
+  OS << '"';
+}
+
+static void writeValue(raw_ostream &OS, const JSONValue &V) {
+  switch (V.Kind) {
+  case JSONValue::Scalar:
+    if (V.Quoted)
+      writeString(OS, V.Str);
+    else
+      OS << V.Str;
+    break;
+  case JSONValue::Object:
+    OS << '{';
+    for (unsigned i = 0, e = V.Members.size(); i != e; ++i) {
+      OS << (i ? "," : "");
+      writeString(OS, V.Members[i].first);
+      OS << ':';
+      writeValue(OS, V.Members[i].second);
+    }
+    OS << '}';
+    break;
+  case JSONValue::Array:
+    OS << '[';
+    for (unsigned i = 0, e = V.Elements.size(); i != e; ++i) {
+      OS << (i ? "," : "");
+      writeValue(OS, V.Elements[i]);
+    }
+    OS << ']';
+    break;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Transport
+//===----------------------------------------------------------------------===//
+
+/// \brief Read one message body; returns false at the end of the input.
+static bool readMessage(std::string &Body) {
+  unsigned Length = 0;
+  bool HaveLength = false;
+  char Line[1024];
+  while (fgets(Line, sizeof(Line), stdin)) {
+    StringRef Header = StringRef(Line).rtrim("\r\n");
+    if (Header.empty()) {
+      if (!HaveLength)
+        continue;
+      Body.resize(Length);
+      return Length == 0 || fread(&Body[0], 1, Length, stdin) == Length;
+    }
+    if (Header.startswith("Content-Length:"))
+      HaveLength = !Header.substr(15).trim().getAsInteger(10, Length);
+  }
+  return false;
+}
+
+static void sendMessage(StringRef Body) {
+  outs() << "Content-Length: " << Body.size() << "\r\n\r\n" << Body;
+  outs().flush();
+}
+
+static void sendResponse(const JSONValue &ID, StringRef Result) {
+  std::string Body;
+  raw_string_ostream OS(Body);
+  OS << "{\"jsonrpc\":\"2.0\",\"id\":";
+  writeValue(OS, ID);
+  OS << ",\"result\":" << Result << "}";
+  sendMessage(OS.str());
+}
+
+static void sendError(const JSONValue &ID, int Code, StringRef Message) {
+  std::string Body;
+  raw_string_ostream OS(Body);
+  OS << "{\"jsonrpc\":\"2.0\",\"id\":";
+  writeValue(OS, ID);
+  OS << ",\"error\":{\"code\":" << Code << ",\"message\":";
+  writeString(OS, Message);
+  OS << "}}";
+  sendMessage(OS.str());
+}
+
+static void sendNotification(StringRef Method, StringRef Params) {
+  std::string Body;
+  raw_string_ostream OS(Body);
+  OS << "{\"jsonrpc\":\"2.0\",\"method\":";
+  writeString(OS, Method);
+  OS << ",\"params\":" << Params << "}";
+  sendMessage(OS.str());
+}
+
+//===----------------------------------------------------------------------===//
+// Documents
+//===----------------------------------------------------------------------===//
+
+static std::string uriToPath(StringRef URI) {
+  if (URI.startswith("file://"))
+    URI = URI.substr(7);
+  std::string Path;
+  for (unsigned i = 0, e = URI.size(); i != e; ++i) {
+    unsigned Byte;
+    if (URI[i] == '%' && i + 2 < e &&
+        !URI.substr(i + 1, 2).getAsInteger(16, Byte)) {
+      Path += (char)Byte;
+      i += 2;
+    } else {
+      Path += URI[i];
+    }
+  }
+  return Path;
+}
+
+static std::string pathToURI(StringRef Path) {
+  std::string URI = "file://";
+  for (unsigned i = 0, e = Path.size(); i != e; ++i) {
+    unsigned char C = Path[i];
+    if (isalnum(C) || C == '/' || C == '-' || C == '_' || C == '.' ||
+        C == '~') {
+      URI += C;
+    } else {
+      URI += '%';
+      URI += hexdigit(C >> 4, false);
+      URI += hexdigit(C & 15, false);
+    }
+  }
+  return URI;
+}
+
+namespace {
+
+/// \brief A position in a file: zero-based line and column.  Columns count
+/// UTF-16 code units, as the protocol requires, unless the client accepted
+/// UTF-8 positions, in which case they count bytes.
+struct Position {
+  unsigned Line, Column;
+  Position() : Line(0), Column(0) {}
+  Position(unsigned Line, unsigned Column) : Line(Line), Column(Column) {}
+};
+
+/// \brief The column of the end of \p LineText, which starts a line.
+static unsigned getColumn(StringRef LineText, bool UTF8Positions) {
+  if (UTF8Positions)
+    return LineText.size();
+  unsigned Column = 0;
+  for (unsigned i = 0, e = LineText.size(); i != e; ++i) {
+    unsigned char C = LineText[i];
+    // Each character is one unit, except that those beyond the BMP, the
+    // four-byte sequences, are a surrogate pair.
+    if ((C & 0xC0) != 0x80)
+      ++Column;
+    if ((C & 0xF8) == 0xF0)
+      ++Column;
+  }
+  return Column;
+}
+
+/// \brief The byte offset in \p LineText of column \p Column, or of the end
+/// of the character the column is in the middle of.
+static unsigned getColumnOffset(StringRef LineText, unsigned Column,
+                                bool UTF8Positions) {
+  if (UTF8Positions)
+    return std::min(Column, (unsigned)LineText.size());
+  unsigned i = 0, e = LineText.size();
+  while (i != e && Column) {
+    unsigned char C = LineText[i];
+    unsigned Size = C < 0xC0 ? 1 : C < 0xE0 ? 2 : C < 0xF0 ? 3 : 4;
+    Column -= std::min(Column, Size == 4 ? 2U : 1U);
+    i = std::min(i + Size, e);
+  }
+  return i;
+}
+
+/// \brief Maps between byte offsets and positions in a text.
+class LineTable {
+  StringRef Text;
+  std::vector<unsigned> LineStarts;
+  bool UTF8Positions;
+
+public:
+  LineTable(StringRef Text, bool UTF8Positions)
+    : Text(Text), UTF8Positions(UTF8Positions) {
+    LineStarts.push_back(0);
+    for (unsigned i = 0, e = Text.size(); i != e; ++i)
+      if (Text[i] == '\n')
+        LineStarts.push_back(i + 1);
+  }
+
+  Position getPosition(unsigned Offset) const {
+    Offset = std::min(Offset, (unsigned)Text.size());
+    unsigned Line = std::upper_bound(LineStarts.begin(), LineStarts.end(),
+                                     Offset) - LineStarts.begin() - 1;
+    return Position(Line, getColumn(Text.slice(LineStarts[Line], Offset),
+                                    UTF8Positions));
+  }
+
+  unsigned getOffset(Position P, unsigned Size) const {
+    if (P.Line >= LineStarts.size())
+      return Size;
+    unsigned Start = LineStarts[P.Line];
+    unsigned End = P.Line + 1 == LineStarts.size() ? Text.size()
+                                                   : LineStarts[P.Line + 1];
+    return std::min(Start + getColumnOffset(Text.slice(Start, End), P.Column,
+                                            UTF8Positions), Size);
+  }
+};
+
+/// \brief A location in the workspace.
+struct Location {
+  std::string Path;
+  Position Begin, End;
+};
+
+static void writePosition(raw_ostream &OS, Position P) {
+  OS << "{\"line\":" << P.Line << ",\"character\":" << P.Column << "}";
+}
+
+static void writeLocation(raw_ostream &OS, const Location &L) {
+  OS << "{\"uri\":";
+  writeString(OS, pathToURI(L.Path));
+  OS << ",\"range\":{\"start\":";
+  writePosition(OS, L.Begin);
+  OS << ",\"end\":";
+  writePosition(OS, L.End);
+  OS << "}}";
+}
+
+static bool isIdentifierChar(char C) {
+  return isalnum((unsigned char)C) || C == '_' || C == '$';
+}
+
+//===----------------------------------------------------------------------===//
+// Workspace index
+//===----------------------------------------------------------------------===//
+
+/// \brief The design elements declared in the files of some directories,
+/// found by a textual scan that skips comments and strings.
+class WorkspaceIndex {
+  struct FileInfo {
+    time_t ModTime;
+    std::vector<std::pair<std::string, Location> > Declarations;
+  };
+
+  std::vector<std::string> Roots;
+  std::map<std::string, FileInfo> Files;
+  StringMap<std::vector<Location> > ByName;
+  /// \brief Names looked up in vain since the last refresh.
+  StringSet<> Missing;
+  /// \brief When the last refresh finished.
+  std::chrono::steady_clock::time_point LastRefresh;
+  bool Built;
+  /// \brief The client reported files that changed since the last refresh.
+  bool Stale;
+  bool UTF8Positions;
+
+  void scanFile(const std::string &Path);
+  void rebuildNames();
+
+public:
+  WorkspaceIndex() : Built(false), Stale(false), UTF8Positions(false) {}
+
+  void addRoot(StringRef Dir) { Roots.push_back(Dir.str()); Built = false; }
+
+  /// \brief Count columns in bytes instead of UTF-16 code units.
+  void setUTF8Positions(bool UTF8) {
+    if (UTF8 != UTF8Positions)
+      Files.clear();
+    UTF8Positions = UTF8;
+    Built = false;
+  }
+
+  /// \brief Rescan the files that changed since they were last scanned.
+  void refresh();
+
+  /// \brief Let the next lookup that misses refresh the index right away.
+  void invalidate() { Stale = true; }
+
+  /// \brief Find the design elements named \p Name, building the index on
+  /// first use.  If nothing is found, the index is refreshed first if the
+  /// client reported changed files, or if \p Name is new and the last
+  /// refresh is some seconds old.
+  const std::vector<Location> *lookup(StringRef Name);
+};
+
+} // end anonymous namespace
+
+static bool isSourceFile(StringRef Path) {
+  StringRef Ext = sys::path::extension(Path);
+  return Ext == ".v" || Ext == ".sv" || Ext == ".vh" || Ext == ".svh" ||
+         Ext == ".vp" || Ext == ".svp";
+}
+
+/// \brief Whether \p Word introduces a design element with a name.
+static bool isDesignKeyword(StringRef Word) {
+  return Word == "module" || Word == "macromodule" || Word == "interface" ||
+         Word == "program" || Word == "package" || Word == "primitive" ||
+         Word == "class" || Word == "checker" || Word == "config";
+}
+
+/// \brief Find the design elements declared in \p Text.
+static void scanDeclarations(StringRef Path, StringRef Text,
+                             bool UTF8Positions,
+                             std::vector<std::pair<std::string,
+                                                   Location> > &Out) {
+  unsigned Line = 0, LineStart = 0;
+  StringRef Prev, Keyword;
+  for (unsigned i = 0, e = Text.size(); i < e;) {
+    char C = Text[i];
+    if (C == '\n') {
+      ++Line;
+      LineStart = ++i;
+    } else if (C == '/' && i + 1 < e && Text[i + 1] == '/') {
+      while (i < e && Text[i] != '\n')
+        ++i;
+    } else if (C == '/' && i + 1 < e && Text[i + 1] == '*') {
+      for (i += 2; i < e && !(Text[i] == '*' && i + 1 < e &&
+                             Text[i + 1] == '/'); ++i)
+        if (Text[i] == '\n') {
+          ++Line;
+          LineStart = i + 1;
+        }
+      i += 2;
+    } else if (C == '"') {
+      for (++i; i < e && Text[i] != '"' && Text[i] != '\n'; ++i)
+        if (Text[i] == '\\')
+          ++i;
+      ++i;
+    } else if (C == '`' || C == '$' || isIdentifierChar(C)) {
+      unsigned Start = i;
+      for (++i; i < e && isIdentifierChar(Text[i]); ++i) {}
+      StringRef Word = Text.slice(Start, i);
+      if (!Keyword.empty()) {
+        if (Word == "automatic" || Word == "static" || Word == "class")
+          continue;
+        if (C != '`' && C != '$' && !isdigit((unsigned char)C)) {
+          Location L;
+          L.Path = Path.str();
+          L.Begin = Position(Line, getColumn(Text.slice(LineStart, Start),
+                                             UTF8Positions));
+          L.End = Position(Line, L.Begin.Column +
+                                 getColumn(Word, UTF8Positions));
+          Out.push_back(std::make_pair(Word.str(), L));
+        }
+        Keyword = StringRef();
+      } else if (isDesignKeyword(Word) && Prev != "virtual" &&
+                 Prev != "typedef") {
+        Keyword = Word;
+      }
+      Prev = Word;
+    } else {
+      if (!isspace((unsigned char)C))
+        Keyword = Prev = StringRef();
+      ++i;
+    }
+  }
+}
+
+void WorkspaceIndex::scanFile(const std::string &Path) {
+  struct stat Status;
+  if (::stat(Path.c_str(), &Status))
+    return;
+  std::map<std::string, FileInfo>::iterator It = Files.find(Path);
+  if (It != Files.end() && It->second.ModTime == Status.st_mtime)
+    return;
+
+  FileInfo &Info = Files[Path];
+  Info.ModTime = Status.st_mtime;
+  Info.Declarations.clear();
+  OwningPtr<MemoryBuffer> Buffer;
+  if (!MemoryBuffer::getFile(Path, Buffer))
+    scanDeclarations(Path, Buffer->getBuffer(), UTF8Positions,
+                     Info.Declarations);
+}
+
+void WorkspaceIndex::rebuildNames() {
+  ByName.clear();
+  for (std::map<std::string, FileInfo>::iterator I = Files.begin(),
+         E = Files.end(); I != E; ++I)
+    for (unsigned i = 0, e = I->second.Declarations.size(); i != e; ++i)
+      ByName[I->second.Declarations[i].first].push_back(
+        I->second.Declarations[i].second);
+}
+
+void WorkspaceIndex::refresh() {
+  for (unsigned r = 0, re = Roots.size(); r != re; ++r) {
+    error_code EC;
+    for (sys::fs::recursive_directory_iterator I(Roots[r], EC), E;
+         I != E && !EC; I.increment(EC))
+      if (isSourceFile(I->path()))
+        scanFile(I->path());
+  }
+  rebuildNames();
+  Missing.clear();
+  LastRefresh = std::chrono::steady_clock::now();
+  Built = true;
+  Stale = false;
+}
+
+/// \brief The least time between two refreshes on a miss that the client
+/// did not ask for; each walks every directory of the workspace.
+static const unsigned RefreshIntervalSeconds = 5;
+
+const std::vector<Location> *WorkspaceIndex::lookup(StringRef Name) {
+  if (!Built)
+    refresh();
+  StringMap<std::vector<Location> >::iterator It = ByName.find(Name);
+  if (It != ByName.end())
+    return &It->second;
+
+  if (!Stale &&
+      (Missing.count(Name) ||
+       std::chrono::steady_clock::now() - LastRefresh <
+         std::chrono::seconds(RefreshIntervalSeconds))) {
+    Missing.insert(Name);
+    return 0;
+  }
+  refresh();
+  It = ByName.find(Name);
+  if (It != ByName.end())
+    return &It->second;
+  Missing.insert(Name);
+  return 0;
+}
+
+//===----------------------------------------------------------------------===//
+// Server
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+class LanguageServer {
+  IntrusiveRefCntPtr<HeaderSearchOptions> HSOpts;
+  IntrusiveRefCntPtr<PreprocessorOptions> PPOpts;
+  IntrusiveRefCntPtr<FileManager> FileMgr;
+  OwningPtr<FrozenIdentifierTable> IdentifierBase;
+
+  /// \brief The open documents by URI.
+  std::map<std::string, IncrementalParser *> Documents;
+  WorkspaceIndex Index;
+  bool ShutdownRequested;
+  /// \brief The client accepted positions in UTF-8 code units.
+  bool UTF8Positions;
+
+  void publishDiagnostics(StringRef URI, const IncrementalParser &Doc);
+
+  void onInitialize(const JSONValue &ID, const JSONValue &Params);
+  void onDidOpen(const JSONValue &Params);
+  void onDidChange(const JSONValue &Params);
+  void onDidClose(const JSONValue &Params);
+  void onDocumentSymbol(const JSONValue &ID, const JSONValue &Params);
+  void onDefinition(const JSONValue &ID, const JSONValue &Params);
+
+  IncrementalParser *getDocument(const JSONValue &Params);
+
+public:
+  LanguageServer();
+  ~LanguageServer() { DeleteContainerSeconds(Documents); }
+
+  /// \brief Handle one message; returns false once the client asked the
+  /// server to exit.
+  bool handleMessage(const JSONValue &Msg);
+
+  int getExitCode() const { return ShutdownRequested ? 0 : 1; }
+};
+
+} // end anonymous namespace
+
+LanguageServer::LanguageServer()
+  : HSOpts(new HeaderSearchOptions()), PPOpts(new PreprocessorOptions()),
+    FileMgr(new FileManager(FileSystemOptions())), ShutdownRequested(false),
+    UTF8Positions(false) {
+  for (unsigned i = 0, e = IncludePaths.size(); i != e; ++i) {
+    HSOpts->AddPath(IncludePaths[i], frontend::Quoted, true);
+    Index.addRoot(IncludePaths[i]);
+  }
+  for (unsigned i = 0, e = LibraryDirs.size(); i != e; ++i)
+    Index.addRoot(LibraryDirs[i]);
+
+  if (!IdentifierBaseFile.empty()) {
+    std::string Error;
+    IdentifierBase.reset(FrozenIdentifierTable::loadFromFile(
+      IdentifierBaseFile, Error));
+    if (!IdentifierBase)
+      errs() << "warning: ignoring identifier table '" << IdentifierBaseFile
+             << "': " << Error << "\n";
+  }
+}
+
+bool LanguageServer::handleMessage(const JSONValue &Msg) {
+  StringRef Method = Msg.getString("method");
+  const JSONValue *ID = Msg.get("id");
+  static const JSONValue NoParams;
+  const JSONValue *Params = Msg.get("params");
+  if (!Params)
+    Params = &NoParams;
+
+  if (Method == "initialize" && ID)
+    onInitialize(*ID, *Params);
+  else if (Method == "shutdown" && ID) {
+    ShutdownRequested = true;
+    sendResponse(*ID, "null");
+  } else if (Method == "exit")
+    return false;
+  else if (Method == "textDocument/didOpen")
+    onDidOpen(*Params);
+  else if (Method == "textDocument/didChange")
+    onDidChange(*Params);
+  else if (Method == "textDocument/didClose")
+    onDidClose(*Params);
+  else if (Method == "textDocument/didSave" ||
+           Method == "workspace/didChangeWatchedFiles")
+    Index.invalidate();
+  else if (Method == "textDocument/documentSymbol" && ID)
+    onDocumentSymbol(*ID, *Params);
+  else if (Method == "textDocument/definition" && ID)
+    onDefinition(*ID, *Params);
+  else if (ID)
+    sendError(*ID, -32601, "method not found: " + Method.str());
+  // Other notifications, e.g. initialized, need no answer.
+  return true;
+}
+
+void LanguageServer::onInitialize(const JSONValue &ID,
+                                  const JSONValue &Params) {
+  StringRef RootURI = Params.getString("rootUri");
+  if (!RootURI.empty() && RootURI != "null")
+    Index.addRoot(uriToPath(RootURI));
+  else if (!Params.getString("rootPath").empty() &&
+           Params.getString("rootPath") != "null")
+    Index.addRoot(Params.getString("rootPath"));
+
+  // Columns are UTF-16 code units unless the client also takes UTF-8,
+  // which are the byte offsets the front end has anyway.
+  if (const JSONValue *Capabilities = Params.get("capabilities"))
+    if (const JSONValue *General = Capabilities->get("general"))
+      if (const JSONValue *Encodings = General->get("positionEncodings"))
+        for (unsigned i = 0, e = Encodings->Elements.size(); i != e; ++i)
+          if (Encodings->Elements[i].Str == "utf-8")
+            UTF8Positions = true;
+  Index.setUTF8Positions(UTF8Positions);
+
+  // Incremental text sync; the edits are applied to the IncrementalParser.
+  // Saves are reported too, as they may change what the index holds.
+  sendResponse(ID, (Twine("{\"capabilities\":{\"positionEncoding\":\"") +
+                    (UTF8Positions ? "utf-8" : "utf-16") + "\","
+                    "\"textDocumentSync\":{\"openClose\":true,\"change\":2,"
+                    "\"save\":{}},"
+                    "\"documentSymbolProvider\":true,"
+                    "\"definitionProvider\":true}}").str());
+}
+
+IncrementalParser *LanguageServer::getDocument(const JSONValue &Params) {
+  const JSONValue *TextDocument = Params.get("textDocument");
+  if (!TextDocument)
+    return 0;
+  std::map<std::string, IncrementalParser *>::iterator It =
+    Documents.find(TextDocument->getString("uri").str());
+  return It == Documents.end() ? 0 : It->second;
+}
+
+void LanguageServer::publishDiagnostics(StringRef URI,
+                                        const IncrementalParser &Doc) {
+  LineTable Lines(Doc.getText(), UTF8Positions);
+  std::string Params;
+  raw_string_ostream OS(Params);
+  OS << "{\"uri\":";
+  writeString(OS, URI);
+  OS << ",\"diagnostics\":[";
+  bool First = true;
+  const std::vector<DocumentDiagnostic> &Diags = Doc.getDiagnostics();
+  for (unsigned i = 0, e = Diags.size(); i != e; ++i) {
+    const DocumentDiagnostic &D = Diags[i];
+    Position P = Lines.getPosition(D.HasOffset ? D.Offset : 0);
+    OS << (First ? "" : ",") << "{\"range\":{\"start\":";
+    writePosition(OS, P);
+    OS << ",\"end\":";
+    writePosition(OS, P);
+    OS << "},\"severity\":"
+       << (D.Level >= DiagnosticsEngine::Error ? 1 :
+           D.Level == DiagnosticsEngine::Warning ? 2 : 3)
+       << ",\"source\":\"vlang\",\"message\":";
+    writeString(OS, D.Message);
+    OS << "}";
+    First = false;
+  }
+  OS << "]}";
+  sendNotification("textDocument/publishDiagnostics", OS.str());
+}
+
+void LanguageServer::onDidOpen(const JSONValue &Params) {
+  const JSONValue *TextDocument = Params.get("textDocument");
+  if (!TextDocument)
+    return;
+  std::string URI = TextDocument->getString("uri").str();
+  IncrementalParser *&Doc = Documents[URI];
+  if (!Doc) {
+    Doc = new IncrementalParser(HSOpts, PPOpts);
+    Doc->setFileManager(FileMgr.getPtr());
+    Doc->setIdentifierBase(IdentifierBase.get());
+  }
+  Doc->parse(uriToPath(URI), TextDocument->getString("text"));
+  publishDiagnostics(URI, *Doc);
+}
+
+void LanguageServer::onDidChange(const JSONValue &Params) {
+  IncrementalParser *Doc = getDocument(Params);
+  const JSONValue *Changes = Params.get("contentChanges");
+  if (!Doc || !Changes || Changes->Kind != JSONValue::Array)
+    return;
+
+  for (unsigned i = 0, e = Changes->Elements.size(); i != e; ++i) {
+    const JSONValue &Change = Changes->Elements[i];
+    StringRef NewText = Change.getString("text");
+    const JSONValue *Range = Change.get("range");
+    const JSONValue *Start = Range ? Range->get("start") : 0;
+    const JSONValue *End = Range ? Range->get("end") : 0;
+    Position Begin, Finish;
+    if (!Start || !End ||
+        !Start->getUnsigned("line", Begin.Line) ||
+        !Start->getUnsigned("character", Begin.Column) ||
+        !End->getUnsigned("line", Finish.Line) ||
+        !End->getUnsigned("character", Finish.Column)) {
+      // The whole text was sent.
+      Doc->parse(Doc->getName(), NewText);
+      continue;
+    }
+    LineTable Lines(Doc->getText(), UTF8Positions);
+    unsigned Size = Doc->getText().size();
+    unsigned BeginOffset = Lines.getOffset(Begin, Size);
+    unsigned EndOffset = std::max(Lines.getOffset(Finish, Size), BeginOffset);
+    Doc->applyEdit(BeginOffset, EndOffset - BeginOffset, NewText);
+  }
+  publishDiagnostics(Params.get("textDocument")->getString("uri"), *Doc);
+}
+
+void LanguageServer::onDidClose(const JSONValue &Params) {
+  const JSONValue *TextDocument = Params.get("textDocument");
+  if (!TextDocument)
+    return;
+  std::map<std::string, IncrementalParser *>::iterator It =
+    Documents.find(TextDocument->getString("uri").str());
+  if (It == Documents.end())
+    return;
+  delete It->second;
+  Documents.erase(It);
+
+  std::string Cleared;
+  raw_string_ostream OS(Cleared);
+  OS << "{\"uri\":";
+  writeString(OS, TextDocument->getString("uri"));
+  OS << ",\"diagnostics\":[]}";
+  sendNotification("textDocument/publishDiagnostics", OS.str());
+}
+
+/// \brief The protocol's SymbolKind for an element introduced by \p K.
+static unsigned getSymbolKind(tok::TokenKind K) {
+  switch (K) {
+  case tok::kw_interface: return 11;   // Interface
+  case tok::kw_package:   return 4;    // Package
+  case tok::kw_class:     return 5;    // Class
+  case tok::kw_function:
+  case tok::kw_task:      return 12;   // Function
+  case tok::kw_config:    return 3;    // Namespace
+  case tok::kw_module:
+  case tok::kw_macromodule:
+  case tok::kw_primitive:
+  case tok::kw_program:
+  case tok::kw_checker:   return 2;    // Module
+  default:                return 13;   // Variable
+  }
+}
+
+void LanguageServer::onDocumentSymbol(const JSONValue &ID,
+                                      const JSONValue &Params) {
+  IncrementalParser *Doc = getDocument(Params);
+  if (!Doc) {
+    sendResponse(ID, "[]");
+    return;
+  }
+  LineTable Lines(Doc->getText(), UTF8Positions);
+  std::string Result;
+  raw_string_ostream OS(Result);
+  OS << "[";
+  bool First = true;
+  const std::vector<DesignElement> &Elements = Doc->getElements();
+  for (unsigned i = 0, e = Elements.size(); i != e; ++i) {
+    const DesignElement &E = Elements[i];
+    if (E.Name.empty())
+      continue;
+    Location L;
+    L.Path = Doc->getName().str();
+    L.Begin = Lines.getPosition(E.Begin);
+    L.End = Lines.getPosition(E.End);
+    OS << (First ? "" : ",") << "{\"name\":";
+    writeString(OS, E.Name);
+    OS << ",\"kind\":" << getSymbolKind(E.Keyword) << ",\"location\":";
+    writeLocation(OS, L);
+    OS << "}";
+    First = false;
+  }
+  OS << "]";
+  sendResponse(ID, OS.str());
+}
+
+void LanguageServer::onDefinition(const JSONValue &ID,
+                                  const JSONValue &Params) {
+  IncrementalParser *Doc = getDocument(Params);
+  const JSONValue *Pos = Params.get("position");
+  Position P;
+  if (!Doc || !Pos || !Pos->getUnsigned("line", P.Line) ||
+      !Pos->getUnsigned("character", P.Column)) {
+    sendResponse(ID, "[]");
+    return;
+  }
+
+  // Find the identifier under the cursor.
+  StringRef Text = Doc->getText();
+  LineTable Lines(Text, UTF8Positions);
+  unsigned Offset = Lines.getOffset(P, Text.size());
+  unsigned Begin = Offset, End = Offset;
+  while (Begin && isIdentifierChar(Text[Begin - 1]))
+    --Begin;
+  while (End < Text.size() && isIdentifierChar(Text[End]))
+    ++End;
+  StringRef Word = Text.slice(Begin, End);
+  if (Word.empty()) {
+    sendResponse(ID, "[]");
+    return;
+  }
+
+  std::vector<Location> Found;
+  unsigned DefOffset;
+  if (Begin && Text[Begin - 1] == '`') {
+    // A macro: the `define in effect here.
+    if (Doc->findMacroDefinition(Word, Begin, DefOffset)) {
+      Location L;
+      L.Path = Doc->getName().str();
+      L.Begin = Lines.getPosition(DefOffset);
+      L.End = Lines.getPosition(DefOffset + Word.size());
+      Found.push_back(L);
+    }
+  } else {
+    // A design element: the open documents have the latest text, the index
+    // covers the rest of the workspace.
+    for (std::map<std::string, IncrementalParser *>::iterator
+           I = Documents.begin(), E = Documents.end(); I != E; ++I) {
+      const std::vector<DesignElement> &Elements = I->second->getElements();
+      for (unsigned i = 0, e = Elements.size(); i != e; ++i)
+        if (Elements[i].Name == Word) {
+          LineTable DocLines(I->second->getText(), UTF8Positions);
+          Location L;
+          L.Path = I->second->getName().str();
+          L.Begin = DocLines.getPosition(Elements[i].Begin);
+          L.End = DocLines.getPosition(Elements[i].End);
+          Found.push_back(L);
+        }
+    }
+    if (Found.empty())
+      if (const std::vector<Location> *Indexed = Index.lookup(Word))
+        Found = *Indexed;
+  }
+
+  std::string Result;
+  raw_string_ostream OS(Result);
+  OS << "[";
+  for (unsigned i = 0, e = Found.size(); i != e; ++i) {
+    OS << (i ? "," : "");
+    writeLocation(OS, Found[i]);
+  }
+  OS << "]";
+  sendResponse(ID, OS.str());
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, " Vlang language server\n");
+
+  LanguageServer Server;
+  std::string Body;
+  while (readMessage(Body)) {
+    JSONValue Msg;
+    if (!parseJSON(Body, Msg) || Msg.Kind != JSONValue::Object) {
+      errs() << "vlang-lsp: ignoring malformed message\n";
+      continue;
+    }
+    std::chrono::steady_clock::time_point Start =
+      std::chrono::steady_clock::now();
+    bool KeepGoing = Server.handleMessage(Msg);
+    if (LogRequests) {
+      double MS = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - Start).count();
+      errs() << Msg.getString("method") << ": " << format("%.2f", MS)
+             << " ms\n";
+    }
+    if (!KeepGoing)
+      return Server.getExitCode();
+  }
+  return 1;
+}
@@ -0,0 +1,99 @@
+//===--- VlangClient.cpp - Thin client of the vlang compile server -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// vlangc takes the command line of vlang and has the vlangd compile server
+// run it, printing the output and exiting with the status vlang would have.
+// When no server is listening, or the server does not run jobs with these
+// arguments, vlangc runs vlang itself, so it can always stand in for vlang.
+//
+// The client is kept to the C and POSIX libraries: it runs once per job,
+// and what it does is cheap next to loading the front end.
+//
+// Environment:
+//   VLANGD_SOCKET       the socket of the server, see getDefaultSocketPath()
+//   VLANG               the vlang to run instead, by default the one next to
+//                       vlangc, or else the one on the PATH
+//   VLANGC_NO_FALLBACK  if set, fail instead of running vlang, for scripts
+//                       and benchmarks that must reach the server
+//
+//===----------------------------------------------------------------------===//
+
+#include "VlangdProtocol.h"
+#include <climits>
+#include <sys/stat.h>
+
+/// \brief The vlang to run when the server does not run the job.
+static std::string getVlangPath() {
+  if (const char *Path = ::getenv("VLANG"))
+    if (*Path)
+      return Path;
+
+  char Self[PATH_MAX];
+  ssize_t N = ::readlink("/proc/self/exe", Self, sizeof(Self) - 1);
+  if (N > 0) {
+    std::string Sibling(Self, N);
+    std::string::size_type Slash = Sibling.rfind('/');
+    if (Slash != std::string::npos) {
+      Sibling.replace(Slash + 1, std::string::npos, "vlang");
+      struct stat Status;
+      if (::stat(Sibling.c_str(), &Status) == 0)
+        return Sibling;
+    }
+  }
+  return "vlang";
+}
+
+/// \brief Send the job to the server.  Returns true and sets \p R if the
+/// server answered.
+static bool runOnServer(int argc, char *argv[], vlangd::Response &R) {
+  int FD = vlangd::connectToServer(vlangd::getDefaultSocketPath());
+  if (FD < 0)
+    return false;
+
+  std::vector<std::string> Strings;
+  char Cwd[PATH_MAX];
+  if (!::getcwd(Cwd, sizeof(Cwd))) {
+    ::close(FD);
+    return false;
+  }
+  Strings.push_back(Cwd);
+  Strings.insert(Strings.end(), argv + 1, argv + argc);
+
+  bool Answered = vlangd::writeRequest(FD, Strings) &&
+                  vlangd::readResponse(FD, R);
+  ::close(FD);
+  return Answered;
+}
+
+int main(int argc, char *argv[]) {
+  vlangd::Response R;
+  if (runOnServer(argc, argv, R) && R.Status == vlangd::Done) {
+    // The server kept the two streams apart, so their order relative to
+    // each other is lost; that of redirected vlang output is no better.
+    if (!vlangd::writeAll(STDOUT_FILENO, R.Out.data(), R.Out.size()) ||
+        !vlangd::writeAll(STDERR_FILENO, R.Err.data(), R.Err.size()))
+      return 1;
+    return R.ExitCode;
+  }
+
+  if (::getenv("VLANGC_NO_FALLBACK")) {
+    fprintf(stderr, "vlangc: no vlangd at '%s' runs this job\n",
+            vlangd::getDefaultSocketPath().c_str());
+    return 2;
+  }
+
+  std::string Vlang = getVlangPath();
+  std::vector<char *> Args(argv, argv + argc);
+  Args[0] = const_cast<char *>(Vlang.c_str());
+  Args.push_back(0);
+  ::execvp(Args[0], &Args[0]);
+  fprintf(stderr, "vlangc: cannot run '%s': %s\n", Vlang.c_str(),
+          strerror(errno));
+  return 127;
+}
@@ -0,0 +1,725 @@
+//===--- VlangDaemon.cpp - Compile server for vlang -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// vlangd runs vlang jobs sent to it by vlangc over a Unix domain socket, so
+// that a build that runs vlang many times pays for starting the front end
+// once.  Jobs preprocess (-E), print dependencies (-M) or parse their
+// inputs, and produce the same output vlang would; vlangc runs vlang itself
+// for the options the server does not implement.
+//
+// Between jobs the server keeps:
+//
+//  - the file manager, and with it every stat and directory lookup made,
+//  - a header search per list of include directories, with the results of
+//    its `include lookups,
+//  - a frozen identifier table of every identifier seen so far, which the
+//    identifier table of each job looks names up in first, and
+//  - the parse caches the jobs named, already opened.
+//
+// The file manager is only right as long as the files it has seen do not
+// change, so every directory a job read a file from or searched for one in
+// is watched through inotify.  Before each job the pending events are read:
+// a modified file is dropped from the file manager, to be looked up again,
+// and a file created, removed or renamed, which can change where a lookup
+// ends up, resets the file manager and the header searches.  Jobs are run
+// one at a time, in the order they arrive.
+//
+//===----------------------------------------------------------------------===//
+
+#include "VlangdProtocol.h"
+#include "vlang/Basic/FileManager.h"
+#include "vlang/Basic/FrozenIdentifierTable.h"
+#include "vlang/Basic/SourceManager.h"
+#include "vlang/Diag/Diagnostic.h"
+#include "vlang/Diag/DiagnosticOptions.h"
+#include "vlang/Diag/TextDiagnosticPrinter.h"
+#include "vlang/Frontend/CommandFiles.h"
+#include "vlang/Frontend/CompilationUnit.h"
+#include "vlang/Frontend/InputUnit.h"
+#include "vlang/Lex/HeaderSearch.h"
+#include "vlang/Lex/HeaderSearchOptions.h"
+#include "vlang/Parse/ConfigTable.h"
+#include "vlang/Parse/DesignUnitTable.h"
+#include "vlang/Serialization/ParseCache.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <climits>
+#include <csignal>
+#include <map>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+using namespace llvm;
+using namespace vlang;
+
+static cl::opt<std::string>
+SocketPath("socket",
+           cl::desc("Listen on the Unix domain socket <path>, by default "
+                    "$VLANGD_SOCKET, $XDG_RUNTIME_DIR/vlangd.sock or "
+                    "/tmp/vlangd-<uid>.sock"),
+           cl::value_desc("path"));
+
+static cl::opt<unsigned>
+IdleTimeout("idle-timeout", cl::init(1800),
+            cl::desc("Exit after <seconds> without a job, or never if 0"),
+            cl::value_desc("seconds"));
+
+static cl::opt<bool>
+LogRequests("log", cl::desc("Log each job and its latency to stderr"));
+
+//===----------------------------------------------------------------------===//
+// Jobs.
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief A vlang command line the server runs.
+struct Job {
+  std::string WorkingDir;
+  std::vector<std::string> Inputs;
+  /// \brief The -I directories, then the +incdir+ ones, in search order.
+  std::vector<std::string> IncludeDirs;
+  std::vector<std::string> Defines;
+  std::vector<std::string> UnknownPlusArgs;
+  bool PreprocessOnly;
+  bool PrintDependencies;
+  bool UseTokenBuffer;
+  bool CompilationUnitMode;
+  std::string ParseCacheDir;
+  unsigned ParseCacheSize;
+
+  Job()
+    : PreprocessOnly(false), PrintDependencies(false), UseTokenBuffer(false),
+      CompilationUnitMode(false), ParseCacheSize(512) {}
+
+  bool isPreprocessOnly() const { return PreprocessOnly || PrintDependencies; }
+};
+
+} // end anonymous namespace
+
+/// \brief Read a request, the working directory of the client and the
+/// arguments it was given, into \p J.  Returns false if vlang must run them
+/// itself: for options the server does not implement, for -f, since command
+/// files can refer to the environment of the client, and for command lines
+/// vlang rejects, so that it is vlang that reports them.
+static bool parseJob(const std::vector<std::string> &Request, Job &J) {
+  J.WorkingDir = Request[0];
+  std::vector<std::string> Args(Request.begin() + 1, Request.end());
+  if (std::find(Args.begin(), Args.end(), "-f") != Args.end())
+    return false;
+
+  PlusArgs Plus;
+  ExtractPlusArgs(Args, Plus, J.UnknownPlusArgs);
+  for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+    StringRef Arg = Args[i];
+    if (!Arg.startswith("-") || Arg == "-") {
+      J.Inputs.push_back(Arg.str());
+      continue;
+    }
+
+    // Like the option parser, take --name as well as -name, and a value
+    // after '=' as well as in the next argument.
+    StringRef Name = Arg.substr(Arg.startswith("--") ? 2 : 1);
+    StringRef Value;
+    bool HasValue = false;
+    if (Name.find('=') != StringRef::npos) {
+      std::pair<StringRef, StringRef> NameValue = Name.split('=');
+      Name = NameValue.first;
+      Value = NameValue.second;
+      HasValue = true;
+    }
+
+    if (Name == "E" || Name == "M" || Name == "token-buffer" ||
+        Name == "compilation-unit") {
+      if (HasValue)
+        return false;
+      if (Name == "E")
+        J.PreprocessOnly = true;
+      else if (Name == "M")
+        J.PrintDependencies = true;
+      else if (Name == "token-buffer")
+        J.UseTokenBuffer = true;
+      else
+        J.CompilationUnitMode = true;
+      continue;
+    }
+
+    if (Name != "I" && Name != "parse-cache" && Name != "parse-cache-size")
+      return false;
+    if (!HasValue) {
+      if (i + 1 == e)
+        return false;
+      Value = Args[++i];
+    }
+    if (Name == "I")
+      J.IncludeDirs.push_back(Value.str());
+    else if (Name == "parse-cache")
+      J.ParseCacheDir = Value.str();
+    else if (Value.getAsInteger(10, J.ParseCacheSize))
+      return false;
+  }
+
+  J.IncludeDirs.insert(J.IncludeDirs.end(), Plus.IncludeDirs.begin(),
+                       Plus.IncludeDirs.end());
+  J.Defines = Plus.Defines;
+
+  // The combinations vlang rejects.
+  if (J.Inputs.empty())
+    return false;
+  if (J.isPreprocessOnly() &&
+      (J.CompilationUnitMode || !J.ParseCacheDir.empty()))
+    return false;
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// File watching.
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief Watches, through inotify, the directories jobs read files from and
+/// search for them in.
+class FileWatcher {
+  int FD;
+  std::map<int, std::string> Directories;
+  StringMap<int> Watches;
+  /// \brief The name the file manager knows each file read by, by its
+  /// absolute path.
+  StringMap<std::string> Names;
+  /// \brief Set when a directory could not be watched, so that changes to
+  /// it may go unnoticed.
+  bool LostTrack;
+
+  FileWatcher(const FileWatcher &) LLVM_DELETED_FUNCTION;
+  void operator=(const FileWatcher &) LLVM_DELETED_FUNCTION;
+
+public:
+  FileWatcher()
+    : FD(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), LostTrack(false) {}
+  ~FileWatcher() {
+    if (FD >= 0)
+      ::close(FD);
+  }
+
+  /// \brief The descriptor that becomes readable when events are pending,
+  /// or -1 if inotify is not available.
+  int getFD() const { return FD; }
+
+  unsigned getNumDirectories() const { return Watches.size(); }
+
+  /// \brief Watch the directory at absolute path \p Dir.  Returns true if
+  /// it was not watched yet.
+  bool watchDirectory(StringRef Dir);
+
+  /// \brief Note that the file at absolute path \p Path was read as \p Name,
+  /// and watch its directory.  Returns true if the directory was not watched
+  /// yet, so that the file may have changed since it was read.
+  bool addFile(StringRef Path, StringRef Name) {
+    Names[Path] = Name.str();
+    return watchDirectory(sys::path::parent_path(Path));
+  }
+
+  /// \brief Forget the files read, when the file manager that knew them by
+  /// their names is replaced.
+  void clearFiles() { Names.clear(); }
+
+  /// \brief Read the pending events, adding the names of the files read that
+  /// were modified to \p Modified.  Returns true if a file was created,
+  /// removed or renamed, or if changes may have been missed.
+  bool readEvents(std::vector<std::string> &Modified);
+};
+
+} // end anonymous namespace
+
+bool FileWatcher::watchDirectory(StringRef Dir) {
+  if (Watches.count(Dir))
+    return false;
+  if (FD < 0)
+    return true;
+
+  const uint32_t Mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE |
+                        IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                        IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+  int WD = ::inotify_add_watch(FD, Dir.str().c_str(), Mask);
+  if (WD < 0) {
+    LostTrack = true;
+    return true;
+  }
+  Watches[Dir] = WD;
+  Directories[WD] = Dir.str();
+  return true;
+}
+
+bool FileWatcher::readEvents(std::vector<std::string> &Modified) {
+  bool Changed = LostTrack || FD < 0;
+  LostTrack = false;
+  if (FD < 0)
+    return Changed;
+
+  uint64_t Buffer[2048];
+  while (true) {
+    ssize_t N = ::read(FD, Buffer, sizeof(Buffer));
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      break;
+
+    const char *P = (const char *)Buffer, *End = P + N;
+    while (P < End) {
+      const inotify_event *Event = (const inotify_event *)P;
+      P += sizeof(inotify_event) + Event->len;
+
+      if (Event->mask & IN_IGNORED) {
+        std::map<int, std::string>::iterator Dir =
+          Directories.find(Event->wd);
+        if (Dir != Directories.end()) {
+          Watches.erase(Dir->second);
+          Directories.erase(Dir);
+        }
+        Changed = true;
+        continue;
+      }
+      if (Event->mask & (IN_Q_OVERFLOW | IN_CREATE | IN_DELETE |
+                         IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                         IN_MOVE_SELF)) {
+        Changed = true;
+        continue;
+      }
+
+      std::map<int, std::string>::iterator Dir = Directories.find(Event->wd);
+      if (Dir == Directories.end() || !Event->len)
+        continue;
+      SmallString<256> Path(Dir->second);
+      sys::path::append(Path, Event->name);
+      StringMap<std::string>::iterator Name = Names.find(Path);
+      if (Name != Names.end())
+        Modified.push_back(Name->second);
+    }
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+// The server.
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief The search paths of one list of include directories, and the
+/// lookups made through them.
+struct WarmHeaderSearch {
+  IntrusiveRefCntPtr<HeaderSearchOptions> Opts;
+  OwningPtr<HeaderSearch> Info;
+};
+
+/// \brief What the inputs of one job share.
+struct JobState {
+  const Job &J;
+  WarmHeaderSearch &HS;
+  ParseCache *Parses;
+  DesignUnitTable Units;
+  ConfigTable Configs;
+  raw_ostream &OS;
+  raw_ostream &ErrOS;
+  unsigned NumReplayed;
+  unsigned NumParsed;
+  unsigned NumStored;
+  /// \brief Files read from directories that were not watched yet, to be
+  /// dropped from the file manager once the input is done with them.
+  std::vector<const FileEntry *> Unwatched;
+
+  JobState(const Job &J, WarmHeaderSearch &HS, ParseCache *Parses,
+           raw_ostream &OS, raw_ostream &ErrOS)
+    : J(J), HS(HS), Parses(Parses), OS(OS), ErrOS(ErrOS), NumReplayed(0),
+      NumParsed(0), NumStored(0) {}
+};
+
+class CompileServer {
+  LangOptions LangOpts;
+  DiagnosticsEngine Diags;
+  IntrusiveRefCntPtr<FileManager> FileMgr;
+  /// \brief The directory the relative names the file manager knows are
+  /// relative to.
+  std::string FileMgrDir;
+  StringMap<WarmHeaderSearch *> HeaderSearches;
+  OwningPtr<FrozenIdentifierTable> IdentifierBase;
+  StringMap<ParseCache *> ParseCaches;
+  FileWatcher Watcher;
+  unsigned NumJobs;
+  unsigned NumResets;
+
+  CompileServer(const CompileServer &) LLVM_DELETED_FUNCTION;
+  void operator=(const CompileServer &) LLVM_DELETED_FUNCTION;
+
+  void resetFiles();
+  WarmHeaderSearch &getHeaderSearch(const Job &J);
+  ParseCache *getParseCache(const Job &J);
+  void watchFilesRead(const SourceManager &SM, JobState &S);
+  void runInput(JobState &S, const std::string &File, StringRef Source,
+                OwningPtr<FrozenIdentifierTable> &NewBase);
+  bool run(const std::vector<std::string> &Request, vlangd::Response &R);
+
+public:
+  CompileServer();
+  ~CompileServer();
+
+  int getWatcherFD() const { return Watcher.getFD(); }
+
+  /// \brief Bring the file manager and the header searches up to date with
+  /// the changes made to the files they have seen.
+  void syncWithFileSystem();
+
+  /// \brief Answer the request on the connection \p FD.
+  void serve(int FD);
+};
+
+} // end anonymous namespace
+
+CompileServer::CompileServer()
+  : Diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs()),
+          new DiagnosticOptions(), new IgnoringDiagConsumer()),
+    FileMgr(new FileManager(FileSystemOptions())), NumJobs(0), NumResets(0) {}
+
+CompileServer::~CompileServer() {
+  for (StringMap<WarmHeaderSearch *>::iterator I = HeaderSearches.begin(),
+         E = HeaderSearches.end(); I != E; ++I)
+    delete I->getValue();
+  for (StringMap<ParseCache *>::iterator I = ParseCaches.begin(),
+         E = ParseCaches.end(); I != E; ++I)
+    delete I->getValue();
+}
+
+void CompileServer::resetFiles() {
+  for (StringMap<WarmHeaderSearch *>::iterator I = HeaderSearches.begin(),
+         E = HeaderSearches.end(); I != E; ++I)
+    delete I->getValue();
+  HeaderSearches.clear();
+  FileMgr = new FileManager(FileSystemOptions());
+  Watcher.clearFiles();
+  ++NumResets;
+}
+
+void CompileServer::syncWithFileSystem() {
+  std::vector<std::string> Modified;
+  if (Watcher.readEvents(Modified)) {
+    resetFiles();
+    return;
+  }
+  for (unsigned i = 0, e = Modified.size(); i != e; ++i)
+    if (const FileEntry *FE = FileMgr->getFile(Modified[i], false, false))
+      FileMgr->invalidateCache(FE);
+}
+
+WarmHeaderSearch &CompileServer::getHeaderSearch(const Job &J) {
+  std::string Key;
+  for (unsigned i = 0, e = J.IncludeDirs.size(); i != e; ++i) {
+    Key += J.IncludeDirs[i];
+    Key += '\0';
+  }
+  WarmHeaderSearch *&HS = HeaderSearches[Key];
+  if (!HS) {
+    HS = new WarmHeaderSearch();
+    HS->Opts = new HeaderSearchOptions();
+    for (unsigned i = 0, e = J.IncludeDirs.size(); i != e; ++i)
+      HS->Opts->AddPath(J.IncludeDirs[i], frontend::Quoted, true);
+    HS->Info.reset(new HeaderSearch(HS->Opts, *FileMgr, Diags, LangOpts));
+  }
+  return *HS;
+}
+
+ParseCache *CompileServer::getParseCache(const Job &J) {
+  if (J.ParseCacheDir.empty())
+    return 0;
+  SmallString<256> Dir(J.ParseCacheDir);
+  sys::fs::make_absolute(Dir);
+  uint64_t SizeLimit = (uint64_t)J.ParseCacheSize << 20;
+  ParseCache *&Cache = ParseCaches[Dir];
+  if (Cache && Cache->getSizeLimit() != SizeLimit) {
+    delete Cache;
+    Cache = 0;
+  }
+  if (!Cache)
+    Cache = new ParseCache(Dir, SizeLimit);
+  return Cache;
+}
+
+void CompileServer::watchFilesRead(const SourceManager &SM, JobState &S) {
+  for (SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+         E = SM.fileinfo_end(); I != E; ++I) {
+    const FileEntry *FE = I->first;
+    SmallString<256> Path(FE->getName());
+    sys::fs::make_absolute(Path);
+    if (Watcher.addFile(Path, FE->getName()))
+      S.Unwatched.push_back(FE);
+  }
+}
+
+/// \brief Run the job of \p S on one input: \p File, or \p Source named
+/// \p File if it is not empty.  Sets \p NewBase if the input added
+/// identifiers the identifier base does not have.
+void CompileServer::runInput(JobState &S, const std::string &File,
+                             StringRef Source,
+                             OwningPtr<FrozenIdentifierTable> &NewBase) {
+  const Job &J = S.J;
+  Diags.Reset();
+  // The file manager, the header search and the identifier base are the
+  // server's; the rest of the unit holds what the input read and defined.
+  InputUnit Unit(Diags, *FileMgr, LangOpts, *S.HS.Info, J.Defines,
+                 IdentifierBase.get());
+
+  // Only a file entry is among the files a unit reads, which -M prints.
+  std::string ErrorStr;
+  if (Unit.createMainFile(File, Source, J.isPreprocessOnly(), ErrorStr)) {
+    S.ErrOS << "error: " << ErrorStr << "\n";
+    return;
+  }
+
+  if (J.isPreprocessOnly()) {
+    preprocessInput(Unit, File, J.PrintDependencies, S.OS);
+  } else {
+    Unit.enterMainFile(StringRef());
+    InputParseOptions ParseOpts;
+    ParseOpts.Units = &S.Units;
+    ParseOpts.Configs = &S.Configs;
+    ParseOpts.Parses = S.Parses;
+    ParseOpts.UseTokenBuffer = J.UseTokenBuffer;
+    InputParseResult Parsed = parseInput(Unit, ParseOpts);
+    S.OS << "\nFINISHED parsing\n";
+    if (Parsed.UsedParseCache) {
+      S.OS << "parse cache: " << Parsed.NumReplayed
+           << " elements replayed, " << Parsed.NumParsed
+           << " parsed, " << Parsed.NumStored << " stored\n";
+      S.NumReplayed += Parsed.NumReplayed;
+      S.NumParsed += Parsed.NumParsed;
+      S.NumStored += Parsed.NumStored;
+    }
+  }
+
+  watchFilesRead(Unit.SourceMgr, S);
+  if (Unit.hasNewIdentifiers())
+    NewBase.reset(FrozenIdentifierTable::create(Unit.PP.getIdentifierTable()));
+}
+
+/// \brief Run the job \p Request asks for, filling in \p R.  Returns false
+/// if the server does not run it.
+bool CompileServer::run(const std::vector<std::string> &Request,
+                        vlangd::Response &R) {
+  Job J;
+  if (!parseJob(Request, J) || ::chdir(J.WorkingDir.c_str()) != 0)
+    return false;
+
+  // The file manager knows files by the names the jobs used, which are
+  // relative to the directory they ran in.
+  syncWithFileSystem();
+  if (J.WorkingDir != FileMgrDir) {
+    resetFiles();
+    FileMgrDir = J.WorkingDir;
+  }
+
+  // Watch where the inputs and includes are looked for before they are, so
+  // that a file created there meanwhile is not missed.
+  for (unsigned i = 0, e = J.IncludeDirs.size(); i != e; ++i) {
+    SmallString<256> Dir(J.IncludeDirs[i]);
+    sys::fs::make_absolute(Dir);
+    Watcher.watchDirectory(Dir);
+  }
+  for (unsigned i = 0, e = J.Inputs.size(); i != e; ++i) {
+    SmallString<256> Path(J.Inputs[i]);
+    sys::fs::make_absolute(Path);
+    Watcher.watchDirectory(sys::path::parent_path(Path));
+  }
+
+  raw_string_ostream OS(R.Out), ErrOS(R.Err);
+  for (unsigned i = 0, e = J.UnknownPlusArgs.size(); i != e; ++i)
+    ErrOS << "warning: ignoring unknown argument '" << J.UnknownPlusArgs[i]
+          << "'\n";
+
+  DiagnosticConsumer *DiagClient =
+    new TextDiagnosticPrinter(ErrOS, new DiagnosticOptions());
+  Diags.setClient(DiagClient, /*ShouldOwnClient=*/true);
+
+  JobState S(J, getHeaderSearch(J), getParseCache(J), OS, ErrOS);
+  std::vector<std::string> Files;
+  std::vector<std::string> Sources;
+  if (J.CompilationUnitMode) {
+    Files.push_back("<compilation-unit>");
+    Sources.push_back(getCompilationUnitSource(J.Inputs));
+  } else {
+    Files = J.Inputs;
+    Sources.resize(Files.size());
+  }
+  for (unsigned i = 0, e = Files.size(); i != e; ++i) {
+    OwningPtr<FrozenIdentifierTable> NewBase;
+    runInput(S, Files[i], Sources[i], NewBase);
+    // The unit that looked names up in the old base is gone.
+    if (NewBase)
+      IdentifierBase.reset(NewBase.take());
+    for (unsigned F = 0, FE = S.Unwatched.size(); F != FE; ++F)
+      FileMgr->invalidateCache(S.Unwatched[F]);
+    S.Unwatched.clear();
+  }
+
+  if (S.Parses)
+    OS << "parse cache: " << S.NumReplayed << " elements replayed, "
+       << S.NumParsed << " parsed, " << S.NumStored << " stored, "
+       << S.Parses->prune() << " evicted\n";
+
+  Diags.setClient(new IgnoringDiagConsumer(), /*ShouldOwnClient=*/true);
+  OS.flush();
+  ErrOS.flush();
+  R.Status = vlangd::Done;
+  R.ExitCode = 0;
+  return true;
+}
+
+void CompileServer::serve(int FD) {
+  std::vector<std::string> Request;
+  if (!vlangd::readRequest(FD, Request))
+    return;
+
+  double Start = TimeRecord::getCurrentTime(true).getWallTime();
+  vlangd::Response R;
+  bool Ran = run(Request, R);
+  if (!Ran)
+    R.Status = vlangd::Unsupported;
+  double Seconds = TimeRecord::getCurrentTime(false).getWallTime() - Start;
+  vlangd::writeResponse(FD, R);
+
+  if (Ran)
+    ++NumJobs;
+  if (LogRequests)
+    errs() << "job " << NumJobs << ": " << (Ran ? "ran" : "unsupported")
+           << " in " << format("%.1f", Seconds * 1000) << " ms; "
+           << Watcher.getNumDirectories() << " directories watched, "
+           << NumResets << " file manager resets\n";
+}
+
+//===----------------------------------------------------------------------===//
+// Main driver code.
+//===----------------------------------------------------------------------===//
+
+static volatile sig_atomic_t StopRequested = 0;
+
+static void handleStopSignal(int) {
+  StopRequested = 1;
+}
+
+/// \brief Listen on the socket at \p Path.  Returns the listening socket,
+/// or -1 and sets \p ErrorStr.
+static int listenAt(const std::string &Path, std::string &ErrorStr) {
+  int Running = vlangd::connectToServer(Path);
+  if (Running >= 0) {
+    ::close(Running);
+    ErrorStr = "another server is listening there";
+    return -1;
+  }
+
+  // The socket is bound under a temporary name and renamed into place once
+  // it accepts connections, so that a client never finds it half set up,
+  // and a socket left behind by a server that died is replaced.
+  std::string TempPath = Path + "." + utostr(::getpid()) + ".tmp";
+  sockaddr_un Addr;
+  if (!vlangd::getSocketAddress(TempPath, Addr)) {
+    ErrorStr = "path too long for a socket";
+    return -1;
+  }
+  int FD = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (FD < 0) {
+    ErrorStr = strerror(errno);
+    return -1;
+  }
+  ::unlink(TempPath.c_str());
+  // The server reads any file its clients name, so only its user may
+  // connect.
+  if (::bind(FD, (const sockaddr *)&Addr, sizeof(Addr)) != 0 ||
+      ::chmod(TempPath.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(FD, 64) != 0 ||
+      ::rename(TempPath.c_str(), Path.c_str()) != 0) {
+    ErrorStr = strerror(errno);
+    ::close(FD);
+    ::unlink(TempPath.c_str());
+    return -1;
+  }
+  return FD;
+}
+
+int main(int argc, char *argv[]) {
+  cl::ParseCommandLineOptions(argc, argv, " vlang compile server\n");
+
+  std::string Path = SocketPath.empty() ? vlangd::getDefaultSocketPath()
+                                        : std::string(SocketPath);
+  std::string ErrorStr;
+  int ListenFD = listenAt(Path, ErrorStr);
+  if (ListenFD < 0) {
+    errs() << "error: cannot listen on '" << Path << "': " << ErrorStr
+           << "\n";
+    return 1;
+  }
+  struct stat Socket;
+  if (::stat(Path.c_str(), &Socket) != 0)
+    Socket.st_ino = 0;
+
+  struct sigaction Action;
+  memset(&Action, 0, sizeof(Action));
+  Action.sa_handler = handleStopSignal;
+  ::sigaction(SIGTERM, &Action, 0);
+  ::sigaction(SIGINT, &Action, 0);
+  ::sigaction(SIGHUP, &Action, 0);
+  ::signal(SIGPIPE, SIG_IGN);
+
+  int Timeout = -1;
+  if (IdleTimeout)
+    Timeout = std::min<unsigned>(IdleTimeout, INT_MAX / 1000) * 1000;
+  CompileServer Server;
+  while (!StopRequested) {
+    pollfd FDs[2];
+    FDs[0].fd = ListenFD;
+    FDs[0].events = POLLIN;
+    FDs[1].fd = Server.getWatcherFD();
+    FDs[1].events = POLLIN;
+    int N = ::poll(FDs, FDs[1].fd >= 0 ? 2 : 1, Timeout);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      break;
+
+    // Read events as they come, so that the queue does not overflow while
+    // the server is idle.
+    if (FDs[1].fd >= 0 && (FDs[1].revents & POLLIN))
+      Server.syncWithFileSystem();
+    if (FDs[0].revents & POLLIN) {
+      int Connection = ::accept4(ListenFD, 0, 0, SOCK_CLOEXEC);
+      if (Connection >= 0) {
+        // The mode of the socket already keeps other users out; this also
+        // covers a socket path given in a directory that does not.
+        if (vlangd::isPeerSameUser(Connection))
+          Server.serve(Connection);
+        ::close(Connection);
+      }
+    }
+  }
+
+  // Leave the socket alone if another server has replaced it since.
+  ::close(ListenFD);
+  struct stat Current;
+  if (::stat(Path.c_str(), &Current) == 0 && Current.st_ino == Socket.st_ino)
+    ::unlink(Path.c_str());
+  return 0;
+}
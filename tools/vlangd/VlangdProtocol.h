@@ -0,0 +1,215 @@
+//===--- VlangdProtocol.h - Messages between vlangc and vlangd --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the messages the vlangc client and the vlangd compile
+// server exchange over a Unix domain socket.  The client sends one request
+// and the server answers it with one response:
+//
+//   request:   magic, string count, working directory, arguments...
+//   response:  status, exit code, standard output, standard error
+//
+// Integers are 32 bits in host byte order, as both ends run on one host, and
+// a string is its length followed by its bytes.  The client does not link
+// against LLVM, so only the C and POSIX libraries are used here.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_VLANG_TOOLS_VLANGD_VLANGDPROTOCOL_H
+#define LLVM_VLANG_TOOLS_VLANGD_VLANGDPROTOCOL_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace vlangd {
+
+static const uint32_t RequestMagic = 0x564c4431; // 'VLD1'
+
+/// \brief Longest string either end accepts, to bound what a corrupt
+/// message can make it allocate.
+static const uint32_t MaxStringSize = 1U << 30;
+
+enum ResponseStatus {
+  /// \brief The server ran the job; its output is in the response.
+  Done = 0,
+  /// \brief The server does not run jobs with these arguments; the client
+  /// runs vlang instead.
+  Unsupported = 1
+};
+
+/// \brief The socket both ends use unless told otherwise: $VLANGD_SOCKET,
+/// or one in $XDG_RUNTIME_DIR, which only its user can enter, or else one
+/// per user in /tmp.  Anyone can create the latter first, so the client
+/// also checks who it connected to; see connectToServer().
+inline std::string getDefaultSocketPath() {
+  if (const char *Path = ::getenv("VLANGD_SOCKET"))
+    if (*Path)
+      return Path;
+  if (const char *Dir = ::getenv("XDG_RUNTIME_DIR"))
+    if (*Dir)
+      return std::string(Dir) + "/vlangd.sock";
+  char Buffer[64];
+  snprintf(Buffer, sizeof(Buffer), "/tmp/vlangd-%u.sock",
+           (unsigned)::getuid());
+  return Buffer;
+}
+
+/// \brief Fill \p Addr with the address of the socket at \p Path.  Returns
+/// false if the path is too long for a socket address.
+inline bool getSocketAddress(const std::string &Path, sockaddr_un &Addr) {
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  if (Path.size() >= sizeof(Addr.sun_path))
+    return false;
+  memcpy(Addr.sun_path, Path.c_str(), Path.size() + 1);
+  return true;
+}
+
+/// \brief Whether the process at the other end of the connected socket
+/// \p FD runs as the same user as this one.
+inline bool isPeerSameUser(int FD) {
+#if defined(SO_PEERCRED)
+  struct ucred Cred;
+  socklen_t Size = sizeof(Cred);
+  if (::getsockopt(FD, SOL_SOCKET, SO_PEERCRED, &Cred, &Size) != 0 ||
+      Size != sizeof(Cred))
+    return false;
+  return Cred.uid == ::getuid();
+#else
+  uid_t Uid;
+  gid_t Gid;
+  if (::getpeereid(FD, &Uid, &Gid) != 0)
+    return false;
+  return Uid == ::getuid();
+#endif
+}
+
+/// \brief Connect to the server listening at \p Path.  Returns the socket,
+/// or -1 if no server is listening there or it runs as another user, who
+/// could otherwise answer jobs in its place.
+inline int connectToServer(const std::string &Path) {
+  sockaddr_un Addr;
+  if (!getSocketAddress(Path, Addr))
+    return -1;
+  int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0)
+    return -1;
+  if (::connect(FD, (const sockaddr *)&Addr, sizeof(Addr)) != 0 ||
+      !isPeerSameUser(FD)) {
+    ::close(FD);
+    return -1;
+  }
+  return FD;
+}
+
+inline bool writeAll(int FD, const void *Data, size_t Size) {
+  const char *P = (const char *)Data;
+  while (Size) {
+    ssize_t N = ::write(FD, P, Size);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    P += N;
+    Size -= N;
+  }
+  return true;
+}
+
+inline bool readAll(int FD, void *Data, size_t Size) {
+  char *P = (char *)Data;
+  while (Size) {
+    ssize_t N = ::read(FD, P, Size);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    P += N;
+    Size -= N;
+  }
+  return true;
+}
+
+inline bool writeUInt32(int FD, uint32_t V) {
+  return writeAll(FD, &V, sizeof(V));
+}
+
+inline bool readUInt32(int FD, uint32_t &V) {
+  return readAll(FD, &V, sizeof(V));
+}
+
+inline bool writeString(int FD, const std::string &S) {
+  return writeUInt32(FD, S.size()) && writeAll(FD, S.data(), S.size());
+}
+
+inline bool readString(int FD, std::string &S) {
+  uint32_t Size;
+  if (!readUInt32(FD, Size) || Size > MaxStringSize)
+    return false;
+  S.resize(Size);
+  return !Size || readAll(FD, &S[0], Size);
+}
+
+inline bool writeRequest(int FD, const std::vector<std::string> &Strings) {
+  if (!writeUInt32(FD, RequestMagic) || !writeUInt32(FD, Strings.size()))
+    return false;
+  for (size_t i = 0, e = Strings.size(); i != e; ++i)
+    if (!writeString(FD, Strings[i]))
+      return false;
+  return true;
+}
+
+/// \brief Read a request: the working directory of the client first, then
+/// its arguments, without the program name.
+inline bool readRequest(int FD, std::vector<std::string> &Strings) {
+  uint32_t Magic, Count;
+  if (!readUInt32(FD, Magic) || Magic != RequestMagic ||
+      !readUInt32(FD, Count) || Count == 0 || Count > 1U << 20)
+    return false;
+  Strings.resize(Count);
+  for (uint32_t i = 0; i != Count; ++i)
+    if (!readString(FD, Strings[i]))
+      return false;
+  return true;
+}
+
+/// \brief What the server sends back for a request.
+struct Response {
+  uint32_t Status;
+  int32_t ExitCode;
+  std::string Out;
+  std::string Err;
+
+  Response() : Status(Unsupported), ExitCode(0) {}
+};
+
+inline bool writeResponse(int FD, const Response &R) {
+  return writeUInt32(FD, R.Status) && writeUInt32(FD, (uint32_t)R.ExitCode) &&
+         writeString(FD, R.Out) && writeString(FD, R.Err);
+}
+
+inline bool readResponse(int FD, Response &R) {
+  uint32_t ExitCode;
+  if (!readUInt32(FD, R.Status) || !readUInt32(FD, ExitCode) ||
+      !readString(FD, R.Out) || !readString(FD, R.Err))
+    return false;
+  R.ExitCode = (int32_t)ExitCode;
+  return true;
+}
+
+} // end namespace vlangd
+
+#endif
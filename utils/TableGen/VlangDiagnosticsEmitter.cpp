@@ -593,6 +593,37 @@ static std::string getDiagCategoryEnum(llvm::StringRef name) {
   return enumName.str();
 }
   
+/// \brief Collect every diagnostic controlled by \p GroupName, directly or
+/// through its subgroups, in a deterministic order and without duplicates.
+static void computeGroupClosure(const std::string &GroupName,
+                                std::map<std::string, GroupInfo> &DiagsInGroup,
+                                const RecordVec &DiagsInPedantic,
+                                const RecordVec &GroupsInPedantic,
+                                std::set<std::string> &VisitedGroups,
+                                SetVector<const Record*> &Closure) {
+  if (!VisitedGroups.insert(GroupName).second)
+    return;
+
+  std::map<std::string, GroupInfo>::iterator I = DiagsInGroup.find(GroupName);
+  assert(I != DiagsInGroup.end() && "Referenced without existing?");
+  const GroupInfo &GI = I->second;
+  const bool IsPedantic = GroupName == "pedantic";
+
+  Closure.insert(GI.DiagsInGroup.begin(), GI.DiagsInGroup.end());
+  if (IsPedantic)
+    Closure.insert(DiagsInPedantic.begin(), DiagsInPedantic.end());
+
+  for (unsigned i = 0, e = GI.SubGroups.size(); i != e; ++i)
+    computeGroupClosure(GI.SubGroups[i], DiagsInGroup, DiagsInPedantic,
+                        GroupsInPedantic, VisitedGroups, Closure);
+  if (IsPedantic) {
+    for (unsigned i = 0, e = GroupsInPedantic.size(); i != e; ++i)
+      computeGroupClosure(GroupsInPedantic[i]->getValueAsString("GroupName"),
+                          DiagsInGroup, DiagsInPedantic, GroupsInPedantic,
+                          VisitedGroups, Closure);
+  }
+}
+
 namespace vlang {
 void EmitVlangDiagGroups(RecordKeeper &Records, raw_ostream &OS) {
   // Compute a mapping from a DiagGroup to all of its parents.
@@ -662,6 +693,28 @@ void EmitVlangDiagGroups(RecordKeeper &Records, raw_ostream &OS) {
     }
   }
   OS << "#endif // GET_DIAG_ARRAYS\n\n";
+
+  // Emit, for each group, the flattened and deduplicated set of diagnostics it
+  // controls, including those of all its (transitive) subgroups. This lets
+  // -W processing copy a single array instead of walking the group tree.
+  std::set<unsigned> GroupsWithClosure;
+  OS << "\n#ifdef GET_DIAG_ARRAYS\n";
+  for (std::map<std::string, GroupInfo>::iterator
+       I = DiagsInGroup.begin(), E = DiagsInGroup.end(); I != E; ++I) {
+    SetVector<const Record*> Closure;
+    std::set<std::string> VisitedGroups;
+    computeGroupClosure(I->first, DiagsInGroup, DiagsInPedantic,
+                        GroupsInPedantic, VisitedGroups, Closure);
+    if (Closure.empty())
+      continue;
+    GroupsWithClosure.insert(I->second.IDNo);
+
+    OS << "static const short DiagClosure" << I->second.IDNo << "[] = { ";
+    for (unsigned i = 0, e = Closure.size(); i != e; ++i)
+      OS << "diag::" << Closure[i]->getName() << ", ";
+    OS << "-1 };\n";
+  }
+  OS << "#endif // GET_DIAG_ARRAYS\n\n";
   
   // Emit the table now.
   OS << "\n#ifdef GET_DIAG_TABLE\n";
@@ -694,9 +747,15 @@ void EmitVlangDiagGroups(RecordKeeper &Records, raw_ostream &OS) {
     const bool hasSubGroups = !I->second.SubGroups.empty() ||
                               (IsPedantic && !GroupsInPedantic.empty());
     if (!hasSubGroups)
+      OS << "0, ";
+    else
+      OS << "DiagSubGroup" << I->second.IDNo << ", ";
+
+    // Flattened diagnostics.
+    if (!GroupsWithClosure.count(I->second.IDNo))
       OS << 0;
     else
-      OS << "DiagSubGroup" << I->second.IDNo;
+      OS << "DiagClosure" << I->second.IDNo;
     OS << " },\n";
   }
   OS << "#endif // GET_DIAG_TABLE\n\n";